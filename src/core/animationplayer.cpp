@@ -30,6 +30,8 @@
 
 #include "sceneentity.h"
 #include "kuesa_p.h"
+#include "retargetedmappercache_p.h"
+#include "transformtrackanimator_p.h"
 
 #include <Qt3DAnimation/QClipAnimator>
 #include <Qt3DAnimation/QChannelMapping>
@@ -61,6 +63,15 @@ using namespace Qt3DAnimation;
  * than those specified in a mapper. For example, an animation where the clip
  * data affect transformation properties, can be applied to any Qt3DCore::QTransform
  * instance, not just the one specified in the mapper data.
+ *
+ * The mappers generated for explicit targets are shared between all the
+ * AnimationPlayer instances using the same mapper and the same list of
+ * targets.
+ *
+ * When the mapper was imported with
+ * Kuesa::GLTF2Importer::TransformTrackAnimations, the clip is applied to the
+ * Qt3DCore::QTransform and Qt3DCore::QJoint targets directly, sampling all
+ * the channels once per frame rather than going through the animation aspect.
  */
 
 /*!
@@ -251,6 +262,8 @@ AnimationPlayer::AnimationPlayer(Qt3DCore::QNode *parent)
     , m_sceneEntity(nullptr)
     , m_status(None)
     , m_animator(new Qt3DAnimation::QClipAnimator(this))
+    , m_trackAnimator(nullptr)
+    , m_useTrackAnimator(false)
     , m_running(false)
 {
     updateSceneFromParent(parent);
@@ -267,6 +280,7 @@ AnimationPlayer::AnimationPlayer(Qt3DCore::QNode *parent)
 
 AnimationPlayer::~AnimationPlayer()
 {
+    releaseRetargetedMapper();
 }
 
 AnimationPlayer::Status AnimationPlayer::status() const
@@ -400,12 +414,21 @@ void AnimationPlayer::removeTarget(Qt3DCore::QNode *target)
 
 bool AnimationPlayer::isRunning() const
 {
+    if (m_useTrackAnimator)
+        return m_trackAnimator->state() == QAbstractAnimation::Running;
     return m_animator->isRunning();
 }
 
 void AnimationPlayer::setRunning(bool running)
 {
-    m_animator->setRunning(running);
+    if (m_useTrackAnimator) {
+        if (running)
+            m_trackAnimator->start();
+        else
+            m_trackAnimator->stop();
+    } else {
+        m_animator->setRunning(running);
+    }
     m_running = running;
 }
 
@@ -417,6 +440,8 @@ int AnimationPlayer::loopCount() const
 void AnimationPlayer::setLoopCount(int loops)
 {
     m_animator->setLoopCount(loops);
+    if (m_trackAnimator)
+        m_trackAnimator->setLoopCount(loops);
 }
 
 QClock *AnimationPlayer::clock() const
@@ -427,16 +452,23 @@ QClock *AnimationPlayer::clock() const
 void AnimationPlayer::setClock(QClock *clock)
 {
     m_animator->setClock(clock);
+    if (m_trackAnimator)
+        m_trackAnimator->setClock(clock);
 }
 
 float AnimationPlayer::normalizedTime() const
 {
+    if (m_useTrackAnimator)
+        return m_trackAnimator->normalizedTime();
     return m_animator->normalizedTime();
 }
 
 void AnimationPlayer::setNormalizedTime(float timeFraction)
 {
-    m_animator->setNormalizedTime(timeFraction);
+    if (m_useTrackAnimator)
+        m_trackAnimator->setNormalizedTime(timeFraction);
+    else
+        m_animator->setNormalizedTime(timeFraction);
 }
 
 /*!
@@ -444,7 +476,10 @@ void AnimationPlayer::setNormalizedTime(float timeFraction)
  */
 void AnimationPlayer::start()
 {
-    m_animator->start();
+    if (m_useTrackAnimator)
+        m_trackAnimator->start();
+    else
+        m_animator->start();
 }
 
 /*!
@@ -452,17 +487,22 @@ void AnimationPlayer::start()
  */
 void AnimationPlayer::stop()
 {
-    m_animator->stop();
+    if (m_useTrackAnimator)
+        m_trackAnimator->stop();
+    else
+        m_animator->stop();
 }
 
 void AnimationPlayer::matchClipAndTargets()
 {
     if (m_sceneEntity == nullptr) {
+        clearMapping();
         setStatus(Error);
         return;
     }
 
     if (m_clip.isEmpty() && m_mapper.isEmpty()) {
+        clearMapping();
         setStatus(Error);
         return;
     }
@@ -472,6 +512,7 @@ void AnimationPlayer::matchClipAndTargets()
 
     if (!clip || !mapper) {
         qCWarning(kuesa, "Undefined clip or mapper in AnimationPlayer");
+        clearMapping();
         setStatus(Error);
         return;
     }
@@ -491,6 +532,7 @@ void AnimationPlayer::matchClipAndTargets()
                 return (value.name() == mappingChannel);
             });
             if (it == clip->clipData().end()) {
+                clearMapping();
                 setStatus(Error);
                 qCWarning(kuesa, "Mapped property %i does not match any clip", mappingId);
                 return;
@@ -500,11 +542,17 @@ void AnimationPlayer::matchClipAndTargets()
 
     m_animator->setClip(clip);
 
+    // Mappers imported in transform track mode are played by applying the
+    // sampled values directly to the targets
+    const bool transformTracks = qobject_cast<TransformTrackMapper *>(mapper) != nullptr;
+
     if (m_targets.isEmpty()) {
         m_animator->setChannelMapper(mapper);
+        releaseRetargetedMapper();
     } else {
         // If we have different number of targets than of mapping, disable, since we can't know which target we want for each mapping
         if (m_targets.size() != numMappings) {
+            clearMapping();
             setStatus(Error);
             qCWarning(kuesa, "Number of targets and mappings need to match");
             return;
@@ -517,6 +565,7 @@ void AnimationPlayer::matchClipAndTargets()
 
             // Verify the target node has the property the mapping is animating
             if (mapping != nullptr && !targetNode->property(mapping->property().toStdString().c_str()).isValid()) {
+                clearMapping();
                 setStatus(Error);
                 qCWarning(kuesa, "Mapped property %i does not match any property on target node", mappingId);
                 return;
@@ -524,22 +573,68 @@ void AnimationPlayer::matchClipAndTargets()
         }
 
         // If everything matches and we can animate the targets using the mapping and the clip,
-        // create a new mapper to use those targets
-        Qt3DAnimation::QChannelMapper *newMapper = new Qt3DAnimation::QChannelMapper;
-        for (int mappingId = 0; mappingId < mappings.size(); ++mappingId) {
-            Qt3DAnimation::QChannelMapping *oldMapping = qobject_cast<Qt3DAnimation::QChannelMapping *>(mappings.at(mappingId));
-            if (!oldMapping)
-                continue;
-            Qt3DAnimation::QChannelMapping *newMapping = new Qt3DAnimation::QChannelMapping;
-            newMapping->setChannelName(oldMapping->channelName());
-            newMapping->setProperty(oldMapping->property());
-            newMapping->setTarget(m_targets.at(mappingId));
-            newMapper->addMapping(newMapping);
-        }
-
+        // retrieve a mapper using those targets. Players sharing the same mapper and
+        // targets will share the same retargeted mapper instance
+        Qt3DAnimation::QChannelMapper *newMapper = RetargetedMapperCache::instance()->acquire(mapper, m_targets);
         m_animator->setChannelMapper(newMapper);
+        releaseRetargetedMapper();
+        m_retargetedMapper = newMapper;
+    }
+
+    bool useTrackAnimator = false;
+    if (transformTracks) {
+        if (!m_trackAnimator) {
+            m_trackAnimator = new TransformTrackAnimator(this);
+            m_trackAnimator->setLoopCount(m_animator->loopCount());
+            m_trackAnimator->setClock(m_animator->clock());
+            connect(m_trackAnimator, &QAbstractAnimation::stateChanged, this, [this](QAbstractAnimation::State newState) {
+                emit runningChanged(newState == QAbstractAnimation::Running);
+            });
+        }
+        useTrackAnimator = m_trackAnimator->setClip(clip, m_animator->channelMapper());
+        if (!useTrackAnimator)
+            qCWarning(kuesa, "Mapper can't be played as transform tracks, falling back to the animation aspect");
     }
+    setUseTrackAnimator(useTrackAnimator);
 
-    m_animator->setRunning(m_running);
+    setRunning(m_running);
     setStatus(Ready);
 }
+
+void AnimationPlayer::setUseTrackAnimator(bool useTrackAnimator)
+{
+    if (m_useTrackAnimator == useTrackAnimator)
+        return;
+
+    // Only one of the animators may drive the targets
+    if (useTrackAnimator)
+        m_animator->setRunning(false);
+    else
+        m_trackAnimator->stop();
+    m_useTrackAnimator = useTrackAnimator;
+}
+
+/*!
+ * \internal
+ *
+ * Detaches the current mapping from both animators and releases the
+ * retargeted mapper so that a player in the Error state no longer drives the
+ * targets it matched previously.
+ */
+void AnimationPlayer::clearMapping()
+{
+    m_animator->setChannelMapper(nullptr);
+    if (m_trackAnimator)
+        m_trackAnimator->setClip(nullptr, nullptr);
+    setUseTrackAnimator(false);
+    releaseRetargetedMapper();
+}
+
+void AnimationPlayer::releaseRetargetedMapper()
+{
+    // Mapper might already have been destroyed if its source mapper
+    // or one of the targets went away
+    if (!m_retargetedMapper.isNull())
+        RetargetedMapperCache::instance()->release(m_retargetedMapper.data());
+    m_retargetedMapper.clear();
+}
@@ -30,17 +30,20 @@
 #define KUESA_ANIMATIONPLAYER_H
 
 #include <Qt3DCore/QNode>
+#include <QtCore/QPointer>
 #include <Kuesa/kuesa_global.h>
 
 QT_BEGIN_NAMESPACE
 
 namespace Qt3DAnimation {
 class QClipAnimator;
+class QChannelMapper;
 class QClock;
 } // namespace Qt3DAnimation
 
 namespace Kuesa {
 class SceneEntity;
+class TransformTrackAnimator;
 
 class KUESASHARED_EXPORT AnimationPlayer : public Qt3DCore::QNode
 {
@@ -106,6 +109,9 @@ private:
     void matchClipAndTargets();
     void setStatus(Status status);
     void updateSceneFromParent(Qt3DCore::QNode *parent);
+    void clearMapping();
+    void releaseRetargetedMapper();
+    void setUseTrackAnimator(bool useTrackAnimator);
 
     SceneEntity *m_sceneEntity;
     Status m_status;
@@ -113,6 +119,9 @@ private:
     QString m_mapper;
     QVector<Qt3DCore::QNode *> m_targets;
     Qt3DAnimation::QClipAnimator *m_animator;
+    QPointer<Qt3DAnimation::QChannelMapper> m_retargetedMapper;
+    TransformTrackAnimator *m_trackAnimator;
+    bool m_useTrackAnimator;
     bool m_running;
 };
 
@@ -0,0 +1,206 @@
+/*
+    animationsampler.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "animationsampler_p.h"
+
+#include <Qt3DAnimation/QAnimationClipData>
+#include <Qt3DAnimation/QChannel>
+#include <Qt3DAnimation/QChannelComponent>
+
+#include <algorithm>
+#include <cmath>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Qt3DAnimation;
+
+namespace Kuesa {
+
+namespace {
+
+// Returns the parameter u in [0, 1] for which the x coordinate of the
+// bezier curve defined by x0, x1, x2, x3 equals x. The curve is expected to
+// be monotonic in x, which is the case for the handles we generate.
+float findBezierParameter(float x0, float x1, float x2, float x3, float x)
+{
+    const float epsilon = 1.0e-6f;
+    float lower = 0.0f;
+    float upper = 1.0f;
+    float u = (x - x0) / (x3 - x0);
+
+    for (int i = 0; i < 8; ++i) {
+        const float v = 1.0f - u;
+        const float value = v * v * v * x0 + 3.0f * v * v * u * x1 + 3.0f * v * u * u * x2 + u * u * u * x3 - x;
+        if (std::abs(value) < epsilon)
+            return u;
+        if (value > 0.0f)
+            upper = u;
+        else
+            lower = u;
+        const float derivative = 3.0f * (v * v * (x1 - x0) + 2.0f * v * u * (x2 - x1) + u * u * (x3 - x2));
+        const float next = u - value / derivative;
+        // Fall back to bisection when Newton leaves the bracket
+        u = (derivative == 0.0f || next <= lower || next >= upper) ? 0.5f * (lower + upper) : next;
+    }
+    return u;
+}
+
+float bezier(float p0, float p1, float p2, float p3, float u)
+{
+    const float v = 1.0f - u;
+    return v * v * v * p0 + 3.0f * v * v * u * p1 + 3.0f * v * u * u * p2 + u * u * u * p3;
+}
+
+} // namespace
+
+AnimationSampler::AnimationSampler()
+    : m_duration(0.0f)
+{
+}
+
+AnimationSampler::AnimationSampler(const QAnimationClipData &clipData)
+    : m_duration(0.0f)
+{
+    m_channels.reserve(clipData.channelCount());
+    for (const QChannel &channel : clipData) {
+        m_channels.push_back({ channel.name(), m_components.size(), channel.channelComponentCount() });
+        for (const QChannelComponent &channelComponent : channel) {
+            m_components.push_back({ m_keyFrames.size(), channelComponent.keyFrameCount() });
+            for (const QKeyFrame &keyFrame : channelComponent) {
+                const QVector2D coordinates = keyFrame.coordinates();
+                const QVector2D rightHandle = keyFrame.rightControlPoint();
+                const QVector2D leftHandle = keyFrame.leftControlPoint();
+                m_keyFrames.push_back({ coordinates.x(), coordinates.y(),
+                                        rightHandle.x(), rightHandle.y(),
+                                        leftHandle.x(), leftHandle.y(),
+                                        keyFrame.interpolationType() });
+                m_duration = std::max(m_duration, coordinates.x());
+            }
+        }
+    }
+}
+
+float AnimationSampler::duration() const
+{
+    return m_duration;
+}
+
+int AnimationSampler::channelCount() const
+{
+    return m_channels.size();
+}
+
+// Number of values written by each sample
+int AnimationSampler::componentCount() const
+{
+    return m_components.size();
+}
+
+int AnimationSampler::channelIndex(const QString &name) const
+{
+    for (int i = 0, m = m_channels.size(); i < m; ++i) {
+        if (m_channels.at(i).name == name)
+            return i;
+    }
+    return -1;
+}
+
+QString AnimationSampler::channelName(int channel) const
+{
+    return m_channels.at(channel).name;
+}
+
+int AnimationSampler::channelOffset(int channel) const
+{
+    return m_channels.at(channel).firstComponent;
+}
+
+int AnimationSampler::channelComponentCount(int channel) const
+{
+    return m_channels.at(channel).componentCount;
+}
+
+// values must hold at least componentCount() floats
+void AnimationSampler::sample(float time, float *values) const
+{
+    for (const Component &component : m_components)
+        *values++ = sampleComponent(component, time);
+}
+
+QVector<float> AnimationSampler::sample(float time) const
+{
+    QVector<float> values(m_components.size());
+    sample(time, values.data());
+    return values;
+}
+
+// values must hold at least sampleCount * componentCount() floats
+void AnimationSampler::sampleRange(float startTime, float timeStep, int sampleCount, float *values) const
+{
+    const int stride = m_components.size();
+    for (int i = 0; i < sampleCount; ++i)
+        sample(startTime + float(i) * timeStep, values + i * stride);
+}
+
+float AnimationSampler::sampleComponent(const Component &component, float time) const
+{
+    const int count = component.keyFrameCount;
+    if (count == 0)
+        return 0.0f;
+
+    const KeyFrame *keyFrames = m_keyFrames.constData() + component.firstKeyFrame;
+    if (time <= keyFrames[0].time)
+        return keyFrames[0].value;
+    if (time >= keyFrames[count - 1].time)
+        return keyFrames[count - 1].value;
+
+    // Find the segment [k0, k1] containing time
+    const KeyFrame *next = std::upper_bound(keyFrames, keyFrames + count, time, [](float t, const KeyFrame &keyFrame) {
+        return t < keyFrame.time;
+    });
+    const KeyFrame &k0 = *(next - 1);
+    const KeyFrame &k1 = *next;
+
+    switch (k0.interpolation) {
+    case QKeyFrame::ConstantInterpolation:
+        return k0.value;
+    case QKeyFrame::LinearInterpolation: {
+        const float u = (time - k0.time) / (k1.time - k0.time);
+        return k0.value + u * (k1.value - k0.value);
+    }
+    case QKeyFrame::BezierInterpolation: {
+        const float u = findBezierParameter(k0.time, k0.rightTime, k1.leftTime, k1.time, time);
+        return bezier(k0.value, k0.rightValue, k1.leftValue, k1.value, u);
+    }
+    }
+    return k0.value;
+}
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
@@ -0,0 +1,119 @@
+/*
+    animationsampler_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_ANIMATIONSAMPLER_P_H
+#define KUESA_ANIMATIONSAMPLER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Kuesa API.  It exists for the convenience
+// of other Kuesa classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <Qt3DAnimation/QKeyFrame>
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DAnimation {
+class QAnimationClipData;
+} // namespace Qt3DAnimation
+
+namespace Kuesa {
+
+// Evaluates clip data on the CPU, outside of the Qt3D animation aspect,
+// following the same rules: values are clamped before the first and after
+// the last key frame and the interpolation of a segment is given by the
+// key frame starting it.
+//
+// Key frames are flattened at construction. Sampling doesn't modify the
+// sampler, the same time always yields the same values and a sampler can
+// be shared between threads.
+//
+// Sampled values are written in a flat array holding the components of all
+// channels one after the other, in the order of the clip data. Rotation
+// channels are written as is (scalar part first) and aren't normalized.
+class Q_AUTOTEST_EXPORT AnimationSampler
+{
+public:
+    AnimationSampler();
+    explicit AnimationSampler(const Qt3DAnimation::QAnimationClipData &clipData);
+
+    float duration() const;
+    int channelCount() const;
+    int componentCount() const;
+    int channelIndex(const QString &name) const;
+    QString channelName(int channel) const;
+    int channelOffset(int channel) const;
+    int channelComponentCount(int channel) const;
+
+    void sample(float time, float *values) const;
+    QVector<float> sample(float time) const;
+    void sampleRange(float startTime, float timeStep, int sampleCount, float *values) const;
+
+private:
+    struct KeyFrame {
+        float time;
+        float value;
+        float rightTime;
+        float rightValue;
+        float leftTime;
+        float leftValue;
+        Qt3DAnimation::QKeyFrame::InterpolationType interpolation;
+    };
+
+    struct Component {
+        int firstKeyFrame;
+        int keyFrameCount;
+    };
+
+    struct Channel {
+        QString name;
+        int firstComponent;
+        int componentCount;
+    };
+
+    float sampleComponent(const Component &component, float time) const;
+
+    QVector<KeyFrame> m_keyFrames;
+    QVector<Component> m_components;
+    QVector<Channel> m_channels;
+    float m_duration;
+};
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_ANIMATIONSAMPLER_P_H
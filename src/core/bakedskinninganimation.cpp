@@ -0,0 +1,499 @@
+/*
+    bakedskinninganimation.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "bakedskinninganimation.h"
+#include "bakedskinninganimation_p.h"
+
+#include "sceneentity.h"
+#include "metallicroughnessmaterial.h"
+#include "animationsampler_p.h"
+#include "kuesa_p.h"
+
+#include <Qt3DCore/QJoint>
+#include <Qt3DCore/QSkeleton>
+#include <Qt3DRender/QTexture>
+#include <Qt3DRender/QTextureImageData>
+#include <Qt3DRender/QParameter>
+#include <Qt3DAnimation/QAnimationClip>
+#include <Qt3DAnimation/QChannelMapper>
+#include <Qt3DAnimation/QChannelMapping>
+
+#include <QtCore/qmath.h>
+
+QT_USE_NAMESPACE
+using namespace Kuesa;
+
+/*!
+ * \class Kuesa::BakedSkinningAnimation
+ * \inheaderfile Kuesa/BakedSkinningAnimation
+ * \inmodule Kuesa
+ * \since 1.0
+ * \brief Bakes skeletal animations into a texture for crowds of identical
+ * skinned characters
+ *
+ * Each skinned character normally comes with its own Qt3DCore::QArmature and
+ * Qt3DCore::QSkeleton, which means its joint hierarchy is evaluated on the
+ * CPU every frame. When many instances of the same character play the same
+ * animations, BakedSkinningAnimation can be used instead: the clips are
+ * sampled once at framesPerSecond and the resulting skinning matrices are
+ * stored in a floating point texture, one row per frame and three texels per
+ * joint.
+ *
+ * Materials attached with attach() then select the baked skinning vertex
+ * shader, which fetches the joint matrices from the texture at the current
+ * time. Every attached material shares the texture and time parameters,
+ * advancing the animation of all instances therefore only requires updating
+ * the time property. Each material only holds which clip it plays and a time
+ * offset, so that instances don't all move in sync.
+ *
+ * \note Baked skinning requires texelFetch and floating point textures and
+ * is therefore not available with OpenGL ES 2, where the meshes are rendered
+ * in their bind pose.
+ */
+
+/*!
+ * \qmltype BakedSkinningAnimation
+ * \inqmlmodule Kuesa
+ * \since 1.0
+ * \instantiates Kuesa::BakedSkinningAnimation
+ * \brief Bakes skeletal animations into a texture for crowds of identical
+ * skinned characters
+ *
+ * Clips are sampled once at framesPerSecond and the resulting skinning
+ * matrices are stored in a floating point texture. Materials attached with
+ * attach() fetch the joint matrices from the texture at the current time.
+ */
+
+/*!
+    \property BakedSkinningAnimation::framesPerSecond
+    \brief the rate at which clips are sampled when baked
+
+    Changing this value only affects clips baked afterwards.
+ */
+
+/*!
+    \qmlproperty float BakedSkinningAnimation::framesPerSecond
+    \brief the rate at which clips are sampled when baked
+ */
+
+/*!
+    \property BakedSkinningAnimation::time
+    \brief the current animation time, in seconds, shared by all attached materials
+ */
+
+/*!
+    \qmlproperty float BakedSkinningAnimation::time
+    \brief the current animation time, in seconds, shared by all attached materials
+ */
+
+/*!
+    \property BakedSkinningAnimation::jointCount
+    \brief the number of joints of the skeleton used to bake clips
+ */
+
+/*!
+    \property BakedSkinningAnimation::clipCount
+    \brief the number of baked clips
+ */
+
+/*!
+    \property BakedSkinningAnimation::texture
+    \brief the texture holding the baked skinning matrices
+ */
+
+BakedSkinningTextureDataGenerator::BakedSkinningTextureDataGenerator(const QVector<float> &data, int width, int height)
+    : m_data(data)
+    , m_width(width)
+    , m_height(height)
+{
+}
+
+Qt3DRender::QTextureImageDataPtr BakedSkinningTextureDataGenerator::operator()()
+{
+    Qt3DRender::QTextureImageDataPtr imageData = Qt3DRender::QTextureImageDataPtr::create();
+    imageData->setTarget(QOpenGLTexture::Target2D);
+    imageData->setFormat(QOpenGLTexture::RGBA32F);
+    imageData->setPixelFormat(QOpenGLTexture::RGBA);
+    imageData->setPixelType(QOpenGLTexture::Float32);
+    imageData->setWidth(m_width);
+    imageData->setHeight(m_height);
+    imageData->setDepth(1);
+    imageData->setFaces(1);
+    imageData->setLayers(1);
+    imageData->setMipLevels(1);
+
+    QByteArray bytes(reinterpret_cast<const char *>(m_data.constData()), m_data.size() * int(sizeof(float)));
+    bytes.resize(m_width * m_height * 4 * int(sizeof(float)));
+    imageData->setData(bytes, 4 * int(sizeof(float)));
+    return imageData;
+}
+
+bool BakedSkinningTextureDataGenerator::operator==(const Qt3DRender::QTextureImageDataGenerator &other) const
+{
+    const auto otherFunctor = Qt3DRender::functor_cast<BakedSkinningTextureDataGenerator>(&other);
+    // Qt3D shares the textures of equal generators, which must then hold the
+    // same data. Copies of the same vector compare without reading it
+    return otherFunctor != nullptr && otherFunctor->m_width == m_width &&
+            otherFunctor->m_height == m_height && otherFunctor->m_data == m_data;
+}
+
+BakedSkinningTextureImage::BakedSkinningTextureImage(Qt3DCore::QNode *parent)
+    : Qt3DRender::QAbstractTextureImage(parent)
+    , m_width(1)
+    , m_height(1)
+{
+}
+
+void BakedSkinningTextureImage::setData(const QVector<float> &data, int width, int height)
+{
+    m_data = data;
+    m_width = width;
+    m_height = height;
+    notifyDataGeneratorChanged();
+}
+
+Qt3DRender::QTextureImageDataGeneratorPtr BakedSkinningTextureImage::dataGenerator() const
+{
+    return Qt3DRender::QTextureImageDataGeneratorPtr(new BakedSkinningTextureDataGenerator(m_data, m_width, m_height));
+}
+
+BakedSkinningAnimation::BakedSkinningAnimation(Qt3DCore::QNode *parent)
+    : Qt3DCore::QNode(parent)
+    , m_framesPerSecond(30.0f)
+    , m_jointCount(0)
+    , m_texture(new Qt3DRender::QTexture2D(this))
+    , m_textureImage(new BakedSkinningTextureImage(m_texture))
+    , m_textureParameter(new Qt3DRender::QParameter(QStringLiteral("bakedSkinningTexture"), m_texture, this))
+    , m_timeParameter(new Qt3DRender::QParameter(QStringLiteral("bakedSkinningTime"), 0.0f, this))
+{
+    m_texture->setFormat(Qt3DRender::QAbstractTexture::RGBA32F);
+    m_texture->setGenerateMipMaps(false);
+    m_texture->setMinificationFilter(Qt3DRender::QAbstractTexture::Nearest);
+    m_texture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Nearest);
+    m_texture->wrapMode()->setX(Qt3DRender::QTextureWrapMode::ClampToEdge);
+    m_texture->wrapMode()->setY(Qt3DRender::QTextureWrapMode::ClampToEdge);
+    m_texture->setSize(1, 1);
+    m_texture->addTextureImage(m_textureImage);
+}
+
+BakedSkinningAnimation::~BakedSkinningAnimation()
+{
+}
+
+float BakedSkinningAnimation::framesPerSecond() const
+{
+    return m_framesPerSecond;
+}
+
+void BakedSkinningAnimation::setFramesPerSecond(float framesPerSecond)
+{
+    if (qFuzzyCompare(m_framesPerSecond, framesPerSecond) || framesPerSecond <= 0.0f)
+        return;
+    m_framesPerSecond = framesPerSecond;
+    emit framesPerSecondChanged(framesPerSecond);
+}
+
+float BakedSkinningAnimation::time() const
+{
+    return m_timeParameter->value().toFloat();
+}
+
+void BakedSkinningAnimation::setTime(float time)
+{
+    if (qFuzzyCompare(this->time(), time))
+        return;
+    m_timeParameter->setValue(time);
+    emit timeChanged(time);
+}
+
+int BakedSkinningAnimation::jointCount() const
+{
+    return m_jointCount;
+}
+
+int BakedSkinningAnimation::clipCount() const
+{
+    return m_clips.size();
+}
+
+Qt3DRender::QAbstractTexture *BakedSkinningAnimation::texture() const
+{
+    return m_texture;
+}
+
+/*!
+ * Samples \a clip, whose channels are mapped to the joints of \a skeleton by
+ * \a mapper, and appends the resulting skinning matrices to the texture.
+ *
+ * All the clips baked in the same instance must animate skeletons with the
+ * same number of joints.
+ *
+ * Returns the index of the baked clip or -1 if the clip could not be baked.
+ */
+int BakedSkinningAnimation::addClip(Qt3DAnimation::QAnimationClip *clip,
+                                    Qt3DAnimation::QChannelMapper *mapper,
+                                    Qt3DCore::QSkeleton *skeleton)
+{
+    if (!clip || !mapper || !skeleton || !skeleton->rootJoint()) {
+        qCWarning(kuesa, "BakedSkinningAnimation requires a clip, a mapper and a skeleton with a root joint");
+        return -1;
+    }
+
+    // Flatten the joint hierarchy in depth first order, which matches the
+    // indices of the skinning palette
+    QVector<Qt3DCore::QJoint *> joints;
+    QVector<int> parents;
+    QHash<Qt3DCore::QNode *, int> jointIndices;
+    QVector<QPair<Qt3DCore::QJoint *, int>> stack = { { skeleton->rootJoint(), -1 } };
+    while (!stack.isEmpty()) {
+        const QPair<Qt3DCore::QJoint *, int> entry = stack.takeLast();
+        const int jointIdx = joints.size();
+        jointIndices.insert(entry.first, jointIdx);
+        joints.push_back(entry.first);
+        parents.push_back(entry.second);
+        const QVector<Qt3DCore::QJoint *> children = entry.first->childJoints();
+        for (int i = children.size() - 1; i >= 0; --i)
+            stack.push_back({ children.at(i), jointIdx });
+    }
+
+    if (m_jointCount != 0 && m_jointCount != joints.size()) {
+        qCWarning(kuesa, "BakedSkinningAnimation: all baked clips must use skeletons with the same number of joints");
+        return -1;
+    }
+
+    // Find which channels of the clip animate which joint
+    struct JointTracks {
+        int translation = -1;
+        int rotation = -1;
+        int scale = -1;
+    };
+    const AnimationSampler sampler(clip->clipData());
+    QVector<JointTracks> tracks(joints.size());
+    const QVector<Qt3DAnimation::QAbstractChannelMapping *> mappings = mapper->mappings();
+    for (Qt3DAnimation::QAbstractChannelMapping *abstractMapping : mappings) {
+        auto mapping = qobject_cast<Qt3DAnimation::QChannelMapping *>(abstractMapping);
+        if (!mapping)
+            continue;
+        const int jointIdx = jointIndices.value(mapping->target(), -1);
+        const int channelIdx = sampler.channelIndex(mapping->channelName());
+        if (jointIdx < 0 || channelIdx < 0)
+            continue;
+        const QString property = mapping->property();
+        const int offset = sampler.channelOffset(channelIdx);
+        if (property == QLatin1String("translation"))
+            tracks[jointIdx].translation = offset;
+        else if (property == QLatin1String("rotation"))
+            tracks[jointIdx].rotation = offset;
+        else if (property == QLatin1String("scale"))
+            tracks[jointIdx].scale = offset;
+    }
+
+    BakedClip bakedClip;
+    bakedClip.firstFrame = m_clips.isEmpty() ? 0 : m_clips.last().firstFrame + m_clips.last().frameCount;
+    bakedClip.duration = sampler.duration();
+    bakedClip.frameCount = bakedClip.duration > 0.0f ? qCeil(bakedClip.duration * m_framesPerSecond) + 1 : 1;
+
+    const int jointCount = joints.size();
+    m_data.reserve(m_data.size() + bakedClip.frameCount * jointCount * 12);
+    QVector<QMatrix4x4> globalTransforms(jointCount);
+    QVector<float> values(sampler.componentCount());
+    for (int frame = 0; frame < bakedClip.frameCount; ++frame) {
+        const float time = bakedClip.frameCount > 1 ? bakedClip.duration * float(frame) / float(bakedClip.frameCount - 1) : 0.0f;
+        sampler.sample(time, values.data());
+
+        for (int jointIdx = 0; jointIdx < jointCount; ++jointIdx) {
+            const Qt3DCore::QJoint *joint = joints.at(jointIdx);
+            const JointTracks &jointTracks = tracks.at(jointIdx);
+
+            QMatrix4x4 localTransform;
+            if (jointTracks.translation >= 0) {
+                const float *t = values.constData() + jointTracks.translation;
+                localTransform.translate(t[0], t[1], t[2]);
+            } else {
+                localTransform.translate(joint->translation());
+            }
+            if (jointTracks.rotation >= 0) {
+                // Rotation components are stored with the scalar part first
+                const float *r = values.constData() + jointTracks.rotation;
+                localTransform.rotate(QQuaternion(r[0], r[1], r[2], r[3]).normalized());
+            } else {
+                localTransform.rotate(joint->rotation());
+            }
+            if (jointTracks.scale >= 0) {
+                const float *s = values.constData() + jointTracks.scale;
+                localTransform.scale(s[0], s[1], s[2]);
+            } else {
+                localTransform.scale(joint->scale());
+            }
+
+            const int parentIdx = parents.at(jointIdx);
+            globalTransforms[jointIdx] = parentIdx >= 0 ? globalTransforms.at(parentIdx) * localTransform : localTransform;
+
+            // Only the first three rows are stored, the last one is always (0, 0, 0, 1)
+            const QMatrix4x4 skinningMatrix = globalTransforms.at(jointIdx) * joint->inverseBindMatrix();
+            for (int row = 0; row < 3; ++row) {
+                for (int column = 0; column < 4; ++column)
+                    m_data.push_back(skinningMatrix(row, column));
+            }
+        }
+    }
+
+    m_jointCount = jointCount;
+    m_clips.push_back(bakedClip);
+
+    const int width = 3 * m_jointCount;
+    const int height = bakedClip.firstFrame + bakedClip.frameCount;
+    m_texture->setSize(width, height);
+    m_textureImage->setData(m_data, width, height);
+
+    emit bakedDataChanged();
+    return m_clips.size() - 1;
+}
+
+/*!
+ * Convenience overload looking up the clip and the mapper named \a clip and
+ * the skeleton named \a skeleton in the collections of \a sceneEntity.
+ */
+int BakedSkinningAnimation::addClip(SceneEntity *sceneEntity, const QString &clip, const QString &skeleton)
+{
+    if (!sceneEntity) {
+        qCWarning(kuesa, "BakedSkinningAnimation requires a SceneEntity to look up assets");
+        return -1;
+    }
+    return addClip(qobject_cast<Qt3DAnimation::QAnimationClip *>(sceneEntity->animationClip(clip)),
+                   sceneEntity->animationMapping(clip),
+                   qobject_cast<Qt3DCore::QSkeleton *>(sceneEntity->skeleton(skeleton)));
+}
+
+/*!
+ * Removes all the baked clips. Materials which were attached to a clip should
+ * be attached again once new clips are baked.
+ */
+void BakedSkinningAnimation::clear()
+{
+    m_clips.clear();
+    m_data.clear();
+    m_jointCount = 0;
+    m_texture->setSize(1, 1);
+    m_textureImage->setData(m_data, 1, 1);
+    emit bakedDataChanged();
+}
+
+/*!
+ * Returns the row of the texture holding the first frame of \a clip.
+ */
+int BakedSkinningAnimation::clipFirstFrame(int clip) const
+{
+    return (clip >= 0 && clip < m_clips.size()) ? m_clips.at(clip).firstFrame : -1;
+}
+
+/*!
+ * Returns the number of frames baked for \a clip.
+ */
+int BakedSkinningAnimation::clipFrameCount(int clip) const
+{
+    return (clip >= 0 && clip < m_clips.size()) ? m_clips.at(clip).frameCount : 0;
+}
+
+/*!
+ * Returns the duration in seconds of \a clip.
+ */
+float BakedSkinningAnimation::clipDuration(int clip) const
+{
+    return (clip >= 0 && clip < m_clips.size()) ? m_clips.at(clip).duration : 0.0f;
+}
+
+/*!
+ * Returns the skinning matrix baked for \a joint at \a frame of \a clip.
+ */
+QMatrix4x4 BakedSkinningAnimation::skinningMatrix(int clip, int frame, int joint) const
+{
+    if (clip < 0 || clip >= m_clips.size() || frame < 0 || frame >= m_clips.at(clip).frameCount || joint < 0 || joint >= m_jointCount)
+        return QMatrix4x4();
+
+    const float *values = m_data.constData() + ((m_clips.at(clip).firstFrame + frame) * m_jointCount + joint) * 12;
+    return QMatrix4x4(values[0], values[1], values[2], values[3],
+                      values[4], values[5], values[6], values[7],
+                      values[8], values[9], values[10], values[11],
+                      0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+QVector4D BakedSkinningAnimation::clipParameterValue(int clip, float timeOffset) const
+{
+    return QVector4D(clipFirstFrame(clip), clipFrameCount(clip), clipDuration(clip), timeOffset);
+}
+
+/*!
+ * Configures \a material to play \a clip from the baked texture, offset by
+ * \a timeOffset seconds. The texture and time parameters are shared between
+ * all the attached materials.
+ */
+void BakedSkinningAnimation::attach(MetallicRoughnessMaterial *material, int clip, float timeOffset)
+{
+    if (!material)
+        return;
+
+    if (clip < 0 || clip >= m_clips.size()) {
+        qCWarning(kuesa, "BakedSkinningAnimation: invalid clip index %i", clip);
+        return;
+    }
+
+    Qt3DRender::QParameter *clipParameter = m_clipParameters.value(material, nullptr);
+    if (clipParameter) {
+        clipParameter->setValue(clipParameterValue(clip, timeOffset));
+        return;
+    }
+
+    clipParameter = new Qt3DRender::QParameter(QStringLiteral("bakedSkinningClip"), clipParameterValue(clip, timeOffset), material);
+    m_clipParameters.insert(material, clipParameter);
+    connect(material, &QObject::destroyed, this, [this, material] {
+        m_clipParameters.remove(material);
+    });
+
+    material->addParameter(m_textureParameter);
+    material->addParameter(m_timeParameter);
+    material->addParameter(clipParameter);
+    material->setUseBakedSkinning(true);
+}
+
+/*!
+ * Restores \a material to its regular skinning path.
+ */
+void BakedSkinningAnimation::detach(MetallicRoughnessMaterial *material)
+{
+    Qt3DRender::QParameter *clipParameter = m_clipParameters.take(material);
+    if (!clipParameter)
+        return;
+
+    disconnect(material, nullptr, this, nullptr);
+    material->removeParameter(m_textureParameter);
+    material->removeParameter(m_timeParameter);
+    material->removeParameter(clipParameter);
+    delete clipParameter;
+    material->setUseBakedSkinning(false);
+}
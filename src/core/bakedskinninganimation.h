@@ -0,0 +1,124 @@
+/*
+    bakedskinninganimation.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_BAKEDSKINNINGANIMATION_H
+#define KUESA_BAKEDSKINNINGANIMATION_H
+
+#include <Qt3DCore/QNode>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QVector4D>
+#include <QtCore/QHash>
+#include <Kuesa/kuesa_global.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DCore {
+class QSkeleton;
+}
+
+namespace Qt3DRender {
+class QAbstractTexture;
+class QParameter;
+} // namespace Qt3DRender
+
+namespace Qt3DAnimation {
+class QAnimationClip;
+class QChannelMapper;
+} // namespace Qt3DAnimation
+
+namespace Kuesa {
+class SceneEntity;
+class MetallicRoughnessMaterial;
+class BakedSkinningTextureImage;
+
+class KUESASHARED_EXPORT BakedSkinningAnimation : public Qt3DCore::QNode
+{
+    Q_OBJECT
+    Q_PROPERTY(float framesPerSecond READ framesPerSecond WRITE setFramesPerSecond NOTIFY framesPerSecondChanged)
+    Q_PROPERTY(float time READ time WRITE setTime NOTIFY timeChanged)
+    Q_PROPERTY(int jointCount READ jointCount NOTIFY bakedDataChanged)
+    Q_PROPERTY(int clipCount READ clipCount NOTIFY bakedDataChanged)
+    Q_PROPERTY(Qt3DRender::QAbstractTexture *texture READ texture CONSTANT)
+public:
+    explicit BakedSkinningAnimation(Qt3DCore::QNode *parent = nullptr);
+    ~BakedSkinningAnimation();
+
+    float framesPerSecond() const;
+    float time() const;
+    int jointCount() const;
+    int clipCount() const;
+    Qt3DRender::QAbstractTexture *texture() const;
+
+    int addClip(Qt3DAnimation::QAnimationClip *clip,
+                Qt3DAnimation::QChannelMapper *mapper,
+                Qt3DCore::QSkeleton *skeleton);
+    Q_INVOKABLE int addClip(Kuesa::SceneEntity *sceneEntity, const QString &clip, const QString &skeleton);
+    Q_INVOKABLE void clear();
+
+    Q_INVOKABLE int clipFirstFrame(int clip) const;
+    Q_INVOKABLE int clipFrameCount(int clip) const;
+    Q_INVOKABLE float clipDuration(int clip) const;
+    QMatrix4x4 skinningMatrix(int clip, int frame, int joint) const;
+
+    Q_INVOKABLE void attach(Kuesa::MetallicRoughnessMaterial *material, int clip, float timeOffset = 0.0f);
+    Q_INVOKABLE void detach(Kuesa::MetallicRoughnessMaterial *material);
+
+public Q_SLOTS:
+    void setFramesPerSecond(float framesPerSecond);
+    void setTime(float time);
+
+Q_SIGNALS:
+    void framesPerSecondChanged(float framesPerSecond);
+    void timeChanged(float time);
+    void bakedDataChanged();
+
+private:
+    struct BakedClip {
+        int firstFrame = 0;
+        int frameCount = 0;
+        float duration = 0.0f;
+    };
+
+    QVector4D clipParameterValue(int clip, float timeOffset) const;
+
+    float m_framesPerSecond;
+    int m_jointCount;
+    QVector<BakedClip> m_clips;
+    QVector<float> m_data;
+    Qt3DRender::QAbstractTexture *m_texture;
+    BakedSkinningTextureImage *m_textureImage;
+    Qt3DRender::QParameter *m_textureParameter;
+    Qt3DRender::QParameter *m_timeParameter;
+    QHash<Kuesa::MetallicRoughnessMaterial *, Qt3DRender::QParameter *> m_clipParameters;
+};
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_BAKEDSKINNINGANIMATION_H
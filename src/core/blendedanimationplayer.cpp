@@ -0,0 +1,594 @@
+/*
+    blendedanimationplayer.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "blendedanimationplayer.h"
+
+#include "sceneentity.h"
+#include "kuesa_p.h"
+
+#include <Qt3DAnimation/QBlendedClipAnimator>
+#include <Qt3DAnimation/QClipBlendValue>
+#include <Qt3DAnimation/QLerpClipBlend>
+#include <Qt3DAnimation/QAdditiveClipBlend>
+#include <Qt3DAnimation/QChannelMapper>
+#include <Qt3DAnimation/QChannelMapping>
+#include <Qt3DAnimation/QAnimationClip>
+#include <Qt3DAnimation/QClock>
+#include <QtCore/QSet>
+
+QT_USE_NAMESPACE
+using namespace Kuesa;
+using namespace Qt3DAnimation;
+
+/*!
+ * \class Kuesa::BlendedAnimationPlayer
+ * \inheaderfile Kuesa/BlendedAnimationPlayer
+ * \inmodule Kuesa
+ * \since 1.0
+ * \brief Blend several animations defined in glTF files
+ *
+ * BlendedAnimationPlayer is a utility class designed to play several
+ * animation clips at once, where the clip and mapping data is stored in
+ * collections (typically loaded from glTF files). This is typically used to
+ * cross fade between a walk and a run cycle or to layer a partial animation
+ * on top of a full body one.
+ *
+ * Clips are referenced by name and are combined in the order they were
+ * added. Each clip is a layer with a weight and a BlendMode:
+ *
+ * \list
+ * \li BlendedAnimationPlayer::Blend layers are averaged together according to
+ * their relative weights.
+ * \li BlendedAnimationPlayer::Additive layers are added on top of the result
+ * of the blended layers, scaled by their weight.
+ * \endlist
+ *
+ * For each clip, the mapper with the same name is looked up in the
+ * AnimationMappingCollection of the SceneEntity. All the mappings of those
+ * mappers are merged into a single channel mapper where each channel is only
+ * resolved once, no matter how many layers animate it. Changing the weight
+ * of a layer only updates the blend factors of the blend tree, it does not
+ * trigger a new channel resolution.
+ *
+ * BlendedAnimationPlayer internally uses an instance of
+ * Qt3DAnimation::QBlendedClipAnimator and mirrors it's api.
+ */
+
+/*!
+ * \qmltype BlendedAnimationPlayer
+ * \inqmlmodule Kuesa
+ * \since 1.0
+ * \instantiates Kuesa::BlendedAnimationPlayer
+ * \brief Blend several animations defined in glTF files
+ *
+ * BlendedAnimationPlayer is a utility class designed to play several
+ * animation clips at once, where the clip and mapping data is stored in
+ * collections (typically loaded from glTF files).
+ *
+ * Clips are added with addClip() and are combined in the order they were
+ * added. Blend layers are averaged together according to their relative
+ * weights, Additive layers are added on top of the result.
+ *
+ * BlendedAnimationPlayer internally uses an instance of
+ * Qt3DAnimation::QBlendedClipAnimator and mirrors it's api.
+ */
+
+/*!
+    \enum BlendedAnimationPlayer::Status
+
+    This enum type describes state of the player.
+
+    \value None  Unknown state (default).
+    \value Ready  All the clips and their mappers have been found and are valid.
+    \value Error  An error occured when looking for assets or trying to match clip and mapper properties.
+*/
+
+/*!
+    \enum BlendedAnimationPlayer::BlendMode
+
+    This enum type describes how a clip is combined with the other layers.
+
+    \value Blend  The clip is averaged with the other Blend layers according to its relative weight.
+    \value Additive  The clip is added on top of the Blend layers, scaled by its weight.
+*/
+
+/*!
+    \property BlendedAnimationPlayer::sceneEntity
+    \brief pointer to the SceneEntity which contains the collections used to look up clip and mapper data
+ */
+
+/*!
+    \qmlproperty Entity BlendedAnimationPlayer::sceneEntity
+    \brief pointer to the SceneEntity which contains the collections used to look up clip and mapper data
+ */
+
+/*!
+    \property BlendedAnimationPlayer::status
+    \brief the current status of the player
+ */
+
+/*!
+    \qmlproperty enumeration BlendedAnimationPlayer::status
+    \brief the current status of the player
+
+    \list
+    \li None   Unknown state (default).
+    \li Ready  All the clips and their mappers have been found and are valid.
+    \li Error  An error occured when looking for assets or trying to match clip and mapper properties.
+    \endlist
+ */
+
+/*!
+    \property BlendedAnimationPlayer::clips
+    \brief the names of the clips currently layered, in blending order
+ */
+
+/*!
+    \qmlproperty list<string> BlendedAnimationPlayer::clips
+    \brief the names of the clips currently layered, in blending order
+ */
+
+/*!
+    \property BlendedAnimationPlayer::running
+    \brief controls if the animation is running or not
+
+    This reflects the state of the internal Qt3DAnimation::QBlendedClipAnimator instance.
+ */
+
+/*!
+    \qmlproperty bool BlendedAnimationPlayer::running
+    \brief controls if the animation is running or not
+
+    This reflects the state of the internal Qt3DAnimation::QBlendedClipAnimator instance.
+ */
+
+/*!
+    \property BlendedAnimationPlayer::loops
+    \brief controls the number of time the animation should repeat.
+
+    If the value is 0 (default), the animation will run only once.
+
+    If the value is BlendedAnimationPlayer::Infinite, the animation will loop
+    indefinitly until explicitly stopped.
+
+    This reflects the state of the internal Qt3DAnimation::QBlendedClipAnimator instance.
+ */
+
+/*!
+    \qmlproperty int BlendedAnimationPlayer::loops
+    \brief controls the number of time the animation should repeat.
+
+    If the value is 0 (default), the animation will run only once.
+
+    If the value is BlendedAnimationPlayer.Infinite, the animation will loop
+    indefinitly until explicitly stopped.
+ */
+
+/*!
+    \property BlendedAnimationPlayer::clock
+    \brief instance of Qt3DAnimation::QClock used to control animation speed and direction
+
+    This reflects the state of the internal Qt3DAnimation::QBlendedClipAnimator instance.
+ */
+
+/*!
+    \qmlproperty Clock BlendedAnimationPlayer::clock
+    \brief instance of Qt3DAnimation::QClock used to control animation speed and direction
+ */
+
+/*!
+    \property BlendedAnimationPlayer::normalizedTime
+    \brief progress of the animation as a uniform value between 0. and 1.
+
+    This reflects the state of the internal Qt3DAnimation::QBlendedClipAnimator instance.
+ */
+
+/*!
+    \qmlproperty float BlendedAnimationPlayer::normalizedTime
+    \brief progress of the animation as a uniform value between 0. and 1.
+ */
+
+BlendedAnimationPlayer::BlendedAnimationPlayer(Qt3DCore::QNode *parent)
+    : Qt3DCore::QNode(parent)
+    , m_sceneEntity(nullptr)
+    , m_status(None)
+    , m_animator(new Qt3DAnimation::QBlendedClipAnimator(this))
+    , m_mapper(nullptr)
+    , m_blendTreeRoot(nullptr)
+    , m_blendTree(nullptr)
+    , m_running(false)
+{
+    updateSceneFromParent(parent);
+    connect(this, &Qt3DCore::QNode::parentChanged, this, [this](QObject *parent) {
+        auto parentNode = qobject_cast<Qt3DCore::QNode *>(parent);
+        this->updateSceneFromParent(parentNode);
+    });
+
+    connect(m_animator, &QBlendedClipAnimator::runningChanged, this, &BlendedAnimationPlayer::runningChanged);
+    connect(m_animator, &QBlendedClipAnimator::loopCountChanged, this, &BlendedAnimationPlayer::loopCountChanged);
+    connect(m_animator, &QBlendedClipAnimator::clockChanged, this, &BlendedAnimationPlayer::clockChanged);
+    connect(m_animator, &QBlendedClipAnimator::normalizedTimeChanged, this, &BlendedAnimationPlayer::normalizedTimeChanged);
+}
+
+BlendedAnimationPlayer::~BlendedAnimationPlayer()
+{
+}
+
+BlendedAnimationPlayer::Status BlendedAnimationPlayer::status() const
+{
+    return m_status;
+}
+
+void BlendedAnimationPlayer::setStatus(BlendedAnimationPlayer::Status status)
+{
+    if (m_status != status) {
+        m_status = status;
+        emit statusChanged(m_status);
+    }
+}
+
+void BlendedAnimationPlayer::updateSceneFromParent(Qt3DCore::QNode *parent)
+{
+    if (m_sceneEntity)
+        return;
+
+    while (parent) {
+        auto scene = qobject_cast<SceneEntity *>(parent);
+        if (scene) {
+            setSceneEntity(scene);
+            break;
+        }
+        parent = parent->parentNode();
+    }
+}
+
+SceneEntity *BlendedAnimationPlayer::sceneEntity() const
+{
+    return m_sceneEntity;
+}
+
+void BlendedAnimationPlayer::setSceneEntity(SceneEntity *sceneEntity)
+{
+    if (sceneEntity == m_sceneEntity)
+        return;
+
+    if (m_sceneEntity)
+        disconnect(m_sceneEntity, &SceneEntity::loadingDone, this, &BlendedAnimationPlayer::rebuildBlendTree);
+
+    m_sceneEntity = sceneEntity;
+    if (m_sceneEntity)
+        connect(m_sceneEntity, &SceneEntity::loadingDone, this, &BlendedAnimationPlayer::rebuildBlendTree);
+
+    emit sceneEntityChanged(sceneEntity);
+    rebuildBlendTree();
+}
+
+QStringList BlendedAnimationPlayer::clips() const
+{
+    QStringList names;
+    names.reserve(m_layers.size());
+    for (const Layer &layer : m_layers)
+        names.push_back(layer.clip);
+    return names;
+}
+
+/*!
+ * \brief BlendedAnimationPlayer::addClip adds \a clip as a new layer
+ *
+ * The clip is blended with the \a weight and \a mode specified. If the clip
+ * is already part of the player, only its weight and mode are updated.
+ *
+ * At least one layer must use the BlendedAnimationPlayer::Blend mode for the
+ * player to be valid.
+ *
+ * \sa BlendedAnimationPlayer::removeClip
+ */
+void BlendedAnimationPlayer::addClip(const QString &clip, float weight, BlendMode mode)
+{
+    const int idx = layerIndex(clip);
+    if (idx >= 0) {
+        if (m_layers[idx].mode == mode) {
+            setClipWeight(clip, weight);
+            return;
+        }
+        m_layers[idx].weight = weight;
+        m_layers[idx].mode = mode;
+    } else {
+        Layer layer;
+        layer.clip = clip;
+        layer.weight = weight;
+        layer.mode = mode;
+        m_layers.push_back(layer);
+        emit clipsChanged(clips());
+    }
+    rebuildBlendTree();
+}
+
+/*!
+ * \brief BlendedAnimationPlayer::removeClip removes the layer playing \a clip
+ *
+ * \sa BlendedAnimationPlayer::addClip
+ */
+void BlendedAnimationPlayer::removeClip(const QString &clip)
+{
+    const int idx = layerIndex(clip);
+    if (idx < 0)
+        return;
+
+    m_layers.remove(idx);
+    emit clipsChanged(clips());
+    rebuildBlendTree();
+}
+
+/*!
+ * \brief BlendedAnimationPlayer::setClipWeight sets the \a weight of the layer playing \a clip
+ *
+ * This only updates the blend factors of the existing blend tree.
+ */
+void BlendedAnimationPlayer::setClipWeight(const QString &clip, float weight)
+{
+    const int idx = layerIndex(clip);
+    if (idx < 0 || qFuzzyCompare(m_layers[idx].weight, weight))
+        return;
+
+    m_layers[idx].weight = weight;
+    updateBlendFactors();
+}
+
+/*!
+ * \brief BlendedAnimationPlayer::clipWeight returns the weight of the layer playing \a clip
+ *
+ * Returns 0 if \a clip is not part of the player.
+ */
+float BlendedAnimationPlayer::clipWeight(const QString &clip) const
+{
+    const int idx = layerIndex(clip);
+    return idx >= 0 ? m_layers.at(idx).weight : 0.0f;
+}
+
+/*!
+ * \brief BlendedAnimationPlayer::crossFade blends from \a fromClip to \a toClip
+ *
+ * Both clips are added as Blend layers if needed. \a factor ranges from 0
+ * (only \a fromClip is visible) to 1 (only \a toClip is visible).
+ */
+void BlendedAnimationPlayer::crossFade(const QString &fromClip, const QString &toClip, float factor)
+{
+    factor = qBound(0.0f, factor, 1.0f);
+    addClip(fromClip, 1.0f - factor, Blend);
+    addClip(toClip, factor, Blend);
+}
+
+/*!
+ * \brief BlendedAnimationPlayer::blendTree returns the root of the blend tree
+ * currently used by the player, or nullptr if the player is not ready.
+ */
+QAbstractClipBlendNode *BlendedAnimationPlayer::blendTree() const
+{
+    return m_blendTree;
+}
+
+/*!
+ * \brief BlendedAnimationPlayer::channelMapper returns the mapper merging the
+ * mappings of all the layers, or nullptr if the player is not ready.
+ */
+QChannelMapper *BlendedAnimationPlayer::channelMapper() const
+{
+    return m_mapper;
+}
+
+bool BlendedAnimationPlayer::isRunning() const
+{
+    return m_animator->isRunning();
+}
+
+void BlendedAnimationPlayer::setRunning(bool running)
+{
+    m_animator->setRunning(running);
+    m_running = running;
+}
+
+int BlendedAnimationPlayer::loopCount() const
+{
+    return m_animator->loopCount();
+}
+
+void BlendedAnimationPlayer::setLoopCount(int loops)
+{
+    m_animator->setLoopCount(loops);
+}
+
+QClock *BlendedAnimationPlayer::clock() const
+{
+    return m_animator->clock();
+}
+
+void BlendedAnimationPlayer::setClock(QClock *clock)
+{
+    m_animator->setClock(clock);
+}
+
+float BlendedAnimationPlayer::normalizedTime() const
+{
+    return m_animator->normalizedTime();
+}
+
+void BlendedAnimationPlayer::setNormalizedTime(float timeFraction)
+{
+    m_animator->setNormalizedTime(timeFraction);
+}
+
+/*!
+ * \brief Starts the animation
+ */
+void BlendedAnimationPlayer::start()
+{
+    m_animator->start();
+}
+
+/*!
+ * \brief Stops the animation
+ */
+void BlendedAnimationPlayer::stop()
+{
+    m_animator->stop();
+}
+
+int BlendedAnimationPlayer::layerIndex(const QString &clip) const
+{
+    for (int i = 0, m = m_layers.size(); i < m; ++i) {
+        if (m_layers.at(i).clip == clip)
+            return i;
+    }
+    return -1;
+}
+
+void BlendedAnimationPlayer::rebuildBlendTree()
+{
+    m_animator->setBlendTree(nullptr);
+    m_animator->setChannelMapper(nullptr);
+    for (Layer &layer : m_layers)
+        layer.blendNode = nullptr;
+    m_blendTree = nullptr;
+    delete m_blendTreeRoot;
+    m_blendTreeRoot = nullptr;
+    delete m_mapper;
+    m_mapper = nullptr;
+
+    if (m_sceneEntity == nullptr || m_layers.isEmpty()) {
+        setStatus(Error);
+        return;
+    }
+
+    const bool hasBlendLayer = std::any_of(m_layers.cbegin(), m_layers.cend(), [](const Layer &layer) {
+        return layer.mode == Blend;
+    });
+    if (!hasBlendLayer) {
+        qCWarning(kuesa, "BlendedAnimationPlayer requires at least one Blend layer");
+        setStatus(Error);
+        return;
+    }
+
+    // Look up all the assets first so we don't build a partial tree
+    QVector<QAnimationClip *> clips;
+    QVector<QChannelMapper *> mappers;
+    clips.reserve(m_layers.size());
+    mappers.reserve(m_layers.size());
+    for (const Layer &layer : qAsConst(m_layers)) {
+        QAnimationClip *clip = qobject_cast<QAnimationClip *>(m_sceneEntity->animationClip(layer.clip));
+        QChannelMapper *mapper = m_sceneEntity->animationMapping(layer.clip);
+        if (!clip || !mapper) {
+            qCWarning(kuesa) << "Undefined clip or mapper" << layer.clip << "in BlendedAnimationPlayer";
+            setStatus(Error);
+            return;
+        }
+        clips.push_back(clip);
+        mappers.push_back(mapper);
+    }
+
+    // Merge the mappings of all layers. Clips animating the same node use the
+    // same channel names, the mapping nodes of the first mapper defining a
+    // channel are referenced (not copied) so that each channel gets resolved
+    // only once regardless of the number of layers
+    m_mapper = new QChannelMapper(this);
+    QSet<QString> mappedChannels;
+    QSet<QAbstractChannelMapping *> mappedNodes;
+    for (QChannelMapper *mapper : qAsConst(mappers)) {
+        const QVector<QAbstractChannelMapping *> mappings = mapper->mappings();
+        for (QAbstractChannelMapping *abstractMapping : mappings) {
+            if (mappedNodes.contains(abstractMapping))
+                continue;
+            // mappings contains either QChannelMappings or QSkeletonMappings
+            QChannelMapping *mapping = qobject_cast<QChannelMapping *>(abstractMapping);
+            if (mapping != nullptr) {
+                if (mappedChannels.contains(mapping->channelName()))
+                    continue;
+                mappedChannels.insert(mapping->channelName());
+            }
+            mappedNodes.insert(abstractMapping);
+            m_mapper->addMapping(abstractMapping);
+        }
+    }
+
+    // Blend layers are chained with lerps so that the result is the weighted
+    // average of all the Blend clips. Additive layers are stacked on top.
+    m_blendTreeRoot = new Qt3DCore::QNode(this);
+    for (int i = 0, m = m_layers.size(); i < m; ++i) {
+        Layer &layer = m_layers[i];
+        if (layer.mode != Blend)
+            continue;
+        auto value = new QClipBlendValue(clips.at(i), m_blendTreeRoot);
+        if (m_blendTree == nullptr) {
+            m_blendTree = value;
+        } else {
+            auto lerp = new QLerpClipBlend(m_blendTreeRoot);
+            lerp->setStartClip(m_blendTree);
+            lerp->setEndClip(value);
+            layer.blendNode = lerp;
+            m_blendTree = lerp;
+        }
+    }
+    for (int i = 0, m = m_layers.size(); i < m; ++i) {
+        Layer &layer = m_layers[i];
+        if (layer.mode != Additive)
+            continue;
+        auto value = new QClipBlendValue(clips.at(i), m_blendTreeRoot);
+        auto additive = new QAdditiveClipBlend(m_blendTreeRoot);
+        additive->setBaseClip(m_blendTree);
+        additive->setAdditiveClip(value);
+        layer.blendNode = additive;
+        m_blendTree = additive;
+    }
+
+    updateBlendFactors();
+
+    m_animator->setChannelMapper(m_mapper);
+    m_animator->setBlendTree(m_blendTree);
+    m_animator->setRunning(m_running);
+    setStatus(Ready);
+}
+
+void BlendedAnimationPlayer::updateBlendFactors()
+{
+    // Lerp i blends the accumulated result of layers [0, i[ with layer i.
+    // Using w_i / sum(w_0..w_i) as factor yields the weighted average.
+    float accumulatedWeight = 0.0f;
+    for (const Layer &layer : qAsConst(m_layers)) {
+        if (layer.mode == Blend) {
+            const float weight = qMax(0.0f, layer.weight);
+            accumulatedWeight += weight;
+            auto lerp = qobject_cast<QLerpClipBlend *>(layer.blendNode);
+            if (lerp)
+                lerp->setBlendFactor(accumulatedWeight > 0.0f ? weight / accumulatedWeight : 0.0f);
+        } else {
+            auto additive = qobject_cast<QAdditiveClipBlend *>(layer.blendNode);
+            if (additive)
+                additive->setAdditiveFactor(layer.weight);
+        }
+    }
+}
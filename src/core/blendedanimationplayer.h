@@ -0,0 +1,141 @@
+/*
+    blendedanimationplayer.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_BLENDEDANIMATIONPLAYER_H
+#define KUESA_BLENDEDANIMATIONPLAYER_H
+
+#include <Qt3DCore/QNode>
+#include <Kuesa/kuesa_global.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DAnimation {
+class QBlendedClipAnimator;
+class QAbstractClipBlendNode;
+class QChannelMapper;
+class QClock;
+} // namespace Qt3DAnimation
+
+namespace Kuesa {
+class SceneEntity;
+
+class KUESASHARED_EXPORT BlendedAnimationPlayer : public Qt3DCore::QNode
+{
+    Q_OBJECT
+    Q_PROPERTY(Kuesa::SceneEntity *sceneEntity READ sceneEntity WRITE setSceneEntity NOTIFY sceneEntityChanged)
+    Q_PROPERTY(Status status READ status NOTIFY statusChanged)
+    Q_PROPERTY(QStringList clips READ clips NOTIFY clipsChanged)
+    Q_PROPERTY(bool running READ isRunning WRITE setRunning NOTIFY runningChanged)
+    Q_PROPERTY(int loops READ loopCount WRITE setLoopCount NOTIFY loopCountChanged)
+    Q_PROPERTY(Qt3DAnimation::QClock *clock READ clock WRITE setClock NOTIFY clockChanged)
+    Q_PROPERTY(float normalizedTime READ normalizedTime WRITE setNormalizedTime NOTIFY normalizedTimeChanged)
+public:
+    enum Loops { Infinite = -1 };
+    Q_ENUM(Loops) // LCOV_EXCL_LINE
+
+    enum Status {
+        None = 0,
+        Ready,
+        Error
+    };
+    Q_ENUM(Status) // LCOV_EXCL_LINE
+
+    enum BlendMode {
+        Blend = 0,
+        Additive
+    };
+    Q_ENUM(BlendMode) // LCOV_EXCL_LINE
+
+    explicit BlendedAnimationPlayer(Qt3DCore::QNode *parent = nullptr);
+    ~BlendedAnimationPlayer();
+
+    SceneEntity *sceneEntity() const;
+    Status status() const;
+    QStringList clips() const;
+    bool isRunning() const;
+    int loopCount() const;
+    Qt3DAnimation::QClock *clock() const;
+    float normalizedTime() const;
+
+    Q_INVOKABLE void addClip(const QString &clip, float weight = 1.0f, Kuesa::BlendedAnimationPlayer::BlendMode mode = Blend);
+    Q_INVOKABLE void removeClip(const QString &clip);
+    Q_INVOKABLE void setClipWeight(const QString &clip, float weight);
+    Q_INVOKABLE float clipWeight(const QString &clip) const;
+    Q_INVOKABLE void crossFade(const QString &fromClip, const QString &toClip, float factor);
+
+    Qt3DAnimation::QAbstractClipBlendNode *blendTree() const;
+    Qt3DAnimation::QChannelMapper *channelMapper() const;
+
+public Q_SLOTS:
+    void setSceneEntity(SceneEntity *sceneEntity);
+    void setRunning(bool running);
+    void setLoopCount(int loops);
+    void setClock(Qt3DAnimation::QClock *clock);
+    void setNormalizedTime(float timeFraction);
+
+    void start();
+    void stop();
+
+Q_SIGNALS:
+    void sceneEntityChanged(const SceneEntity *sceneEntity);
+    void statusChanged(Status status);
+    void clipsChanged(const QStringList &clips);
+    void runningChanged(bool running);
+    void loopCountChanged(int loops);
+    void clockChanged(Qt3DAnimation::QClock *clock);
+    void normalizedTimeChanged(float index);
+
+private:
+    struct Layer {
+        QString clip;
+        float weight = 1.0f;
+        BlendMode mode = Blend;
+        Qt3DCore::QNode *blendNode = nullptr;
+    };
+
+    void rebuildBlendTree();
+    void updateBlendFactors();
+    void setStatus(Status status);
+    void updateSceneFromParent(Qt3DCore::QNode *parent);
+    int layerIndex(const QString &clip) const;
+
+    SceneEntity *m_sceneEntity;
+    Status m_status;
+    QVector<Layer> m_layers;
+    Qt3DAnimation::QBlendedClipAnimator *m_animator;
+    Qt3DAnimation::QChannelMapper *m_mapper;
+    Qt3DCore::QNode *m_blendTreeRoot;
+    Qt3DAnimation::QAbstractClipBlendNode *m_blendTree;
+    bool m_running;
+};
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_BLENDEDANIMATIONPLAYER_H
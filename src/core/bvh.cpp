@@ -0,0 +1,320 @@
+/*
+    bvh.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "bvh_p.h"
+
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+
+namespace {
+
+template<typename ValueType>
+float readComponent(const char *rawData, int component)
+{
+    ValueType value;
+    memcpy(&value, rawData + component * sizeof(ValueType), sizeof(ValueType));
+    return float(value);
+}
+
+// Integer positions are normalized, as Qt3D reads them
+bool readPosition(const MeshBvh::MeshData &meshData, uint vertex, QVector3D &position)
+{
+    const char *rawData = meshData.positionData.constData() + meshData.positionOffset + vertex * meshData.positionStride;
+    switch (meshData.positionType) {
+    case Qt3DRender::QAttribute::Float:
+        position = QVector3D(readComponent<float>(rawData, 0), readComponent<float>(rawData, 1), readComponent<float>(rawData, 2));
+        return true;
+    case Qt3DRender::QAttribute::UnsignedShort:
+        position = QVector3D(readComponent<quint16>(rawData, 0), readComponent<quint16>(rawData, 1), readComponent<quint16>(rawData, 2)) / 65535.0f;
+        return true;
+    case Qt3DRender::QAttribute::UnsignedByte:
+        position = QVector3D(readComponent<quint8>(rawData, 0), readComponent<quint8>(rawData, 1), readComponent<quint8>(rawData, 2)) / 255.0f;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool readIndex(const MeshBvh::MeshData &meshData, uint i, quint32 &index)
+{
+    const char *rawData = meshData.indexData.constData() + meshData.indexOffset + i * meshData.indexStride;
+    switch (meshData.indexType) {
+    case Qt3DRender::QAttribute::UnsignedByte:
+        index = quint32(readComponent<quint8>(rawData, 0));
+        return true;
+    case Qt3DRender::QAttribute::UnsignedShort:
+        index = quint32(readComponent<quint16>(rawData, 0));
+        return true;
+    case Qt3DRender::QAttribute::UnsignedInt: {
+        memcpy(&index, rawData, sizeof(quint32));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+uint typeSize(Qt3DRender::QAttribute::VertexBaseType type)
+{
+    switch (type) {
+    case Qt3DRender::QAttribute::UnsignedByte:
+        return 1;
+    case Qt3DRender::QAttribute::UnsignedShort:
+        return 2;
+    case Qt3DRender::QAttribute::Float:
+    case Qt3DRender::QAttribute::UnsignedInt:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// Möller-Trumbore, hitting both faces of the triangle
+bool intersectTriangle(const QVector3D &origin, const QVector3D &direction,
+                       const QVector3D &v0, const QVector3D &v1, const QVector3D &v2,
+                       float *distance)
+{
+    const QVector3D edge1 = v1 - v0;
+    const QVector3D edge2 = v2 - v0;
+    const QVector3D p = QVector3D::crossProduct(direction, edge2);
+    const float determinant = QVector3D::dotProduct(edge1, p);
+    if (std::abs(determinant) < std::numeric_limits<float>::min())
+        return false;
+
+    const float inverseDeterminant = 1.0f / determinant;
+    const QVector3D s = origin - v0;
+    const float u = QVector3D::dotProduct(s, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    const QVector3D q = QVector3D::crossProduct(s, edge1);
+    const float v = QVector3D::dotProduct(direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    *distance = QVector3D::dotProduct(edge2, q) * inverseDeterminant;
+    return *distance >= 0.0f;
+}
+
+} // namespace
+
+void BoundingBox::unite(const QVector3D &point)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        min[axis] = std::min(min[axis], point[axis]);
+        max[axis] = std::max(max[axis], point[axis]);
+    }
+}
+
+void BoundingBox::unite(const BoundingBox &other)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        min[axis] = std::min(min[axis], other.min[axis]);
+        max[axis] = std::max(max[axis], other.max[axis]);
+    }
+}
+
+bool BoundingBox::intersects(const BoundingBox &other) const
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        if (min[axis] > other.max[axis] || max[axis] < other.min[axis])
+            return false;
+    }
+    return true;
+}
+
+// Slab test, entryDistance is 0 when the ray starts inside the box
+bool BoundingBox::intersectsRay(const QVector3D &origin, const QVector3D &inverseDirection, float maxDistance, float *entryDistance) const
+{
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t0 = (min[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (max[axis] - origin[axis]) * inverseDirection[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        // Written so that NaNs, from rays along a face of the box, are ignored
+        tMin = t0 > tMin ? t0 : tMin;
+        tMax = t1 < tMax ? t1 : tMax;
+        if (tMin > tMax)
+            return false;
+    }
+    *entryDistance = tMin;
+    return true;
+}
+
+/*!
+ * \class Kuesa::Bvh
+ * \internal
+ *
+ * Bounding volume hierarchy over a set of boxes, split at the median of the
+ * box centers along their largest axis. Nodes are stored depth first.
+ */
+
+void Bvh::build(const QVector<BoundingBox> &itemBounds, int maxLeafSize)
+{
+    m_nodes.clear();
+    m_items.clear();
+    if (itemBounds.isEmpty())
+        return;
+
+    QVector<QVector3D> centers;
+    centers.reserve(itemBounds.size());
+    m_items.reserve(itemBounds.size());
+    for (int i = 0, m = itemBounds.size(); i < m; ++i) {
+        centers.push_back(itemBounds.at(i).center());
+        m_items.push_back(i);
+    }
+
+    m_nodes.reserve(2 * (itemBounds.size() / std::max(maxLeafSize, 1)) + 1);
+    buildNode(itemBounds, centers, 0, itemBounds.size(), std::max(maxLeafSize, 1));
+}
+
+int Bvh::buildNode(const QVector<BoundingBox> &itemBounds, const QVector<QVector3D> &centers, int first, int count, int maxLeafSize)
+{
+    const int nodeIdx = m_nodes.size();
+    m_nodes.push_back(Node());
+
+    BoundingBox bounds;
+    BoundingBox centerBounds;
+    for (int i = first, end = first + count; i < end; ++i) {
+        bounds.unite(itemBounds.at(m_items.at(i)));
+        centerBounds.unite(centers.at(m_items.at(i)));
+    }
+    m_nodes[nodeIdx].bounds = bounds;
+
+    if (count <= maxLeafSize) {
+        m_nodes[nodeIdx].first = first;
+        m_nodes[nodeIdx].count = count;
+        return nodeIdx;
+    }
+
+    const QVector3D extent = centerBounds.max - centerBounds.min;
+    const int axis = (extent.x() >= extent.y() && extent.x() >= extent.z()) ? 0 : (extent.y() >= extent.z() ? 1 : 2);
+    const int half = count / 2;
+    int *items = m_items.data();
+    std::nth_element(items + first, items + first + half, items + first + count,
+                     [&centers, axis](int a, int b) { return centers.at(a)[axis] < centers.at(b)[axis]; });
+
+    buildNode(itemBounds, centers, first, half, maxLeafSize);
+    const int secondChild = buildNode(itemBounds, centers, first + half, count - half, maxLeafSize);
+    m_nodes[nodeIdx].first = secondChild;
+    return nodeIdx;
+}
+
+/*!
+ * \class Kuesa::MeshBvh
+ * \internal
+ *
+ * Bounding volume hierarchy over the triangles of a mesh, used to cast rays
+ * against it without going through all its triangles.
+ */
+
+QSharedPointer<MeshBvh> MeshBvh::build(const MeshData &meshData)
+{
+    auto meshBvh = QSharedPointer<MeshBvh>::create();
+
+    const uint positionSize = 3 * typeSize(meshData.positionType);
+    const bool hasIndices = !meshData.indexData.isEmpty();
+    if (positionSize == 0 || meshData.vertexCount == 0 || (hasIndices && typeSize(meshData.indexType) == 0))
+        return meshBvh;
+
+    const quint64 positionEnd = quint64(meshData.positionOffset) + quint64(meshData.vertexCount - 1) * meshData.positionStride + positionSize;
+    if (positionEnd > quint64(meshData.positionData.size()))
+        return meshBvh;
+
+    uint count = meshData.count;
+    if (hasIndices) {
+        const quint64 indexEnd = quint64(meshData.indexOffset) + quint64(meshData.first + count) * meshData.indexStride;
+        if (indexEnd > quint64(meshData.indexData.size()))
+            return meshBvh;
+    } else if (meshData.first + count > meshData.vertexCount) {
+        return meshBvh;
+    }
+
+    QVector<QVector3D> vertices;
+    QVector<BoundingBox> triangleBounds;
+    vertices.reserve(int(count));
+    triangleBounds.reserve(int(count / 3));
+    for (uint i = meshData.first, end = meshData.first + count - count % 3; i < end; i += 3) {
+        QVector3D triangle[3];
+        bool isValid = true;
+        for (uint corner = 0; corner < 3 && isValid; ++corner) {
+            quint32 vertex = i + corner;
+            if (hasIndices)
+                isValid = readIndex(meshData, i + corner, vertex);
+            isValid = isValid && vertex < meshData.vertexCount && readPosition(meshData, vertex, triangle[corner]);
+        }
+        if (!isValid)
+            continue;
+
+        BoundingBox bounds;
+        for (const QVector3D &vertex : triangle) {
+            vertices.push_back(vertex);
+            bounds.unite(vertex);
+        }
+        triangleBounds.push_back(bounds);
+    }
+
+    meshBvh->m_bvh.build(triangleBounds);
+
+    // Store the triangles in the order of the leaves
+    const QVector<int> &items = meshBvh->m_bvh.items();
+    meshBvh->m_vertices.reserve(vertices.size());
+    for (const int triangle : items) {
+        meshBvh->m_vertices.push_back(vertices.at(3 * triangle));
+        meshBvh->m_vertices.push_back(vertices.at(3 * triangle + 1));
+        meshBvh->m_vertices.push_back(vertices.at(3 * triangle + 2));
+    }
+
+    return meshBvh;
+}
+
+bool MeshBvh::castRay(const QVector3D &origin, const QVector3D &direction, float maxDistance, float *distance) const
+{
+    bool hit = false;
+    // Triangles are stored in the order of the items
+    m_bvh.castRay(origin, direction, maxDistance, [&](int triangle, float itemMaxDistance) {
+        float triangleDistance = 0.0f;
+        if (intersectTriangle(origin, direction,
+                              m_vertices.at(3 * triangle), m_vertices.at(3 * triangle + 1), m_vertices.at(3 * triangle + 2),
+                              &triangleDistance) &&
+            triangleDistance <= itemMaxDistance) {
+            hit = true;
+            *distance = triangleDistance;
+            return triangleDistance;
+        }
+        return itemMaxDistance;
+    });
+    return hit;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,222 @@
+/*
+    bvh_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_BVH_P_H
+#define KUESA_BVH_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Kuesa API.  It exists for the convenience
+// of other Kuesa classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVector>
+#include <QtGui/QVector3D>
+#include <Qt3DRender/QAttribute>
+#include <algorithm>
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+namespace Kuesa {
+
+struct BoundingBox {
+    QVector3D min = QVector3D(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    QVector3D max = QVector3D(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+
+    bool isEmpty() const { return min.x() > max.x(); }
+    QVector3D center() const { return 0.5f * (min + max); }
+    void unite(const QVector3D &point);
+    void unite(const BoundingBox &other);
+    bool intersects(const BoundingBox &other) const;
+    bool intersectsRay(const QVector3D &origin, const QVector3D &inverseDirection, float maxDistance, float *entryDistance) const;
+};
+
+class Q_AUTOTEST_EXPORT Bvh
+{
+public:
+    struct Node {
+        BoundingBox bounds;
+        // First item of a leaf, or second child of an inner node whose
+        // first child follows it
+        int first = 0;
+        // Item count of a leaf, 0 for inner nodes
+        int count = 0;
+    };
+
+    void build(const QVector<BoundingBox> &itemBounds, int maxLeafSize = 4);
+
+    const QVector<Node> &nodes() const { return m_nodes; }
+    // Item indices, grouped by leaf
+    const QVector<int> &items() const { return m_items; }
+    BoundingBox bounds() const { return m_nodes.isEmpty() ? BoundingBox() : m_nodes.first().bounds; }
+
+    // Calls itemTest(slot, maxDistance) for the items of the leaves the ray
+    // enters before maxDistance, nearest leaves first, slot being the
+    // position of the item in items(). itemTest returns the distance of its
+    // hit, if any, to stop visiting farther leaves.
+    template<typename ItemTest>
+    void castRay(const QVector3D &origin, const QVector3D &direction, float maxDistance, ItemTest itemTest) const;
+
+    // Calls visitor(item) for the items of the leaves whose bounds pass
+    // boundsTest
+    template<typename BoundsTest, typename ItemVisitor>
+    void query(BoundsTest boundsTest, ItemVisitor visitor) const;
+
+private:
+    int buildNode(const QVector<BoundingBox> &itemBounds, const QVector<QVector3D> &centers, int first, int count, int maxLeafSize);
+
+    QVector<Node> m_nodes;
+    QVector<int> m_items;
+};
+
+// Triangles of a mesh, in the space of its position attribute
+class Q_AUTOTEST_EXPORT MeshBvh
+{
+public:
+    // Copy of the mesh data, which can be read from any thread
+    struct MeshData {
+        QByteArray positionData;
+        Qt3DRender::QAttribute::VertexBaseType positionType = Qt3DRender::QAttribute::Float;
+        uint positionOffset = 0;
+        uint positionStride = 0;
+        uint vertexCount = 0;
+        QByteArray indexData;
+        Qt3DRender::QAttribute::VertexBaseType indexType = Qt3DRender::QAttribute::UnsignedInt;
+        uint indexOffset = 0;
+        uint indexStride = 0;
+        // Range of the indices, or of the vertices without indices, to draw
+        uint first = 0;
+        uint count = 0;
+    };
+
+    static QSharedPointer<MeshBvh> build(const MeshData &meshData);
+
+    bool castRay(const QVector3D &origin, const QVector3D &direction, float maxDistance, float *distance) const;
+    BoundingBox bounds() const { return m_bvh.bounds(); }
+    int triangleCount() const { return m_vertices.size() / 3; }
+
+private:
+    Bvh m_bvh;
+    // Three vertices per triangle, ordered as the items of the BVH
+    QVector<QVector3D> m_vertices;
+};
+
+template<typename ItemTest>
+void Bvh::castRay(const QVector3D &origin, const QVector3D &direction, float maxDistance, ItemTest itemTest) const
+{
+    if (m_nodes.isEmpty())
+        return;
+
+    const QVector3D inverseDirection(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+    float entryDistance = 0.0f;
+    if (!m_nodes.first().bounds.intersectsRay(origin, inverseDirection, maxDistance, &entryDistance))
+        return;
+
+    struct StackEntry {
+        int node;
+        float entryDistance;
+    };
+    StackEntry stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = { 0, entryDistance };
+
+    while (stackSize > 0) {
+        const StackEntry entry = stack[--stackSize];
+        if (entry.entryDistance > maxDistance)
+            continue;
+
+        const Node &node = m_nodes.at(entry.node);
+        if (node.count > 0) {
+            for (int i = node.first, end = node.first + node.count; i < end; ++i)
+                maxDistance = std::min(maxDistance, itemTest(i, maxDistance));
+            continue;
+        }
+
+        // Visit the nearest child first
+        const int firstChild = entry.node + 1;
+        const int secondChild = node.first;
+        float firstDistance = 0.0f;
+        float secondDistance = 0.0f;
+        const bool hitsFirst = m_nodes.at(firstChild).bounds.intersectsRay(origin, inverseDirection, maxDistance, &firstDistance);
+        const bool hitsSecond = m_nodes.at(secondChild).bounds.intersectsRay(origin, inverseDirection, maxDistance, &secondDistance);
+        if (hitsFirst && hitsSecond) {
+            if (firstDistance <= secondDistance) {
+                stack[stackSize++] = { secondChild, secondDistance };
+                stack[stackSize++] = { firstChild, firstDistance };
+            } else {
+                stack[stackSize++] = { firstChild, firstDistance };
+                stack[stackSize++] = { secondChild, secondDistance };
+            }
+        } else if (hitsFirst) {
+            stack[stackSize++] = { firstChild, firstDistance };
+        } else if (hitsSecond) {
+            stack[stackSize++] = { secondChild, secondDistance };
+        }
+    }
+}
+
+template<typename BoundsTest, typename ItemVisitor>
+void Bvh::query(BoundsTest boundsTest, ItemVisitor visitor) const
+{
+    if (m_nodes.isEmpty())
+        return;
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const int nodeIdx = stack[--stackSize];
+        const Node &node = m_nodes.at(nodeIdx);
+        if (!boundsTest(node.bounds))
+            continue;
+
+        if (node.count > 0) {
+            for (int i = node.first, end = node.first + node.count; i < end; ++i)
+                visitor(m_items.at(i));
+            continue;
+        }
+
+        stack[stackSize++] = node.first;
+        stack[stackSize++] = nodeIdx + 1;
+    }
+}
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_BVH_P_H
@@ -28,6 +28,7 @@
 
 #include "abstractassetcollection.h"
 #include "kuesa_p.h"
+#include <algorithm>
 
 Q_LOGGING_CATEGORY(kuesa, "Kuesa")
 
@@ -62,6 +63,9 @@ using namespace Kuesa;
  *
  * Removing an asset from the collection also results in the asset being
  * destroyed if the asset's parent is the collection itself.
+ *
+ * Importers can also register assets which are only created the first time
+ * they are looked up. Their names are listed along with the other ones.
  */
 
 /*!
@@ -89,12 +93,17 @@ AbstractAssetCollection::~AbstractAssetCollection()
 
 QStringList AbstractAssetCollection::names()
 {
-    return m_assets.keys();
+    if (m_assetFactories.isEmpty())
+        return m_assets.keys();
+
+    QStringList names = m_assets.keys() + m_assetFactories.keys();
+    std::sort(names.begin(), names.end());
+    return names;
 }
 
 int AbstractAssetCollection::size()
 {
-    return m_assets.size();
+    return m_assets.size() + m_assetFactories.size();
 }
 
 /*!
@@ -102,7 +111,7 @@ int AbstractAssetCollection::size()
  */
 bool AbstractAssetCollection::contains(const QString &name) const
 {
-    return m_assets.find(name) != m_assets.end();
+    return m_assets.find(name) != m_assets.end() || m_assetFactories.contains(name);
 }
 
 /*!
@@ -110,6 +119,11 @@ bool AbstractAssetCollection::contains(const QString &name) const
  */
 void AbstractAssetCollection::remove(const QString &name)
 {
+    if (m_assetFactories.remove(name) > 0) {
+        emit namesChanged();
+        return;
+    }
+
     auto asset = m_assets.take(name);
     if (asset) {
         //remove connection before deleting so handleAssetDestruction() is not called
@@ -131,6 +145,7 @@ void AbstractAssetCollection::clear()
             delete a;
     }
     m_assets.clear();
+    m_assetFactories.clear();
     emit namesChanged();
 }
 
@@ -141,8 +156,8 @@ void AbstractAssetCollection::addAsset(const QString &name, Qt3DCore::QNode *ass
 {
     Q_ASSERT(asset);
     auto it = m_assets.find(name);
-    const bool nameExists = it != m_assets.end();
-    if (nameExists) {
+    const bool nameExists = it != m_assets.end() || m_assetFactories.remove(name) > 0;
+    if (it != m_assets.end()) {
         auto oldAsset = it.value();
         //remove connection before deleting so handleAssetDestruction() is not called
         removeDestructionConnection(oldAsset);
@@ -161,6 +176,67 @@ void AbstractAssetCollection::addAsset(const QString &name, Qt3DCore::QNode *ass
     addDestructionConnection(name, asset);
 }
 
+/*!
+ * \internal
+ *
+ * Adds an asset named \a name which is only created by \a factory when it is
+ * first looked up. The asset isn't created anymore once \a owner is
+ * destroyed, or if \a factory returns nullptr.
+ */
+void AbstractAssetCollection::addAssetFactory(const QString &name, Qt3DCore::QNode *owner, const AssetFactory &factory)
+{
+    Q_ASSERT(owner);
+    Q_ASSERT(factory);
+
+    // Replace an existing asset, as addAsset() does
+    bool nameExists = m_assetFactories.contains(name);
+    auto it = m_assets.find(name);
+    if (it != m_assets.end()) {
+        nameExists = true;
+        auto oldAsset = it.value();
+        removeDestructionConnection(oldAsset);
+        m_assets.erase(it);
+        if (oldAsset->parent() == this)
+            delete oldAsset;
+    }
+
+    m_assetFactories.insert(name, { owner, factory });
+    if (!m_ownerDestructionConnections.contains(owner)) {
+        auto f = [this, owner]() { handleOwnerDestruction(owner); };
+        m_ownerDestructionConnections.insert(owner, connect(owner, &Qt3DCore::QNode::nodeDestroyed, this, f));
+    }
+
+    if (!nameExists)
+        emit namesChanged();
+}
+
+/*!
+ * \internal
+ *
+ * Returns true if the asset named \a name hasn't been created yet.
+ */
+bool AbstractAssetCollection::hasAssetFactory(const QString &name) const
+{
+    return m_assetFactories.contains(name);
+}
+
+void AbstractAssetCollection::handleOwnerDestruction(Qt3DCore::QNode *owner)
+{
+    QObject::disconnect(m_ownerDestructionConnections.take(owner));
+
+    bool removedFactories = false;
+    for (auto it = m_assetFactories.begin(); it != m_assetFactories.end();) {
+        if (it->owner == owner) {
+            it = m_assetFactories.erase(it);
+            removedFactories = true;
+        } else {
+            ++it;
+        }
+    }
+    if (removedFactories)
+        emit namesChanged();
+}
+
 void AbstractAssetCollection::handleAssetDestruction(const QString &name)
 {
     auto asset = m_assets.take(name);
@@ -189,6 +265,9 @@ void AbstractAssetCollection::clearDestructionConnections()
     for (const auto &connection : qAsConst(m_destructionConnections))
         QObject::disconnect(connection);
     m_destructionConnections.clear();
+    for (const auto &connection : qAsConst(m_ownerDestructionConnections))
+        QObject::disconnect(connection);
+    m_ownerDestructionConnections.clear();
 }
 
 /*!
@@ -196,7 +275,24 @@ void AbstractAssetCollection::clearDestructionConnections()
  */
 Qt3DCore::QNode *AbstractAssetCollection::findAsset(const QString &name)
 {
-    return m_assets.value(name, nullptr);
+    auto factoryIt = m_assetFactories.find(name);
+    if (factoryIt == m_assetFactories.end())
+        return m_assets.value(name, nullptr);
+
+    // The asset created takes the place of its factory
+    const AssetFactory factory = factoryIt->factory;
+    m_assetFactories.erase(factoryIt);
+    Qt3DCore::QNode *asset = factory();
+    if (asset == nullptr) {
+        emit namesChanged();
+        return nullptr;
+    }
+
+    if (asset->parent() == nullptr)
+        asset->setParent(this);
+    m_assets.insert(name, asset);
+    addDestructionConnection(name, asset);
+    return asset;
 }
 
 QT_END_NAMESPACE
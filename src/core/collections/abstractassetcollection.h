@@ -31,6 +31,7 @@
 
 #include <Qt3DCore/qnode.h>
 #include <Kuesa/kuesa_global.h>
+#include <functional>
 
 QT_BEGIN_NAMESPACE
 
@@ -49,6 +50,10 @@ public:
     bool contains(const QString &name) const;
     Qt3DCore::QNode *findAsset(const QString &name);
 
+    using AssetFactory = std::function<Qt3DCore::QNode *()>;
+    void addAssetFactory(const QString &name, Qt3DCore::QNode *owner, const AssetFactory &factory);
+    bool hasAssetFactory(const QString &name) const;
+
     void remove(const QString &name);
     void clear();
 
@@ -66,9 +71,17 @@ private:
     void addDestructionConnection(const QString &name, Qt3DCore::QNode *asset);
     void removeDestructionConnection(Qt3DCore::QNode *asset);
     void clearDestructionConnections();
+    void handleOwnerDestruction(Qt3DCore::QNode *owner);
+
+    struct OwnedAssetFactory {
+        Qt3DCore::QNode *owner;
+        AssetFactory factory;
+    };
 
     QMap<QString, Qt3DCore::QNode *> m_assets;
     QHash<QNode *, QMetaObject::Connection> m_destructionConnections;
+    QMap<QString, OwnedAssetFactory> m_assetFactories;
+    QHash<QNode *, QMetaObject::Connection> m_ownerDestructionConnections;
 };
 
 } // namespace Kuesa
@@ -31,6 +31,13 @@ SOURCES += \
     $$PWD/metallicroughnesseffect.cpp \
     $$PWD/metallicroughnessmaterial.cpp \
     $$PWD/animationplayer.cpp \
+    $$PWD/blendedanimationplayer.cpp \
+    $$PWD/animationsampler.cpp \
+    $$PWD/transformtrackanimator.cpp \
+    $$PWD/bakedskinninganimation.cpp \
+    $$PWD/retargetedmappercache.cpp \
+    $$PWD/bvh.cpp \
+    $$PWD/scenequery.cpp \
     $$PWD/skybox.cpp
 
 HEADERS += \
@@ -42,5 +49,13 @@ HEADERS += \
     $$PWD/metallicroughnesseffect.h \
     $$PWD/metallicroughnessmaterial.h \
     $$PWD/animationplayer.h \
+    $$PWD/blendedanimationplayer.h \
+    $$PWD/animationsampler_p.h \
+    $$PWD/transformtrackanimator_p.h \
+    $$PWD/bakedskinninganimation.h \
+    $$PWD/bakedskinninganimation_p.h \
+    $$PWD/retargetedmappercache_p.h \
+    $$PWD/bvh_p.h \
+    $$PWD/scenequery_p.h \
     $$PWD/skybox.h
 
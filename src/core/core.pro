@@ -32,7 +32,8 @@ DEFINES += QT_NO_FOREACH
 
 DEFINES += QT_BUILD_KUESA_LIB
 
-QT += qml 3dcore 3dcore-private 3drender 3dquickextras 3danimation
+QT += qml 3dcore 3dcore-private 3drender 3dlogic 3dquickextras 3danimation
+QT_PRIVATE += concurrent
 
 include(core.pri)
 include(collections/collections.pri)
@@ -45,6 +45,14 @@
 #include "zfillrenderstage_p.h"
 #include "opaquerenderstage_p.h"
 #include "transparentrenderstage_p.h"
+#include "weightedblendedrenderstage_p.h"
+#include "rendertargetpool_p.h"
+#include "fusedpostprocessingeffect_p.h"
+#include "weightedblendedcompositeeffect_p.h"
+#include "renderscalecontroller_p.h"
+#include "renderstageprofiler_p.h"
+#include "kuesa_p.h"
+#include <Qt3DLogic/qframeaction.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -95,6 +103,13 @@ using namespace Kuesa;
  * This sorting can be expensive and is disabled by default. It can be enabled
  * by calling \fn setBackToFrontSorting.
  *
+ * Alternatively, calling \fn setOrderIndependentTransparency renders
+ * transparent objects with weighted blended order independent transparency,
+ * which needs no sorting at all and handles intersecting objects. Entities
+ * having a Material with a compatible RenderPass that has a FilterKey
+ * KuesaDrawStage with a value set to TransparentOIT will then be rendered
+ * instead of the Transparent ones.
+ *
  * In some case, an optimization technique known as an early z-filling pass can
  * provide a significant performance gain. This is especially true for large
  * scenes using complex rendering materials. The idea consist in filling the
@@ -152,6 +167,13 @@ using namespace Kuesa;
  * This sorting can be expensive and is disabled by default. It can be enabled
  * by setting the backToFrontSorting to true.
  *
+ * Alternatively, setting orderIndependentTransparency to true renders
+ * transparent objects with weighted blended order independent transparency,
+ * which needs no sorting at all and handles intersecting objects. Entities
+ * having a Material with a compatible RenderPass that has a FilterKey
+ * KuesaDrawStage with a value set to TransparentOIT will then be rendered
+ * instead of the Transparent ones.
+ *
  * In some case, an optimization technique known as an early z-filling pass can
  * provide a significant performance gain. This is especially true for large
  * scenes using complex rendering materials. The idea consist in filling the
@@ -266,6 +288,44 @@ using namespace Kuesa;
     Disabled by default.
 */
 
+/*!
+    \property Kuesa::ForwardRenderer::orderIndependentTransparency
+
+    Holds whether transparent objects are rendered with weighted blended order
+    independent transparency rather than alpha blended over the scene in
+    draw order. backToFrontSorting has no effect when enabled. Disabled by
+    default.
+
+    Transparent objects are accumulated into offscreen targets sharing the
+    depth buffer of the opaque objects, then composited over them in a full
+    screen pass, before any post processing effect. Colors are averaged with
+    weights favoring close and opaque surfaces, which is an approximation
+    that doesn't depend on the order objects are drawn in.
+
+    \note This requires OpenGL 3 or OpenGL ES 3 with support for rendering
+    into half float textures. The scene is always rendered offscreen when
+    enabled.
+*/
+
+/*!
+    \qmlproperty bool Kuesa::ForwardRenderer::orderIndependentTransparency
+
+    Holds whether transparent objects are rendered with weighted blended order
+    independent transparency rather than alpha blended over the scene in
+    draw order. backToFrontSorting has no effect when enabled. Disabled by
+    default.
+
+    Transparent objects are accumulated into offscreen targets sharing the
+    depth buffer of the opaque objects, then composited over them in a full
+    screen pass, before any post processing effect. Colors are averaged with
+    weights favoring close and opaque surfaces, which is an approximation
+    that doesn't depend on the order objects are drawn in.
+
+    \note This requires OpenGL 3 or OpenGL ES 3 with support for rendering
+    into half float textures. The scene is always rendered offscreen when
+    enabled.
+*/
+
 /*!
     \property Kuesa::ForwardRenderer::zFilling
 
@@ -278,6 +338,280 @@ using namespace Kuesa;
     Holds whether multi-pass zFilling support is enabled. Disabled by default.
 */
 
+/*!
+    \enum ForwardRenderer::OpaqueSortPolicy
+
+    This enum type describes the order opaque objects are drawn in.
+
+    \value NoOpaqueSorting  Opaque objects are drawn in no particular order.
+    \value StateChangeOpaqueSorting  Opaque objects are grouped by shader
+    program, then by render states, then drawn front to back, minimizing GPU
+    state changes while still benefiting from early depth rejection.
+    \value FrontToBackOpaqueSorting  Opaque objects are drawn front to back,
+    maximizing early depth rejection of hidden fragments.
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::opaqueSortPolicy
+
+    Holds the order opaque objects are drawn in. Scenes with many materials
+    sharing a few shaders benefit from StateChangeOpaqueSorting, while scenes
+    with expensive fragment shaders and a lot of overdraw benefit from
+    FrontToBackOpaqueSorting. NoOpaqueSorting by default.
+*/
+
+/*!
+    \qmlproperty enumeration Kuesa::ForwardRenderer::opaqueSortPolicy
+
+    Holds the order opaque objects are drawn in. Scenes with many materials
+    sharing a few shaders benefit from StateChangeOpaqueSorting, while scenes
+    with expensive fragment shaders and a lot of overdraw benefit from
+    FrontToBackOpaqueSorting. NoOpaqueSorting by default.
+
+    \list
+    \li ForwardRenderer.NoOpaqueSorting
+    \li ForwardRenderer.StateChangeOpaqueSorting
+    \li ForwardRenderer.FrontToBackOpaqueSorting
+    \endlist
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::renderTargetSizeGranularity
+
+    Holds the granularity, in pixels, of the size of the offscreen render
+    targets used by post processing effects. Their width and height are
+    rounded up to a multiple of this value, so that small changes of the
+    surface size don't reallocate them. 1 by default, meaning render targets
+    always match the surface size.
+*/
+
+/*!
+    \qmlproperty int Kuesa::ForwardRenderer::renderTargetSizeGranularity
+
+    Holds the granularity, in pixels, of the size of the offscreen render
+    targets used by post processing effects. Their width and height are
+    rounded up to a multiple of this value, so that small changes of the
+    surface size don't reallocate them. 1 by default, meaning render targets
+    always match the surface size.
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::renderScale
+
+    Holds the scale, between 0.1 and 1.0, applied to the size of the surface
+    to render the scene and post processing effects at. The last effect
+    upsamples the result to the surface. Lower values trade resolution for
+    rendering speed. 1.0 by default.
+
+    \note The scene is only rendered at a lower resolution when post
+    processing effects are used, it is otherwise rendered directly on the
+    surface.
+*/
+
+/*!
+    \qmlproperty real Kuesa::ForwardRenderer::renderScale
+
+    Holds the scale, between 0.1 and 1.0, applied to the size of the surface
+    to render the scene and post processing effects at. The last effect
+    upsamples the result to the surface. Lower values trade resolution for
+    rendering speed. 1.0 by default.
+
+    \note The scene is only rendered at a lower resolution when post
+    processing effects are used, it is otherwise rendered directly on the
+    surface.
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::automaticRenderScale
+
+    Holds whether the renderScale is adjusted automatically based on measured
+    frame times, to render frames at targetFrameRate. The scale is lowered as
+    soon as frames take too long and is raised back progressively. Disabled by
+    default.
+
+    \note Frame times are measured by the Qt 3D logic aspect, which must be
+    registered with the aspect engine.
+*/
+
+/*!
+    \qmlproperty bool Kuesa::ForwardRenderer::automaticRenderScale
+
+    Holds whether the renderScale is adjusted automatically based on measured
+    frame times, to render frames at targetFrameRate. The scale is lowered as
+    soon as frames take too long and is raised back progressively. Disabled by
+    default.
+
+    \note Frame times are measured by the Qt 3D logic aspect, which must be
+    registered with the aspect engine.
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::minimumRenderScale
+
+    Holds the lowest renderScale automaticRenderScale can pick. 0.5 by
+    default.
+*/
+
+/*!
+    \qmlproperty real Kuesa::ForwardRenderer::minimumRenderScale
+
+    Holds the lowest renderScale automaticRenderScale can pick. 0.5 by
+    default.
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::targetFrameRate
+
+    Holds the frame rate, in frames per second, automaticRenderScale tries to
+    maintain. 60 by default.
+*/
+
+/*!
+    \qmlproperty real Kuesa::ForwardRenderer::targetFrameRate
+
+    Holds the frame rate, in frames per second, automaticRenderScale tries to
+    maintain. 60 by default.
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::approximateProfiling
+
+    Holds whether the time spent rendering each render stage and post
+    processing effect is estimated. Results are reported by
+    renderStageTimings and renderStageCpuTimings. Disabled by default.
+
+    Qt 3D doesn't allow timing part of a frame with GPU timer queries, so the
+    results are approximations: render stages and effects are disabled in
+    turn for a few dozen frames, and their time is the difference with the
+    frames where all of them are enabled. renderStageTimings are differences
+    of frame times, mixing the CPU time spent submitting draw calls and the
+    GPU time executing them. renderStageCpuTimings are differences of the CPU
+    time used by the application, so are the CPU side only. The automatic
+    render scale is paused while profiling.
+
+    \warning This is meant for development only: while profiling, most
+    rendered frames miss the render stage or effect being measured, so what
+    is displayed is not the final image.
+
+    \note Frame times are measured by the Qt 3D logic aspect, which must be
+    registered with the aspect engine. When they are capped by v-sync,
+    disabling a stage doesn't make frames shorter and renderStageTimings drop
+    to about 0; a warning is then output. Render with a swap interval of 0 for
+    them to be meaningful. renderStageCpuTimings aren't affected.
+*/
+
+/*!
+    \qmlproperty bool Kuesa::ForwardRenderer::approximateProfiling
+
+    Holds whether the time spent rendering each render stage and post
+    processing effect is estimated. Results are reported by
+    renderStageTimings and renderStageCpuTimings. Disabled by default.
+
+    Qt 3D doesn't allow timing part of a frame with GPU timer queries, so the
+    results are approximations: render stages and effects are disabled in
+    turn for a few dozen frames, and their time is the difference with the
+    frames where all of them are enabled. renderStageTimings are differences
+    of frame times, mixing the CPU time spent submitting draw calls and the
+    GPU time executing them. renderStageCpuTimings are differences of the CPU
+    time used by the application, so are the CPU side only. The automatic
+    render scale is paused while profiling.
+
+    \warning This is meant for development only: while profiling, most
+    rendered frames miss the render stage or effect being measured, so what
+    is displayed is not the final image.
+
+    \note Frame times are measured by the Qt 3D logic aspect, which must be
+    registered with the aspect engine. When they are capped by v-sync,
+    disabling a stage doesn't make frames shorter and renderStageTimings drop
+    to about 0; a warning is then output. Render with a swap interval of 0 for
+    them to be meaningful. renderStageCpuTimings aren't affected.
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::renderStageTimings
+
+    Holds the approximate time, in milliseconds, spent rendering each render
+    stage and post processing effect, CPU and GPU combined, while profiling,
+    keyed by their object names. Stages and effects not measured yet are
+    omitted. Updated about once per second.
+
+    \sa approximateProfiling
+*/
+
+/*!
+    \qmlproperty var Kuesa::ForwardRenderer::renderStageTimings
+
+    Holds the approximate time, in milliseconds, spent rendering each render
+    stage and post processing effect, CPU and GPU combined, while profiling,
+    keyed by their object names. Stages and effects not measured yet are
+    omitted. Updated about once per second.
+
+    \badcode
+    Repeater {
+        model: Object.keys(frameGraph.renderStageTimings)
+        Text { text: modelData + ": " + frameGraph.renderStageTimings[modelData].toFixed(2) + " ms" }
+    }
+    \endcode
+
+    \sa approximateProfiling
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::renderStageCpuTimings
+
+    Holds the approximate CPU time, in milliseconds, used by the application
+    for each render stage and post processing effect while profiling, keyed
+    by their object names. Stages and effects not measured yet are omitted.
+    Updated about once per second.
+
+    \sa approximateProfiling
+*/
+
+/*!
+    \qmlproperty var Kuesa::ForwardRenderer::renderStageCpuTimings
+
+    Holds the approximate CPU time, in milliseconds, used by the application
+    for each render stage and post processing effect while profiling, keyed
+    by their object names. Stages and effects not measured yet are omitted.
+    Updated about once per second.
+
+    \sa approximateProfiling
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::profiledFrameTime
+
+    Holds the average frame time, in milliseconds, with all render stages and
+    effects enabled while profiling, or 0 when not measured yet.
+*/
+
+/*!
+    \qmlproperty real Kuesa::ForwardRenderer::profiledFrameTime
+
+    Holds the average frame time, in milliseconds, with all render stages and
+    effects enabled while profiling, or 0 when not measured yet.
+*/
+
+/*!
+    \property Kuesa::ForwardRenderer::profiledCpuFrameTime
+
+    Holds the average CPU time, in milliseconds, used by the application for
+    a frame with all render stages and effects enabled while profiling, or 0
+    when not measured yet. This is summed over all threads, including the
+    ones of Qt 3D. A value well below profiledFrameTime means frames are
+    bound by the GPU or by v-sync.
+*/
+
+/*!
+    \qmlproperty real Kuesa::ForwardRenderer::profiledCpuFrameTime
+
+    Holds the average CPU time, in milliseconds, used by the application for
+    a frame with all render stages and effects enabled while profiling, or 0
+    when not measured yet. This is summed over all threads, including the
+    ones of Qt 3D. A value well below profiledFrameTime means frames are
+    bound by the GPU or by v-sync.
+*/
+
 /*!
     \qmlproperty list<AbstractPostProcessingEffect> Kuesa::ForwardRenderer::postProcessingEffects
 
@@ -293,6 +627,8 @@ using namespace Kuesa;
     the effect.
 
     The FrameGraph tree is reconfigured upon replacing the list of effects.
+    Changes made to the list are batched so that the reconfiguration happens
+    at most once before the next frame.
 */
 
 ForwardRenderer::ForwardRenderer(Qt3DCore::QNode *parent)
@@ -305,13 +641,26 @@ ForwardRenderer::ForwardRenderer(Qt3DCore::QNode *parent)
     , m_noDrawClearBuffer(new Qt3DRender::QNoDraw())
     , m_frustumCulling(new Qt3DRender::QFrustumCulling())
     , m_backToFrontSorting(false)
+    , m_orderIndependentTransparency(false)
     , m_zfilling(false)
+    , m_opaqueSortPolicy(NoOpaqueSorting)
+    , m_frameGraphReconfigurationPending(false)
+    , m_textureSizeUpdatePending(false)
+    , m_renderTargetSizeGranularity(1)
+    , m_renderScale(1.0f)
+    , m_automaticRenderScale(false)
+    , m_renderScaleController(new RenderScaleController)
+    , m_approximateProfiling(false)
+    , m_renderStageProfiler(new RenderStageProfiler)
+    , m_lastProcessCpuTime(-1.0)
+    , m_frameTimeEntity(nullptr)
+    , m_weightedBlendedCompositeEffect(nullptr)
+    , m_weightedBlendedRenderTarget(nullptr)
     , m_renderToTextureRootNode(nullptr)
     , m_effectsRootNode(nullptr)
     , m_renderStageRootNode(nullptr)
+    , m_renderTargetPool(new RenderTargetPool(this))
 {
-    m_renderTargets[0] = nullptr;
-    m_renderTargets[1] = nullptr;
 
     auto filterKey = new Qt3DRender::QFilterKey(this);
     filterKey->setName(QStringLiteral("renderingStyle"));
@@ -341,8 +690,16 @@ ForwardRenderer::~ForwardRenderer()
     for (auto framegraph : m_effectFGSubtrees)
         framegraph->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
     m_effectFGSubtrees.clear();
+    for (auto fusedEffect : qAsConst(m_fusedEffects))
+        fusedEffect->frameGraphSubTree()->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
+    qDeleteAll(m_fusedEffects);
+    m_fusedEffects.clear();
+    if (m_weightedBlendedCompositeEffect)
+        m_weightedBlendedCompositeEffect->frameGraphSubTree()->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
     qDeleteAll(m_renderStages);
     m_renderStages.clear();
+    delete m_renderScaleController;
+    delete m_renderStageProfiler;
 }
 
 /*!
@@ -385,6 +742,15 @@ bool ForwardRenderer::backToFrontSorting() const
     return m_backToFrontSorting;
 }
 
+/*!
+ * Returns whether transparent objects are rendered with order independent
+ * transparency.
+ */
+bool ForwardRenderer::orderIndependentTransparency() const
+{
+    return m_orderIndependentTransparency;
+}
+
 /*!
  * Returns whether zfill passes are enabled or not.
  */
@@ -393,6 +759,117 @@ bool ForwardRenderer::zFilling() const
     return m_zfilling;
 }
 
+/*!
+ * Returns the order opaque objects are drawn in.
+ */
+ForwardRenderer::OpaqueSortPolicy ForwardRenderer::opaqueSortPolicy() const
+{
+    return m_opaqueSortPolicy;
+}
+
+/*!
+ * Returns the granularity of the size of offscreen render targets.
+ */
+int ForwardRenderer::renderTargetSizeGranularity() const
+{
+    return m_renderTargetSizeGranularity;
+}
+
+/*!
+ * Returns the scale applied to the surface size for offscreen rendering.
+ */
+float ForwardRenderer::renderScale() const
+{
+    return m_renderScale;
+}
+
+/*!
+ * Returns whether the render scale is adjusted based on frame times.
+ */
+bool ForwardRenderer::automaticRenderScale() const
+{
+    return m_automaticRenderScale;
+}
+
+/*!
+ * Returns the lowest render scale picked automatically.
+ */
+float ForwardRenderer::minimumRenderScale() const
+{
+    return m_renderScaleController->minimumScale();
+}
+
+/*!
+ * Returns the frame rate the automatic render scale aims for.
+ */
+float ForwardRenderer::targetFrameRate() const
+{
+    return 1.0f / m_renderScaleController->targetFrameTime();
+}
+
+/*!
+ * Returns whether the time of render stages and effects is being estimated.
+ */
+bool ForwardRenderer::approximateProfiling() const
+{
+    return m_approximateProfiling;
+}
+
+/*!
+ * Returns the time in milliseconds spent rendering each render stage and
+ * effect measured so far, keyed by name.
+ */
+QVariantMap ForwardRenderer::renderStageTimings() const
+{
+    QVariantMap timings;
+    if (!m_approximateProfiling)
+        return timings;
+    for (int section = 0; section < m_profiledSections.size(); ++section) {
+        const float sectionTime = m_renderStageProfiler->sectionTime(section);
+        if (sectionTime >= 0.0f)
+            timings.insert(m_profiledSections.at(section).first, sectionTime * 1000.0f);
+    }
+    return timings;
+}
+
+/*!
+ * Returns the CPU time in milliseconds used for each render stage and effect
+ * measured so far, keyed by name.
+ */
+QVariantMap ForwardRenderer::renderStageCpuTimings() const
+{
+    QVariantMap timings;
+    if (!m_approximateProfiling)
+        return timings;
+    for (int section = 0; section < m_profiledSections.size(); ++section) {
+        const float sectionCpuTime = m_renderStageProfiler->sectionCpuTime(section);
+        if (sectionCpuTime >= 0.0f)
+            timings.insert(m_profiledSections.at(section).first, sectionCpuTime * 1000.0f);
+    }
+    return timings;
+}
+
+/*!
+ * Returns the average frame time in milliseconds measured while profiling.
+ */
+float ForwardRenderer::profiledFrameTime() const
+{
+    if (!m_approximateProfiling)
+        return 0.0f;
+    return std::max(0.0f, m_renderStageProfiler->frameTime() * 1000.0f);
+}
+
+/*!
+ * Returns the average CPU time in milliseconds used by the application for a
+ * frame, measured while profiling.
+ */
+float ForwardRenderer::profiledCpuFrameTime() const
+{
+    if (!m_approximateProfiling)
+        return 0.0f;
+    return std::max(0.0f, m_renderStageProfiler->cpuFrameTime() * 1000.0f);
+}
+
 /*!
  * Registers a new post processing effect \a effect with the ForwardRenderer
  * FrameGraph. In essence this will complete the FrameGraph tree with a
@@ -404,7 +881,15 @@ bool ForwardRenderer::zFilling() const
  * unexpected behavior. It is advised against unless explicitly documented in
  * the effect.
  *
- * The FrameGraph tree is reconfigured upon insertion of a new effect.
+ * The FrameGraph tree is reconfigured upon insertion of a new effect. The
+ * reconfiguration is deferred until control returns to the event loop, so
+ * that adding or removing several effects in a row only rebuilds the tree
+ * once.
+ *
+ * Consecutive effects that are fusable are rendered in a single full screen
+ * pass rather than each into an intermediate texture.
+ *
+ * \sa AbstractPostProcessingEffect::isFusable
  */
 void ForwardRenderer::addPostProcessingEffect(AbstractPostProcessingEffect *effect)
 {
@@ -418,7 +903,13 @@ void ForwardRenderer::addPostProcessingEffect(AbstractPostProcessingEffect *effe
     QObject::connect(effect,
                      &Qt3DCore::QNode::nodeDestroyed,
                      this,
-                     [this, effect]() { removePostProcessingEffect(effect); });
+                     [this, effect]() { unregisterPostProcessingEffect(effect); });
+
+    // Effects becoming fusable or not change how the chain is split in passes
+    QObject::connect(effect,
+                     &AbstractPostProcessingEffect::fusableChanged,
+                     this,
+                     &ForwardRenderer::scheduleFrameGraphReconfiguration);
 
     // Add FrameGraph subtree to dedicated subtree of effects
     auto effectFGSubtree = effect->frameGraphSubTree();
@@ -427,8 +918,7 @@ void ForwardRenderer::addPostProcessingEffect(AbstractPostProcessingEffect *effe
         m_effectFGSubtrees.insert(effect, effectFGSubtree);
 
         // Reconfigure FrameGraph Tree
-        reconfigureFrameGraph();
-        reconfigureStages();
+        scheduleFrameGraphReconfiguration();
     }
 }
 
@@ -436,22 +926,44 @@ void ForwardRenderer::addPostProcessingEffect(AbstractPostProcessingEffect *effe
  * Unregisters \a effect from the current ForwardRenderer's FrameGraph. This
  * will destroy the FrameGraph subtree associated with the effect.
  *
- * The FrameGraph tree is reconfigured upon removal of an effect.
+ * The FrameGraph tree is reconfigured upon removal of an effect. As for
+ * addPostProcessingEffect, the reconfiguration is deferred.
  */
 void ForwardRenderer::removePostProcessingEffect(AbstractPostProcessingEffect *effect)
+{
+    if (!m_postProcessingEffects.contains(effect))
+        return;
+
+    unregisterPostProcessingEffect(effect);
+
+    // pooled textures get released on reconfiguration, the effect goes back to its own
+    effect->acquireTextures(nullptr, 0);
+}
+
+/*!
+ * \internal
+ *
+ * Forgets about \a effect and schedules the reconfiguration of the
+ * FrameGraph. Unlike removePostProcessingEffect, this doesn't call into the
+ * effect, which may be partially destroyed already when this is called from
+ * its nodeDestroyed signal.
+ */
+void ForwardRenderer::unregisterPostProcessingEffect(AbstractPostProcessingEffect *effect)
 {
     if (!m_postProcessingEffects.contains(effect))
         return;
 
     // Remove effect entry
     m_postProcessingEffects.removeAll(effect);
+    QObject::disconnect(effect, nullptr, this, nullptr);
 
     // unparent FG subtree associated with Effect.
-    m_effectFGSubtrees.take(effect)->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
+    auto effectFGSubtree = m_effectFGSubtrees.take(effect);
+    if (!effectFGSubtree.isNull())
+        effectFGSubtree->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
 
     // Reconfigure FrameGraph Tree
-    reconfigureFrameGraph();
-    reconfigureStages();
+    scheduleFrameGraphReconfiguration();
 }
 
 /*!
@@ -543,6 +1055,25 @@ void ForwardRenderer::setBackToFrontSorting(bool alphaBlending)
     }
 }
 
+/*!
+    Renders transparent objects with weighted blended order independent
+    transparency if \a orderIndependentTransparency is true, instead of
+    blending them in draw order.
+
+    This avoids sorting transparent objects every frame and renders
+    intersecting objects correctly, at the cost of rendering the scene
+    offscreen and of an approximated blending. The FrameGraph tree
+    reconfiguration is deferred as for post processing effects.
+*/
+void ForwardRenderer::setOrderIndependentTransparency(bool orderIndependentTransparency)
+{
+    if (m_orderIndependentTransparency != orderIndependentTransparency) {
+        m_orderIndependentTransparency = orderIndependentTransparency;
+        Q_EMIT orderIndependentTransparencyChanged(orderIndependentTransparency);
+        scheduleFrameGraphReconfiguration();
+    }
+}
+
 /*!
     Activates multi-pass zFilling support.
 
@@ -560,6 +1091,251 @@ void ForwardRenderer::setZFilling(bool zfilling)
     }
 }
 
+/*!
+    Sets the order opaque objects are drawn in to \a opaqueSortPolicy.
+*/
+void ForwardRenderer::setOpaqueSortPolicy(ForwardRenderer::OpaqueSortPolicy opaqueSortPolicy)
+{
+    if (m_opaqueSortPolicy != opaqueSortPolicy) {
+        m_opaqueSortPolicy = opaqueSortPolicy;
+        Q_EMIT opaqueSortPolicyChanged(opaqueSortPolicy);
+        reconfigureStages();
+    }
+}
+
+/*!
+    Sets the granularity of the size of offscreen render targets to \a
+    granularity pixels. Values lower than 1 are treated as 1.
+
+    Larger values avoid reallocating offscreen textures on small surface size
+    changes, at the expense of rendering effects into slightly larger
+    textures than needed.
+*/
+void ForwardRenderer::setRenderTargetSizeGranularity(int granularity)
+{
+    granularity = std::max(1, granularity);
+    if (m_renderTargetSizeGranularity != granularity) {
+        m_renderTargetSizeGranularity = granularity;
+        Q_EMIT renderTargetSizeGranularityChanged(granularity);
+        scheduleTextureSizeUpdate();
+    }
+}
+
+/*!
+    Sets the scale applied to the surface size to render the scene and
+    effects at to \a renderScale. Values are clamped between 0.1 and 1.0.
+*/
+void ForwardRenderer::setRenderScale(float renderScale)
+{
+    renderScale = qBound(0.1f, renderScale, 1.0f);
+    m_renderScaleController->setScale(renderScale);
+    if (!qFuzzyCompare(m_renderScale, renderScale)) {
+        m_renderScale = renderScale;
+        Q_EMIT renderScaleChanged(renderScale);
+        scheduleTextureSizeUpdate();
+    }
+}
+
+/*!
+    Enables or disables the automatic adjustment of the render scale
+    depending on \a automaticRenderScale. Disabling it keeps the last picked
+    scale.
+*/
+void ForwardRenderer::setAutomaticRenderScale(bool automaticRenderScale)
+{
+    if (m_automaticRenderScale == automaticRenderScale)
+        return;
+
+    m_automaticRenderScale = automaticRenderScale;
+    if (automaticRenderScale) {
+        m_renderScaleController->reset();
+        m_renderScaleController->setScale(m_renderScale);
+    }
+    updateFrameTimeEntity();
+    Q_EMIT automaticRenderScaleChanged(automaticRenderScale);
+}
+
+/*!
+    Sets the lowest render scale picked automatically to \a
+    minimumRenderScale.
+*/
+void ForwardRenderer::setMinimumRenderScale(float minimumRenderScale)
+{
+    const float previousMinimum = m_renderScaleController->minimumScale();
+    m_renderScaleController->setMinimumScale(minimumRenderScale);
+    if (!qFuzzyCompare(previousMinimum, m_renderScaleController->minimumScale())) {
+        Q_EMIT minimumRenderScaleChanged(m_renderScaleController->minimumScale());
+        if (automaticRenderScale())
+            setRenderScale(m_renderScaleController->scale());
+    }
+}
+
+/*!
+    Sets the frame rate the automatic render scale aims for to \a
+    targetFrameRate frames per second.
+*/
+void ForwardRenderer::setTargetFrameRate(float targetFrameRate)
+{
+    if (targetFrameRate <= 0.0f || qFuzzyCompare(this->targetFrameRate(), targetFrameRate))
+        return;
+    m_renderScaleController->setTargetFrameTime(1.0f / targetFrameRate);
+    Q_EMIT targetFrameRateChanged(targetFrameRate);
+}
+
+/*!
+    Enables or disables estimating the time of render stages and effects
+    depending on \a approximateProfiling. Results are forgotten when
+    profiling is disabled.
+*/
+void ForwardRenderer::setApproximateProfiling(bool approximateProfiling)
+{
+    if (m_approximateProfiling == approximateProfiling)
+        return;
+
+    m_approximateProfiling = approximateProfiling;
+    setProfiledSectionEnabled(m_renderStageProfiler->disabledSection(), true);
+    m_renderStageProfiler->reset();
+    m_lastProcessCpuTime = -1.0;
+    if (approximateProfiling)
+        warnIfFrameTimesCapped();
+    else if (m_automaticRenderScale)
+        m_renderScaleController->reset();
+    updateFrameTimeEntity();
+    Q_EMIT approximateProfilingChanged(approximateProfiling);
+    Q_EMIT profilingResultsChanged();
+}
+
+/*!
+ * \internal
+ *
+ * Creates the entity measuring frame times when the automatic render scale or
+ * profiling need them, destroys it otherwise.
+ */
+void ForwardRenderer::updateFrameTimeEntity()
+{
+    const bool needsFrameTimes = m_automaticRenderScale || m_approximateProfiling;
+    if (needsFrameTimes == (m_frameTimeEntity != nullptr))
+        return;
+
+    if (needsFrameTimes) {
+        // Entity holding the frame action, which is triggered by the logic aspect every frame
+        m_frameTimeEntity = new Qt3DCore::QEntity(this);
+        m_frameTimeEntity->setObjectName(QStringLiteral("KuesaFrameTime"));
+        auto frameAction = new Qt3DLogic::QFrameAction(m_frameTimeEntity);
+        QObject::connect(frameAction, &Qt3DLogic::QFrameAction::triggered,
+                         this, &ForwardRenderer::handleFrameTime);
+        m_frameTimeEntity->addComponent(frameAction);
+    } else {
+        delete m_frameTimeEntity;
+        m_frameTimeEntity = nullptr;
+    }
+}
+
+/*!
+ * \internal
+ *
+ * Accounts for a frame rendered in \a frameTime seconds.
+ */
+void ForwardRenderer::handleFrameTime(float frameTime)
+{
+    // Knocking stages out while profiling skews frame times
+    if (m_approximateProfiling)
+        updateProfiling(frameTime);
+    else if (m_automaticRenderScale)
+        updateAutomaticRenderScale(frameTime);
+}
+
+/*!
+ * \internal
+ *
+ * Accounts for a frame rendered in \a frameTime seconds, adjusting the render
+ * scale when needed.
+ */
+void ForwardRenderer::updateAutomaticRenderScale(float frameTime)
+{
+    if (m_renderScaleController->update(frameTime))
+        setRenderScale(m_renderScaleController->scale());
+}
+
+/*!
+ * \internal
+ *
+ * Accounts for a frame rendered in \a frameTime seconds while profiling,
+ * enabling back the section profiled so far and disabling the next one when
+ * a measurement completes.
+ */
+void ForwardRenderer::updateProfiling(float frameTime)
+{
+    // CPU time used by the process since the previous frame
+    const double processCpuTime = RenderStageProfiler::processCpuTime();
+    float cpuTime = -1.0f;
+    if (m_lastProcessCpuTime >= 0.0 && processCpuTime >= 0.0)
+        cpuTime = float(processCpuTime - m_lastProcessCpuTime);
+    m_lastProcessCpuTime = processCpuTime;
+
+    const int disabledSection = m_renderStageProfiler->disabledSection();
+    if (!m_renderStageProfiler->update(frameTime, cpuTime))
+        return;
+
+    setProfiledSectionEnabled(disabledSection, true);
+    setProfiledSectionEnabled(m_renderStageProfiler->disabledSection(), false);
+    Q_EMIT profilingResultsChanged();
+}
+
+/*!
+ * \internal
+ *
+ * Gathers the render stages and effects to profile, once they are in place
+ * in the FrameGraph tree. Results are forgotten if they changed.
+ */
+void ForwardRenderer::updateProfiledSections()
+{
+    QVector<ProfiledSection> sections;
+    sections.reserve(m_renderStages.size() + m_profiledEffectSections.size());
+    for (AbstractRenderStage *stage : qAsConst(m_renderStages))
+        sections.push_back({ stage->objectName(), stage });
+    sections += m_profiledEffectSections;
+
+    if (sections == m_profiledSections)
+        return;
+
+    // A rebuilt section must not stay disabled
+    setProfiledSectionEnabled(m_renderStageProfiler->disabledSection(), true);
+    m_profiledSections = sections;
+    m_renderStageProfiler->setSectionCount(sections.size());
+    if (m_approximateProfiling)
+        Q_EMIT profilingResultsChanged();
+}
+
+/*!
+ * \internal
+ *
+ * Enables or disables the FrameGraph node of profiled \a section depending
+ * on \a enabled. Does nothing if \a section is -1 or doesn't exist anymore.
+ */
+void ForwardRenderer::setProfiledSectionEnabled(int section, bool enabled)
+{
+    if (section < 0 || section >= m_profiledSections.size())
+        return;
+    Qt3DRender::QFrameGraphNode *node = m_profiledSections.at(section).second;
+    if (node)
+        node->setEnabled(enabled);
+}
+
+/*!
+ * \internal
+ *
+ * Warns when the render surface is a window presented with v-sync, which
+ * caps the frame times the approximate profiling relies on.
+ */
+void ForwardRenderer::warnIfFrameTimesCapped() const
+{
+    auto window = qobject_cast<QWindow *>(m_surfaceSelector->surface());
+    if (window && window->format().swapInterval() != 0)
+        qCWarning(kuesa, "Frame times are capped by v-sync, renderStageTimings won't be meaningful. "
+                         "Use a swap interval of 0 while profiling");
+}
+
 /*!
  * \internal
  *
@@ -568,18 +1344,36 @@ void ForwardRenderer::setZFilling(bool zfilling)
  */
 void ForwardRenderer::updateTextureSizes()
 {
-    const QSize targetSize = currentSurfaceSize();
-    QVector<Qt3DRender::QRenderTargetOutput *> outputs;
-    for (auto target : m_renderTargets) {
-        if (target != nullptr)
-            outputs += target->outputs();
-    }
-    for (auto output : outputs)
-        output->texture()->setSize(targetSize.width(), targetSize.height());
+    m_textureSizeUpdatePending = false;
+
+    const QSize targetSize = renderTargetSize();
+    if (targetSize == m_renderTargetPool->sceneSize())
+        return;
+    m_renderTargetPool->setSceneSize(targetSize);
     for (auto effect : m_postProcessingEffects)
         effect->setSceneSize(targetSize);
 }
 
+/*!
+ * \internal
+ *
+ * Requests an update of the off-screen textures once control returns to the
+ * event loop. Interactively resizing a window changes its width and height
+ * many times per frame, this ensures textures are resized at most once per
+ * frame.
+ */
+void ForwardRenderer::scheduleTextureSizeUpdate()
+{
+    if (m_textureSizeUpdatePending)
+        return;
+
+    m_textureSizeUpdatePending = true;
+    QMetaObject::invokeMethod(this, [this] {
+        if (m_textureSizeUpdatePending)
+            updateTextureSizes();
+    }, Qt::QueuedConnection);
+}
+
 /*!
  * \internal
  *
@@ -599,23 +1393,60 @@ void ForwardRenderer::handleSurfaceChange()
 
     // surface should only be a QWindow or QOffscreenSurface. Have to downcast since QSurface isn't QObject
     if (auto window = qobject_cast<QWindow *>(surface)) {
-        m_resizeConnections.push_back(connect(window, &QWindow::widthChanged, this, &ForwardRenderer::updateTextureSizes));
-        m_resizeConnections.push_back(connect(window, &QWindow::heightChanged, this, &ForwardRenderer::updateTextureSizes));
+        m_resizeConnections.push_back(connect(window, &QWindow::widthChanged, this, &ForwardRenderer::scheduleTextureSizeUpdate));
+        m_resizeConnections.push_back(connect(window, &QWindow::heightChanged, this, &ForwardRenderer::scheduleTextureSizeUpdate));
     } else if (qobject_cast<QOffscreenSurface *>(surface)) {
-        m_resizeConnections.push_back(connect(m_surfaceSelector, &Qt3DRender::QRenderSurfaceSelector::externalRenderTargetSizeChanged, this, &ForwardRenderer::updateTextureSizes));
+        m_resizeConnections.push_back(connect(m_surfaceSelector, &Qt3DRender::QRenderSurfaceSelector::externalRenderTargetSizeChanged, this, &ForwardRenderer::scheduleTextureSizeUpdate));
     } else {
         qWarning() << "Unexpected surface type for surface " << surface;
     }
+    if (m_approximateProfiling)
+        warnIfFrameTimesCapped();
     updateTextureSizes();
 }
 
+/*!
+ * \internal
+ *
+ * Requests a rebuild of the FrameGraph tree once control returns to the event
+ * loop. Multiple requests made in the meantime result in a single rebuild.
+ */
+void ForwardRenderer::scheduleFrameGraphReconfiguration()
+{
+    if (m_frameGraphReconfigurationPending)
+        return;
+
+    m_frameGraphReconfigurationPending = true;
+    QMetaObject::invokeMethod(this, [this] {
+        if (!m_frameGraphReconfigurationPending)
+            return;
+        reconfigureFrameGraph();
+        reconfigureStages();
+    }, Qt::QueuedConnection);
+}
+
 /*!
  * \internal
  *
  * Rebuild FrameGraph tree based on selected effects in the correct order.
+ *
+ * Offscreen textures are acquired from a RenderTargetPool for the passes
+ * that use them, the main scene being pass 0 and effect n being pass n + 1.
+ * Textures whose passes don't overlap share the same storage. Textures and
+ * render targets are reused between rebuilds and the ones the new chain
+ * doesn't need anymore are released.
+ *
+ * Runs of fusable effects are replaced by a FusedPostProcessingEffect and
+ * count as a single pass.
+ *
+ * With order independent transparency, the scene is always rendered into a
+ * texture and a WeightedBlendedCompositeEffect is inserted as the first
+ * effect, reading the transparency targets written in pass 0.
  */
 void ForwardRenderer::reconfigureFrameGraph()
 {
+    m_frameGraphReconfigurationPending = false;
+
     // Based on the effect types, reorder elements from the FrameGraph in the correct order
     // e.g We want Bloom to happen after DoF...
     //     We may need to render the scene into a texture first ...
@@ -635,6 +1466,14 @@ void ForwardRenderer::reconfigureFrameGraph()
         m_effectFGSubtrees.value(effect)->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
     for (AbstractRenderStage *stage : m_renderStages)
         stage->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
+    for (FusedPostProcessingEffect *fusedEffect : qAsConst(m_fusedEffects))
+        fusedEffect->frameGraphSubTree()->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
+    qDeleteAll(m_fusedEffects);
+    m_fusedEffects.clear();
+    if (m_weightedBlendedCompositeEffect)
+        m_weightedBlendedCompositeEffect->frameGraphSubTree()->setParent(static_cast<Qt3DCore::QNode *>(nullptr));
+    m_weightedBlendedRenderTarget = nullptr;
+    m_profiledEffectSections.clear();
     delete m_effectsRootNode;
     m_effectsRootNode = nullptr;
 
@@ -645,22 +1484,17 @@ void ForwardRenderer::reconfigureFrameGraph()
     // renderStageRoot if we have no FX is the frustumCullingNode
     m_renderStageRootNode = m_frustumCulling;
 
-    delete m_renderTargets[0];
-    delete m_renderTargets[1];
-    m_renderTargets[0] = nullptr;
-    m_renderTargets[1] = nullptr;
+    // Release all pooled textures, they get acquired again below
+    m_renderTargetPool->reset();
 
     // Configure effects
-    if (!m_postProcessingEffects.empty()) {
-        if (!m_renderTargets[0]) {
-            // create a render target for main scene
-            m_renderTargets[0] = createRenderTarget(true);
-        }
-        if (m_postProcessingEffects.size() > 1 && !m_renderTargets[1]) {
-            m_renderTargets[1] = createRenderTarget(false);
-            // create a secondary render target to do ping-pong when we have
-            // more than 1 fx
-        }
+    if (!m_postProcessingEffects.empty() || m_orderIndependentTransparency) {
+        const auto targetSize = renderTargetSize();
+        m_renderTargetPool->setSceneSize(targetSize);
+
+        // main scene is rendered in pass 0 and read by the first effect
+        Qt3DRender::QAbstractTexture *sceneColorTexture = m_renderTargetPool->acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 1);
+        Qt3DRender::QAbstractTexture *sceneDepthTexture = m_renderTargetPool->acquireTexture(Qt3DRender::QAbstractTexture::DepthFormat, 0, 0);
 
         // create a subtree under m_frustumCulling to render the main scene into a texture
         m_renderToTextureRootNode = new Qt3DRender::QFrameGraphNode(m_frustumCulling);
@@ -670,7 +1504,7 @@ void ForwardRenderer::reconfigureFrameGraph()
         auto mainSceneFilter = new Qt3DRender::QLayerFilter(m_renderToTextureRootNode);
         mainSceneFilter->setFilterMode(Qt3DRender::QLayerFilter::DiscardAnyMatchingLayers);
         auto sceneTargetSelector = new Qt3DRender::QRenderTargetSelector(mainSceneFilter);
-        sceneTargetSelector->setTarget(m_renderTargets[0]);
+        sceneTargetSelector->setTarget(m_renderTargetPool->renderTarget(sceneColorTexture, sceneDepthTexture));
 
         auto clearScreen = new Qt3DRender::QClearBuffers(sceneTargetSelector);
         clearScreen->setBuffers(Qt3DRender::QClearBuffers::ColorDepthBuffer);
@@ -684,17 +1518,25 @@ void ForwardRenderer::reconfigureFrameGraph()
         m_effectsRootNode = new Qt3DRender::QFrameGraphNode(m_viewport);
         m_effectsRootNode->setObjectName(QStringLiteral("KuesaPostProcessingEffects"));
 
-        // Gather the different effect types
-        const auto targetSize = currentSurfaceSize();
-        int previousRenderTargetIndex = 0;
-        for (int effectNo = 0; effectNo < m_postProcessingEffects.count(); ++effectNo) {
-            auto effect = m_postProcessingEffects[effectNo];
-            const int currentRenderTargetIndex = 1 - previousRenderTargetIndex;
+        // Gather the different effect types, fusing per-pixel effects together
+        QVector<AbstractPostProcessingEffect *> effects = fuseEffects();
+
+        // Transparent objects are composited over the scene before any effect
+        if (m_orderIndependentTransparency) {
+            if (!m_weightedBlendedCompositeEffect)
+                m_weightedBlendedCompositeEffect = new WeightedBlendedCompositeEffect(this);
+            effects.prepend(m_weightedBlendedCompositeEffect);
+        }
+
+        Qt3DRender::QAbstractTexture *inputTexture = sceneColorTexture;
+        for (int effectNo = 0; effectNo < effects.count(); ++effectNo) {
+            auto effect = effects[effectNo];
+            const int pass = effectNo + 1;
 
-            // determine which render target we used for previous effect.  It holds the input texture for current effect
-            auto previousRenderTarget = m_renderTargets[previousRenderTargetIndex];
-            effect->setInputTexture(findRenderTargetTexture(previousRenderTarget, Qt3DRender::QRenderTargetOutput::Color0));
+            // the texture written by the previous pass is the input texture for current effect
+            effect->setInputTexture(inputTexture);
             effect->setSceneSize(targetSize);
+            effect->acquireTextures(m_renderTargetPool, pass);
 
             // add the layers from the effect to block them from being rendered in the main scene
             for (auto layer : effect->layers())
@@ -702,25 +1544,103 @@ void ForwardRenderer::reconfigureFrameGraph()
 
             // Create a render target selector for all but the last effect to create the input texture for the next effect
             Qt3DCore::QNode *effectParentNode = m_effectsRootNode;
-            if (effectNo < m_postProcessingEffects.count() - 1) {
+            if (effectNo < effects.count() - 1) {
                 auto selector = new Qt3DRender::QRenderTargetSelector(effectParentNode);
                 selector->setObjectName(QStringLiteral("Effect %1").arg(effectNo));
-                selector->setTarget(m_renderTargets[currentRenderTargetIndex]);
+                // output is read by the next effect
+                inputTexture = m_renderTargetPool->acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, pass, pass + 1);
+                selector->setTarget(m_renderTargetPool->renderTarget(inputTexture));
                 effectParentNode = selector;
             }
 
             // add the effect subtree to our framegraph
-            m_effectFGSubtrees.value(effect)->setParent(effectParentNode);
+            const auto effectFGSubtree = m_effectFGSubtrees.value(effect, effect->frameGraphSubTree());
+            effectFGSubtree->setParent(effectParentNode);
+
+            // name the effect after the effect, its subtree or its type for profiling
+            QString sectionName = effect->objectName();
+            if (sectionName.isEmpty())
+                sectionName = effectFGSubtree->objectName();
+            if (sectionName.isEmpty())
+                sectionName = QString::fromLatin1(effect->metaObject()->className());
+            const QString baseName = sectionName;
+            for (int duplicateNo = 2; std::any_of(m_profiledEffectSections.cbegin(), m_profiledEffectSections.cend(),
+                                                  [&sectionName](const ProfiledSection &section) { return section.first == sectionName; });
+                 ++duplicateNo)
+                sectionName = QStringLiteral("%1 %2").arg(baseName).arg(duplicateNo);
+            m_profiledEffectSections.push_back({ sectionName, effectFGSubtree.data() });
+        }
 
-            previousRenderTargetIndex = currentRenderTargetIndex;
+        // transparent objects are accumulated while drawing the scene, tested against its depth
+        if (m_orderIndependentTransparency) {
+            const QVector<Qt3DRender::QAbstractTexture *> transparencyTextures {
+                m_weightedBlendedCompositeEffect->accumulationTexture(),
+                m_weightedBlendedCompositeEffect->weightTexture()
+            };
+            m_weightedBlendedRenderTarget = m_renderTargetPool->renderTarget(transparencyTextures, sceneDepthTexture);
         }
     }
 
+    // Free what the previous chain used and this one doesn't
+    m_renderTargetPool->releaseUnused();
+
     const bool blocked = blockNotifications(true);
     emit frameGraphTreeReconfigured();
     blockNotifications(blocked);
 }
 
+/*!
+ * \internal
+ *
+ * Returns the effects to render, in order, where each run of two or more
+ * consecutive fusable effects is replaced by a FusedPostProcessingEffect
+ * rendering them in a single pass.
+ */
+QVector<AbstractPostProcessingEffect *> ForwardRenderer::fuseEffects()
+{
+    QVector<AbstractPostProcessingEffect *> effects;
+    effects.reserve(m_postProcessingEffects.size());
+
+    int effectNo = 0;
+    while (effectNo < m_postProcessingEffects.size()) {
+        int runEnd = effectNo;
+        while (runEnd < m_postProcessingEffects.size() && m_postProcessingEffects[runEnd]->isFusable())
+            ++runEnd;
+
+        if (runEnd - effectNo > 1) {
+            auto fusedEffect = new FusedPostProcessingEffect(m_postProcessingEffects.mid(effectNo, runEnd - effectNo), this);
+            m_fusedEffects.push_back(fusedEffect);
+            effects.push_back(fusedEffect);
+            effectNo = runEnd;
+        } else {
+            effects.push_back(m_postProcessingEffects[effectNo]);
+            ++effectNo;
+        }
+    }
+    return effects;
+}
+
+/*!
+ * \internal
+ *
+ * Returns the sort types of the opaque render stage for \a policy.
+ */
+QVector<Qt3DRender::QSortPolicy::SortType> ForwardRenderer::opaqueSortTypes(ForwardRenderer::OpaqueSortPolicy policy)
+{
+    switch (policy) {
+    case StateChangeOpaqueSorting:
+        // Material sorts by shader program
+        return { Qt3DRender::QSortPolicy::Material,
+                 Qt3DRender::QSortPolicy::StateChangeCost,
+                 Qt3DRender::QSortPolicy::FrontToBack };
+    case FrontToBackOpaqueSorting:
+        return { Qt3DRender::QSortPolicy::FrontToBack };
+    case NoOpaqueSorting:
+    default:
+        return {};
+    }
+}
+
 void ForwardRenderer::reconfigureStages()
 {
     bool requiresReordering = false;
@@ -768,10 +1688,41 @@ void ForwardRenderer::reconfigureStages()
         }
     }
 
-    // Handle BackToFront sorting change
+    // Handle opaque sort policy change
     {
+        auto opaqueStage = static_cast<OpaqueRenderStage *>(m_renderStages.at(m_renderStages.size() - 2));
+        const QVector<Qt3DRender::QSortPolicy::SortType> sortTypes = opaqueSortTypes(m_opaqueSortPolicy);
+        if (opaqueStage->sortTypes() != sortTypes)
+            opaqueStage->setSortTypes(sortTypes);
+    }
+
+    // Handle order independent transparency change
+    {
+        // The last stage renders transparent objects, blended or weighted
+        auto weightedBlendedStage = qobject_cast<WeightedBlendedRenderStage *>(m_renderStages.last());
+        const bool hasWeightedBlendedStage = weightedBlendedStage != nullptr;
+
+        if (m_orderIndependentTransparency != hasWeightedBlendedStage) {
+            delete m_renderStages.takeLast();
+            if (m_orderIndependentTransparency) {
+                weightedBlendedStage = new WeightedBlendedRenderStage();
+                m_renderStages.push_back(weightedBlendedStage);
+            } else {
+                weightedBlendedStage = nullptr;
+                auto transparentStage = new TransparentRenderStage();
+                transparentStage->setBackToFrontSorting(m_backToFrontSorting);
+                m_renderStages.push_back(transparentStage);
+            }
+            requiresReordering = true;
+        }
+
+        if (weightedBlendedStage)
+            weightedBlendedStage->setRenderTarget(m_weightedBlendedRenderTarget);
+    }
+
+    // Handle BackToFront sorting change
+    if (auto transparentRenderStage = qobject_cast<TransparentRenderStage *>(m_renderStages.last())) {
         // This only affects the TransparentRenderStage
-        TransparentRenderStage *transparentRenderStage = static_cast<TransparentRenderStage *>(m_renderStages.last());
         const bool alphaBlendingIsEnabled = transparentRenderStage->backToFrontSorting();
 
         if (m_backToFrontSorting != alphaBlendingIsEnabled)
@@ -787,42 +1738,8 @@ void ForwardRenderer::reconfigureStages()
         for (AbstractRenderStage *stage : m_renderStages)
             stage->setParent(m_renderStageRootNode);
     };
-}
-
-/*!
- * \internal
- *
- * Helper function to create a QRenderTarget with the correct texture formats
- * and sizes.
- */
-Qt3DRender::QRenderTarget *ForwardRenderer::createRenderTarget(bool includeDepth)
-{
-
-    auto renderTarget = new Qt3DRender::QRenderTarget(this);
-    auto colorTexture = new Qt3DRender::QTexture2D;
-    colorTexture->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
-    colorTexture->setGenerateMipMaps(false);
 
-    const auto targetSize = currentSurfaceSize();
-    colorTexture->setSize(targetSize.width(), targetSize.height());
-    auto colorOutput = new Qt3DRender::QRenderTargetOutput;
-
-    colorOutput->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Color0);
-    colorOutput->setTexture(colorTexture);
-    renderTarget->addOutput(colorOutput);
-
-    if (includeDepth) {
-        auto depthTexture = new Qt3DRender::QTexture2D;
-        depthTexture->setFormat(Qt3DRender::QAbstractTexture::DepthFormat);
-        depthTexture->setSize(targetSize.width(), targetSize.height());
-        depthTexture->setGenerateMipMaps(false);
-        auto depthOutput = new Qt3DRender::QRenderTargetOutput;
-        depthOutput->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Depth);
-        depthOutput->setTexture(depthTexture);
-        renderTarget->addOutput(depthOutput);
-    }
-
-    return renderTarget;
+    updateProfiledSections();
 }
 
 /*!
@@ -865,6 +1782,31 @@ QSize ForwardRenderer::currentSurfaceSize() const
     return size;
 }
 
+/*!
+ * \internal
+ *
+ * Returns the size of the offscreen render targets, that is the surface size
+ * scaled by the render scale and rounded up to the render target size
+ * granularity.
+ */
+QSize ForwardRenderer::renderTargetSize() const
+{
+    QSize surfaceSize = currentSurfaceSize();
+    if (surfaceSize.isEmpty())
+        return surfaceSize;
+
+    if (m_renderScale < 1.0f)
+        surfaceSize = QSize(std::max(1, qRound(surfaceSize.width() * m_renderScale)),
+                            std::max(1, qRound(surfaceSize.height() * m_renderScale)));
+    if (m_renderTargetSizeGranularity <= 1)
+        return surfaceSize;
+
+    const auto roundUp = [this](int value) {
+        return ((value + m_renderTargetSizeGranularity - 1) / m_renderTargetSizeGranularity) * m_renderTargetSizeGranularity;
+    };
+    return QSize(roundUp(surfaceSize.width()), roundUp(surfaceSize.height()));
+}
+
 /*!
  * Sets the size of the external render target.
  */
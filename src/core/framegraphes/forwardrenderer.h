@@ -34,7 +34,10 @@
 #include <Qt3DRender/qframegraphnode.h>
 #include <Qt3DRender/qclearbuffers.h>
 #include <Qt3DRender/qrendertargetoutput.h>
+#include <Qt3DRender/qsortpolicy.h>
 #include <QVector>
+#include <QVariantMap>
+#include <QPointer>
 
 QT_BEGIN_NAMESPACE
 
@@ -52,7 +55,12 @@ class QRenderTarget;
 namespace Kuesa {
 
 class AbstractPostProcessingEffect;
+class FusedPostProcessingEffect;
+class WeightedBlendedCompositeEffect;
 class AbstractRenderStage;
+class RenderTargetPool;
+class RenderScaleController;
+class RenderStageProfiler;
 
 class KUESASHARED_EXPORT ForwardRenderer : public Qt3DRender::QFrameGraphNode
 {
@@ -65,9 +73,28 @@ class KUESASHARED_EXPORT ForwardRenderer : public Qt3DRender::QFrameGraphNode
     Q_PROPERTY(Qt3DRender::QClearBuffers::BufferType clearBuffers READ clearBuffers WRITE setClearBuffers NOTIFY clearBuffersChanged)
     Q_PROPERTY(bool frustumCulling READ frustumCulling WRITE setFrustumCulling NOTIFY frustumCullingChanged)
     Q_PROPERTY(bool backToFrontSorting READ backToFrontSorting WRITE setBackToFrontSorting NOTIFY backToFrontSortingChanged)
+    Q_PROPERTY(bool orderIndependentTransparency READ orderIndependentTransparency WRITE setOrderIndependentTransparency NOTIFY orderIndependentTransparencyChanged)
     Q_PROPERTY(bool zFilling READ zFilling WRITE setZFilling NOTIFY zFillingChanged)
+    Q_PROPERTY(Kuesa::ForwardRenderer::OpaqueSortPolicy opaqueSortPolicy READ opaqueSortPolicy WRITE setOpaqueSortPolicy NOTIFY opaqueSortPolicyChanged)
+    Q_PROPERTY(int renderTargetSizeGranularity READ renderTargetSizeGranularity WRITE setRenderTargetSizeGranularity NOTIFY renderTargetSizeGranularityChanged)
+    Q_PROPERTY(float renderScale READ renderScale WRITE setRenderScale NOTIFY renderScaleChanged)
+    Q_PROPERTY(bool automaticRenderScale READ automaticRenderScale WRITE setAutomaticRenderScale NOTIFY automaticRenderScaleChanged)
+    Q_PROPERTY(float minimumRenderScale READ minimumRenderScale WRITE setMinimumRenderScale NOTIFY minimumRenderScaleChanged)
+    Q_PROPERTY(float targetFrameRate READ targetFrameRate WRITE setTargetFrameRate NOTIFY targetFrameRateChanged)
+    Q_PROPERTY(bool approximateProfiling READ approximateProfiling WRITE setApproximateProfiling NOTIFY approximateProfilingChanged)
+    Q_PROPERTY(QVariantMap renderStageTimings READ renderStageTimings NOTIFY profilingResultsChanged)
+    Q_PROPERTY(QVariantMap renderStageCpuTimings READ renderStageCpuTimings NOTIFY profilingResultsChanged)
+    Q_PROPERTY(float profiledFrameTime READ profiledFrameTime NOTIFY profilingResultsChanged)
+    Q_PROPERTY(float profiledCpuFrameTime READ profiledCpuFrameTime NOTIFY profilingResultsChanged)
 
 public:
+    enum OpaqueSortPolicy {
+        NoOpaqueSorting,
+        StateChangeOpaqueSorting,
+        FrontToBackOpaqueSorting
+    };
+    Q_ENUM(OpaqueSortPolicy)
+
     ForwardRenderer(Qt3DCore::QNode *parent = nullptr);
     ~ForwardRenderer();
 
@@ -79,7 +106,19 @@ public:
     Qt3DRender::QClearBuffers::BufferType clearBuffers() const;
     bool frustumCulling() const;
     bool backToFrontSorting() const;
+    bool orderIndependentTransparency() const;
     bool zFilling() const;
+    OpaqueSortPolicy opaqueSortPolicy() const;
+    int renderTargetSizeGranularity() const;
+    float renderScale() const;
+    bool automaticRenderScale() const;
+    float minimumRenderScale() const;
+    float targetFrameRate() const;
+    bool approximateProfiling() const;
+    QVariantMap renderStageTimings() const;
+    QVariantMap renderStageCpuTimings() const;
+    float profiledFrameTime() const;
+    float profiledCpuFrameTime() const;
 
     Q_INVOKABLE void addPostProcessingEffect(AbstractPostProcessingEffect *effect);
     Q_INVOKABLE void removePostProcessingEffect(AbstractPostProcessingEffect *effect);
@@ -98,7 +137,15 @@ public Q_SLOTS:
     void setClearBuffers(Qt3DRender::QClearBuffers::BufferType clearBuffers);
     void setFrustumCulling(bool frustumCulling);
     void setBackToFrontSorting(bool backToFrontSorting);
+    void setOrderIndependentTransparency(bool orderIndependentTransparency);
     void setZFilling(bool zfilling);
+    void setOpaqueSortPolicy(Kuesa::ForwardRenderer::OpaqueSortPolicy opaqueSortPolicy);
+    void setRenderTargetSizeGranularity(int granularity);
+    void setRenderScale(float renderScale);
+    void setAutomaticRenderScale(bool automaticRenderScale);
+    void setMinimumRenderScale(float minimumRenderScale);
+    void setTargetFrameRate(float targetFrameRate);
+    void setApproximateProfiling(bool approximateProfiling);
 
 Q_SIGNALS:
     void renderSurfaceChanged(QObject *renderSurface);
@@ -109,16 +156,37 @@ Q_SIGNALS:
     void clearBuffersChanged(Qt3DRender::QClearBuffers::BufferType clearBuffers);
     void frustumCullingChanged(bool frustumCulling);
     void backToFrontSortingChanged(bool backToFrontSorting);
+    void orderIndependentTransparencyChanged(bool orderIndependentTransparency);
     void zFillingChanged(bool zFilling);
+    void opaqueSortPolicyChanged(Kuesa::ForwardRenderer::OpaqueSortPolicy opaqueSortPolicy);
+    void renderTargetSizeGranularityChanged(int renderTargetSizeGranularity);
+    void renderScaleChanged(float renderScale);
+    void automaticRenderScaleChanged(bool automaticRenderScale);
+    void minimumRenderScaleChanged(float minimumRenderScale);
+    void targetFrameRateChanged(float targetFrameRate);
+    void approximateProfilingChanged(bool approximateProfiling);
+    void profilingResultsChanged();
     void frameGraphTreeReconfigured();
 
 private:
     void updateTextureSizes();
+    void scheduleTextureSizeUpdate();
     void handleSurfaceChange();
     QSize currentSurfaceSize() const;
+    QSize renderTargetSize() const;
+    void updateFrameTimeEntity();
+    void handleFrameTime(float frameTime);
+    void updateAutomaticRenderScale(float frameTime);
+    void updateProfiling(float frameTime);
+    void updateProfiledSections();
+    void setProfiledSectionEnabled(int section, bool enabled);
+    void warnIfFrameTimesCapped() const;
+    void scheduleFrameGraphReconfiguration();
+    void unregisterPostProcessingEffect(AbstractPostProcessingEffect *effect);
     void reconfigureFrameGraph();
     void reconfigureStages();
-    Qt3DRender::QRenderTarget *createRenderTarget(bool includeDepth);
+    static QVector<Qt3DRender::QSortPolicy::SortType> opaqueSortTypes(OpaqueSortPolicy policy);
+    QVector<AbstractPostProcessingEffect *> fuseEffects();
     AbstractPostProcessingEffect::FrameGraphNodePtr frameGraphSubtreeForPostProcessingEffect(AbstractPostProcessingEffect *effect) const;
 
     Qt3DRender::QTechniqueFilter *m_techniqueFilter;
@@ -129,9 +197,24 @@ private:
     Qt3DRender::QNoDraw *m_noDrawClearBuffer;
     Qt3DRender::QFrustumCulling *m_frustumCulling;
     bool m_backToFrontSorting;
+    bool m_orderIndependentTransparency;
     bool m_zfilling;
+    OpaqueSortPolicy m_opaqueSortPolicy;
+    bool m_frameGraphReconfigurationPending;
+    bool m_textureSizeUpdatePending;
+    int m_renderTargetSizeGranularity;
+    float m_renderScale;
+    bool m_automaticRenderScale;
+    RenderScaleController *m_renderScaleController;
+    bool m_approximateProfiling;
+    RenderStageProfiler *m_renderStageProfiler;
+    double m_lastProcessCpuTime;
+    Qt3DCore::QEntity *m_frameTimeEntity;
     QVector<AbstractPostProcessingEffect *> m_postProcessingEffects;
     QHash<AbstractPostProcessingEffect *, AbstractPostProcessingEffect::FrameGraphNodePtr> m_effectFGSubtrees;
+    QVector<FusedPostProcessingEffect *> m_fusedEffects;
+    WeightedBlendedCompositeEffect *m_weightedBlendedCompositeEffect;
+    Qt3DRender::QRenderTarget *m_weightedBlendedRenderTarget;
 
     QVector<QMetaObject::Connection> m_resizeConnections;
 
@@ -139,10 +222,15 @@ private:
     Qt3DRender::QFrameGraphNode *m_renderToTextureRootNode;
     Qt3DRender::QFrameGraphNode *m_effectsRootNode;
     Qt3DRender::QFrameGraphNode *m_renderStageRootNode;
-    Qt3DRender::QRenderTarget *m_renderTargets[2];
+    RenderTargetPool *m_renderTargetPool;
 
     //For controlling render stages
     QVector<AbstractRenderStage *> m_renderStages;
+
+    //For profiling render stages and effects, by name
+    using ProfiledSection = QPair<QString, QPointer<Qt3DRender::QFrameGraphNode>>;
+    QVector<ProfiledSection> m_profiledEffectSections;
+    QVector<ProfiledSection> m_profiledSections;
 };
 } // namespace Kuesa
 QT_END_NAMESPACE
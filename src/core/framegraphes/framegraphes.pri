@@ -28,15 +28,23 @@ INCLUDEPATH += $$PWD
 
 SOURCES += \
     $$PWD/forwardrenderer.cpp \
+    $$PWD/rendertargetpool.cpp \
+    $$PWD/renderscalecontroller.cpp \
+    $$PWD/renderstageprofiler.cpp \
     $$PWD/abstractrenderstage.cpp \
     $$PWD/zfillrenderstage.cpp \
     $$PWD/opaquerenderstage.cpp \
-    $$PWD/transparentrenderstage.cpp
+    $$PWD/transparentrenderstage.cpp \
+    $$PWD/weightedblendedrenderstage.cpp
 
 HEADERS += \
     $$PWD/forwardrenderer.h \
+    $$PWD/rendertargetpool_p.h \
+    $$PWD/renderscalecontroller_p.h \
+    $$PWD/renderstageprofiler_p.h \
     $$PWD/abstractrenderstage_p.h \
     $$PWD/zfillrenderstage_p.h \
     $$PWD/opaquerenderstage_p.h \
-    $$PWD/transparentrenderstage_p.h
+    $$PWD/transparentrenderstage_p.h \
+    $$PWD/weightedblendedrenderstage_p.h
 
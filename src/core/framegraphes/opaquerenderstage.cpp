@@ -31,6 +31,7 @@
 #include <Qt3DRender/QDepthTest>
 #include <Qt3DRender/QNoDepthMask>
 #include <Qt3DRender/QRenderStateSet>
+#include <Qt3DRender/QSortPolicy>
 
 QT_USE_NAMESPACE
 
@@ -50,6 +51,10 @@ OpaqueRenderStage::OpaqueRenderStage(Qt3DCore::QNode *parent)
     m_depthTest->setDepthFunction(Qt3DRender::QDepthTest::Less);
     m_states->addRenderState(m_depthTest);
     m_noDepthWrite = new Qt3DRender::QNoDepthMask(m_states);
+
+    // Opaque objects are drawn in no particular order unless sort types are set
+    m_sortPolicy = new Qt3DRender::QSortPolicy(m_states);
+    m_sortPolicy->setEnabled(false);
 }
 
 OpaqueRenderStage::~OpaqueRenderStage()
@@ -74,3 +79,21 @@ bool OpaqueRenderStage::zFilling() const
 {
     return m_depthTest->depthFunction() == Qt3DRender::QDepthTest::Equal;
 }
+
+/*!
+ * Sets the criteria opaque objects are sorted by before being drawn to \a
+ * sortTypes, the first one being the primary criterion. No sorting takes
+ * place when \a sortTypes is empty.
+ */
+void OpaqueRenderStage::setSortTypes(const QVector<Qt3DRender::QSortPolicy::SortType> &sortTypes)
+{
+    m_sortPolicy->setSortTypes(sortTypes);
+    m_sortPolicy->setEnabled(!sortTypes.empty());
+}
+
+QVector<Qt3DRender::QSortPolicy::SortType> OpaqueRenderStage::sortTypes() const
+{
+    if (!m_sortPolicy->isEnabled())
+        return {};
+    return m_sortPolicy->sortTypes();
+}
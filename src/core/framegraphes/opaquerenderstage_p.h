@@ -41,6 +41,7 @@
 //
 
 #include "abstractrenderstage_p.h"
+#include <Qt3DRender/qsortpolicy.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -48,6 +49,7 @@ namespace Qt3DRender {
 class QDepthTest;
 class QNoDepthMask;
 class QRenderStateSet;
+class QSortPolicy;
 } // namespace Qt3DRender
 
 namespace Kuesa {
@@ -62,10 +64,14 @@ public:
     void setZFilling(bool zFill);
     bool zFilling() const;
 
+    void setSortTypes(const QVector<Qt3DRender::QSortPolicy::SortType> &sortTypes);
+    QVector<Qt3DRender::QSortPolicy::SortType> sortTypes() const;
+
 private:
     Qt3DRender::QRenderStateSet *m_states;
     Qt3DRender::QDepthTest *m_depthTest;
     Qt3DRender::QNoDepthMask *m_noDepthWrite;
+    Qt3DRender::QSortPolicy *m_sortPolicy;
 };
 } // namespace Kuesa
 
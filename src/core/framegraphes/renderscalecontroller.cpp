@@ -0,0 +1,182 @@
+/*
+    renderscalecontroller.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "renderscalecontroller_p.h"
+#include <QtMath>
+#include <algorithm>
+
+QT_USE_NAMESPACE
+
+using namespace Kuesa;
+
+/*!
+ * \class Kuesa::RenderScaleController
+ * \internal
+ *
+ * Picks the scale at which the ForwardRenderer renders its offscreen targets
+ * so that frames are rendered within a target frame time.
+ *
+ * Frame times are averaged over a few frames. When the average exceeds the
+ * target, the scale is lowered right away, in proportion to the excess
+ * since the cost of a frame is mostly proportional to its pixel count. When
+ * frames are rendered in time for a while, the scale is raised by a step.
+ * Frame times are usually capped by v-sync, so raising the scale is a probe:
+ * each probe followed by a quick downscale doubles the time before the next
+ * one, avoiding oscillations between two scales.
+ *
+ * Scales are multiples of scaleStep and changes are at least
+ * settleFrameCount frames apart, so that offscreen textures don't get
+ * reallocated on every frame.
+ */
+
+const float RenderScaleController::maximumScale = 1.0f;
+const float RenderScaleController::scaleStep = 0.05f;
+const int RenderScaleController::settleFrameCount = 30;
+
+namespace {
+
+// Frame time ratios to the target triggering a change
+const float downscaleThreshold = 1.1f;
+const float upscaleThreshold = 1.05f;
+const float averagingFactor = 0.1f;
+const int maximumUpscaleDelay = 60 * RenderScaleController::settleFrameCount;
+
+float quantized(float scale)
+{
+    return std::round(scale / RenderScaleController::scaleStep) * RenderScaleController::scaleStep;
+}
+
+} // namespace
+
+RenderScaleController::RenderScaleController()
+    : m_targetFrameTime(1.0f / 60.0f)
+    , m_minimumScale(0.5f)
+    , m_scale(maximumScale)
+{
+    reset();
+}
+
+/*!
+ * Sets the frame time to stay under, in seconds, to \a targetFrameTime.
+ */
+void RenderScaleController::setTargetFrameTime(float targetFrameTime)
+{
+    m_targetFrameTime = targetFrameTime;
+}
+
+float RenderScaleController::targetFrameTime() const
+{
+    return m_targetFrameTime;
+}
+
+/*!
+ * Sets the lowest scale that can be picked to \a minimumScale.
+ */
+void RenderScaleController::setMinimumScale(float minimumScale)
+{
+    m_minimumScale = qBound(scaleStep, minimumScale, maximumScale);
+    m_scale = std::max(m_scale, m_minimumScale);
+}
+
+float RenderScaleController::minimumScale() const
+{
+    return m_minimumScale;
+}
+
+/*!
+ * Sets the current scale to \a scale, for instance when the scale was
+ * changed manually.
+ */
+void RenderScaleController::setScale(float scale)
+{
+    m_scale = qBound(m_minimumScale, scale, maximumScale);
+}
+
+float RenderScaleController::scale() const
+{
+    return m_scale;
+}
+
+/*!
+ * Returns the average of the last frame times, or a negative value when no
+ * frame was measured yet.
+ */
+float RenderScaleController::averageFrameTime() const
+{
+    return m_averageFrameTime;
+}
+
+/*!
+ * Forgets the measured frame times.
+ */
+void RenderScaleController::reset()
+{
+    m_averageFrameTime = -1.0f;
+    m_framesSinceChange = 0;
+    m_upscaleDelay = 2 * settleFrameCount;
+    m_lastChangeWasUpscale = false;
+}
+
+/*!
+ * Accounts for a frame rendered in \a frameTime seconds and returns true if
+ * the scale was changed as a result.
+ */
+bool RenderScaleController::update(float frameTime)
+{
+    if (frameTime <= 0.0f || m_targetFrameTime <= 0.0f)
+        return false;
+
+    m_averageFrameTime = m_averageFrameTime < 0.0f
+            ? frameTime
+            : m_averageFrameTime + averagingFactor * (frameTime - m_averageFrameTime);
+    ++m_framesSinceChange;
+
+    if (m_framesSinceChange < settleFrameCount)
+        return false;
+
+    const float ratio = m_averageFrameTime / m_targetFrameTime;
+    float scale = m_scale;
+    if (ratio > downscaleThreshold) {
+        // Pixel count goes with the square of the scale
+        scale = std::min(quantized(m_scale / std::sqrt(ratio)), m_scale - scaleStep);
+        // Going back down right after probing a higher scale
+        if (m_lastChangeWasUpscale && m_framesSinceChange < m_upscaleDelay)
+            m_upscaleDelay = std::min(2 * m_upscaleDelay, maximumUpscaleDelay);
+    } else if (ratio <= upscaleThreshold && m_framesSinceChange >= m_upscaleDelay) {
+        scale = m_scale + scaleStep;
+    }
+
+    scale = qBound(m_minimumScale, scale, maximumScale);
+    if (qFuzzyCompare(scale, m_scale))
+        return false;
+
+    m_lastChangeWasUpscale = scale > m_scale;
+    m_scale = scale;
+    m_framesSinceChange = 0;
+    return true;
+}
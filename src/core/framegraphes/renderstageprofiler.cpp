@@ -0,0 +1,235 @@
+/*
+    renderstageprofiler.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "renderstageprofiler_p.h"
+#include <algorithm>
+#include <ctime>
+
+#if defined(Q_OS_WIN)
+#include <qt_windows.h>
+#endif
+
+QT_USE_NAMESPACE
+
+using namespace Kuesa;
+
+/*!
+ * \class Kuesa::RenderStageProfiler
+ * \internal
+ *
+ * Approximates how long each section of the ForwardRenderer FrameGraph,
+ * render stages and post processing effects, takes to render.
+ *
+ * Qt 3D offers no way of issuing GPU timer queries around part of the
+ * FrameGraph, so sections are knocked out in turn instead: frames are
+ * measured over windows alternating between all sections enabled and one
+ * section disabled, and the time of a section is the difference between the
+ * two averages. This mixes the CPU time submitting the section with the GPU
+ * time executing it, and is only meaningful when frames aren't capped by
+ * v-sync.
+ *
+ * The CPU time used by the process is averaged separately over the same
+ * windows, giving the CPU side of the frame time and, by difference, the
+ * CPU time of each section. Those don't depend on v-sync.
+ *
+ * The first settleFrameCount frames of a window are ignored, giving time to
+ * the FrameGraph change to take effect, then sampleFrameCount frames are
+ * averaged. Results are blended with the previous ones, so that they follow
+ * changes of the scene without being too noisy.
+ */
+
+const int RenderStageProfiler::settleFrameCount = 5;
+const int RenderStageProfiler::sampleFrameCount = 30;
+
+namespace {
+
+const float averagingFactor = 0.5f;
+
+float blended(float previous, float value)
+{
+    return previous < 0.0f ? value : previous + averagingFactor * (value - previous);
+}
+
+} // namespace
+
+RenderStageProfiler::RenderStageProfiler()
+{
+    reset();
+}
+
+/*!
+ * Sets the number of sections to profile to \a sectionCount, forgetting
+ * previous results.
+ */
+void RenderStageProfiler::setSectionCount(int sectionCount)
+{
+    m_sectionTimes.resize(std::max(0, sectionCount));
+    m_sectionCpuTimes.resize(m_sectionTimes.size());
+    reset();
+}
+
+int RenderStageProfiler::sectionCount() const
+{
+    return m_sectionTimes.size();
+}
+
+/*!
+ * Returns the section which must be disabled for the frames to come, or -1
+ * if all sections must be enabled.
+ */
+int RenderStageProfiler::disabledSection() const
+{
+    return m_disabledSection;
+}
+
+/*!
+ * Returns the average frame time, in seconds, with all sections enabled or a
+ * negative value when not measured yet.
+ */
+float RenderStageProfiler::frameTime() const
+{
+    return m_frameTime;
+}
+
+/*!
+ * Returns the average CPU time, in seconds, used by the process for a frame
+ * with all sections enabled, or a negative value when not measured yet.
+ */
+float RenderStageProfiler::cpuFrameTime() const
+{
+    return m_cpuFrameTime;
+}
+
+/*!
+ * Returns the time, in seconds, spent rendering \a section or a negative
+ * value when not measured yet.
+ */
+float RenderStageProfiler::sectionTime(int section) const
+{
+    return m_sectionTimes.value(section, -1.0f);
+}
+
+/*!
+ * Returns the CPU time, in seconds, used by the process for rendering \a
+ * section or a negative value when not measured yet.
+ */
+float RenderStageProfiler::sectionCpuTime(int section) const
+{
+    return m_sectionCpuTimes.value(section, -1.0f);
+}
+
+/*!
+ * Forgets the measured times and enables all sections.
+ */
+void RenderStageProfiler::reset()
+{
+    std::fill(m_sectionTimes.begin(), m_sectionTimes.end(), -1.0f);
+    std::fill(m_sectionCpuTimes.begin(), m_sectionCpuTimes.end(), -1.0f);
+    m_frameTime = -1.0f;
+    m_cpuFrameTime = -1.0f;
+    m_nextSection = 0;
+    startWindow(-1);
+}
+
+void RenderStageProfiler::startWindow(int disabledSection)
+{
+    m_disabledSection = disabledSection;
+    m_windowFrameCount = 0;
+    m_windowFrameTime = 0.0f;
+    m_windowCpuFrameCount = 0;
+    m_windowCpuTime = 0.0f;
+}
+
+/*!
+ * Accounts for a frame rendered in \a frameTime seconds, during which the
+ * process used \a cpuTime seconds of CPU time, and returns true if it
+ * completed a measurement window, in which case the results and the disabled
+ * section may have changed. A negative \a cpuTime means it is unknown.
+ */
+bool RenderStageProfiler::update(float frameTime, float cpuTime)
+{
+    if (frameTime <= 0.0f)
+        return false;
+
+    if (++m_windowFrameCount <= settleFrameCount)
+        return false;
+    m_windowFrameTime += frameTime;
+    if (cpuTime >= 0.0f) {
+        ++m_windowCpuFrameCount;
+        m_windowCpuTime += cpuTime;
+    }
+    if (m_windowFrameCount < settleFrameCount + sampleFrameCount)
+        return false;
+
+    const float average = m_windowFrameTime / sampleFrameCount;
+    if (m_disabledSection < 0) {
+        m_frameTime = blended(m_frameTime, average);
+        if (m_windowCpuFrameCount > 0)
+            m_cpuFrameTime = blended(m_cpuFrameTime, m_windowCpuTime / m_windowCpuFrameCount);
+        if (m_sectionTimes.empty()) {
+            startWindow(-1);
+        } else {
+            // Alternate with the next section knocked out
+            startWindow(m_nextSection);
+            m_nextSection = (m_nextSection + 1) % m_sectionTimes.size();
+        }
+    } else {
+        // Frames can get faster than the baseline due to noise
+        const float sectionTime = std::max(0.0f, m_frameTime - average);
+        m_sectionTimes[m_disabledSection] = blended(m_sectionTimes[m_disabledSection], sectionTime);
+        if (m_windowCpuFrameCount > 0 && m_cpuFrameTime >= 0.0f) {
+            const float sectionCpuTime = std::max(0.0f, m_cpuFrameTime - m_windowCpuTime / m_windowCpuFrameCount);
+            m_sectionCpuTimes[m_disabledSection] = blended(m_sectionCpuTimes[m_disabledSection], sectionCpuTime);
+        }
+        startWindow(-1);
+    }
+    return true;
+}
+
+/*!
+ * Returns the CPU time, in seconds, used so far by all the threads of the
+ * process, or a negative value if it can't be retrieved.
+ */
+double RenderStageProfiler::processCpuTime()
+{
+#if defined(Q_OS_WIN)
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return -1.0;
+    // FILETIMEs count 100 nanosecond intervals
+    const auto seconds = [](const FILETIME &time) {
+        return double((quint64(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7;
+    };
+    return seconds(kernelTime) + seconds(userTime);
+#else
+    const std::clock_t time = std::clock();
+    if (time == std::clock_t(-1))
+        return -1.0;
+    return double(time) / CLOCKS_PER_SEC;
+#endif
+}
@@ -0,0 +1,265 @@
+/*
+    rendertargetpool.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "rendertargetpool_p.h"
+#include <Qt3DRender/qtexture.h>
+#include <Qt3DRender/qrendertarget.h>
+#include <Qt3DRender/qrendertargetoutput.h>
+#include <algorithm>
+
+QT_USE_NAMESPACE
+
+using namespace Kuesa;
+
+/*!
+ * \class Kuesa::RenderTargetPool
+ * \internal
+ *
+ * Holds the offscreen textures used by the ForwardRenderer and its post
+ * processing effects.
+ *
+ * Textures are requested by format for a range of passes of the effect
+ * chain, the main scene being pass 0 and effect n being pass n + 1. A texture
+ * is handed out again for any other range which doesn't overlap the ranges it
+ * was already acquired for, so that textures which are never alive at the
+ * same time share the same storage. Textures follow the scene size, divided
+ * by the size divisor they were requested with.
+ *
+ * Calling reset() forgets the ranges but keeps the textures and render
+ * targets around, so rebuilding a chain reuses existing allocations. Once
+ * the chain is rebuilt, releaseUnused() frees whatever it no longer needs.
+ */
+
+RenderTargetPool::RenderTargetPool(Qt3DCore::QNode *parent)
+    : Qt3DCore::QNode(parent)
+{
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+}
+
+/*!
+ * Resizes all the pooled textures to \a size.
+ */
+void RenderTargetPool::setSceneSize(const QSize &size)
+{
+    if (m_sceneSize == size)
+        return;
+
+    m_sceneSize = size;
+    if (!size.isValid())
+        return;
+    for (const PooledTexture &pooled : qAsConst(m_textures)) {
+        const QSize textureSize = this->textureSize(pooled.sizeDivisor);
+        pooled.texture->setSize(textureSize.width(), textureSize.height());
+    }
+}
+
+QSize RenderTargetPool::sceneSize() const
+{
+    return m_sceneSize;
+}
+
+/*!
+ * Releases all the textures. They will be handed out again by subsequent
+ * calls to acquireTexture().
+ */
+void RenderTargetPool::reset()
+{
+    for (PooledTexture &pooled : m_textures)
+        pooled.passes.clear();
+    for (PooledRenderTarget &pooled : m_renderTargets)
+        pooled.used = false;
+}
+
+/*!
+ * Deletes the textures which weren't acquired and the render targets which
+ * weren't requested since the last call to reset(), as well as the render
+ * targets using deleted textures.
+ */
+void RenderTargetPool::releaseUnused()
+{
+    QVector<Qt3DRender::QAbstractTexture *> releasedTextures;
+    const auto unusedTexture = [&releasedTextures](const PooledTexture &pooled) {
+        if (!pooled.passes.isEmpty())
+            return false;
+        releasedTextures.push_back(pooled.texture);
+        return true;
+    };
+    m_textures.erase(std::remove_if(m_textures.begin(), m_textures.end(), unusedTexture), m_textures.end());
+
+    QVector<Qt3DRender::QRenderTarget *> releasedTargets;
+    const auto unusedTarget = [&releasedTargets, &releasedTextures](const PooledRenderTarget &pooled) {
+        const bool usesReleasedTexture = releasedTextures.contains(pooled.depth) ||
+                std::any_of(pooled.colors.cbegin(), pooled.colors.cend(),
+                            [&releasedTextures](Qt3DRender::QAbstractTexture *color) {
+                                return releasedTextures.contains(color);
+                            });
+        if (pooled.used && !usesReleasedTexture)
+            return false;
+        releasedTargets.push_back(pooled.target);
+        return true;
+    };
+    m_renderTargets.erase(std::remove_if(m_renderTargets.begin(), m_renderTargets.end(), unusedTarget), m_renderTargets.end());
+
+    // Render targets first, their outputs reference the textures
+    qDeleteAll(releasedTargets);
+    qDeleteAll(releasedTextures);
+}
+
+/*!
+ * Returns a texture of the given \a format, with the scene size divided by
+ * \a sizeDivisor, which isn't used by any pass between \a firstPass and \a
+ * lastPass included and reserves it for these passes. A new texture is only
+ * created if no such texture exists.
+ */
+Qt3DRender::QAbstractTexture *RenderTargetPool::acquireTexture(Qt3DRender::QAbstractTexture::TextureFormat format,
+                                                               int firstPass, int lastPass,
+                                                               int sizeDivisor)
+{
+    Q_ASSERT(firstPass <= lastPass);
+    Q_ASSERT(sizeDivisor > 0);
+
+    for (PooledTexture &pooled : m_textures) {
+        if (pooled.texture->format() != format || pooled.sizeDivisor != sizeDivisor)
+            continue;
+        const bool overlaps = std::any_of(pooled.passes.cbegin(), pooled.passes.cend(),
+                                          [firstPass, lastPass](const QPair<int, int> &passes) {
+                                              return firstPass <= passes.second && passes.first <= lastPass;
+                                          });
+        if (!overlaps) {
+            pooled.passes.push_back({ firstPass, lastPass });
+            return pooled.texture;
+        }
+    }
+
+    auto texture = new Qt3DRender::QTexture2D(this);
+    texture->setFormat(format);
+    texture->setGenerateMipMaps(false);
+    if (m_sceneSize.isValid()) {
+        const QSize size = textureSize(sizeDivisor);
+        texture->setSize(size.width(), size.height());
+    }
+    m_textures.push_back({ texture, sizeDivisor, { { firstPass, lastPass } } });
+    return texture;
+}
+
+QSize RenderTargetPool::textureSize(int sizeDivisor) const
+{
+    return QSize(std::max(1, m_sceneSize.width() / sizeDivisor),
+                 std::max(1, m_sceneSize.height() / sizeDivisor));
+}
+
+/*!
+ * Returns a render target with \a color attached to Color0 and \a depth, if
+ * not null, attached to Depth. Render targets are cached for each
+ * combination of textures.
+ */
+Qt3DRender::QRenderTarget *RenderTargetPool::renderTarget(Qt3DRender::QAbstractTexture *color,
+                                                          Qt3DRender::QAbstractTexture *depth)
+{
+    return renderTarget(QVector<Qt3DRender::QAbstractTexture *> { color }, depth);
+}
+
+/*!
+ * Returns a render target with each texture of \a colors attached to the
+ * color attachment point of the same index and \a depth, if not null,
+ * attached to Depth.
+ */
+Qt3DRender::QRenderTarget *RenderTargetPool::renderTarget(const QVector<Qt3DRender::QAbstractTexture *> &colors,
+                                                          Qt3DRender::QAbstractTexture *depth)
+{
+    Q_ASSERT(colors.size() <= Qt3DRender::QRenderTargetOutput::Color15 + 1);
+
+    for (PooledRenderTarget &pooled : m_renderTargets) {
+        if (pooled.colors == colors && pooled.depth == depth) {
+            pooled.used = true;
+            return pooled.target;
+        }
+    }
+
+    auto renderTarget = new Qt3DRender::QRenderTarget(this);
+    for (int i = 0; i < colors.size(); ++i) {
+        auto colorOutput = new Qt3DRender::QRenderTargetOutput;
+        colorOutput->setAttachmentPoint(static_cast<Qt3DRender::QRenderTargetOutput::AttachmentPoint>(Qt3DRender::QRenderTargetOutput::Color0 + i));
+        colorOutput->setTexture(colors.at(i));
+        renderTarget->addOutput(colorOutput);
+    }
+
+    if (depth) {
+        auto depthOutput = new Qt3DRender::QRenderTargetOutput;
+        depthOutput->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Depth);
+        depthOutput->setTexture(depth);
+        renderTarget->addOutput(depthOutput);
+    }
+
+    m_renderTargets.push_back({ renderTarget, colors, depth, true });
+    return renderTarget;
+}
+
+int RenderTargetPool::textureCount() const
+{
+    return m_textures.size();
+}
+
+int RenderTargetPool::renderTargetCount() const
+{
+    return m_renderTargets.size();
+}
+
+/*!
+ * Returns the amount of memory in bytes required by the pooled textures.
+ */
+qint64 RenderTargetPool::memoryUsage() const
+{
+    qint64 bytes = 0;
+    for (const PooledTexture &pooled : m_textures)
+        bytes += qint64(pooled.texture->width()) * pooled.texture->height() * bytesPerPixel(pooled.texture->format());
+    return bytes;
+}
+
+int RenderTargetPool::bytesPerPixel(Qt3DRender::QAbstractTexture::TextureFormat format)
+{
+    switch (format) {
+    case Qt3DRender::QAbstractTexture::R8_UNorm:
+        return 1;
+    case Qt3DRender::QAbstractTexture::RG8_UNorm:
+    case Qt3DRender::QAbstractTexture::R16F:
+    case Qt3DRender::QAbstractTexture::D16:
+        return 2;
+    case Qt3DRender::QAbstractTexture::RGB8_UNorm:
+        return 3;
+    case Qt3DRender::QAbstractTexture::RGBA16F:
+        return 8;
+    case Qt3DRender::QAbstractTexture::RGBA32F:
+        return 16;
+    default:
+        return 4;
+    }
+}
@@ -0,0 +1,108 @@
+/*
+    rendertargetpool_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_RENDERTARGETPOOL_P_H
+#define KUESA_RENDERTARGETPOOL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Kuesa API.  It exists for the convenience
+// of other Kuesa classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <Kuesa/kuesa_global.h>
+#include <Qt3DCore/QNode>
+#include <Qt3DRender/QAbstractTexture>
+#include <QSize>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DRender {
+class QRenderTarget;
+}
+
+namespace Kuesa {
+
+class KUESASHARED_EXPORT RenderTargetPool : public Qt3DCore::QNode
+{
+    Q_OBJECT
+public:
+    explicit RenderTargetPool(Qt3DCore::QNode *parent = nullptr);
+    ~RenderTargetPool();
+
+    void setSceneSize(const QSize &size);
+    QSize sceneSize() const;
+
+    void reset();
+    void releaseUnused();
+    Qt3DRender::QAbstractTexture *acquireTexture(Qt3DRender::QAbstractTexture::TextureFormat format,
+                                                 int firstPass, int lastPass,
+                                                 int sizeDivisor = 1);
+    Qt3DRender::QRenderTarget *renderTarget(Qt3DRender::QAbstractTexture *color,
+                                            Qt3DRender::QAbstractTexture *depth = nullptr);
+    Qt3DRender::QRenderTarget *renderTarget(const QVector<Qt3DRender::QAbstractTexture *> &colors,
+                                            Qt3DRender::QAbstractTexture *depth = nullptr);
+
+    int textureCount() const;
+    int renderTargetCount() const;
+    qint64 memoryUsage() const;
+
+    static int bytesPerPixel(Qt3DRender::QAbstractTexture::TextureFormat format);
+
+private:
+    struct PooledTexture {
+        Qt3DRender::QAbstractTexture *texture;
+        int sizeDivisor;
+        QVector<QPair<int, int>> passes;
+    };
+
+    QSize textureSize(int sizeDivisor) const;
+
+    struct PooledRenderTarget {
+        Qt3DRender::QRenderTarget *target;
+        QVector<Qt3DRender::QAbstractTexture *> colors;
+        Qt3DRender::QAbstractTexture *depth;
+        bool used;
+    };
+
+    QVector<PooledTexture> m_textures;
+    QVector<PooledRenderTarget> m_renderTargets;
+    QSize m_sceneSize;
+};
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_RENDERTARGETPOOL_P_H
@@ -0,0 +1,143 @@
+/*
+    weightedblendedrenderstage.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "weightedblendedrenderstage_p.h"
+#include <Qt3DRender/QFilterKey>
+#include <Qt3DRender/QRenderStateSet>
+#include <Qt3DRender/QNoDepthMask>
+#include <Qt3DRender/QDepthTest>
+#include <Qt3DRender/QClearBuffers>
+#include <Qt3DRender/QNoDraw>
+#include <Qt3DRender/QRenderTarget>
+#include <Qt3DRender/QRenderTargetOutput>
+#include <Qt3DRender/QRenderTargetSelector>
+#include <Qt3DRender/qblendequation.h>
+#include <Qt3DRender/qblendequationarguments.h>
+
+QT_USE_NAMESPACE
+
+using namespace Kuesa;
+
+/*!
+ * \class Kuesa::WeightedBlendedRenderStage
+ * \internal
+ *
+ * Renders transparent objects using weighted blended order independent
+ * transparency (McGuire and Bavoil, JCGT 2013). Render passes with a
+ * KuesaDrawStage FilterKey set to TransparentOIT write their weighted
+ * premultiplied color to the accumulation output and their weighted alpha
+ * to the weight output, in any order.
+ *
+ * As blend functions can't be set per attachment before OpenGL 4.0 and
+ * OpenGL ES 3.2, the product of (1 - alpha), or revealage, is kept in the
+ * alpha channel of the accumulation target: the color channels of both
+ * targets are summed while the alpha channels are multiplied by (1 - alpha).
+ *
+ * The render target, which must share the depth attachment of the opaque
+ * objects, is cleared to (0, 0, 0, 1) before drawing. Its outputs must be
+ * named after accumulationOutputName() and weightOutputName() for the
+ * fragment shader outputs to be bound to them.
+ */
+
+WeightedBlendedRenderStage::WeightedBlendedRenderStage(Qt3DCore::QNode *parent)
+    : AbstractRenderStage(parent)
+    , m_targetSelector(new Qt3DRender::QRenderTargetSelector(this))
+{
+    setObjectName(QStringLiteral("KuesaWeightedBlendedRenderStage"));
+    auto filterKey = new Qt3DRender::QFilterKey(this);
+    filterKey->setName(QStringLiteral("KuesaDrawStage"));
+    filterKey->setValue(QStringLiteral("TransparentOIT"));
+    addMatch(filterKey);
+
+    auto clearBuffers = new Qt3DRender::QClearBuffers(m_targetSelector);
+    clearBuffers->setBuffers(Qt3DRender::QClearBuffers::ColorBuffer);
+    clearBuffers->setClearColor(QColor(0, 0, 0, 255));
+    new Qt3DRender::QNoDraw(clearBuffers);
+
+    auto states = new Qt3DRender::QRenderStateSet(m_targetSelector);
+    auto depthTest = new Qt3DRender::QDepthTest;
+    depthTest->setDepthFunction(Qt3DRender::QDepthTest::LessOrEqual);
+    states->addRenderState(depthTest);
+    states->addRenderState(new Qt3DRender::QNoDepthMask);
+
+    auto blendState = new Qt3DRender::QBlendEquation();
+    blendState->setBlendFunction(Qt3DRender::QBlendEquation::Add);
+    auto blendArgs = new Qt3DRender::QBlendEquationArguments();
+    blendArgs->setSourceRgb(Qt3DRender::QBlendEquationArguments::One);
+    blendArgs->setDestinationRgb(Qt3DRender::QBlendEquationArguments::One);
+    blendArgs->setSourceAlpha(Qt3DRender::QBlendEquationArguments::Zero);
+    blendArgs->setDestinationAlpha(Qt3DRender::QBlendEquationArguments::OneMinusSourceAlpha);
+
+    states->addRenderState(blendState);
+    states->addRenderState(blendArgs);
+}
+
+WeightedBlendedRenderStage::~WeightedBlendedRenderStage()
+{
+}
+
+Qt3DRender::QRenderTarget *WeightedBlendedRenderStage::renderTarget() const
+{
+    return m_targetSelector->target();
+}
+
+/*!
+ * Sets the target transparent objects are rendered into to \a renderTarget
+ * and names its Color0 and Color1 outputs after the accumulation and weight
+ * shader outputs.
+ */
+void WeightedBlendedRenderStage::setRenderTarget(Qt3DRender::QRenderTarget *renderTarget)
+{
+    if (renderTarget) {
+        const auto outputs = renderTarget->outputs();
+        for (Qt3DRender::QRenderTargetOutput *output : outputs) {
+            if (output->attachmentPoint() == Qt3DRender::QRenderTargetOutput::Color0)
+                output->setObjectName(accumulationOutputName());
+            else if (output->attachmentPoint() == Qt3DRender::QRenderTargetOutput::Color1)
+                output->setObjectName(weightOutputName());
+        }
+    }
+    m_targetSelector->setTarget(renderTarget);
+}
+
+/*!
+ * Returns the name of the fragment shader output holding the weighted
+ * premultiplied color and the revealage.
+ */
+QString WeightedBlendedRenderStage::accumulationOutputName()
+{
+    return QStringLiteral("kuesa_oitAccumulation");
+}
+
+/*!
+ * Returns the name of the fragment shader output holding the weighted alpha.
+ */
+QString WeightedBlendedRenderStage::weightOutputName()
+{
+    return QStringLiteral("kuesa_oitWeight");
+}
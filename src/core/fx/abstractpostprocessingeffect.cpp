@@ -85,5 +85,65 @@ void AbstractPostProcessingEffect::setSceneSize(const QSize &size)
     Q_UNUSED(size);
 }
 
+/*!
+ * \internal
+ *
+ * Called by the ForwardRenderer when building the effect chain. Effects
+ * needing intermediate textures should acquire them from \a pool for \a pass,
+ * which is the index of the effect in the chain plus one. When \a pool is
+ * null, the effect should fall back to textures of its own.
+ */
+void AbstractPostProcessingEffect::acquireTextures(RenderTargetPool *pool, int pass)
+{
+    Q_UNUSED(pool);
+    Q_UNUSED(pass);
+}
+
+/*!
+ * Returns true if the effect only transforms the color of each pixel of its
+ * input texture independently of the other pixels.
+ *
+ * When several fusable effects follow each other, the ForwardRenderer
+ * combines them into a single full screen pass, using the code returned by
+ * fusedShaderCode, instead of rendering each of them into an intermediate
+ * texture. Effects whose fusability changes should emit fusableChanged.
+ *
+ * Returns false by default.
+ */
+bool AbstractPostProcessingEffect::isFusable() const
+{
+    return false;
+}
+
+/*!
+ * Returns the GLSL code applying the effect when fused with other effects.
+ *
+ * The code must define a \c {vec4 <prefix>apply(vec4 color, vec2 texCoord)}
+ * function, \a prefix being prepended to the name of that function and of
+ * any global the code declares. The function is called with the color
+ * computed by the previous effects of the fused chain and returns the
+ * transformed color. The code must compile as both GLSL 1.50 and GLSL ES 3.00.
+ *
+ * \sa isFusable, fusedParameters
+ */
+QString AbstractPostProcessingEffect::fusedShaderCode(const QString &prefix) const
+{
+    Q_UNUSED(prefix);
+    return QString();
+}
+
+/*!
+ * Returns the parameters used by the code returned by fusedShaderCode. The
+ * corresponding uniforms must be declared in the code as the prefix followed
+ * by the name of the parameter. Changes to the value of the parameters are
+ * forwarded to the fused pass.
+ *
+ * \sa isFusable, fusedShaderCode
+ */
+QVector<Qt3DRender::QParameter *> AbstractPostProcessingEffect::fusedParameters() const
+{
+    return {};
+}
+
 } // namespace Kuesa
 QT_END_NAMESPACE
@@ -37,11 +37,14 @@
 namespace Qt3DRender {
 class QLayer;
 class QAbstractTexture;
+class QParameter;
 } // namespace Qt3DRender
 
 QT_BEGIN_NAMESPACE
 namespace Kuesa {
 
+class RenderTargetPool;
+
 class KUESASHARED_EXPORT AbstractPostProcessingEffect : public Qt3DCore::QNode
 {
     Q_OBJECT
@@ -62,6 +65,14 @@ public:
     virtual void setInputTexture(Qt3DRender::QAbstractTexture *texture) = 0;
     virtual void setSceneSize(const QSize &size);
     virtual QVector<Qt3DRender::QLayer *> layers() const = 0;
+    virtual void acquireTextures(RenderTargetPool *pool, int pass);
+
+    virtual bool isFusable() const;
+    virtual QString fusedShaderCode(const QString &prefix) const;
+    virtual QVector<Qt3DRender::QParameter *> fusedParameters() const;
+
+Q_SIGNALS:
+    void fusableChanged(bool fusable);
 
 protected:
     explicit AbstractPostProcessingEffect(Qt3DCore::QNode *parent = nullptr, Type = Custom);
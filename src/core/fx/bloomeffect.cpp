@@ -30,6 +30,7 @@
 #include "gaussianblureffect.h"
 #include "thresholdeffect.h"
 #include "fullscreenquad.h"
+#include "rendertargetpool_p.h"
 #include <Qt3DRender/qcameraselector.h>
 #include <Qt3DRender/qrendersurfaceselector.h>
 #include <Qt3DRender/qfilterkey.h>
@@ -97,6 +98,17 @@ using namespace Kuesa;
     \sa GaussianBlurEffect::blurPassCount
 */
 
+/*!
+    \property BloomEffect::blurQuality
+
+    \brief how the bright parts of the scene are blurred
+
+    Lower qualities blur reduced resolution copies of the bright parts of the
+    scene, producing a wider glow for a fraction of the cost.
+
+    \sa GaussianBlurEffect::quality
+*/
+
 /*!
     \qmlproperty BloomEffect::exposure
 
@@ -124,6 +136,15 @@ using namespace Kuesa;
     More passes result in stronger blurring effect but take longer to render.
 */
 
+/*!
+    \qmlproperty BloomEffect::blurQuality
+
+    \brief how the bright parts of the scene are blurred
+
+    Lower qualities blur reduced resolution copies of the bright parts of the
+    scene, producing a wider glow for a fraction of the cost.
+*/
+
 BloomEffect::BloomEffect(Qt3DCore::QNode *parent)
     : AbstractPostProcessingEffect(parent)
     , m_sceneTextureParam(new Qt3DRender::QParameter(QStringLiteral("texture0"), nullptr))
@@ -133,11 +154,10 @@ BloomEffect::BloomEffect(Qt3DCore::QNode *parent)
     m_rootFrameGraphNode.reset(new Qt3DRender::QFrameGraphNode);
     m_rootFrameGraphNode->setObjectName(QStringLiteral("Bloom Effect"));
 
-    m_brightTexture = new Qt3DRender::QTexture2D;
-    auto thresholdRenderTarget = createRenderTarget(m_brightTexture);
-
-    m_blurredBrightTexture = new Qt3DRender::QTexture2D;
-    auto blurRenderTarget = createRenderTarget(m_blurredBrightTexture);
+    // The bright parts are blurred in place: the last blur pass only reads
+    // the blur effect's intermediate texture, so its result can be written
+    // back into the texture holding the threshold result
+    auto brightRenderTarget = createRenderTarget();
 
     // Set up Threshold Material
     m_thresholdEffect = new ThresholdEffect(this);
@@ -145,7 +165,6 @@ BloomEffect::BloomEffect(Qt3DCore::QNode *parent)
 
     // Set up Gaussian Blur
     m_blurEffect = new GaussianBlurEffect(this);
-    m_blurEffect->setInputTexture(m_brightTexture);
     m_layers += m_blurEffect->layers();
 
     // Set up Bloom Material
@@ -184,7 +203,7 @@ BloomEffect::BloomEffect(Qt3DCore::QNode *parent)
     bloomRenderPass->addParameter(m_sceneTextureParam);
     bloomRenderPass->addParameter(m_blurredBrightTextureParam);
     bloomRenderPass->addParameter(m_exposureParam);
-    m_blurredBrightTextureParam->setValue(QVariant::fromValue(m_blurredBrightTexture));
+    setBrightTexture(m_brightTexture);
 
     technique->addRenderPass(bloomRenderPass);
 
@@ -193,6 +212,7 @@ BloomEffect::BloomEffect(Qt3DCore::QNode *parent)
 
     connect(m_thresholdEffect, &ThresholdEffect::thresholdChanged, this, &BloomEffect::thresholdChanged);
     connect(m_blurEffect, &GaussianBlurEffect::blurPassCountChanged, this, &BloomEffect::blurPassCountChanged);
+    connect(m_blurEffect, &GaussianBlurEffect::qualityChanged, this, &BloomEffect::blurQualityChanged);
 
     //
     //  FrameGraph Construction
@@ -200,13 +220,13 @@ BloomEffect::BloomEffect(Qt3DCore::QNode *parent)
 
     // Threshold Pass
     auto thresholdTargetSelector = new Qt3DRender::QRenderTargetSelector(m_rootFrameGraphNode.data());
-    thresholdTargetSelector->setTarget(thresholdRenderTarget);
+    thresholdTargetSelector->setTarget(brightRenderTarget);
     auto thresholdFrameGraph = m_thresholdEffect->frameGraphSubTree();
     thresholdFrameGraph->setParent(thresholdTargetSelector);
 
     // Blur Pass
     auto blurTargetSelector = new Qt3DRender::QRenderTargetSelector(m_rootFrameGraphNode.data());
-    blurTargetSelector->setTarget(blurRenderTarget);
+    blurTargetSelector->setTarget(brightRenderTarget);
     auto blurFrameGraph = m_blurEffect->frameGraphSubTree();
     blurFrameGraph->setParent(blurTargetSelector);
 
@@ -234,19 +254,32 @@ Qt3DRender::QRenderPassFilter *BloomEffect::createRenderPassFilter(const QString
     return filter;
 }
 
-Qt3DRender::QRenderTarget *BloomEffect::createRenderTarget(Qt3DRender::QAbstractTexture *texture)
+Qt3DRender::QRenderTarget *BloomEffect::createRenderTarget()
 {
     auto renderTarget = new Qt3DRender::QRenderTarget(this);
-    auto output = new Qt3DRender::QRenderTargetOutput;
-    output->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Color0);
-    renderTarget->addOutput(output);
-    texture->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
-    texture->setSize(512, 512);
-    texture->setGenerateMipMaps(false);
-    output->setTexture(texture);
+    m_brightTextureOutput = new Qt3DRender::QRenderTargetOutput;
+    m_brightTextureOutput->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Color0);
+    renderTarget->addOutput(m_brightTextureOutput);
+    m_brightTexture = new Qt3DRender::QTexture2D(this);
+    m_brightTexture->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+    m_brightTexture->setSize(512, 512);
+    m_brightTexture->setGenerateMipMaps(false);
     return renderTarget;
 }
 
+/*!
+ * \internal
+ *
+ * Uses \a texture to hold the bright parts of the scene, before and after
+ * blurring.
+ */
+void BloomEffect::setBrightTexture(Qt3DRender::QAbstractTexture *texture)
+{
+    m_brightTextureOutput->setTexture(texture);
+    m_blurEffect->setInputTexture(texture);
+    m_blurredBrightTextureParam->setValue(QVariant::fromValue(texture));
+}
+
 /*!
  * Returns the frame graph subtree corresponding to the effect's implementation.
  *
@@ -267,7 +300,24 @@ void BloomEffect::setSceneSize(const QSize &size)
     m_blurEffect->setSceneSize(size);
     m_thresholdEffect->setSceneSize(size);
     m_brightTexture->setSize(size.width(), size.height());
-    m_blurredBrightTexture->setSize(size.width(), size.height());
+}
+
+/*!
+ * \internal
+ *
+ * Acquires the bright parts texture as well as the intermediate texture of
+ * the blur from \a pool. Both are only needed while the effect is being
+ * rendered.
+ *
+ * \sa AbstractPostProcessingEffect::acquireTextures
+ */
+void BloomEffect::acquireTextures(RenderTargetPool *pool, int pass)
+{
+    Qt3DRender::QAbstractTexture *brightTexture = m_brightTexture;
+    if (pool)
+        brightTexture = pool->acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, pass, pass);
+    setBrightTexture(brightTexture);
+    m_blurEffect->acquireTextures(pool, pass);
 }
 
 /*!
@@ -316,6 +366,16 @@ int BloomEffect::blurPassCount() const
     return m_blurEffect->blurPassCount();
 }
 
+/*!
+ * Returns the quality of the blur applied to the bright parts of the scene.
+ *
+ * \sa BloomEffect::setBlurQuality
+ */
+GaussianBlurEffect::Quality BloomEffect::blurQuality() const
+{
+    return m_blurEffect->quality();
+}
+
 /*!
  * Sets the exposure value.
  *
@@ -350,6 +410,16 @@ void BloomEffect::setBlurPassCount(int blurPassCount)
     m_blurEffect->setBlurPassCount(blurPassCount);
 }
 
+/*!
+ * Sets the quality of the blur applied to the bright parts of the scene.
+ *
+ * \sa BloomEffect::blurQuality
+ */
+void BloomEffect::setBlurQuality(GaussianBlurEffect::Quality blurQuality)
+{
+    m_blurEffect->setQuality(blurQuality);
+}
+
 QString BloomEffect::passName() const
 {
     return QStringLiteral("bloomPass");
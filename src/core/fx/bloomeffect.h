@@ -31,11 +31,13 @@
 
 #include <Kuesa/kuesa_global.h>
 #include <Kuesa/abstractpostprocessingeffect.h>
+#include <Kuesa/gaussianblureffect.h>
 
 QT_BEGIN_NAMESPACE
 
 namespace Qt3DRender {
 class QRenderTarget;
+class QRenderTargetOutput;
 class QRenderPass;
 class QShaderProgram;
 class QParameter;
@@ -49,7 +51,6 @@ class QCamera;
 namespace Kuesa {
 
 class ThresholdEffect;
-class GaussianBlurEffect;
 class BloomMaterial;
 
 class KUESASHARED_EXPORT BloomEffect : public AbstractPostProcessingEffect
@@ -59,6 +60,7 @@ class KUESASHARED_EXPORT BloomEffect : public AbstractPostProcessingEffect
     Q_PROPERTY(float exposure READ exposure WRITE setExposure NOTIFY exposureChanged)
     Q_PROPERTY(float threshold READ threshold WRITE setThreshold NOTIFY thresholdChanged)
     Q_PROPERTY(int blurPassCount READ blurPassCount WRITE setBlurPassCount NOTIFY blurPassCountChanged)
+    Q_PROPERTY(Kuesa::GaussianBlurEffect::Quality blurQuality READ blurQuality WRITE setBlurQuality NOTIFY blurQualityChanged)
 
 public:
     BloomEffect(Qt3DCore::QNode *parent = nullptr);
@@ -68,30 +70,35 @@ public:
 
     void setSceneSize(const QSize &size) override;
     void setInputTexture(Qt3DRender::QAbstractTexture *texture) override;
+    void acquireTextures(RenderTargetPool *pool, int pass) override;
 
     float exposure() const;
     float threshold() const;
     int blurPassCount() const;
+    GaussianBlurEffect::Quality blurQuality() const;
 
 public Q_SLOTS:
     void setExposure(float exposure);
     void setThreshold(float threshold);
     void setBlurPassCount(int blurPassCount);
+    void setBlurQuality(Kuesa::GaussianBlurEffect::Quality blurQuality);
 
 Q_SIGNALS:
     void exposureChanged(float exposure);
     void thresholdChanged(float threshold);
     void blurPassCountChanged(int blurPassCount);
+    void blurQualityChanged(Kuesa::GaussianBlurEffect::Quality blurQuality);
 
 private:
     Qt3DRender::QRenderPassFilter *createRenderPassFilter(const QString &name, const QVariant &value = QVariant());
-    Qt3DRender::QRenderTarget *createRenderTarget(Qt3DRender::QAbstractTexture *texture);
+    Qt3DRender::QRenderTarget *createRenderTarget();
+    void setBrightTexture(Qt3DRender::QAbstractTexture *texture);
     QString passName() const;
 
     FrameGraphNodePtr m_rootFrameGraphNode;
 
     Qt3DRender::QAbstractTexture *m_brightTexture;
-    Qt3DRender::QAbstractTexture *m_blurredBrightTexture;
+    Qt3DRender::QRenderTargetOutput *m_brightTextureOutput;
 
     ThresholdEffect *m_thresholdEffect;
     GaussianBlurEffect *m_blurEffect;
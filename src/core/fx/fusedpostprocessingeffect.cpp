@@ -0,0 +1,212 @@
+/*
+    fusedpostprocessingeffect.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Jim Albamont <jim.albamont@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "fusedpostprocessingeffect_p.h"
+#include "fullscreenquad.h"
+#include <Qt3DRender/qrenderpassfilter.h>
+#include <Qt3DRender/qfilterkey.h>
+#include <Qt3DRender/qshaderprogram.h>
+#include <Qt3DRender/qparameter.h>
+#include <Qt3DRender/qmaterial.h>
+#include <Qt3DRender/qeffect.h>
+#include <Qt3DRender/qrenderpass.h>
+#include <Qt3DRender/qgraphicsapifilter.h>
+#include <Qt3DRender/qtechnique.h>
+#include <Qt3DRender/qlayerfilter.h>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+
+/*!
+ * \class Kuesa::FusedPostProcessingEffect
+ * \internal
+ * \inmodule Kuesa
+ * \brief Renders a chain of fusable effects in a single full screen pass
+ *
+ * FusedPostProcessingEffect is created by the ForwardRenderer for
+ * consecutive effects whose isFusable returns true. It generates a fragment
+ * shader calling the code provided by each effect in turn, so the chain only
+ * reads its input texture and writes its output once instead of going
+ * through an intermediate texture per effect.
+ *
+ * The parameters of each effect are mirrored under the prefix of the effect
+ * in the generated shader and kept in sync with the originals.
+ */
+
+FusedPostProcessingEffect::FusedPostProcessingEffect(const QVector<AbstractPostProcessingEffect *> &effects,
+                                                     Qt3DCore::QNode *parent)
+    : AbstractPostProcessingEffect(parent)
+    , m_effects(effects)
+    , m_layer(nullptr)
+    , m_inputTextureParameter(new Qt3DRender::QParameter(QStringLiteral("inputTexture"), nullptr))
+{
+    m_rootFrameGraphNode.reset(new Qt3DRender::QFrameGraphNode);
+    m_rootFrameGraphNode->setObjectName(QStringLiteral("Fused Effect"));
+
+    auto fusedMaterial = new Qt3DRender::QMaterial(m_rootFrameGraphNode.data());
+
+    auto effect = new Qt3DRender::QEffect;
+    fusedMaterial->setEffect(effect);
+
+    const auto makeTechnique = [&effects](Qt3DRender::QGraphicsApiFilter::Api api, int majorVersion, int minorVersion,
+                                          Qt3DRender::QGraphicsApiFilter::OpenGLProfile profile, const QString &vertexShader,
+                                          const QByteArray &header) {
+        auto technique = new Qt3DRender::QTechnique;
+
+        technique->graphicsApiFilter()->setApi(api);
+        technique->graphicsApiFilter()->setMajorVersion(majorVersion);
+        technique->graphicsApiFilter()->setMinorVersion(minorVersion);
+        technique->graphicsApiFilter()->setProfile(profile);
+
+        auto techniqueFilterKey = new Qt3DRender::QFilterKey;
+        techniqueFilterKey->setName(QStringLiteral("renderingStyle"));
+        techniqueFilterKey->setValue(QStringLiteral("forward"));
+        technique->addFilterKey(techniqueFilterKey);
+
+        auto renderPass = new Qt3DRender::QRenderPass;
+
+        auto shaderProgram = new Qt3DRender::QShaderProgram(renderPass);
+        shaderProgram->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(vertexShader)));
+        shaderProgram->setFragmentShaderCode(fragmentShaderCode(effects, header).toUtf8());
+        renderPass->setShaderProgram(shaderProgram);
+
+        auto passFilterKey = new Qt3DRender::QFilterKey;
+        passFilterKey->setName(QStringLiteral("KuesaFusedPass"));
+        renderPass->addFilterKey(passFilterKey);
+
+        technique->addRenderPass(renderPass);
+
+        return technique;
+    };
+
+    effect->addTechnique(makeTechnique(Qt3DRender::QGraphicsApiFilter::OpenGL,
+                                       3, 2,
+                                       Qt3DRender::QGraphicsApiFilter::CoreProfile,
+                                       QStringLiteral("qrc:/kuesa/shaders/gl3/passthrough.vert"),
+                                       QByteArrayLiteral("#version 150 core\n")));
+    effect->addTechnique(makeTechnique(Qt3DRender::QGraphicsApiFilter::OpenGLES,
+                                       3, 0,
+                                       Qt3DRender::QGraphicsApiFilter::NoProfile,
+                                       QStringLiteral("qrc:/kuesa/shaders/es3/passthrough.vert"),
+                                       QByteArrayLiteral("#version 300 es\nprecision highp float;\n")));
+
+    effect->addParameter(m_inputTextureParameter);
+
+    // Mirror the parameters of each effect under its prefix
+    for (int effectNo = 0; effectNo < m_effects.size(); ++effectNo) {
+        const QString prefix = effectPrefix(effectNo);
+        const auto parameters = m_effects.at(effectNo)->fusedParameters();
+        for (Qt3DRender::QParameter *parameter : parameters) {
+            auto fusedParameter = new Qt3DRender::QParameter(prefix + parameter->name(), parameter->value());
+            QObject::connect(parameter, &Qt3DRender::QParameter::valueChanged,
+                             fusedParameter, &Qt3DRender::QParameter::setValue);
+            effect->addParameter(fusedParameter);
+        }
+    }
+
+    auto fullScreenQuad = new FullScreenQuad(fusedMaterial, m_rootFrameGraphNode.data());
+    m_layer = fullScreenQuad->layer();
+
+    //
+    //  FrameGraph Construction
+    //
+    auto layerFilter = new Qt3DRender::QLayerFilter(m_rootFrameGraphNode.data());
+    layerFilter->addLayer(m_layer);
+    auto renderPassFilter = new Qt3DRender::QRenderPassFilter(layerFilter);
+    auto filterKey = new Qt3DRender::QFilterKey;
+    filterKey->setName(QStringLiteral("KuesaFusedPass"));
+    renderPassFilter->addMatch(filterKey);
+}
+
+FusedPostProcessingEffect::~FusedPostProcessingEffect()
+{
+}
+
+AbstractPostProcessingEffect::FrameGraphNodePtr FusedPostProcessingEffect::frameGraphSubTree() const
+{
+    return m_rootFrameGraphNode;
+}
+
+QVector<Qt3DRender::QLayer *> FusedPostProcessingEffect::layers() const
+{
+    return { m_layer };
+}
+
+void FusedPostProcessingEffect::setInputTexture(Qt3DRender::QAbstractTexture *texture)
+{
+    m_inputTextureParameter->setValue(QVariant::fromValue(texture));
+}
+
+/*!
+ * Returns the effects rendered by this pass, in order.
+ */
+QVector<AbstractPostProcessingEffect *> FusedPostProcessingEffect::effects() const
+{
+    return m_effects;
+}
+
+/*!
+ * Returns the prefix of the globals of effect \a effectNo in the generated
+ * shader.
+ */
+QString FusedPostProcessingEffect::effectPrefix(int effectNo)
+{
+    return QStringLiteral("kuesa_fx%1_").arg(effectNo);
+}
+
+/*!
+ * Returns the fragment shader applying \a effects in order to the input
+ * texture, starting with the \a header specific to the shading language
+ * version.
+ */
+QString FusedPostProcessingEffect::fragmentShaderCode(const QVector<AbstractPostProcessingEffect *> &effects,
+                                                      const QByteArray &header)
+{
+    QString code = QString::fromLatin1(header);
+    code += QStringLiteral("\nin vec2 texCoord;\n"
+                           "out vec4 fragColor;\n"
+                           "uniform sampler2D inputTexture;\n");
+
+    QString body;
+    for (int effectNo = 0; effectNo < effects.size(); ++effectNo) {
+        const QString prefix = effectPrefix(effectNo);
+        code += QLatin1Char('\n') + effects.at(effectNo)->fusedShaderCode(prefix);
+        body += QStringLiteral("    color = %1apply(color, texCoord);\n").arg(prefix);
+    }
+
+    code += QStringLiteral("\nvoid main()\n"
+                           "{\n"
+                           "    vec4 color = texture(inputTexture, texCoord);\n");
+    code += body;
+    code += QStringLiteral("    fragColor = color;\n"
+                           "}\n");
+    return code;
+}
+
+QT_END_NAMESPACE
@@ -32,7 +32,9 @@ HEADERS += \
     $$PWD/gaussianblureffect.h \
     $$PWD/thresholdeffect.h \
     $$PWD/bloomeffect.h \
-    $$PWD/opacitymask.h
+    $$PWD/opacitymask.h \
+    $$PWD/fusedpostprocessingeffect_p.h \
+    $$PWD/weightedblendedcompositeeffect_p.h
 
 SOURCES += \
     $$PWD/abstractpostprocessingeffect.cpp \
@@ -40,4 +42,6 @@ SOURCES += \
     $$PWD/gaussianblureffect.cpp \
     $$PWD/thresholdeffect.cpp \
     $$PWD/bloomeffect.cpp \
-    $$PWD/opacitymask.cpp
+    $$PWD/opacitymask.cpp \
+    $$PWD/fusedpostprocessingeffect.cpp \
+    $$PWD/weightedblendedcompositeeffect.cpp
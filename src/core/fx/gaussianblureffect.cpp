@@ -28,6 +28,7 @@
 
 #include "gaussianblureffect.h"
 #include "fullscreenquad.h"
+#include "rendertargetpool_p.h"
 #include <Qt3DRender/qtexture.h>
 #include <Qt3DRender/qrendertarget.h>
 #include <Qt3DRender/qmaterial.h>
@@ -45,6 +46,8 @@
 #include <Qt3DRender/qcamera.h>
 #include <Qt3DRender/qlayerfilter.h>
 #include <Qt3DRender/qrendertargetselector.h>
+#include <QVector2D>
+#include <algorithm>
 
 QT_BEGIN_NAMESPACE
 
@@ -60,8 +63,24 @@ using namespace Kuesa;
  * GaussianBlurEffect is a post-processing effect that applies a
  * Gaussian blur to the scene. The amount of blurring can be adjusted
  * using the blurPassCount property.
+ *
+ * With the default HighQuality setting, the blur is made of full resolution
+ * separable passes. The lower quality settings instead progressively
+ * downsample the scene into a chain of textures, each half the size of the
+ * previous one, then upsample it back (dual filtering). This provides a wide
+ * blur for a fraction of the cost, which matters at high resolutions.
  */
 
+/*!
+    \enum GaussianBlurEffect::Quality
+
+    This enum type describes how the blur is computed.
+
+    \value HighQuality  blurPassCount full resolution Gaussian blur passes (default).
+    \value MediumQuality  Downsample and upsample through 4 levels of reduced resolution.
+    \value LowQuality  Downsample and upsample through 2 levels of reduced resolution.
+*/
+
 /*!
     \property GaussianBlurEffect::blurPassCount
 
@@ -69,6 +88,18 @@ using namespace Kuesa;
 
     This is the number of times to apply the blur filter. More passes result in stronger
     blurring effect but take longer to render.
+
+    \note Only used with the HighQuality setting.
+*/
+
+/*!
+    \property GaussianBlurEffect::quality
+
+    \brief how the blur is computed
+
+    Lower qualities blur reduced resolution copies of the scene, which is much
+    cheaper than the full resolution passes of the default HighQuality
+    setting.
 */
 
 /*!
@@ -78,22 +109,41 @@ using namespace Kuesa;
 
     This is the number of times to apply the blur filter. More passes result in stronger
     blurring effect but take longer to render.
+
+    \note Only used with the HighQuality setting.
+*/
+
+/*!
+    \qmlproperty GaussianBlurEffect::quality
+
+    \brief how the blur is computed
+
+    Lower qualities blur reduced resolution copies of the scene, which is much
+    cheaper than the full resolution passes of the default
+    GaussianBlurEffect.HighQuality setting.
 */
 
 GaussianBlurEffect::GaussianBlurEffect(Qt3DCore::QNode *parent)
     : AbstractPostProcessingEffect(parent)
     , m_layer(nullptr)
     , m_blurPassCount(8)
+    , m_quality(HighQuality)
     , m_blurTextureOutput1(new Qt3DRender::QRenderTargetOutput)
+    , m_blurTextureOutput2(new Qt3DRender::QRenderTargetOutput)
     , m_blurTarget1(new Qt3DRender::QRenderTarget)
     , m_blurTarget2(new Qt3DRender::QRenderTarget)
     , m_blurTexture1(nullptr)
     , m_blurTexture2(nullptr)
+    , m_ownTexturePool(new RenderTargetPool(this))
+    , m_texturePass(0)
     , m_blurTextureParam1(new Qt3DRender::QParameter(QStringLiteral("textureSampler"), nullptr))
     , m_blurTextureParam2(new Qt3DRender::QParameter(QStringLiteral("textureSampler"), nullptr))
     , m_widthParameter(new Qt3DRender::QParameter(QStringLiteral("width"), 1))
     , m_heightParameter(new Qt3DRender::QParameter(QStringLiteral("height"), 1))
+    , m_dualFilterInputParameter(nullptr)
 {
+    m_texturePool = m_ownTexturePool;
+
     m_rootFrameGraphNode.reset(new Qt3DRender::QFrameGraphNode);
     m_rootFrameGraphNode->setObjectName(QLatin1String("Gaussian Blur Effect"));
 
@@ -107,15 +157,9 @@ GaussianBlurEffect::GaussianBlurEffect(Qt3DCore::QNode *parent)
     m_blurTextureOutput1->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Color0);
     m_blurTarget1->addOutput(m_blurTextureOutput1);
 
-    auto blurOutput2 = new Qt3DRender::QRenderTargetOutput;
-    blurOutput2->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Color0);
-    m_blurTarget2->addOutput(blurOutput2);
-
-    m_blurTexture2 = new Qt3DRender::QTexture2D;
-    m_blurTexture2->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
-    m_blurTexture2->setGenerateMipMaps(false);
-    m_blurTexture2->setSize(512, 512);
-    blurOutput2->setTexture(m_blurTexture2);
+    // Target 2 texture is acquired when creating the blur passes
+    m_blurTextureOutput2->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Color0);
+    m_blurTarget2->addOutput(m_blurTextureOutput2);
 
     // Set up GaussianBlur Material
     auto blurMaterial = new Qt3DRender::QMaterial(m_rootFrameGraphNode.data());
@@ -148,10 +192,24 @@ GaussianBlurEffect::GaussianBlurEffect(Qt3DCore::QNode *parent)
 
     auto blurPass2 = createBlurPass(2);
     blurPass2->addParameter(m_blurTextureParam2);
-    m_blurTextureParam2->setValue(QVariant::fromValue(m_blurTexture2));
     blurPass2->setShaderProgram(blurShader);
     technique->addRenderPass(blurPass2);
 
+    // Dual filtering passes, textures and texel sizes are set on the pass filters
+    auto downsamplePass = createBlurPass(3);
+    auto downsampleShader = new Qt3DRender::QShaderProgram(downsamplePass);
+    downsampleShader->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/passthrough.vert"))));
+    downsampleShader->setFragmentShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/dualfilterdownsample.frag"))));
+    downsamplePass->setShaderProgram(downsampleShader);
+    technique->addRenderPass(downsamplePass);
+
+    auto upsamplePass = createBlurPass(4);
+    auto upsampleShader = new Qt3DRender::QShaderProgram(upsamplePass);
+    upsampleShader->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/passthrough.vert"))));
+    upsampleShader->setFragmentShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/dualfilterupsample.frag"))));
+    upsamplePass->setShaderProgram(upsampleShader);
+    technique->addRenderPass(upsamplePass);
+
     blurMaterial->addParameter(m_widthParameter);
     blurMaterial->addParameter(m_heightParameter);
 
@@ -163,7 +221,26 @@ GaussianBlurEffect::GaussianBlurEffect(Qt3DCore::QNode *parent)
 
     m_blurPassRoot = new Qt3DRender::QFrameGraphNode(blurLayerFilter);
 
-    createBlurPasses();
+    updateBlurPasses();
+}
+
+/*!
+ * \internal
+ *
+ * Recreates the blur passes for the current quality.
+ */
+void GaussianBlurEffect::updateBlurPasses()
+{
+    //just do the simple thing for now and delete all children and recreate.
+    for (auto child : m_blurPassRoot->childNodes())
+        delete child;
+    m_dualFilterInputParameter = nullptr;
+    m_halfPixelParameters.clear();
+
+    if (m_quality == HighQuality)
+        createBlurPasses();
+    else
+        createDualFilterPasses();
 }
 
 /*!
@@ -174,6 +251,10 @@ GaussianBlurEffect::GaussianBlurEffect(Qt3DCore::QNode *parent)
  */
 void GaussianBlurEffect::createBlurPasses()
 {
+    Qt3DRender::QAbstractTexture *texture = blurTexture2();
+    m_blurTextureOutput2->setTexture(texture);
+    m_blurTextureParam2->setValue(QVariant::fromValue(texture));
+
     for (int i = 0; i < m_blurPassCount - 1; ++i) {
         auto blurTargetSelectorA = new Qt3DRender::QRenderTargetSelector(m_blurPassRoot);
         blurTargetSelectorA->setTarget(m_blurTarget2);
@@ -198,6 +279,103 @@ void GaussianBlurEffect::createBlurPasses()
     blurPassFilterB->setParent(m_blurPassRoot);
 }
 
+/*!
+ * \internal
+ *
+ * Creates the passes downsampling the input texture into each level of the
+ * chain, then upsampling it back, the last upsampling pass rendering into the
+ * current render target.
+ */
+void GaussianBlurEffect::createDualFilterPasses()
+{
+    const int levelCount = downsampleLevelCount(m_quality);
+
+    for (int level = 1; level <= levelCount; ++level) {
+        auto selector = new Qt3DRender::QRenderTargetSelector(m_blurPassRoot);
+        selector->setTarget(m_texturePool->renderTarget(levelTexture(level)));
+
+        auto downsampleFilter = createRenderPassFilter(passName(), 3);
+        downsampleFilter->setParent(selector);
+        auto sourceParameter = new Qt3DRender::QParameter(QStringLiteral("dualFilterSampler"),
+                                                          level == 1 ? m_blurTexture1 : levelTexture(level - 1));
+        downsampleFilter->addParameter(sourceParameter);
+        addHalfPixelParameter(downsampleFilter, level - 1);
+        if (level == 1)
+            m_dualFilterInputParameter = sourceParameter;
+    }
+
+    for (int level = levelCount; level >= 1; --level) {
+        Qt3DCore::QNode *parentNode = m_blurPassRoot;
+        if (level > 1) {
+            auto selector = new Qt3DRender::QRenderTargetSelector(m_blurPassRoot);
+            selector->setTarget(m_texturePool->renderTarget(levelTexture(level - 1)));
+            parentNode = selector;
+        }
+
+        auto upsampleFilter = createRenderPassFilter(passName(), 4);
+        upsampleFilter->setParent(parentNode);
+        upsampleFilter->addParameter(new Qt3DRender::QParameter(QStringLiteral("dualFilterSampler"), levelTexture(level)));
+        addHalfPixelParameter(upsampleFilter, level);
+    }
+
+    updateHalfPixelParameters();
+}
+
+void GaussianBlurEffect::addHalfPixelParameter(Qt3DRender::QRenderPassFilter *filter, int sourceLevel)
+{
+    auto parameter = new Qt3DRender::QParameter(QStringLiteral("halfPixel"), QVector2D());
+    filter->addParameter(parameter);
+    m_halfPixelParameters.push_back({ parameter, 1 << sourceLevel });
+}
+
+/*!
+ * \internal
+ *
+ * Updates the size of half a texel of the texture sampled by each of the
+ * dual filtering passes.
+ */
+void GaussianBlurEffect::updateHalfPixelParameters()
+{
+    if (m_sceneSize.isEmpty())
+        return;
+
+    for (const auto &halfPixelParameter : qAsConst(m_halfPixelParameters)) {
+        const int divisor = halfPixelParameter.second;
+        const float width = float(std::max(1, m_sceneSize.width() / divisor));
+        const float height = float(std::max(1, m_sceneSize.height() / divisor));
+        halfPixelParameter.first->setValue(QVector2D(0.5f / width, 0.5f / height));
+    }
+}
+
+/*!
+ * \internal
+ *
+ * Returns the intermediate texture of the full resolution blur passes.
+ */
+Qt3DRender::QAbstractTexture *GaussianBlurEffect::blurTexture2()
+{
+    if (!m_blurTexture2)
+        m_blurTexture2 = m_texturePool->acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, m_texturePass, m_texturePass);
+    return m_blurTexture2;
+}
+
+/*!
+ * \internal
+ *
+ * Returns the texture for \a level of the downsample chain, level n being
+ * the scene size divided by 2^n.
+ */
+Qt3DRender::QAbstractTexture *GaussianBlurEffect::levelTexture(int level)
+{
+    Q_ASSERT(level > 0);
+    while (m_levelTextures.size() < level) {
+        const int sizeDivisor = 1 << (m_levelTextures.size() + 1);
+        m_levelTextures.push_back(m_texturePool->acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm,
+                                                                m_texturePass, m_texturePass, sizeDivisor));
+    }
+    return m_levelTextures.at(level - 1);
+}
+
 /*!
  * Returns the frame graph subtree corresponding to the effect's implementation.
  *
@@ -224,6 +402,8 @@ void GaussianBlurEffect::setInputTexture(Qt3DRender::QAbstractTexture *texture)
     m_blurTexture1 = texture;
     m_blurTextureParam1->setValue(QVariant::fromValue(texture));
     m_blurTextureOutput1->setTexture(texture);
+    if (m_dualFilterInputParameter)
+        m_dualFilterInputParameter->setValue(QVariant::fromValue(texture));
 }
 
 /*!
@@ -236,9 +416,34 @@ void GaussianBlurEffect::setSceneSize(const QSize &size)
 {
     m_heightParameter->setValue(size.height());
     m_widthParameter->setValue(size.width());
-    // only need to resize texture 2.
-    // texture 1 is passed as "input texture" so should be resized elsewhere
-    m_blurTexture2->setSize(size.width(), size.height());
+    // only need to resize our own textures.
+    // texture 1 is passed as "input texture" so should be resized elsewhere,
+    // as are textures acquired from the ForwardRenderer's pool
+    m_sceneSize = size;
+    m_ownTexturePool->setSceneSize(size);
+    updateHalfPixelParameters();
+}
+
+/*!
+ * \internal
+ *
+ * Acquires the intermediate blur textures from \a pool. The textures are
+ * only needed while the effect is being rendered, so they can be shared with
+ * other effects of the chain.
+ *
+ * \sa AbstractPostProcessingEffect::acquireTextures
+ */
+void GaussianBlurEffect::acquireTextures(RenderTargetPool *pool, int pass)
+{
+    m_texturePool = pool ? pool : m_ownTexturePool;
+    m_texturePass = pool ? pass : 0;
+    if (!pool)
+        m_ownTexturePool->reset();
+    m_blurTexture2 = nullptr;
+    m_levelTextures.clear();
+    updateBlurPasses();
+    if (!pool)
+        m_ownTexturePool->releaseUnused();
 }
 
 /*!
@@ -262,16 +467,55 @@ void GaussianBlurEffect::setBlurPassCount(int blurPasscount)
         return;
 
     m_blurPassCount = blurPasscount;
-
-    //just do the simple thing for now and delete all children and recreate.
-    for (auto child : m_blurPassRoot->childNodes()) {
-        delete child;
-    }
-    createBlurPasses();
+    if (m_quality == HighQuality)
+        updateBlurPasses();
 
     emit blurPassCountChanged(m_blurPassCount);
 }
 
+/*!
+ * Returns the quality of the blur.
+ *
+ * \sa GaussianBlurEffect::setQuality
+ */
+GaussianBlurEffect::Quality GaussianBlurEffect::quality() const
+{
+    return m_quality;
+}
+
+/*!
+ * Sets the quality of the blur to \a quality.
+ *
+ * \sa GaussianBlurEffect::quality
+ */
+void GaussianBlurEffect::setQuality(GaussianBlurEffect::Quality quality)
+{
+    if (m_quality == quality)
+        return;
+
+    m_quality = quality;
+    updateBlurPasses();
+
+    emit qualityChanged(m_quality);
+}
+
+/*!
+ * Returns the number of reduced resolution levels used for \a quality, or 0
+ * if it blurs at full resolution.
+ */
+int GaussianBlurEffect::downsampleLevelCount(GaussianBlurEffect::Quality quality)
+{
+    switch (quality) {
+    case MediumQuality:
+        return 4;
+    case LowQuality:
+        return 2;
+    case HighQuality:
+    default:
+        return 0;
+    }
+}
+
 Qt3DRender::QRenderPassFilter *GaussianBlurEffect::createRenderPassFilter(const QString &name, const QVariant &value)
 {
     auto filter = new Qt3DRender::QRenderPassFilter;
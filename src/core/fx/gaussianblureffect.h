@@ -31,6 +31,7 @@
 
 #include <Kuesa/kuesa_global.h>
 #include <Kuesa/abstractpostprocessingeffect.h>
+#include <QSize>
 
 QT_BEGIN_NAMESPACE
 
@@ -47,30 +48,51 @@ class QFrameGraphNode;
 namespace Kuesa {
 
 class GaussianBlurMaterial;
+class RenderTargetPool;
 
 class KUESASHARED_EXPORT GaussianBlurEffect : public AbstractPostProcessingEffect
 {
     Q_OBJECT
 
     Q_PROPERTY(int blurPassCount READ blurPassCount WRITE setBlurPassCount NOTIFY blurPassCountChanged)
+    Q_PROPERTY(Kuesa::GaussianBlurEffect::Quality quality READ quality WRITE setQuality NOTIFY qualityChanged)
 
 public:
+    enum Quality {
+        HighQuality,
+        MediumQuality,
+        LowQuality
+    };
+    Q_ENUM(Quality)
+
     GaussianBlurEffect(Qt3DCore::QNode *parent = nullptr);
     FrameGraphNodePtr frameGraphSubTree() const override;
     QVector<Qt3DRender::QLayer *> layers() const override;
 
     void setInputTexture(Qt3DRender::QAbstractTexture *texture) override;
     void setSceneSize(const QSize &size) override;
+    void acquireTextures(RenderTargetPool *pool, int pass) override;
     int blurPassCount() const;
+    Quality quality() const;
+
+    static int downsampleLevelCount(Quality quality);
 
 public Q_SLOTS:
     void setBlurPassCount(int blurPassCount);
+    void setQuality(Kuesa::GaussianBlurEffect::Quality quality);
 
 Q_SIGNALS:
     void blurPassCountChanged(int blurPassCount);
+    void qualityChanged(Kuesa::GaussianBlurEffect::Quality quality);
 
 private:
+    void updateBlurPasses();
     void createBlurPasses();
+    void createDualFilterPasses();
+    void addHalfPixelParameter(Qt3DRender::QRenderPassFilter *filter, int sourceLevel);
+    void updateHalfPixelParameters();
+    Qt3DRender::QAbstractTexture *blurTexture2();
+    Qt3DRender::QAbstractTexture *levelTexture(int level);
     QString passName() const;
     Qt3DRender::QRenderPassFilter *createRenderPassFilter(const QString &name, const QVariant &value = QVariant());
     Qt3DRender::QRenderPass *createBlurPass(int pass);
@@ -79,9 +101,12 @@ private:
     Qt3DRender::QLayer *m_layer;
 
     int m_blurPassCount;
+    Quality m_quality;
+    QSize m_sceneSize;
 
     //Textures and targets
     Qt3DRender::QRenderTargetOutput *m_blurTextureOutput1;
+    Qt3DRender::QRenderTargetOutput *m_blurTextureOutput2;
     Qt3DRender::QRenderTarget *m_blurTarget1;
     Qt3DRender::QRenderTarget *m_blurTarget2;
 
@@ -90,10 +115,18 @@ private:
 
     Qt3DRender::QFrameGraphNode *m_blurPassRoot;
 
+    // Textures are acquired from the ForwardRenderer's pool or from our own
+    RenderTargetPool *m_ownTexturePool;
+    RenderTargetPool *m_texturePool;
+    int m_texturePass;
+    QVector<Qt3DRender::QAbstractTexture *> m_levelTextures;
+
     Qt3DRender::QParameter *m_blurTextureParam1;
     Qt3DRender::QParameter *m_blurTextureParam2;
     Qt3DRender::QParameter *m_widthParameter;
     Qt3DRender::QParameter *m_heightParameter;
+    Qt3DRender::QParameter *m_dualFilterInputParameter;
+    QVector<QPair<Qt3DRender::QParameter *, int>> m_halfPixelParameters;
 };
 } // namespace Kuesa
 QT_END_NAMESPACE
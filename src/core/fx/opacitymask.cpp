@@ -93,6 +93,11 @@ namespace Kuesa {
     \badcode
     vec4 pixelColor = vec4(inputColor.rgb / maskColor.a, inputColor.a * maskColor.a)
     \endcode
+
+    The premultiplied alpha variant only depends on the input and mask colors
+    of each pixel. It is therefore fusable with other per-pixel effects into a
+    single pass by the ForwardRenderer. The regular variant blends with the
+    content of the render target and is always rendered in a pass of its own.
  */
 
 /*!
@@ -263,6 +268,7 @@ void OpacityMask::setPremultipliedAlpha(bool premultipliedAlpha)
     m_gl3ShaderBuilder->setEnabledLayers({ layer });
     m_es3ShaderBuilder->setEnabledLayers({ layer });
     m_blendRenderState->setEnabled(!m_premultipliedAlpha);
+    emit fusableChanged(isFusable());
 }
 
 bool OpacityMask::premultipliedAlpha() const
@@ -270,6 +276,29 @@ bool OpacityMask::premultipliedAlpha() const
     return m_premultipliedAlpha;
 }
 
+bool OpacityMask::isFusable() const
+{
+    // Regular masking relies on blending with the render target
+    return m_premultipliedAlpha;
+}
+
+QString OpacityMask::fusedShaderCode(const QString &prefix) const
+{
+    // Same as the premultiplied_alpha layer of the opacitymask.frag.json graph
+    return QStringLiteral("uniform sampler2D %1maskTexture;\n"
+                          "vec4 %1apply(vec4 color, vec2 texCoord)\n"
+                          "{\n"
+                          "    float maskAlpha = texture(%1maskTexture, texCoord).a;\n"
+                          "    return vec4(color.rgb / max(maskAlpha, 0.01), color.a * maskAlpha);\n"
+                          "}\n")
+            .arg(prefix);
+}
+
+QVector<Qt3DRender::QParameter *> OpacityMask::fusedParameters() const
+{
+    return { m_maskParameter };
+}
+
 } // namespace Kuesa
 
 QT_END_NAMESPACE
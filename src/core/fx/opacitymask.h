@@ -57,6 +57,10 @@ public:
     QVector<Qt3DRender::QLayer *> layers() const override;
     void setInputTexture(Qt3DRender::QAbstractTexture *texture) override;
 
+    bool isFusable() const override;
+    QString fusedShaderCode(const QString &prefix) const override;
+    QVector<Qt3DRender::QParameter *> fusedParameters() const override;
+
     void setMask(Qt3DRender::QAbstractTexture *mask);
     Qt3DRender::QAbstractTexture *mask() const;
 
@@ -57,6 +57,9 @@ using namespace Kuesa;
  *
  * ThresholdEffect is a post-processing effect that passes through any pixel
  * above a certain brightness value and sets all others to black.
+ *
+ * The effect is fusable: consecutive fusable effects are rendered by the
+ * ForwardRenderer in a single pass.
  */
 
 /*!
@@ -187,4 +190,43 @@ void ThresholdEffect::setInputTexture(Qt3DRender::QAbstractTexture *texture)
     m_textureParam->setValue(QVariant::fromValue(texture));
 }
 
+/*!
+ * Returns true as the threshold only depends on the color of each pixel.
+ *
+ * \sa AbstractPostProcessingEffect::isFusable
+ */
+bool ThresholdEffect::isFusable() const
+{
+    return true;
+}
+
+/*!
+ * Returns the code applying the threshold in a fused pass, with \a prefix
+ * prepended to its globals.
+ *
+ * \sa AbstractPostProcessingEffect::fusedShaderCode
+ */
+QString ThresholdEffect::fusedShaderCode(const QString &prefix) const
+{
+    // Same as the threshold.frag.json graph
+    return QStringLiteral("uniform float %1threshold;\n"
+                          "vec4 %1apply(vec4 color, vec2 texCoord)\n"
+                          "{\n"
+                          "    if (dot(color.rgb, vec3(0.2126, 0.7152, 0.0722)) > %1threshold)\n"
+                          "        return vec4(color.rgb, 1.0);\n"
+                          "    return vec4(0.0, 0.0, 0.0, 1.0);\n"
+                          "}\n")
+            .arg(prefix);
+}
+
+/*!
+ * Returns the threshold parameter used by the fused code.
+ *
+ * \sa AbstractPostProcessingEffect::fusedParameters
+ */
+QVector<Qt3DRender::QParameter *> ThresholdEffect::fusedParameters() const
+{
+    return { m_thresholdParameter };
+}
+
 QT_END_NAMESPACE
@@ -55,6 +55,10 @@ public:
     QVector<Qt3DRender::QLayer *> layers() const override;
     void setInputTexture(Qt3DRender::QAbstractTexture *texture) override;
 
+    bool isFusable() const override;
+    QString fusedShaderCode(const QString &prefix) const override;
+    QVector<Qt3DRender::QParameter *> fusedParameters() const override;
+
     float threshold() const;
 
 public Q_SLOTS:
@@ -0,0 +1,191 @@
+/*
+    weightedblendedcompositeeffect.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Jim Albamont <jim.albamont@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "weightedblendedcompositeeffect_p.h"
+#include "fullscreenquad.h"
+#include "rendertargetpool_p.h"
+#include <Qt3DRender/qrenderpassfilter.h>
+#include <Qt3DRender/qfilterkey.h>
+#include <Qt3DRender/qshaderprogram.h>
+#include <Qt3DRender/qparameter.h>
+#include <Qt3DRender/qmaterial.h>
+#include <Qt3DRender/qeffect.h>
+#include <Qt3DRender/qrenderpass.h>
+#include <Qt3DRender/qgraphicsapifilter.h>
+#include <Qt3DRender/qtechnique.h>
+#include <Qt3DRender/qlayerfilter.h>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+
+/*!
+ * \class Kuesa::WeightedBlendedCompositeEffect
+ * \internal
+ * \inmodule Kuesa
+ * \brief Composites transparent objects rendered with weighted blended order
+ * independent transparency over the opaque ones
+ *
+ * WeightedBlendedCompositeEffect is inserted by the ForwardRenderer before
+ * any other effect when order independent transparency is enabled. Its input
+ * texture holds the opaque objects, on top of which it blends the weighted
+ * average color of the transparent objects by how much they cover each
+ * pixel.
+ *
+ * The accumulation and weight textures it reads are acquired for the pass
+ * preceding it, in which the WeightedBlendedRenderStage renders into them.
+ */
+
+WeightedBlendedCompositeEffect::WeightedBlendedCompositeEffect(Qt3DCore::QNode *parent)
+    : AbstractPostProcessingEffect(parent)
+    , m_layer(nullptr)
+    , m_inputTextureParameter(new Qt3DRender::QParameter(QStringLiteral("inputTexture"), nullptr))
+    , m_accumulationTextureParameter(new Qt3DRender::QParameter(QStringLiteral("accumulationTexture"), nullptr))
+    , m_weightTextureParameter(new Qt3DRender::QParameter(QStringLiteral("weightTexture"), nullptr))
+    , m_accumulationTexture(nullptr)
+    , m_weightTexture(nullptr)
+{
+    m_rootFrameGraphNode.reset(new Qt3DRender::QFrameGraphNode);
+    m_rootFrameGraphNode->setObjectName(QStringLiteral("Weighted Blended Composite Effect"));
+
+    auto compositeMaterial = new Qt3DRender::QMaterial(m_rootFrameGraphNode.data());
+
+    auto effect = new Qt3DRender::QEffect;
+    compositeMaterial->setEffect(effect);
+
+    const auto makeTechnique = [](Qt3DRender::QGraphicsApiFilter::Api api, int majorVersion, int minorVersion,
+                                  Qt3DRender::QGraphicsApiFilter::OpenGLProfile profile,
+                                  const QString &vertexShader, const QString &fragmentShader) {
+        auto technique = new Qt3DRender::QTechnique;
+
+        technique->graphicsApiFilter()->setApi(api);
+        technique->graphicsApiFilter()->setMajorVersion(majorVersion);
+        technique->graphicsApiFilter()->setMinorVersion(minorVersion);
+        technique->graphicsApiFilter()->setProfile(profile);
+
+        auto techniqueFilterKey = new Qt3DRender::QFilterKey;
+        techniqueFilterKey->setName(QStringLiteral("renderingStyle"));
+        techniqueFilterKey->setValue(QStringLiteral("forward"));
+        technique->addFilterKey(techniqueFilterKey);
+
+        auto renderPass = new Qt3DRender::QRenderPass;
+
+        auto shaderProgram = new Qt3DRender::QShaderProgram(renderPass);
+        shaderProgram->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(vertexShader)));
+        shaderProgram->setFragmentShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(fragmentShader)));
+        renderPass->setShaderProgram(shaderProgram);
+
+        auto passFilterKey = new Qt3DRender::QFilterKey;
+        passFilterKey->setName(QStringLiteral("KuesaWeightedBlendedCompositePass"));
+        renderPass->addFilterKey(passFilterKey);
+
+        technique->addRenderPass(renderPass);
+
+        return technique;
+    };
+
+    effect->addTechnique(makeTechnique(Qt3DRender::QGraphicsApiFilter::OpenGL,
+                                       3, 2,
+                                       Qt3DRender::QGraphicsApiFilter::CoreProfile,
+                                       QStringLiteral("qrc:/kuesa/shaders/gl3/passthrough.vert"),
+                                       QStringLiteral("qrc:/kuesa/shaders/gl3/weightedblendedcomposite.frag")));
+    effect->addTechnique(makeTechnique(Qt3DRender::QGraphicsApiFilter::OpenGLES,
+                                       3, 0,
+                                       Qt3DRender::QGraphicsApiFilter::NoProfile,
+                                       QStringLiteral("qrc:/kuesa/shaders/es3/passthrough.vert"),
+                                       QStringLiteral("qrc:/kuesa/shaders/es3/weightedblendedcomposite.frag")));
+
+    effect->addParameter(m_inputTextureParameter);
+    effect->addParameter(m_accumulationTextureParameter);
+    effect->addParameter(m_weightTextureParameter);
+
+    auto fullScreenQuad = new FullScreenQuad(compositeMaterial, m_rootFrameGraphNode.data());
+    m_layer = fullScreenQuad->layer();
+
+    //
+    //  FrameGraph Construction
+    //
+    auto layerFilter = new Qt3DRender::QLayerFilter(m_rootFrameGraphNode.data());
+    layerFilter->addLayer(m_layer);
+    auto renderPassFilter = new Qt3DRender::QRenderPassFilter(layerFilter);
+    auto filterKey = new Qt3DRender::QFilterKey;
+    filterKey->setName(QStringLiteral("KuesaWeightedBlendedCompositePass"));
+    renderPassFilter->addMatch(filterKey);
+}
+
+WeightedBlendedCompositeEffect::~WeightedBlendedCompositeEffect()
+{
+}
+
+AbstractPostProcessingEffect::FrameGraphNodePtr WeightedBlendedCompositeEffect::frameGraphSubTree() const
+{
+    return m_rootFrameGraphNode;
+}
+
+QVector<Qt3DRender::QLayer *> WeightedBlendedCompositeEffect::layers() const
+{
+    return { m_layer };
+}
+
+void WeightedBlendedCompositeEffect::setInputTexture(Qt3DRender::QAbstractTexture *texture)
+{
+    m_inputTextureParameter->setValue(QVariant::fromValue(texture));
+}
+
+/*!
+ * Acquires the accumulation and weight textures from \a pool, written by the
+ * pass preceding \a pass and read by \a pass.
+ */
+void WeightedBlendedCompositeEffect::acquireTextures(RenderTargetPool *pool, int pass)
+{
+    // Half floats, the weights go well beyond 1
+    m_accumulationTexture = pool->acquireTexture(Qt3DRender::QAbstractTexture::RGBA16F, pass - 1, pass);
+    m_weightTexture = pool->acquireTexture(Qt3DRender::QAbstractTexture::R16F, pass - 1, pass);
+    m_accumulationTextureParameter->setValue(QVariant::fromValue(m_accumulationTexture));
+    m_weightTextureParameter->setValue(QVariant::fromValue(m_weightTexture));
+}
+
+/*!
+ * Returns the texture holding the sum of the weighted premultiplied colors of
+ * the transparent objects and, in alpha, their revealage.
+ */
+Qt3DRender::QAbstractTexture *WeightedBlendedCompositeEffect::accumulationTexture() const
+{
+    return m_accumulationTexture;
+}
+
+/*!
+ * Returns the texture holding the sum of the weighted alphas of the
+ * transparent objects.
+ */
+Qt3DRender::QAbstractTexture *WeightedBlendedCompositeEffect::weightTexture() const
+{
+    return m_weightTexture;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,83 @@
+/*
+    weightedblendedcompositeeffect_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Jim Albamont <jim.albamont@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_WEIGHTEDBLENDEDCOMPOSITEEFFECT_P_H
+#define KUESA_WEIGHTEDBLENDEDCOMPOSITEEFFECT_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Kuesa API.  It exists for the convenience
+// of other Kuesa classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <Kuesa/kuesa_global.h>
+#include <Kuesa/abstractpostprocessingeffect.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DRender {
+class QParameter;
+} // namespace Qt3DRender
+
+namespace Kuesa {
+
+class KUESASHARED_EXPORT WeightedBlendedCompositeEffect : public AbstractPostProcessingEffect
+{
+    Q_OBJECT
+public:
+    explicit WeightedBlendedCompositeEffect(Qt3DCore::QNode *parent = nullptr);
+    ~WeightedBlendedCompositeEffect();
+
+    FrameGraphNodePtr frameGraphSubTree() const override;
+    QVector<Qt3DRender::QLayer *> layers() const override;
+    void setInputTexture(Qt3DRender::QAbstractTexture *texture) override;
+    void acquireTextures(RenderTargetPool *pool, int pass) override;
+
+    Qt3DRender::QAbstractTexture *accumulationTexture() const;
+    Qt3DRender::QAbstractTexture *weightTexture() const;
+
+private:
+    FrameGraphNodePtr m_rootFrameGraphNode;
+    Qt3DRender::QLayer *m_layer;
+    Qt3DRender::QParameter *m_inputTextureParameter;
+    Qt3DRender::QParameter *m_accumulationTextureParameter;
+    Qt3DRender::QParameter *m_weightTextureParameter;
+    Qt3DRender::QAbstractTexture *m_accumulationTexture;
+    Qt3DRender::QAbstractTexture *m_weightTexture;
+};
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_WEIGHTEDBLENDEDCOMPOSITEEFFECT_P_H
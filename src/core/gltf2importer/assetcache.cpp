@@ -0,0 +1,230 @@
+/*
+    assetcache.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "assetcache_p.h"
+#include "kuesa_p.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+using namespace GLTF2Import;
+
+namespace {
+// Unused files are kept until they add up to this size
+const qint64 DefaultMaximumSize = 256 * 1024 * 1024;
+} // namespace
+
+Q_GLOBAL_STATIC(AssetCache, assetCache)
+
+/*!
+ * \class Kuesa::GLTF2Import::AssetCache
+ * \internal
+ *
+ * Process wide cache of the files read by the glTF importers, so that loading
+ * the same scene again, or in several importers, doesn't read them again.
+ *
+ * Files are identified by their canonical path and are read again when their
+ * size or modification date changes. Files with identical contents share the
+ * same data, whatever their paths.
+ *
+ * The data is implicitly shared with the importers using it. Once it isn't
+ * used anymore and the cache grows over its maximum size, the least recently
+ * used contents are evicted.
+ *
+ * Files are read without holding the cache lock. Importers requesting a file
+ * which is being read wait for that read to finish instead of reading it
+ * again.
+ */
+
+AssetCache::AssetCache()
+    : m_maximumSize(DefaultMaximumSize)
+    , m_useCount(0)
+{
+}
+
+/*!
+ * Returns the cache shared by all the importers.
+ */
+AssetCache *AssetCache::instance()
+{
+    return assetCache();
+}
+
+/*!
+ * Returns the content of the file at \a path, reading it unless it is in the
+ * cache. \a success is set to false if the file can't be read.
+ */
+QByteArray AssetCache::fileData(const QString &path, bool &success)
+{
+    const QFileInfo fileInfo(path);
+    const QString canonicalPath = fileInfo.canonicalFilePath();
+    success = !canonicalPath.isEmpty();
+    if (!success)
+        return QByteArray();
+
+    QMutexLocker lock(&m_mutex);
+
+    // Files which changed since they were read are read again
+    const auto fileIt = m_files.constFind(canonicalPath);
+    if (fileIt != m_files.cend() && fileIt->lastModified == fileInfo.lastModified() && fileIt->size == fileInfo.size()) {
+        auto contentIt = m_contents.find(fileIt->contentHash);
+        if (contentIt != m_contents.end()) {
+            ++m_statistics.hits;
+            contentIt->lastUse = ++m_useCount;
+            return contentIt->data;
+        }
+    }
+
+    // Another importer is already reading the file, share its data
+    QSharedPointer<PendingRead> pendingRead = m_pendingReads.value(canonicalPath);
+    if (pendingRead) {
+        while (!pendingRead->finished)
+            m_readFinished.wait(&m_mutex);
+        success = pendingRead->success;
+        if (success)
+            ++m_statistics.hits;
+        return pendingRead->data;
+    }
+
+    ++m_statistics.misses;
+    pendingRead.reset(new PendingRead);
+    m_pendingReads.insert(canonicalPath, pendingRead);
+
+    // The file is read without holding the lock so that importers reading
+    // other files aren't blocked meanwhile
+    lock.unlock();
+    QByteArray data;
+    QByteArray contentHash;
+    QFile file(canonicalPath);
+    success = file.open(QIODevice::ReadOnly);
+    if (success) {
+        data = file.readAll();
+        contentHash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+    }
+    lock.relock();
+
+    if (success) {
+        m_files.insert(canonicalPath, { contentHash, fileInfo.lastModified(), data.size() });
+
+        // Copies of a file elsewhere are only held once
+        auto contentIt = m_contents.find(contentHash);
+        if (contentIt == m_contents.end()) {
+            contentIt = m_contents.insert(contentHash, { data, 0 });
+            m_statistics.size += data.size();
+        } else {
+            data = contentIt->data;
+        }
+        contentIt->lastUse = ++m_useCount;
+    }
+
+    m_pendingReads.remove(canonicalPath);
+    pendingRead->data = data;
+    pendingRead->success = success;
+    pendingRead->finished = true;
+    m_readFinished.wakeAll();
+
+    evict();
+    return data;
+}
+
+/*!
+ * Returns the size above which unused files are evicted, 256MB by default.
+ */
+qint64 AssetCache::maximumSize() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_maximumSize;
+}
+
+void AssetCache::setMaximumSize(qint64 maximumSize)
+{
+    QMutexLocker lock(&m_mutex);
+    m_maximumSize = maximumSize;
+    evict();
+}
+
+/*!
+ * Returns the number of files found in the cache and read since it was
+ * created or cleared, the number of contents evicted and the total size of
+ * the contents held.
+ */
+AssetCache::Statistics AssetCache::statistics() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_statistics;
+}
+
+/*!
+ * Removes all the files from the cache and resets its statistics.
+ */
+void AssetCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_files.clear();
+    m_contents.clear();
+    m_statistics = {};
+}
+
+void AssetCache::evict()
+{
+    while (m_statistics.size > m_maximumSize) {
+        // Evicting contents still in use wouldn't free anything
+        QByteArray leastRecentlyUsedHash;
+        quint64 leastRecentUse = std::numeric_limits<quint64>::max();
+        for (auto it = m_contents.cbegin(), end = m_contents.cend(); it != end; ++it) {
+            if (it->data.isDetached() && it->lastUse < leastRecentUse) {
+                leastRecentUse = it->lastUse;
+                leastRecentlyUsedHash = it.key();
+            }
+        }
+        if (leastRecentlyUsedHash.isEmpty())
+            break;
+
+        removeContent(leastRecentlyUsedHash);
+        ++m_statistics.evictions;
+    }
+}
+
+void AssetCache::removeContent(const QByteArray &contentHash)
+{
+    m_statistics.size -= m_contents.take(contentHash).data.size();
+    for (auto it = m_files.begin(); it != m_files.end();) {
+        if (it->contentHash == contentHash)
+            it = m_files.erase(it);
+        else
+            ++it;
+    }
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,114 @@
+/*
+    assetcache_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_GLTF2IMPORT_ASSETCACHE_P_H
+#define KUESA_GLTF2IMPORT_ASSETCACHE_P_H
+
+//
+//  NOTICE
+//  ------
+//
+// We mean it: this file is not part of the public API and could be
+// modified without notice
+//
+
+#include <QtCore/qglobal.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QWaitCondition>
+
+QT_BEGIN_NAMESPACE
+
+namespace Kuesa {
+namespace GLTF2Import {
+
+class Q_AUTOTEST_EXPORT AssetCache
+{
+public:
+    struct Statistics {
+        int hits = 0;
+        int misses = 0;
+        int evictions = 0;
+        qint64 size = 0;
+    };
+
+    AssetCache();
+
+    static AssetCache *instance();
+
+    QByteArray fileData(const QString &path, bool &success);
+
+    qint64 maximumSize() const;
+    void setMaximumSize(qint64 maximumSize);
+
+    Statistics statistics() const;
+    void clear();
+
+private:
+    struct File {
+        QByteArray contentHash;
+        QDateTime lastModified;
+        qint64 size;
+    };
+
+    struct Content {
+        QByteArray data;
+        quint64 lastUse;
+    };
+
+    // File being read by an importer, the others wait for its data
+    struct PendingRead {
+        QByteArray data;
+        bool success = false;
+        bool finished = false;
+    };
+
+    void evict();
+    void removeContent(const QByteArray &contentHash);
+
+    mutable QMutex m_mutex;
+    // Files by canonical path, files with identical contents share them
+    QHash<QString, File> m_files;
+    QHash<QByteArray, Content> m_contents;
+    QHash<QString, QSharedPointer<PendingRead>> m_pendingReads;
+    QWaitCondition m_readFinished;
+    qint64 m_maximumSize;
+    quint64 m_useCount;
+    Statistics m_statistics;
+};
+
+} // namespace GLTF2Import
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_GLTF2IMPORT_ASSETCACHE_P_H
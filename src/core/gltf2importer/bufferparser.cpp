@@ -28,12 +28,12 @@
 
 #include "bufferparser_p.h"
 
-#include <QFile>
 #include <QDir>
 #include <QJsonArray>
 #include <QDebug>
 
 #include "gltf2context_p.h"
+#include "assetcache_p.h"
 #include "kuesa_p.h"
 
 QT_BEGIN_NAMESPACE
@@ -107,14 +107,11 @@ bool BufferParser::parse(const QJsonArray &buffersArray, GLTF2ContextPrivate *co
 QByteArray BufferParser::dataFromUri(const QString &uri, bool &success) const
 {
     const QString absPath = m_basePath.absoluteFilePath(uri);
-    QFile dataFile(absPath);
-    success = dataFile.open(QIODevice::ReadOnly);
-    if (success)
-        return dataFile.readAll();
-    else
+    const QByteArray data = AssetCache::instance()->fileData(absPath, success);
+    if (!success)
         qCWarning(kuesa) << "Failed to open" << uri;
 
-    return QByteArray();
+    return data;
 }
 
 QT_END_NAMESPACE
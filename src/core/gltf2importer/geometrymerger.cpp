@@ -0,0 +1,289 @@
+/*
+    geometrymerger.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "geometrymerger_p.h"
+#include "geometryutils_p.h"
+
+#include <QtGui/QMatrix3x3>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+#include <Qt3DRender/QGeometryRenderer>
+#include <algorithm>
+#include <numeric>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+using namespace GLTF2Import;
+
+namespace {
+
+bool hasLayout(const Qt3DRender::QAttribute *attribute,
+               Qt3DRender::QAttribute::VertexBaseType vertexBaseType,
+               uint vertexSize)
+{
+    return attribute->vertexBaseType() == vertexBaseType && attribute->vertexSize() == vertexSize;
+}
+
+// Returns the vertex attributes of geometry sorted by name
+QVector<Qt3DRender::QAttribute *> vertexAttributes(const Qt3DRender::QGeometry *geometry,
+                                                   Qt3DRender::QAttribute **indexAttribute)
+{
+    QVector<Qt3DRender::QAttribute *> attributes;
+    *indexAttribute = nullptr;
+    const auto geometryAttributes = geometry->attributes();
+    for (Qt3DRender::QAttribute *attribute : geometryAttributes) {
+        if (attribute->attributeType() == Qt3DRender::QAttribute::IndexAttribute)
+            *indexAttribute = attribute;
+        else
+            attributes.push_back(attribute);
+    }
+    std::sort(attributes.begin(), attributes.end(),
+              [](const Qt3DRender::QAttribute *a, const Qt3DRender::QAttribute *b) { return a->name() < b->name(); });
+    return attributes;
+}
+
+} // namespace
+
+/*!
+ * \internal
+ *
+ * Returns a string identifying the vertex layout of the geometry of \a
+ * renderer. Primitives can only be merged with primitives of the same layout.
+ * An empty string is returned if the primitive can't be merged.
+ */
+QByteArray GeometryMerger::layoutSignature(const Qt3DRender::QGeometryRenderer *renderer)
+{
+    if (renderer == nullptr || renderer->geometry() == nullptr ||
+        renderer->primitiveType() != Qt3DRender::QGeometryRenderer::Triangles ||
+        renderer->primitiveRestartEnabled() || renderer->instanceCount() != 1)
+        return {};
+
+    Qt3DRender::QAttribute *indexAttribute = nullptr;
+    const QVector<Qt3DRender::QAttribute *> attributes = vertexAttributes(renderer->geometry(), &indexAttribute);
+    if (attributes.isEmpty())
+        return {};
+
+    if (indexAttribute != nullptr) {
+        if (!isAttributeReadable(indexAttribute) || indexAttribute->vertexSize() != 1)
+            return {};
+        switch (indexAttribute->vertexBaseType()) {
+        case Qt3DRender::QAttribute::UnsignedByte:
+        case Qt3DRender::QAttribute::UnsignedShort:
+        case Qt3DRender::QAttribute::UnsignedInt:
+            break;
+        default:
+            return {};
+        }
+    }
+
+    bool hasPosition = false;
+    QByteArray signature;
+    for (const Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->count() != attributes.first()->count() || attribute->divisor() != 0 || !isAttributeReadable(attribute))
+            return {};
+
+        // Attributes transformed when merging must be made of floats
+        if (attribute->name() == Qt3DRender::QAttribute::defaultPositionAttributeName()) {
+            if (!hasLayout(attribute, Qt3DRender::QAttribute::Float, 3))
+                return {};
+            hasPosition = true;
+        } else if (attribute->name() == Qt3DRender::QAttribute::defaultNormalAttributeName()) {
+            if (!hasLayout(attribute, Qt3DRender::QAttribute::Float, 3))
+                return {};
+        } else if (attribute->name() == Qt3DRender::QAttribute::defaultTangentAttributeName()) {
+            if (!hasLayout(attribute, Qt3DRender::QAttribute::Float, 4))
+                return {};
+        }
+
+        signature += attribute->name().toUtf8() + ':' +
+                QByteArray::number(attribute->vertexBaseType()) + ':' +
+                QByteArray::number(attribute->vertexSize()) + ';';
+    }
+
+    if (!hasPosition)
+        return {};
+    return signature;
+}
+
+/*!
+ * \internal
+ *
+ * Appends the geometry of \a renderer, transformed by \a matrix, to the merged
+ * geometry. The range of its indices in the merged index buffer is returned in
+ * \a range. Returns false if the geometry can't be merged.
+ */
+bool GeometryMerger::append(const Qt3DRender::QGeometryRenderer *renderer, const QMatrix4x4 &matrix, MergedRange *range)
+{
+    if (layoutSignature(renderer).isEmpty())
+        return false;
+
+    Qt3DRender::QAttribute *indexAttribute = nullptr;
+    const QVector<Qt3DRender::QAttribute *> attributes = vertexAttributes(renderer->geometry(), &indexAttribute);
+
+    // The first geometry appended defines the layout of the merged geometry
+    if (m_attributes.isEmpty()) {
+        for (const Qt3DRender::QAttribute *attribute : attributes)
+            m_attributes.push_back({ attribute->name(), attribute->vertexBaseType(), attribute->vertexSize(), {} });
+    }
+    if (attributes.size() != m_attributes.size())
+        return false;
+    for (int i = 0, m = attributes.size(); i < m; ++i) {
+        const MergedAttribute &mergedAttribute = m_attributes.at(i);
+        if (attributes.at(i)->name() != mergedAttribute.name ||
+            !hasLayout(attributes.at(i), mergedAttribute.vertexBaseType, mergedAttribute.vertexSize))
+            return false;
+    }
+
+    const int vertexCount = int(attributes.first()->count());
+    QVector<quint32> indices;
+    if (indexAttribute != nullptr) {
+        if (!readIndices(indexAttribute, indices))
+            return false;
+        if (std::any_of(indices.cbegin(), indices.cend(), [vertexCount](quint32 index) { return index >= quint32(vertexCount); }))
+            return false;
+    } else {
+        indices.resize(vertexCount);
+        std::iota(indices.begin(), indices.end(), 0U);
+    }
+    // Incomplete triangles aren't drawn anyway
+    indices.resize(indices.size() - indices.size() % 3);
+
+    const QMatrix3x3 normalMatrix = matrix.normalMatrix();
+    const auto transformNormal = [&normalMatrix](const float *normal) {
+        QVector3D transformed;
+        for (int row = 0; row < 3; ++row)
+            transformed[row] = normalMatrix(row, 0) * normal[0] + normalMatrix(row, 1) * normal[1] + normalMatrix(row, 2) * normal[2];
+        return transformed.normalized();
+    };
+    // Mirroring transforms reverse the winding of the triangles
+    const bool mirrored = matrix.determinant() < 0.0f;
+
+    for (int i = 0, m = attributes.size(); i < m; ++i) {
+        const Qt3DRender::QAttribute *attribute = attributes.at(i);
+        const QByteArray data = attribute->buffer()->data();
+        const char *rawData = data.constData() + attribute->byteOffset();
+        const uint stride = attributeElementStride(attribute);
+        const uint size = attributeElementSize(attribute);
+
+        QByteArray &mergedData = m_attributes[i].data;
+        const int mergedOffset = mergedData.size();
+        mergedData.resize(mergedOffset + vertexCount * int(size));
+        char *rawMergedData = mergedData.data() + mergedOffset;
+
+        for (int vertex = 0; vertex < vertexCount; ++vertex) {
+            memcpy(rawMergedData, rawData, size);
+            if (attribute->name() == Qt3DRender::QAttribute::defaultPositionAttributeName()) {
+                float *position = reinterpret_cast<float *>(rawMergedData);
+                const QVector3D transformed = matrix * QVector3D(position[0], position[1], position[2]);
+                position[0] = transformed.x();
+                position[1] = transformed.y();
+                position[2] = transformed.z();
+            } else if (attribute->name() == Qt3DRender::QAttribute::defaultNormalAttributeName()) {
+                float *normal = reinterpret_cast<float *>(rawMergedData);
+                const QVector3D transformed = transformNormal(normal);
+                normal[0] = transformed.x();
+                normal[1] = transformed.y();
+                normal[2] = transformed.z();
+            } else if (attribute->name() == Qt3DRender::QAttribute::defaultTangentAttributeName()) {
+                // w gives the handedness of the bitangent
+                float *tangent = reinterpret_cast<float *>(rawMergedData);
+                const QVector3D transformed = matrix.mapVector(QVector3D(tangent[0], tangent[1], tangent[2])).normalized();
+                tangent[0] = transformed.x();
+                tangent[1] = transformed.y();
+                tangent[2] = transformed.z();
+                if (mirrored)
+                    tangent[3] = -tangent[3];
+            }
+            rawData += stride;
+            rawMergedData += size;
+        }
+    }
+
+    if (range != nullptr) {
+        range->firstIndex = m_indices.size();
+        range->indexCount = indices.size();
+    }
+
+    const quint32 baseVertex = quint32(m_vertexCount);
+    m_indices.reserve(m_indices.size() + indices.size());
+    for (int i = 0, m = indices.size(); i < m; i += 3) {
+        m_indices.push_back(baseVertex + indices.at(i));
+        m_indices.push_back(baseVertex + indices.at(mirrored ? i + 2 : i + 1));
+        m_indices.push_back(baseVertex + indices.at(mirrored ? i + 1 : i + 2));
+    }
+    m_vertexCount += vertexCount;
+
+    return true;
+}
+
+/*!
+ * \internal
+ *
+ * Returns a new renderer drawing all the geometries appended so far, or
+ * nullptr if none was.
+ */
+Qt3DRender::QGeometryRenderer *GeometryMerger::createRenderer() const
+{
+    if (m_vertexCount == 0)
+        return nullptr;
+
+    auto geometry = new Qt3DRender::QGeometry();
+    for (const MergedAttribute &mergedAttribute : m_attributes) {
+        auto buffer = new Qt3DRender::QBuffer(geometry);
+        buffer->setData(mergedAttribute.data);
+        geometry->addAttribute(new Qt3DRender::QAttribute(buffer,
+                                                          mergedAttribute.name,
+                                                          mergedAttribute.vertexBaseType,
+                                                          mergedAttribute.vertexSize,
+                                                          uint(m_vertexCount),
+                                                          0,
+                                                          0,
+                                                          geometry));
+    }
+
+    auto indexBuffer = new Qt3DRender::QBuffer(geometry);
+    indexBuffer->setData(QByteArray(reinterpret_cast<const char *>(m_indices.constData()),
+                                    m_indices.size() * int(sizeof(quint32))));
+    auto indexAttribute = new Qt3DRender::QAttribute(indexBuffer,
+                                                     Qt3DRender::QAttribute::UnsignedInt,
+                                                     1,
+                                                     uint(m_indices.size()),
+                                                     0,
+                                                     0,
+                                                     geometry);
+    indexAttribute->setAttributeType(Qt3DRender::QAttribute::IndexAttribute);
+    geometry->addAttribute(indexAttribute);
+
+    auto renderer = new Qt3DRender::QGeometryRenderer();
+    renderer->setPrimitiveType(Qt3DRender::QGeometryRenderer::Triangles);
+    renderer->setGeometry(geometry);
+    return renderer;
+}
+
+QT_END_NAMESPACE
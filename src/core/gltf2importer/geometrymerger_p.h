@@ -0,0 +1,91 @@
+/*
+    geometrymerger_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_GLTF2IMPORT_GEOMETRYMERGER_P_H
+#define KUESA_GLTF2IMPORT_GEOMETRYMERGER_P_H
+
+//
+//  NOTICE
+//  ------
+//
+// We mean it: this file is not part of the public API and could be
+// modified without notice
+//
+
+#include <QtCore/qglobal.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QVector>
+#include <QtGui/QMatrix4x4>
+#include <Qt3DRender/QAttribute>
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DRender {
+class QGeometryRenderer;
+} // namespace Qt3DRender
+
+namespace Kuesa {
+namespace GLTF2Import {
+
+// Range of the indices of a merged primitive in the merged index buffer
+struct MergedRange {
+    Qt3DRender::QGeometryRenderer *renderer = nullptr;
+    int firstIndex = 0;
+    int indexCount = 0;
+};
+
+class Q_AUTOTEST_EXPORT GeometryMerger
+{
+public:
+    static QByteArray layoutSignature(const Qt3DRender::QGeometryRenderer *renderer);
+
+    bool append(const Qt3DRender::QGeometryRenderer *renderer, const QMatrix4x4 &matrix, MergedRange *range = nullptr);
+    Qt3DRender::QGeometryRenderer *createRenderer() const;
+
+    int vertexCount() const { return m_vertexCount; }
+    int indexCount() const { return m_indices.size(); }
+
+private:
+    struct MergedAttribute {
+        QString name;
+        Qt3DRender::QAttribute::VertexBaseType vertexBaseType;
+        uint vertexSize;
+        QByteArray data;
+    };
+
+    QVector<MergedAttribute> m_attributes;
+    QVector<quint32> m_indices;
+    int m_vertexCount = 0;
+};
+
+} // namespace GLTF2Import
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_GLTF2IMPORT_GEOMETRYMERGER_P_H
@@ -0,0 +1,213 @@
+/*
+    geometryutils_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_GLTF2IMPORT_GEOMETRYUTILS_P_H
+#define KUESA_GLTF2IMPORT_GEOMETRYUTILS_P_H
+
+//
+//  NOTICE
+//  ------
+//
+// We mean it: this file is not part of the public API and could be
+// modified without notice
+//
+
+#include <QtCore/qglobal.h>
+#include <QtCore/QVector>
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QVector3D>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+namespace Kuesa {
+namespace GLTF2Import {
+
+inline uint vertexBaseTypeSize(Qt3DRender::QAttribute::VertexBaseType vertexBaseType)
+{
+    switch (vertexBaseType) {
+    case Qt3DRender::QAttribute::Byte:
+    case Qt3DRender::QAttribute::UnsignedByte:
+        return 1;
+    case Qt3DRender::QAttribute::Short:
+    case Qt3DRender::QAttribute::UnsignedShort:
+    case Qt3DRender::QAttribute::HalfFloat:
+        return 2;
+    case Qt3DRender::QAttribute::Int:
+    case Qt3DRender::QAttribute::UnsignedInt:
+    case Qt3DRender::QAttribute::Float:
+        return 4;
+    case Qt3DRender::QAttribute::Double:
+        return 8;
+    }
+    return 0;
+}
+
+inline uint attributeElementSize(const Qt3DRender::QAttribute *attribute)
+{
+    return attribute->vertexSize() * vertexBaseTypeSize(attribute->vertexBaseType());
+}
+
+inline uint attributeElementStride(const Qt3DRender::QAttribute *attribute)
+{
+    return attribute->byteStride() > 0 ? attribute->byteStride() : attributeElementSize(attribute);
+}
+
+// Checks that all the elements of attribute are within its buffer
+inline bool isAttributeReadable(const Qt3DRender::QAttribute *attribute)
+{
+    if (attribute->buffer() == nullptr || attribute->count() == 0 || attributeElementSize(attribute) == 0)
+        return false;
+    const qint64 end = qint64(attribute->byteOffset()) +
+            qint64(attribute->count() - 1) * attributeElementStride(attribute) +
+            attributeElementSize(attribute);
+    return end <= attribute->buffer()->data().size();
+}
+
+template<typename IndexType>
+void readIndices(const Qt3DRender::QAttribute *attribute, QVector<quint32> &indices)
+{
+    const QByteArray data = attribute->buffer()->data();
+    const char *rawData = data.constData() + attribute->byteOffset();
+    const uint stride = attributeElementStride(attribute);
+    indices.resize(int(attribute->count()));
+    for (quint32 &index : indices) {
+        IndexType value;
+        memcpy(&value, rawData, sizeof(IndexType));
+        index = value;
+        rawData += stride;
+    }
+}
+
+// Reads the values of a readable index attribute, returns false if its type
+// isn't an unsigned integer type
+inline bool readIndices(const Qt3DRender::QAttribute *attribute, QVector<quint32> &indices)
+{
+    if (attribute->vertexSize() != 1)
+        return false;
+
+    switch (attribute->vertexBaseType()) {
+    case Qt3DRender::QAttribute::UnsignedByte:
+        readIndices<quint8>(attribute, indices);
+        return true;
+    case Qt3DRender::QAttribute::UnsignedShort:
+        readIndices<quint16>(attribute, indices);
+        return true;
+    case Qt3DRender::QAttribute::UnsignedInt:
+        readIndices<quint32>(attribute, indices);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Bounds precomputed from the POSITION accessors are stored as dynamic
+// properties, in the space of the position attribute for geometries and in
+// the local space of the node for entities
+inline void setBounds(QObject *object, const QVector3D &boundsMin, const QVector3D &boundsMax)
+{
+    object->setProperty("boundsMin", boundsMin);
+    object->setProperty("boundsMax", boundsMax);
+}
+
+inline bool bounds(const QObject *object, QVector3D &boundsMin, QVector3D &boundsMax)
+{
+    const QVariant minValue = object->property("boundsMin");
+    const QVariant maxValue = object->property("boundsMax");
+    if (!minValue.isValid() || !maxValue.isValid())
+        return false;
+    boundsMin = minValue.value<QVector3D>();
+    boundsMax = maxValue.value<QVector3D>();
+    return true;
+}
+
+// Transforms the bounds to the box bounding their transformed corners
+inline void transformBounds(const QMatrix4x4 &matrix, QVector3D &boundsMin, QVector3D &boundsMax)
+{
+    QVector3D transformedMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    QVector3D transformedMax = -transformedMin;
+    for (int corner = 0; corner < 8; ++corner) {
+        const QVector3D position = matrix * QVector3D((corner & 1) ? boundsMax.x() : boundsMin.x(),
+                                                      (corner & 2) ? boundsMax.y() : boundsMin.y(),
+                                                      (corner & 4) ? boundsMax.z() : boundsMin.z());
+        for (int axis = 0; axis < 3; ++axis) {
+            transformedMin[axis] = std::min(transformedMin[axis], position[axis]);
+            transformedMax[axis] = std::max(transformedMax[axis], position[axis]);
+        }
+    }
+    boundsMin = transformedMin;
+    boundsMax = transformedMax;
+}
+
+inline void uniteBounds(QVector3D &boundsMin, QVector3D &boundsMax, const QVector3D &otherMin, const QVector3D &otherMax)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        boundsMin[axis] = std::min(boundsMin[axis], otherMin[axis]);
+        boundsMax[axis] = std::max(boundsMax[axis], otherMax[axis]);
+    }
+}
+
+// Creates an attribute from which Qt3D computes the bounding volume of a
+// geometry from the given bounds rather than from its positions. It holds as
+// many vertices as the positions of the geometry so that its indices remain
+// valid, alternating the two extreme corners is enough for any set of indices
+// spanning more than one vertex.
+inline Qt3DRender::QAttribute *createBoundsAttribute(const QVector3D &boundsMin, const QVector3D &boundsMax,
+                                                     uint count, Qt3DCore::QNode *parent)
+{
+    QByteArray boundsData(int(count) * 3 * int(sizeof(float)), Qt::Uninitialized);
+    float *rawBounds = reinterpret_cast<float *>(boundsData.data());
+    for (uint i = 0; i < count; ++i) {
+        const QVector3D &corner = (i % 2 == 0) ? boundsMin : boundsMax;
+        *rawBounds++ = corner.x();
+        *rawBounds++ = corner.y();
+        *rawBounds++ = corner.z();
+    }
+
+    auto boundsBuffer = new Qt3DRender::QBuffer(parent);
+    boundsBuffer->setData(boundsData);
+    return new Qt3DRender::QAttribute(boundsBuffer,
+                                      QStringLiteral("boundingPosition"),
+                                      Qt3DRender::QAttribute::Float,
+                                      3,
+                                      count,
+                                      0,
+                                      0,
+                                      parent);
+}
+
+} // namespace GLTF2Import
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_GLTF2IMPORT_GEOMETRYUTILS_P_H
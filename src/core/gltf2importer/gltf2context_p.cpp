@@ -30,11 +30,19 @@
 #include "gltf2context_p.h"
 #include "kuesa_p.h"
 
+#include <Qt3DRender/QAbstractTexture>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometryRenderer>
+#include <Qt3DRender/QLayer>
+#include <Qt3DRender/QMaterial>
+
 QT_BEGIN_NAMESPACE
 using namespace Kuesa;
 using namespace GLTF2Import;
 
 GLTF2ContextPrivate::GLTF2ContextPrivate()
+    : m_defaultScene(-1)
+    , m_assetsParent(nullptr)
 {
 }
 
@@ -86,6 +94,55 @@ void GLTF2ContextPrivate::addBufferView(const BufferView &bufferView)
     m_bufferViews.push_back(bufferView);
 }
 
+/*!
+ * \internal
+ *
+ * Returns the Qt3D buffer holding the data of the buffer view \a id, creating
+ * it on first use. Meshes created later on, when loading lazily, share the
+ * buffers of the meshes created before them.
+ */
+Qt3DRender::QBuffer *GLTF2ContextPrivate::bufferViewBuffer(int id)
+{
+    QPointer<Qt3DRender::QBuffer> &buffer = m_bufferViewBuffers[id];
+    if (buffer.isNull()) {
+        buffer = new Qt3DRender::QBuffer;
+        buffer->setData(bufferView(id).bufferData);
+    }
+    return buffer;
+}
+
+QHash<int, QPointer<Qt3DRender::QBuffer>> GLTF2ContextPrivate::bufferViewBuffers() const
+{
+    return m_bufferViewBuffers;
+}
+
+/*!
+ * \internal
+ *
+ * Replaces the Qt3D buffers of the buffer views by \a buffers, keyed by
+ * buffer view, when they come from another version of the file.
+ */
+void GLTF2ContextPrivate::setBufferViewBuffers(const QHash<int, QPointer<Qt3DRender::QBuffer>> &buffers)
+{
+    m_bufferViewBuffers = buffers;
+}
+
+/*!
+ * \internal
+ *
+ * Forgets the buffers whose data was rewritten, by the mesh optimizer, so that
+ * meshes created afterwards get the data of the buffer views instead.
+ */
+void GLTF2ContextPrivate::releaseModifiedBufferViewBuffers()
+{
+    for (auto it = m_bufferViewBuffers.begin(); it != m_bufferViewBuffers.end();) {
+        if (it->isNull() || (*it)->data().constData() != bufferView(it.key()).bufferData.constData())
+            it = m_bufferViewBuffers.erase(it);
+        else
+            ++it;
+    }
+}
+
 int GLTF2ContextPrivate::cameraCount() const
 {
     return m_cameras.size();
@@ -263,6 +320,11 @@ const Mesh GLTF2ContextPrivate::mesh(int id) const
     return Mesh();
 }
 
+void GLTF2ContextPrivate::setMesh(int id, const Mesh &mesh)
+{
+    m_meshes[id] = mesh;
+}
+
 int GLTF2ContextPrivate::layersCount() const
 {
     return m_layers.size();
@@ -347,6 +409,87 @@ void GLTF2ContextPrivate::setRequiredExtensions(const QStringList &requiredExten
     m_requiredExtensions = requiredExtensions;
 }
 
+int GLTF2ContextPrivate::defaultScene() const
+{
+    return m_defaultScene;
+}
+
+void GLTF2ContextPrivate::setDefaultScene(int defaultScene)
+{
+    m_defaultScene = defaultScene;
+}
+
+Qt3DCore::QNode *GLTF2ContextPrivate::assetsParent() const
+{
+    return m_assetsParent;
+}
+
+/*!
+ * \internal
+ *
+ * Sets \a parent as the parent of the Qt3D nodes created while parsing the
+ * file, which are shared by all the scenes instantiated from it.
+ */
+void GLTF2ContextPrivate::setAssetsParent(Qt3DCore::QNode *parent)
+{
+    m_assetsParent = parent;
+    const auto adopt = [parent](Qt3DCore::QNode *node) {
+        if (node != nullptr && node->parent() != parent)
+            node->setParent(parent);
+    };
+
+    for (const Mesh &mesh : qAsConst(m_meshes)) {
+        for (const Primitive &primitive : mesh.meshPrimitives)
+            adopt(primitive.primitiveRenderer);
+    }
+    for (const Layer &layer : qAsConst(m_layers))
+        adopt(layer.layer);
+    for (const Texture &texture : qAsConst(m_textures))
+        adopt(texture.texture);
+    for (const Material &material : qAsConst(m_materials)) {
+        adopt(material.material(false));
+        adopt(material.material(true));
+        adopt(material.instancedMaterial());
+    }
+    for (const Camera &camera : qAsConst(m_cameras))
+        adopt(camera.lens);
+    // Buffers outlive the meshes which created them when others share them
+    for (const QPointer<Qt3DRender::QBuffer> &buffer : qAsConst(m_bufferViewBuffers))
+        adopt(buffer);
+}
+
+QJsonObject GLTF2ContextPrivate::document() const
+{
+    return m_document;
+}
+
+/*!
+ * \internal
+ *
+ * Keeps the root object of the parsed glTF \a document, to find what changed
+ * when the file is reloaded.
+ */
+void GLTF2ContextPrivate::setDocument(const QJsonObject &document)
+{
+    m_document = document;
+}
+
+/*!
+ * \internal
+ *
+ * Takes the document of \a updated along with the buffers, buffer views,
+ * accessors and nodes parsed from it. The Qt3D assets created from the
+ * previous document are kept and have to be updated separately.
+ */
+void GLTF2ContextPrivate::updateDocument(const GLTF2ContextPrivate &updated)
+{
+    m_document = updated.m_document;
+    m_buffers = updated.m_buffers;
+    m_bufferViews = updated.m_bufferViews;
+    m_accessors = updated.m_accessors;
+    m_treeNodes = updated.m_treeNodes;
+}
+
 template<>
 int GLTF2ContextPrivate::count<Mesh>() const
 {
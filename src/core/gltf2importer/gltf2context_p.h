@@ -37,7 +37,10 @@
 // modified without notice
 //
 
+#include <QHash>
 #include <QVector>
+#include <QJsonObject>
+#include <QPointer>
 #include "bufferparser_p.h"
 #include "bufferviewsparser_p.h"
 #include "cameraparser_p.h"
@@ -55,7 +58,12 @@
 
 QT_BEGIN_NAMESPACE
 
+namespace Qt3DCore {
+class QNode;
+}
+
 namespace Qt3DRender {
+class QBuffer;
 class QLayer;
 }
 
@@ -90,6 +98,10 @@ public:
     int bufferViewCount() const;
     const BufferView bufferView(int id) const;
     void addBufferView(const BufferView &bufferView);
+    Qt3DRender::QBuffer *bufferViewBuffer(int id);
+    QHash<int, QPointer<Qt3DRender::QBuffer>> bufferViewBuffers() const;
+    void setBufferViewBuffers(const QHash<int, QPointer<Qt3DRender::QBuffer>> &buffers);
+    void releaseModifiedBufferViewBuffers();
 
     int cameraCount() const;
     const Camera camera(int id) const;
@@ -102,6 +114,7 @@ public:
     int meshesCount() const;
     void addMesh(const Mesh &mesh);
     const Mesh mesh(int id) const;
+    void setMesh(int id, const Mesh &mesh);
 
     int treeNodeCount() const;
     void addTreeNode(const TreeNode &treeNode);
@@ -145,10 +158,22 @@ public:
     QStringList requiredExtensions() const;
     void setRequiredExtensions(const QStringList &requiredExtensions);
 
+    int defaultScene() const;
+    void setDefaultScene(int defaultScene);
+
+    Qt3DCore::QNode *assetsParent() const;
+    void setAssetsParent(Qt3DCore::QNode *parent);
+
+    QJsonObject document() const;
+    void setDocument(const QJsonObject &document);
+    void updateDocument(const GLTF2ContextPrivate &updated);
+
 private:
     QVector<Accessor> m_accessors;
     QVector<QByteArray> m_buffers;
     QVector<BufferView> m_bufferViews;
+    // Qt3D buffers of the buffer views, shared by the meshes using them
+    QHash<int, QPointer<Qt3DRender::QBuffer>> m_bufferViewBuffers;
     QVector<Camera> m_cameras;
     QVector<Mesh> m_meshes;
     QVector<TreeNode> m_treeNodes;
@@ -162,6 +187,9 @@ private:
     QVector<Skin> m_skins;
     QStringList m_usedExtensions;
     QStringList m_requiredExtensions;
+    int m_defaultScene;
+    Qt3DCore::QNode *m_assetsParent;
+    QJsonObject m_document;
 };
 
 template<>
@@ -29,10 +29,15 @@
 #include "gltf2context.h"
 #include "gltf2importer.h"
 #include "gltf2importer/gltf2parser_p.h"
+#include "gltf2importer/assetcache_p.h"
+#include "gltf2importer/sceneupdater_p.h"
+#include "kuesa_p.h"
 
 #include "collections/meshcollection.h"
 #include <Qt3DCore/QEntity>
+#include <Qt3DRender/QGeometryRenderer>
 #include <Kuesa/SceneEntity>
+#include <algorithm>
 
 namespace {
 
@@ -103,6 +108,16 @@ using namespace Kuesa;
  * \li a material that does perform skinning for use with skinned meshes. It will
  * be added to the collection with the name "skinned_Mat"
  * \endlist
+ *
+ * The bounds of the positions, given by the glTF accessors, are stored as
+ * QVector3D \c boundsMin and \c boundsMax dynamic properties on the imported
+ * geometries, in the space of their position attribute, and on the entities
+ * of the nodes referencing a mesh, in the space of the node.
+ *
+ * Nodes using the MSFT_lod extension switch between the meshes of their
+ * levels of detail according to their screen coverage, once a camera is set
+ * on SceneEntity::levelOfDetailCamera. Unnamed meshes used as levels of detail
+ * are registered as "<node>_lod<level>_<primitive>".
  */
 
 /*!
@@ -160,6 +175,19 @@ using namespace Kuesa;
     \value Error  An error occurred when loading the current glTF file.
 */
 
+/*!
+    \enum GLTF2Importer::AnimationMode
+
+    This enum type describes how the imported animations are played by
+    Kuesa::AnimationPlayer.
+
+    \value AspectAnimations  Animations are evaluated by the Qt 3D animation
+    aspect and applied to their targets through property updates (default).
+    \value TransformTrackAnimations  Animation channels targeting transforms
+    and joints are sampled once per frame and applied with the typed setters of
+    the targets. This is much cheaper for scenes with many animated nodes.
+*/
+
 /*!
     \property GLTF2Importer::source
     \brief the source of the glTF file
@@ -188,6 +216,104 @@ using namespace Kuesa;
     \sa GLTF2Importer::assignNames()
  */
 
+/*!
+    \property GLTF2Importer::animationMode
+    \brief how the imported animations are applied to their targets (default
+    is GLTF2Importer::AspectAnimations)
+
+    \note Changing the mode only affects files loaded afterwards.
+
+    \sa GLTF2Importer::AnimationMode
+ */
+
+/*!
+    \property GLTF2Importer::automaticInstancing
+    \brief if true, meshes referenced by several nodes are drawn with a
+    single instanced draw call (default is false)
+
+    Only nodes of the default scene which aren't skinned and whose transforms,
+    and those of their ancestors, aren't animated are instanced. Their
+    transformations are baked into the instances when loading: the entities of
+    the nodes are still created but moving them has no effect on the
+    instances. Meshes of nodes using the EXT_mesh_gpu_instancing extension are
+    always instanced.
+
+    \note Changing this property only affects files loaded afterwards.
+ */
+
+/*!
+    \property GLTF2Importer::mergeStaticGeometry
+    \brief if true, primitives of static nodes sharing the same material are
+    merged into larger geometries drawn with a single draw call (default is
+    false)
+
+    Only nodes of the default scene which aren't skinned or instanced and whose
+    transforms, and those of their ancestors, aren't animated are merged. Their
+    vertices are transformed to world space when loading: the entities of the
+    nodes are still created but moving them has no effect on the merged
+    geometries. Where the primitives of an entity ended up can be retrieved
+    with mergedRanges().
+
+    \note Changing this property only affects files loaded afterwards.
+
+    \sa GLTF2Importer::mergedRanges()
+ */
+
+/*!
+    \property GLTF2Importer::optimizeMeshes
+    \brief if true, the indexed triangles of meshes are reordered for the
+    vertex cache of the GPU and their indices stored on 16 bits whenever
+    possible (default is false)
+
+    Vertices are also renumbered in the order they are drawn, unless the
+    buffer views holding them are shared with other meshes.
+
+    \note Changing this property only affects files loaded afterwards.
+ */
+
+/*!
+    \property GLTF2Importer::sceneIndex
+    \brief the index of the scene of the glTF file to instantiate, the
+    default scene of the file if negative (default is -1)
+
+    Only the nodes reachable from the scene get entities. Changing the scene
+    once the file is loaded doesn't read nor parse it again: the meshes,
+    materials, textures and layers already created are reused and only the
+    entities, skeletons and animations of the scene are created again.
+ */
+
+/*!
+    \property GLTF2Importer::lazyMeshes
+    \brief if true, the meshes no node of the instantiated scene uses are only
+    created when first looked up in the mesh collection of the SceneEntity
+    (default is false)
+
+    This saves the geometries, and the GPU memory they would use, of files
+    holding many meshes only few scenes or levels of detail need.
+
+    \note Changing this property only affects files loaded afterwards.
+ */
+
+/*!
+    \property GLTF2Importer::loadStatistics
+    \brief statistics about the last loaded file
+
+    The map holds the following entries:
+    \list
+    \li drawCountBeforeMerging: the number of draw calls needed to draw the
+    scene with one draw call per primitive of each node
+    \li drawCount: the number of draw calls actually needed, once meshes are
+    instanced and static geometry is merged
+    \li cacheHits: the number of files, such as the glTF file itself and its
+    buffers, reused from those already read by this or another importer
+    \li cacheMisses: the number of files actually read
+    \endlist
+
+    When reload() updates the scene in place, the map holds the
+    updatedMaterials, updatedMeshes and updatedNodes entries instead of the
+    cache ones, counting the assets and the entities which changed.
+ */
+
 /*!
     \qmlproperty GLTF2Importer::source
     \brief the source of the glTF file
@@ -208,6 +334,59 @@ using namespace Kuesa;
     \brief if true, assets with no names will be added to collections with default names (default is false)
  */
 
+/*!
+    \qmlproperty GLTF2Importer::animationMode
+    \brief how the imported animations are applied to their targets (default
+    is GLTF2Importer.AspectAnimations)
+ */
+
+/*!
+    \qmlproperty GLTF2Importer::automaticInstancing
+    \brief if true, meshes referenced by several static nodes are drawn with
+    a single instanced draw call (default is false)
+
+    Transformations are baked into the instances when loading: moving the
+    entities of instanced nodes has no effect on the instances.
+ */
+
+/*!
+    \qmlproperty GLTF2Importer::mergeStaticGeometry
+    \brief if true, primitives of static nodes sharing the same material are
+    merged into larger geometries drawn with a single draw call (default is
+    false)
+
+    Vertices are transformed to world space when loading: moving the entities
+    of merged nodes has no effect on the merged geometries.
+ */
+
+/*!
+    \qmlproperty GLTF2Importer::optimizeMeshes
+    \brief if true, the indexed triangles of meshes are reordered for the
+    vertex cache of the GPU and their indices stored on 16 bits whenever
+    possible (default is false)
+ */
+
+/*!
+    \qmlproperty GLTF2Importer::sceneIndex
+    \brief the index of the scene of the glTF file to instantiate, the
+    default scene of the file if negative (default is -1)
+
+    Changing the scene once the file is loaded doesn't parse it again.
+ */
+
+/*!
+    \qmlproperty GLTF2Importer::lazyMeshes
+    \brief if true, the meshes no node of the instantiated scene uses are only
+    created when first looked up in the mesh collection (default is false)
+ */
+
+/*!
+    \qmlproperty GLTF2Importer::loadStatistics
+    \brief statistics about the last loaded file, with the
+    drawCountBeforeMerging, drawCount, cacheHits and cacheMisses entries, or
+    updatedMaterials, updatedMeshes and updatedNodes after an update in place
+ */
+
 GLTF2Importer::GLTF2Importer(Qt3DCore::QNode *parent)
     : Qt3DCore::QNode(parent)
     , m_context(new Kuesa::GLTF2Context(this))
@@ -215,6 +394,12 @@ GLTF2Importer::GLTF2Importer(Qt3DCore::QNode *parent)
     , m_status(None)
     , m_sceneEntity(nullptr)
     , m_assignNames(false)
+    , m_animationMode(AspectAnimations)
+    , m_automaticInstancing(false)
+    , m_mergeStaticGeometry(false)
+    , m_optimizeMeshes(false)
+    , m_sceneIndex(-1)
+    , m_lazyMeshes(false)
 {
 }
 
@@ -320,6 +505,225 @@ void GLTF2Importer::setAssignNames(bool assignNames)
     emit assignNamesChanged(m_assignNames);
 }
 
+/*!
+ * Returns how the imported animations are applied to their targets
+ */
+GLTF2Importer::AnimationMode GLTF2Importer::animationMode() const
+{
+    return m_animationMode;
+}
+
+/*!
+ * Sets how the animations of the files loaded from now on are applied to
+ * their targets to \a animationMode.
+ */
+void GLTF2Importer::setAnimationMode(GLTF2Importer::AnimationMode animationMode)
+{
+    if (m_animationMode == animationMode)
+        return;
+
+    m_animationMode = animationMode;
+    emit animationModeChanged(m_animationMode);
+}
+
+/*!
+ * Returns \c true if meshes referenced by several nodes are instanced
+ */
+bool GLTF2Importer::automaticInstancing() const
+{
+    return m_automaticInstancing;
+}
+
+/*!
+ * If \a automaticInstancing is true, the meshes referenced by several static
+ * nodes of the files loaded from now on are drawn with a single instanced
+ * draw call.
+ */
+void GLTF2Importer::setAutomaticInstancing(bool automaticInstancing)
+{
+    if (m_automaticInstancing == automaticInstancing)
+        return;
+
+    m_automaticInstancing = automaticInstancing;
+    emit automaticInstancingChanged(m_automaticInstancing);
+}
+
+/*!
+ * Returns \c true if primitives of static nodes sharing the same material are
+ * merged
+ */
+bool GLTF2Importer::mergeStaticGeometry() const
+{
+    return m_mergeStaticGeometry;
+}
+
+/*!
+ * If \a mergeStaticGeometry is true, the primitives of the static nodes of the
+ * files loaded from now on are merged by material into larger geometries.
+ */
+void GLTF2Importer::setMergeStaticGeometry(bool mergeStaticGeometry)
+{
+    if (m_mergeStaticGeometry == mergeStaticGeometry)
+        return;
+
+    m_mergeStaticGeometry = mergeStaticGeometry;
+    emit mergeStaticGeometryChanged(m_mergeStaticGeometry);
+}
+
+/*!
+ * Returns \c true if meshes are optimized for the vertex cache of the GPU
+ */
+bool GLTF2Importer::optimizeMeshes() const
+{
+    return m_optimizeMeshes;
+}
+
+/*!
+ * If \a optimizeMeshes is true, the triangles of the files loaded from now on
+ * are reordered for the vertex cache of the GPU and their indices narrowed to
+ * 16 bits when possible.
+ */
+void GLTF2Importer::setOptimizeMeshes(bool optimizeMeshes)
+{
+    if (m_optimizeMeshes == optimizeMeshes)
+        return;
+
+    m_optimizeMeshes = optimizeMeshes;
+    emit optimizeMeshesChanged(m_optimizeMeshes);
+}
+
+/*!
+ * Returns the index of the instantiated scene of the file, or -1 for its
+ * default scene
+ */
+int GLTF2Importer::sceneIndex() const
+{
+    return m_sceneIndex;
+}
+
+/*!
+ * Instantiates the scene \a sceneIndex of the file, or its default scene if
+ * \a sceneIndex is negative. The entities of the previous scene are replaced
+ * but the assets of the file are reused.
+ */
+void GLTF2Importer::setSceneIndex(int sceneIndex)
+{
+    sceneIndex = std::max(sceneIndex, -1);
+    if (m_sceneIndex == sceneIndex)
+        return;
+
+    m_sceneIndex = sceneIndex;
+    emit sceneIndexChanged(m_sceneIndex);
+
+    // Otherwise the scene is instantiated when the file is loaded
+    if (m_root != nullptr)
+        QMetaObject::invokeMethod(this, "loadScene", Qt::QueuedConnection);
+}
+
+/*!
+ * Returns \c true if the meshes unused by the instantiated scene are created
+ * on first lookup
+ */
+bool GLTF2Importer::lazyMeshes() const
+{
+    return m_lazyMeshes;
+}
+
+/*!
+ * If \a lazyMeshes is true, the meshes of the files loaded from now on that no
+ * node of the instantiated scene uses are only created when first looked up.
+ */
+void GLTF2Importer::setLazyMeshes(bool lazyMeshes)
+{
+    if (m_lazyMeshes == lazyMeshes)
+        return;
+
+    m_lazyMeshes = lazyMeshes;
+    emit lazyMeshesChanged(m_lazyMeshes);
+}
+
+/*!
+ * Returns statistics about the last loaded file
+ */
+QVariantMap GLTF2Importer::loadStatistics() const
+{
+    return m_loadStatistics;
+}
+
+/*!
+ * Returns where the primitives of \a entity were merged when the
+ * mergeStaticGeometry property is true, as a list of maps with the following
+ * entries:
+ *
+ * \list
+ * \li mesh: the Qt3DRender::QGeometryRenderer drawing the merged geometry
+ * \li firstIndex: the position of the first index of the primitive in the
+ * index buffer of the merged geometry
+ * \li indexCount: the number of indices of the primitive
+ * \endlist
+ *
+ * The list is empty if no primitive of \a entity was merged.
+ */
+QVariantList GLTF2Importer::mergedRanges(Qt3DCore::QEntity *entity) const
+{
+    return m_mergedRanges.value(entity);
+}
+
+/*!
+ * Loads the source again, typically after it was edited.
+ *
+ * When the file only differs from the version already loaded by the
+ * properties of its materials, the transforms of its nodes or the data of its
+ * meshes, the existing materials, entities and meshes are updated in place
+ * and keep their names in the collections of the SceneEntity. This makes
+ * iterating on large assets much faster. Otherwise the file is loaded from
+ * scratch, as are files loaded with automaticInstancing or
+ * mergeStaticGeometry, whose entities don't draw the meshes of their nodes.
+ */
+void GLTF2Importer::reload()
+{
+    if (m_source.isEmpty())
+        return;
+
+    if (m_root != nullptr && !m_nodeEntities.isEmpty()) {
+        setStatus(GLTF2Importer::Status::Loading);
+
+        // Only the meshes which changed get geometries
+        GLTF2Import::GLTF2ContextPrivate updatedContext;
+        GLTF2Import::GLTF2Parser parser;
+        parser.setOptimizeMeshes(m_optimizeMeshes);
+        parser.setLazyMeshes(true);
+        parser.setContext(&updatedContext);
+
+        GLTF2Import::SceneUpdater updater(GLTF2Import::GLTF2ContextPrivate::get(m_context), m_nodeEntities, m_optimizeMeshes);
+        const bool updated = parser.parseDocument(urlToLocalFileOrQrc(m_source)) && updater.update(&updatedContext);
+
+        // The assets created for the new version are only needed while updating
+        Qt3DCore::QNode discardedAssets;
+        updatedContext.setAssetsParent(&discardedAssets);
+
+        if (updated) {
+            const GLTF2Import::SceneUpdater::Statistics statistics = updater.statistics();
+            m_loadStatistics.remove(QStringLiteral("cacheHits"));
+            m_loadStatistics.remove(QStringLiteral("cacheMisses"));
+            m_loadStatistics.insert(QStringLiteral("updatedMaterials"), statistics.materials);
+            m_loadStatistics.insert(QStringLiteral("updatedMeshes"), statistics.meshes);
+            m_loadStatistics.insert(QStringLiteral("updatedNodes"), statistics.nodes);
+            emit loadStatisticsChanged(m_loadStatistics);
+            setStatus(GLTF2Importer::Status::Ready);
+            return;
+        }
+    }
+
+    // The previous entities and assets leave the collections right away,
+    // their names are free for the new ones
+    delete m_root;
+    m_root = nullptr;
+    m_mergedRanges.clear();
+    m_nodeEntities.clear();
+    QMetaObject::invokeMethod(this, "load", Qt::QueuedConnection);
+}
+
 void GLTF2Importer::load()
 {
     setStatus(GLTF2Importer::Status::Loading);
@@ -327,14 +731,83 @@ void GLTF2Importer::load()
     const QString path = urlToLocalFileOrQrc(m_source);
 
     GLTF2Import::GLTF2Parser parser(m_sceneEntity, m_assignNames);
+    configureParser(parser);
     parser.setContext(GLTF2Import::GLTF2ContextPrivate::get(m_context));
 
     Q_ASSERT(m_root == nullptr);
-    m_root = parser.parse(path);
+    const GLTF2Import::AssetCache::Statistics cacheStatisticsBefore = GLTF2Import::AssetCache::instance()->statistics();
+    Qt3DCore::QEntity *root = parser.parse(path, m_sceneIndex);
+    const GLTF2Import::AssetCache::Statistics cacheStatisticsAfter = GLTF2Import::AssetCache::instance()->statistics();
+
+    setRoot(root, parser, cacheStatisticsAfter.hits - cacheStatisticsBefore.hits, cacheStatisticsAfter.misses - cacheStatisticsBefore.misses);
+}
+
+void GLTF2Importer::loadScene()
+{
+    // The source changed, the file is being loaded again
+    if (m_root == nullptr)
+        return;
+
+    GLTF2Import::GLTF2ContextPrivate *context = GLTF2Import::GLTF2ContextPrivate::get(m_context);
+    const int sceneIdx = m_sceneIndex < 0 ? context->defaultScene() : m_sceneIndex;
+    if (sceneIdx < 0 || sceneIdx >= context->scenesCount()) {
+        qCWarning(kuesa) << "Invalid scene reference" << m_sceneIndex;
+        setStatus(GLTF2Importer::Status::Error);
+        return;
+    }
+
+    setStatus(GLTF2Importer::Status::Loading);
+
+    // The assets of the file outlive the entities of the previous scene,
+    // which are removed from the collections right away
+    context->setAssetsParent(this);
+    delete m_root;
+    m_root = nullptr;
+    m_mergedRanges.clear();
+    m_nodeEntities.clear();
+
+    GLTF2Import::GLTF2Parser parser(m_sceneEntity, m_assignNames);
+    configureParser(parser);
+    parser.setContext(context);
+    setRoot(parser.instantiateScene(m_sceneIndex), parser, 0, 0);
+}
+
+void GLTF2Importer::configureParser(GLTF2Import::GLTF2Parser &parser) const
+{
+    parser.setTransformTrackAnimations(m_animationMode == TransformTrackAnimations);
+    parser.setAutomaticInstancing(m_automaticInstancing);
+    parser.setMergeStaticGeometry(m_mergeStaticGeometry);
+    parser.setOptimizeMeshes(m_optimizeMeshes);
+    parser.setLazyMeshes(m_lazyMeshes);
+}
+
+void GLTF2Importer::setRoot(Qt3DCore::QEntity *root, const GLTF2Import::GLTF2Parser &parser, int cacheHits, int cacheMisses)
+{
+    m_root = root;
     if (m_root) {
         m_root->setParent(this);
         if (m_sceneEntity)
             emit m_sceneEntity->loadingDone();
+
+        const auto mergedRanges = parser.mergedRanges();
+        for (auto it = mergedRanges.cbegin(), end = mergedRanges.cend(); it != end; ++it) {
+            QVariantList &ranges = m_mergedRanges[it.key()];
+            for (const GLTF2Import::MergedRange &range : it.value()) {
+                ranges.push_back(QVariantMap{ { QStringLiteral("mesh"), QVariant::fromValue(range.renderer) },
+                                              { QStringLiteral("firstIndex"), range.firstIndex },
+                                              { QStringLiteral("indexCount"), range.indexCount } });
+            }
+        }
+
+        // Entities of merged or instanced nodes can't be updated in place
+        if (!m_automaticInstancing && !m_mergeStaticGeometry)
+            m_nodeEntities = parser.nodeEntities();
+
+        m_loadStatistics = { { QStringLiteral("drawCountBeforeMerging"), parser.drawCountBeforeMerging() },
+                             { QStringLiteral("drawCount"), parser.drawCount() },
+                             { QStringLiteral("cacheHits"), cacheHits },
+                             { QStringLiteral("cacheMisses"), cacheMisses } };
+        emit loadStatisticsChanged(m_loadStatistics);
     }
 
     setStatus(m_root ? GLTF2Importer::Status::Ready : GLTF2Importer::Status::Error);
@@ -347,6 +820,8 @@ void GLTF2Importer::clear()
         m_root->deleteLater();
     }
     m_root = nullptr;
+    m_mergedRanges.clear();
+    m_nodeEntities.clear();
 }
 
 QT_END_NAMESPACE
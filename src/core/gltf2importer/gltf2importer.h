@@ -30,7 +30,8 @@
 #define KUESA_GLTF2IMPORTER_H
 
 #include <QUrl>
-#include <Qt3DCore/QNode>
+#include <QVariantMap>
+#include <Qt3DCore/QEntity>
 #include <Kuesa/kuesa_global.h>
 
 QT_BEGIN_NAMESPACE
@@ -39,6 +40,10 @@ namespace Kuesa {
 class SceneEntity;
 class GLTF2Context;
 
+namespace GLTF2Import {
+class GLTF2Parser;
+}
+
 class KUESASHARED_EXPORT GLTF2Importer : public Qt3DCore::QNode
 {
     Q_OBJECT
@@ -46,6 +51,13 @@ class KUESASHARED_EXPORT GLTF2Importer : public Qt3DCore::QNode
     Q_PROPERTY(Kuesa::GLTF2Importer::Status status READ status NOTIFY statusChanged)
     Q_PROPERTY(Kuesa::SceneEntity *sceneEntity READ sceneEntity WRITE setSceneEntity NOTIFY sceneEntityChanged)
     Q_PROPERTY(bool assignNames READ assignNames WRITE setAssignNames NOTIFY assignNamesChanged)
+    Q_PROPERTY(Kuesa::GLTF2Importer::AnimationMode animationMode READ animationMode WRITE setAnimationMode NOTIFY animationModeChanged)
+    Q_PROPERTY(bool automaticInstancing READ automaticInstancing WRITE setAutomaticInstancing NOTIFY automaticInstancingChanged)
+    Q_PROPERTY(bool mergeStaticGeometry READ mergeStaticGeometry WRITE setMergeStaticGeometry NOTIFY mergeStaticGeometryChanged)
+    Q_PROPERTY(bool optimizeMeshes READ optimizeMeshes WRITE setOptimizeMeshes NOTIFY optimizeMeshesChanged)
+    Q_PROPERTY(int sceneIndex READ sceneIndex WRITE setSceneIndex NOTIFY sceneIndexChanged)
+    Q_PROPERTY(bool lazyMeshes READ lazyMeshes WRITE setLazyMeshes NOTIFY lazyMeshesChanged)
+    Q_PROPERTY(QVariantMap loadStatistics READ loadStatistics NOTIFY loadStatisticsChanged)
 public:
     enum Status {
         None,
@@ -55,6 +67,12 @@ public:
     };
     Q_ENUM(Status)
 
+    enum AnimationMode {
+        AspectAnimations,
+        TransformTrackAnimations
+    };
+    Q_ENUM(AnimationMode)
+
     GLTF2Importer(Qt3DCore::QNode *parent = nullptr);
     ~GLTF2Importer();
 
@@ -62,23 +80,49 @@ public:
     GLTF2Importer::Status status() const;
     Kuesa::SceneEntity *sceneEntity() const;
     bool assignNames() const;
+    AnimationMode animationMode() const;
+    bool automaticInstancing() const;
+    bool mergeStaticGeometry() const;
+    bool optimizeMeshes() const;
+    int sceneIndex() const;
+    bool lazyMeshes() const;
+    QVariantMap loadStatistics() const;
+
+    Q_INVOKABLE QVariantList mergedRanges(Qt3DCore::QEntity *entity) const;
 
 public Q_SLOTS:
     void setSource(const QUrl &source);
     void setSceneEntity(Kuesa::SceneEntity *sceneEntity);
     void setAssignNames(bool assignNames);
+    void setAnimationMode(Kuesa::GLTF2Importer::AnimationMode animationMode);
+    void setAutomaticInstancing(bool automaticInstancing);
+    void setMergeStaticGeometry(bool mergeStaticGeometry);
+    void setOptimizeMeshes(bool optimizeMeshes);
+    void setSceneIndex(int sceneIndex);
+    void setLazyMeshes(bool lazyMeshes);
+    void reload();
 
 Q_SIGNALS:
     void sourceChanged(const QUrl &source);
     void statusChanged(const Kuesa::GLTF2Importer::Status status);
     void sceneEntityChanged(Kuesa::SceneEntity *sceneEntity);
     void assignNamesChanged(bool assignNames);
+    void animationModeChanged(Kuesa::GLTF2Importer::AnimationMode animationMode);
+    void automaticInstancingChanged(bool automaticInstancing);
+    void mergeStaticGeometryChanged(bool mergeStaticGeometry);
+    void optimizeMeshesChanged(bool optimizeMeshes);
+    void sceneIndexChanged(int sceneIndex);
+    void lazyMeshesChanged(bool lazyMeshes);
+    void loadStatisticsChanged(const QVariantMap &loadStatistics);
 
 private Q_SLOTS:
     void load();
+    void loadScene();
 
 private:
     void clear();
+    void configureParser(GLTF2Import::GLTF2Parser &parser) const;
+    void setRoot(Qt3DCore::QEntity *root, const GLTF2Import::GLTF2Parser &parser, int cacheHits, int cacheMisses);
     void setStatus(Status status);
 
     Kuesa::GLTF2Context *m_context;
@@ -88,6 +132,15 @@ private:
     Kuesa::SceneEntity *m_sceneEntity;
     QMetaObject::Connection m_sceneEntityDestructionConnection;
     bool m_assignNames;
+    AnimationMode m_animationMode;
+    bool m_automaticInstancing;
+    bool m_mergeStaticGeometry;
+    bool m_optimizeMeshes;
+    int m_sceneIndex;
+    bool m_lazyMeshes;
+    QVariantMap m_loadStatistics;
+    QHash<Qt3DCore::QEntity *, QVariantList> m_mergedRanges;
+    QVector<Qt3DCore::QEntity *> m_nodeEntities;
 };
 
 } // namespace Kuesa
@@ -44,7 +44,11 @@ SOURCES += \
     $$PWD/animationparser.cpp \
     $$PWD/sceneparser.cpp \
     $$PWD/materialparser.cpp \
-    $$PWD/skinparser.cpp
+    $$PWD/skinparser.cpp \
+    $$PWD/geometrymerger.cpp \
+    $$PWD/meshoptimizer.cpp \
+    $$PWD/assetcache.cpp \
+    $$PWD/sceneupdater.cpp
 
 HEADERS += \
     $$PWD/bufferparser_p.h \
@@ -64,6 +68,11 @@ HEADERS += \
     $$PWD/sceneparser_p.h \
     $$PWD/materialparser_p.h \
     $$PWD/skinparser_p.h \
+    $$PWD/geometrymerger_p.h \
+    $$PWD/geometryutils_p.h \
+    $$PWD/meshoptimizer_p.h \
+    $$PWD/assetcache_p.h \
+    $$PWD/sceneupdater_p.h \
     $$PWD/gltf2context.h
 
 qtConfig(kuesa-draco) {
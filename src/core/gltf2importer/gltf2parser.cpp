@@ -27,6 +27,7 @@
 */
 
 #include "gltf2parser_p.h"
+#include "assetcache_p.h"
 #include "kuesa_p.h"
 #include "kuesa_utils_p.h"
 #include "bufferparser_p.h"
@@ -34,6 +35,7 @@
 #include "bufferaccessorparser_p.h"
 #include "cameraparser_p.h"
 #include "meshparser_p.h"
+#include "geometryutils_p.h"
 #include "nodeparser_p.h"
 #include "sceneentity.h"
 #include "meshcollection.h"
@@ -44,12 +46,13 @@
 #include "sceneparser_p.h"
 #include "skinparser_p.h"
 #include "metallicroughnessmaterial.h"
-#include <QFile>
+#include "transformtrackanimator_p.h"
 #include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonArray>
 
 #include <functional>
+#include <limits>
 
 #include <Qt3DCore/QEntity>
 #include <Qt3DCore/QJoint>
@@ -57,8 +60,13 @@
 #include <Qt3DCore/QSkeleton>
 #include <Qt3DCore/private/qmath3d_p.h>
 #include <Qt3DRender/QCamera>
+#include <Qt3DRender/QGeometry>
 #include <Qt3DRender/QGeometryRenderer>
 #include <Qt3DRender/QLayer>
+#include <Qt3DRender/QLevelOfDetailBoundingSphere>
+#include <Qt3DRender/QLevelOfDetailSwitch>
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
 #include <Qt3DAnimation/QClipAnimator>
 #include <Qt3DAnimation/QAnimationClip>
 #include <Qt3DAnimation/QChannelMapping>
@@ -79,6 +87,9 @@ const QLatin1String KEY_SCENE = QLatin1Literal("scene");
 const QLatin1String KEY_SCENES = QLatin1Literal("scenes");
 const QLatin1String KEY_KDAB_KUESA_LAYER_EXTENSION = QLatin1String("KDAB_Kuesa_Layers");
 const QLatin1String KEY_MSFT_DDS_EXTENSION = QLatin1String("MSFT_texture_dds");
+const QLatin1String KEY_EXT_MESH_GPU_INSTANCING_EXTENSION = QLatin1String("EXT_mesh_gpu_instancing");
+const QLatin1String KEY_KHR_MESH_QUANTIZATION_EXTENSION = QLatin1String("KHR_mesh_quantization");
+const QLatin1String KEY_MSFT_LOD_EXTENSION = QLatin1String("MSFT_lod");
 const QLatin1String KEY_KUESA_LAYERS = QLatin1Literal("layers");
 const QLatin1String KEY_CAMERAS = QLatin1Literal("cameras");
 const QLatin1String KEY_IMAGES = QLatin1Literal("images");
@@ -102,6 +113,9 @@ void addToCollectionWithUniqueName(CollectionType *collection, const QString &ba
     for (int i = 1;; ++i) {
         if (!collection->contains(currentName))
             break;
+        // Assets shared by the scenes of a file are only added once
+        if (!collection->hasAssetFactory(currentName) && collection->find(currentName) == asset)
+            return;
         currentName = QString(QLatin1Literal("%1_%2")).arg(basename, QString::number(i));
     }
     collection->add(currentName, asset);
@@ -109,6 +123,25 @@ void addToCollectionWithUniqueName(CollectionType *collection, const QString &ba
         asset->setObjectName(currentName);
 }
 
+template<class CollectionType>
+void addFactoryToCollectionWithUniqueName(CollectionType *collection, const QString &basename, Qt3DCore::QNode *owner,
+                                          const AbstractAssetCollection::AssetFactory &factory)
+{
+    Q_ASSERT(!basename.isEmpty());
+    QString currentName = basename;
+    for (int i = 1;; ++i) {
+        if (!collection->contains(currentName))
+            break;
+        currentName = QString(QLatin1Literal("%1_%2")).arg(basename, QString::number(i));
+    }
+    collection->addAssetFactory(currentName, owner, [factory, currentName]() -> Qt3DCore::QNode * {
+        Qt3DCore::QNode *asset = factory();
+        if (asset != nullptr && asset->objectName().isEmpty())
+            asset->setObjectName(currentName);
+        return asset;
+    });
+}
+
 bool traverseGLTF(const QVector<KeyParserFuncPair> &parsers,
                   const QJsonObject &rootObject)
 {
@@ -145,13 +178,139 @@ void extractPositionViewDirAndUpVectorFromViewMatrix(const QMatrix4x4 viewMatrix
                          viewMatrix.row(2)[3]);
 }
 
+// Creates an attribute holding the corners of the box bounding all instances,
+// from which Qt3D computes the bounding volume of the instanced geometry
+Qt3DRender::QAttribute *createInstancesBoundsAttribute(Qt3DRender::QGeometry *geometry,
+                                                       const QVector<QMatrix4x4> &instanceMatrices,
+                                                       Qt3DCore::QNode *parent)
+{
+    Qt3DRender::QAttribute *positionAttribute = geometry->boundingVolumePositionAttribute();
+    if (positionAttribute == nullptr) {
+        const auto attributes = geometry->attributes();
+        for (Qt3DRender::QAttribute *attribute : attributes) {
+            if (attribute->name() == Qt3DRender::QAttribute::defaultPositionAttributeName()) {
+                positionAttribute = attribute;
+                break;
+            }
+        }
+    }
+
+    if (positionAttribute == nullptr)
+        return nullptr;
+
+    // Bounds of the mesh, precomputed from the accessor when possible
+    QVector3D meshMin;
+    QVector3D meshMax;
+    if (!bounds(geometry, meshMin, meshMax)) {
+        if (positionAttribute->buffer() == nullptr ||
+            positionAttribute->vertexBaseType() != Qt3DRender::QAttribute::Float || positionAttribute->vertexSize() < 3)
+            return nullptr;
+
+        const QByteArray positionData = positionAttribute->buffer()->data();
+        const int count = int(positionAttribute->count());
+        const int byteStride = positionAttribute->byteStride() > 0 ? int(positionAttribute->byteStride()) : int(positionAttribute->vertexSize() * sizeof(float));
+        const int byteOffset = int(positionAttribute->byteOffset());
+        if (count == 0 || byteOffset + (count - 1) * byteStride + int(3 * sizeof(float)) > positionData.size())
+            return nullptr;
+
+        meshMin = QVector3D(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+        meshMax = -meshMin;
+        const char *rawBytes = positionData.constData() + byteOffset;
+        for (int i = 0; i < count; ++i) {
+            float position[3];
+            memcpy(position, rawBytes, sizeof(position));
+            rawBytes += byteStride;
+            const QVector3D vertex(position[0], position[1], position[2]);
+            uniteBounds(meshMin, meshMax, vertex, vertex);
+        }
+    }
+
+    // Bounds of the transformed corners of all instances
+    QVector3D instancesMin = meshMin;
+    QVector3D instancesMax = meshMax;
+    if (!instanceMatrices.isEmpty()) {
+        instancesMin = QVector3D(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+        instancesMax = -instancesMin;
+    }
+    for (const QMatrix4x4 &instanceMatrix : instanceMatrices) {
+        QVector3D instanceMin = meshMin;
+        QVector3D instanceMax = meshMax;
+        transformBounds(instanceMatrix, instanceMin, instanceMax);
+        uniteBounds(instancesMin, instancesMax, instanceMin, instanceMax);
+    }
+
+    return createBoundsAttribute(instancesMin, instancesMax, positionAttribute->count(), parent);
+}
+
+// Creates a renderer drawing the geometry of renderer once per instance
+// matrix, using an instanceModelMatrix per instance attribute
+Qt3DRender::QGeometryRenderer *createInstancedRenderer(Qt3DRender::QGeometryRenderer *renderer,
+                                                       const QVector<QMatrix4x4> &instanceMatrices)
+{
+    Qt3DRender::QGeometry *geometry = renderer->geometry();
+    auto instancedGeometry = new Qt3DRender::QGeometry();
+
+    // Vertex attributes are shared with the original geometry
+    const auto attributes = geometry->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes)
+        instancedGeometry->addAttribute(attribute);
+
+    // QMatrix4x4 stores its data column major, as expected for mat4 attributes
+    QByteArray instanceData(instanceMatrices.size() * 16 * int(sizeof(float)), Qt::Uninitialized);
+    float *rawInstanceData = reinterpret_cast<float *>(instanceData.data());
+    for (const QMatrix4x4 &instanceMatrix : instanceMatrices) {
+        memcpy(rawInstanceData, instanceMatrix.constData(), 16 * sizeof(float));
+        rawInstanceData += 16;
+    }
+
+    auto instanceBuffer = new Qt3DRender::QBuffer(instancedGeometry);
+    instanceBuffer->setData(instanceData);
+    auto instanceAttribute = new Qt3DRender::QAttribute(instanceBuffer,
+                                                        QStringLiteral("instanceModelMatrix"),
+                                                        Qt3DRender::QAttribute::Float,
+                                                        16,
+                                                        uint(instanceMatrices.size()),
+                                                        0,
+                                                        16 * sizeof(float));
+    instanceAttribute->setDivisor(1);
+    instancedGeometry->addAttribute(instanceAttribute);
+
+    // Not added to the attributes, it is only used for frustum culling
+    Qt3DRender::QAttribute *boundsAttribute = createInstancesBoundsAttribute(geometry, instanceMatrices, instancedGeometry);
+    if (boundsAttribute != nullptr)
+        instancedGeometry->setBoundingVolumePositionAttribute(boundsAttribute);
+
+    auto instancedRenderer = new Qt3DRender::QGeometryRenderer();
+    instancedRenderer->setPrimitiveType(renderer->primitiveType());
+    instancedRenderer->setVertexCount(renderer->vertexCount());
+    instancedRenderer->setIndexOffset(renderer->indexOffset());
+    instancedRenderer->setFirstVertex(renderer->firstVertex());
+    instancedRenderer->setRestartIndexValue(renderer->restartIndexValue());
+    instancedRenderer->setPrimitiveRestartEnabled(renderer->primitiveRestartEnabled());
+    instancedRenderer->setInstanceCount(instanceMatrices.size());
+    instancedRenderer->setGeometry(instancedGeometry);
+
+    // The shared attributes must belong to the scene for Qt3D to use them
+    if (renderer->parent() == nullptr)
+        renderer->setParent(instancedRenderer);
+
+    return instancedRenderer;
+}
+
 } // namespace
 
 GLTF2Parser::GLTF2Parser(SceneEntity *sceneEntity, bool assignNames)
     : m_context(nullptr)
     , m_sceneEntity(sceneEntity)
-    , m_defaultSceneIdx(-1)
+    , m_sceneIdx(-1)
     , m_assignNames(assignNames)
+    , m_transformTrackAnimations(false)
+    , m_automaticInstancing(false)
+    , m_mergeStaticGeometry(false)
+    , m_optimizeMeshes(false)
+    , m_lazyMeshes(false)
+    , m_drawCount(0)
+    , m_drawCountBeforeMerging(0)
 {
 }
 
@@ -159,18 +318,30 @@ GLTF2Parser::~GLTF2Parser()
 {
 }
 
-Qt3DCore::QEntity *GLTF2Parser::parse(const QString &filePath)
+Qt3DCore::QEntity *GLTF2Parser::parse(const QString &filePath, int sceneIdx)
 {
-    QFile f(filePath);
-    f.open(QIODevice::ReadOnly);
-    if (!f.isOpen()) {
-        qCWarning(kuesa()) << "Can't read file" << filePath;
+    if (!parseDocument(filePath))
         return nullptr;
+    return instantiateScene(sceneIdx);
+}
+
+/*!
+ * \internal
+ *
+ * Parses the glTF file \a filePath into the context without instantiating
+ * any of its scenes.
+ */
+bool GLTF2Parser::parseDocument(const QString &filePath)
+{
+    bool readSuccess = false;
+    const QByteArray jsonData = AssetCache::instance()->fileData(filePath, readSuccess);
+    if (!readSuccess) {
+        qCWarning(kuesa()) << "Can't read file" << filePath;
+        return false;
     }
 
     QFileInfo finfo(filePath);
-    const QByteArray jsonData = f.readAll();
-    return parse(jsonData, finfo.absolutePath());
+    return parseDocument(jsonData, finfo.absolutePath());
 }
 
 template<class T>
@@ -218,7 +389,7 @@ QVector<KeyParserFuncPair> GLTF2Parser::prepareParsers()
              const QJsonArray array = value.toArray();
              if (array.size() == 0)
                  return true;
-             MeshParser parser;
+             MeshParser parser(m_optimizeMeshes, m_lazyMeshes);
              return parser.parse(array, m_context);
          } },
         { KEY_CAMERAS, [this](const QJsonValue &value) {
@@ -303,22 +474,39 @@ QVector<KeyParserFuncPair> GLTF2Parser::prepareParsers()
     };
 }
 
-Qt3DCore::QEntity *GLTF2Parser::parse(const QByteArray &jsonData, const QString &basePath)
+/*!
+ * \internal
+ *
+ * Parses the glTF document \a jsonData into the context and instantiates the
+ * scene \a sceneIdx, or the default scene of the document if \a sceneIdx is
+ * negative.
+ */
+Qt3DCore::QEntity *GLTF2Parser::parse(const QByteArray &jsonData, const QString &basePath, int sceneIdx)
+{
+    if (!parseDocument(jsonData, basePath))
+        return nullptr;
+    return instantiateScene(sceneIdx);
+}
+
+/*!
+ * \internal
+ *
+ * Parses the glTF document \a jsonData into the context without
+ * instantiating any of its scenes.
+ */
+bool GLTF2Parser::parseDocument(const QByteArray &jsonData, const QString &basePath)
 {
     QJsonDocument jsonDocument = QJsonDocument::fromJson(jsonData);
     if (jsonDocument.isNull() || !jsonDocument.isObject()) {
         qCWarning(kuesa()) << "File is not a valid json document";
-        return nullptr;
+        return false;
     }
 
     *m_context = {};
-    m_animators.clear();
-    m_treeNodes.clear();
-    m_skeletons.clear();
-    m_gltfJointIdxToSkeletonJointIdxPerSkeleton.clear();
 
     m_basePath = basePath;
     const QJsonObject rootObject = jsonDocument.object();
+    m_context->setDocument(rootObject);
 
     if (rootObject.contains(KEY_EXTENSIONS_USED) && rootObject.value(KEY_EXTENSIONS_USED).isArray()) {
         const QJsonArray extensionObjects = rootObject.value(KEY_EXTENSIONS_USED).toArray();
@@ -340,6 +528,9 @@ Qt3DCore::QEntity *GLTF2Parser::parse(const QByteArray &jsonData, const QString
         const QStringList supportedExtensions = {
             KEY_KDAB_KUESA_LAYER_EXTENSION,
             KEY_MSFT_DDS_EXTENSION,
+            KEY_EXT_MESH_GPU_INSTANCING_EXTENSION,
+            KEY_KHR_MESH_QUANTIZATION_EXTENSION,
+            KEY_MSFT_LOD_EXTENSION,
 #if defined(KUESA_DRACO_COMPRESSION)
             KEY_KHR_DRACO_MESH_COMPRESSION_EXTENSION
 #endif
@@ -353,7 +544,7 @@ Qt3DCore::QEntity *GLTF2Parser::parse(const QByteArray &jsonData, const QString
 
         if (!allRequiredAreSupported) {
             qCWarning(kuesa()) << "File contains unsupported extensions: " << unsupportedExtensions;
-            return nullptr;
+            return false;
         }
     }
 
@@ -361,18 +552,61 @@ Qt3DCore::QEntity *GLTF2Parser::parse(const QByteArray &jsonData, const QString
     const bool parsingSucceeded = traverseGLTF(topLevelParsers, rootObject);
 
     if (!parsingSucceeded)
-        return nullptr;
+        return false;
+
+    m_context->setDefaultScene(rootObject.value(KEY_SCENE).toInt(-1));
+    return true;
+}
 
-    m_defaultSceneIdx = rootObject.value(KEY_SCENE).toInt(-1);
-    if (m_defaultSceneIdx < 0 || m_defaultSceneIdx > m_context->scenesCount()) {
-        qCWarning(kuesa()) << "Invalid default scene reference";
+/*!
+ * \internal
+ *
+ * Generates the Qt3D content of the nodes reachable from the scene \a
+ * sceneIdx of the file already parsed into the context, or from its default
+ * scene if \a sceneIdx is negative. The assets of the file are shared with
+ * the scenes previously instantiated and are reparented to the returned
+ * root entity.
+ */
+Qt3DCore::QEntity *GLTF2Parser::instantiateScene(int sceneIdx)
+{
+    m_sceneIdx = sceneIdx < 0 ? m_context->defaultScene() : sceneIdx;
+    if (m_sceneIdx < 0 || m_sceneIdx >= m_context->scenesCount()) {
+        qCWarning(kuesa()) << (sceneIdx < 0 ? "Invalid default scene reference" : "Invalid scene reference");
         return nullptr;
     }
 
+    m_animators.clear();
+    m_treeNodes.clear();
+    m_skeletons.clear();
+    m_gltfJointIdxToSkeletonJointIdxPerSkeleton.clear();
+    m_mergedRanges.clear();
+    m_lodMeshNames.clear();
+    m_drawCount = 0;
+    m_drawCountBeforeMerging = 0;
+
     // Build vector of tree nodes
     for (int i = 0, m = m_context->treeNodeCount(); i < m; ++i)
         m_treeNodes.push_back(m_context->treeNode(i));
 
+    // Meshes parsed lazily and used by the scene, directly or as levels of
+    // detail, are needed now. The file may have been parsed by another parser
+    {
+        const QVector<bool> reachable = reachableNodes();
+        for (int nodeId = 0, m = m_treeNodes.size(); nodeId < m; ++nodeId) {
+            if (!reachable.at(nodeId))
+                continue;
+            QVector<int> meshNodeIndices = m_treeNodes.at(nodeId).lodNodeIndices;
+            meshNodeIndices.push_front(nodeId);
+            for (const int meshNodeId : qAsConst(meshNodeIndices)) {
+                const int meshId = meshNodeId < m_treeNodes.size() ? m_treeNodes.at(meshNodeId).meshIdx : -1;
+                if (meshId >= 0 && meshId < m_context->meshesCount() && !instantiateMesh(meshId)) {
+                    qCWarning(kuesa()) << "Failed to create mesh" << meshId;
+                    return nullptr;
+                }
+            }
+        }
+    }
+
     // Build hierarchies for Entities and QJoints
     buildEntitiesAndJointsGraph();
 
@@ -389,24 +623,59 @@ Qt3DCore::QEntity *GLTF2Parser::parse(const QByteArray &jsonData, const QString
     // existing parent on the scene root This avoid sending a destroy + created
     // changes because sceneEntity exists and has a backend while the scene root
     // has no backend
-    Qt3DCore::QEntity *gltfSceneEntity = scene(m_defaultSceneIdx);
+    Qt3DCore::QEntity *gltfSceneEntity = scene(m_sceneIdx);
+
+    // The assets are shared by the scenes of the file and the assets created
+    // for this scene only are destroyed along with it
+    m_context->setAssetsParent(gltfSceneEntity);
+    for (const AnimationDetails &animator : qAsConst(m_animators)) {
+        if (animator.clip->parent() == nullptr)
+            animator.clip->setParent(gltfSceneEntity);
+        if (animator.mapper->parent() == nullptr)
+            animator.mapper->setParent(gltfSceneEntity);
+    }
+    for (Qt3DCore::QSkeleton *skeleton : qAsConst(m_skeletons)) {
+        if (skeleton->parent() == nullptr)
+            skeleton->setParent(gltfSceneEntity);
+    }
 
     if (m_sceneEntity) {
 
         if (m_sceneEntity->meshes()) {
+            // Lazy meshes nothing uses yet are created when looked up
+            GLTF2ContextPrivate *context = m_context;
+            const bool optimizeMeshes = m_optimizeMeshes;
+            const auto addPrimitives = [=](const Mesh &mesh, int meshIdx, const QString &baseName) {
+                for (int j = 0, n = mesh.meshPrimitives.size(); j < n; ++j) {
+                    const QString name = QStringLiteral("%1_%2").arg(baseName, QString::number(j));
+                    if (mesh.meshPrimitives.at(j).primitiveRenderer != nullptr) {
+                        addToCollectionWithUniqueName(m_sceneEntity->meshes(), name, mesh.meshPrimitives.at(j).primitiveRenderer);
+                        continue;
+                    }
+                    addFactoryToCollectionWithUniqueName(m_sceneEntity->meshes(), name, gltfSceneEntity, [=]() -> Qt3DCore::QNode * {
+                        // The file was loaded again or another of its scenes instantiated
+                        if (context->assetsParent() != gltfSceneEntity)
+                            return nullptr;
+                        Mesh lazyMesh = context->mesh(meshIdx);
+                        MeshParser parser(optimizeMeshes);
+                        const bool created = parser.instantiateMesh(lazyMesh, context);
+                        context->setMesh(meshIdx, lazyMesh);
+                        context->setAssetsParent(gltfSceneEntity);
+                        return created ? lazyMesh.meshPrimitives.at(j).primitiveRenderer : nullptr;
+                    });
+                }
+            };
+
             addAssetsIntoCollection<Mesh>(
-                    [this](const Mesh &mesh, int) {
-                        for (int j = 0, n = mesh.meshPrimitives.size(); j < n; ++j) {
-                            const QString name = QStringLiteral("%1_%2").arg(mesh.name, QString::number(j));
-                            addToCollectionWithUniqueName(m_sceneEntity->meshes(), name, mesh.meshPrimitives.at(j).primitiveRenderer);
-                        }
-                    },
-                    [this](const Mesh &mesh, int) {
-                        for (int j = 0, n = mesh.meshPrimitives.size(); j < n; ++j) {
-                            const QString name = QStringLiteral("KeusaMesh_%1").arg(j);
-                            addToCollectionWithUniqueName(m_sceneEntity->meshes(), name, mesh.meshPrimitives.at(j).primitiveRenderer);
-                        }
+                    [&](const Mesh &mesh, int i) { addPrimitives(mesh, i, mesh.name); },
+                    [&](const Mesh &mesh, int i) {
+                        if (!m_lodMeshNames.contains(i))
+                            addPrimitives(mesh, i, QStringLiteral("KeusaMesh"));
                     });
+
+            // Unnamed levels of detail are named after the node using them
+            for (auto it = m_lodMeshNames.cbegin(), end = m_lodMeshNames.cend(); it != end; ++it)
+                addPrimitives(m_context->mesh(it.key()), it.key(), it.value());
         }
 
         if (m_sceneEntity->layers())
@@ -476,12 +745,16 @@ Qt3DCore::QEntity *GLTF2Parser::parse(const QByteArray &jsonData, const QString
                             addToCollectionWithUniqueName(m_sceneEntity->materials(), material.name, material.material(false));
                         if (material.hasSkinnedMaterial())
                             addToCollectionWithUniqueName(m_sceneEntity->materials(), material.name + QStringLiteral("_skinned"), material.material(true));
+                        if (material.hasInstancedMaterial())
+                            addToCollectionWithUniqueName(m_sceneEntity->materials(), material.name + QStringLiteral("_instanced"), material.instancedMaterial());
                     },
                     [this](const Material &material, int i) {
                         if (material.hasRegularMaterial())
                             addToCollectionWithUniqueName(m_sceneEntity->materials(), QStringLiteral("KuesaMaterial_%1").arg(i), material.material(false));
                         if (material.hasSkinnedMaterial())
                             addToCollectionWithUniqueName(m_sceneEntity->materials(), QStringLiteral("KuesaMaterial_%1_skinned").arg(i), material.material(true));
+                        if (material.hasInstancedMaterial())
+                            addToCollectionWithUniqueName(m_sceneEntity->materials(), QStringLiteral("KuesaMaterial_%1_instanced").arg(i), material.instancedMaterial());
                     });
 
         if (m_sceneEntity->skeletons())
@@ -502,6 +775,108 @@ const GLTF2ContextPrivate *GLTF2Parser::context() const
     return m_context;
 }
 
+/*!
+ * \internal
+ *
+ * Animations drive the transforms of the nodes directly rather than through
+ * Qt3D channel mappings when \a transformTrackAnimations is true.
+ */
+void GLTF2Parser::setTransformTrackAnimations(bool transformTrackAnimations)
+{
+    m_transformTrackAnimations = transformTrackAnimations;
+}
+
+/*!
+ * \internal
+ *
+ * Static nodes sharing a mesh and a material are drawn as instances when
+ * \a automaticInstancing is true.
+ */
+void GLTF2Parser::setAutomaticInstancing(bool automaticInstancing)
+{
+    m_automaticInstancing = automaticInstancing;
+}
+
+/*!
+ * \internal
+ *
+ * The primitives of static nodes sharing a material are merged into a single
+ * geometry when \a mergeStaticGeometry is true.
+ */
+void GLTF2Parser::setMergeStaticGeometry(bool mergeStaticGeometry)
+{
+    m_mergeStaticGeometry = mergeStaticGeometry;
+}
+
+/*!
+ * \internal
+ *
+ * Indices and vertices are reordered for the vertex cache when
+ * \a optimizeMeshes is true.
+ */
+void GLTF2Parser::setOptimizeMeshes(bool optimizeMeshes)
+{
+    m_optimizeMeshes = optimizeMeshes;
+}
+
+/*!
+ * \internal
+ *
+ * Meshes are only created when first looked up in the scene entity when
+ * \a lazyMeshes is true.
+ */
+void GLTF2Parser::setLazyMeshes(bool lazyMeshes)
+{
+    m_lazyMeshes = lazyMeshes;
+}
+
+/*!
+ * \internal
+ *
+ * Returns the number of draw calls of the last parsed scene.
+ */
+int GLTF2Parser::drawCount() const
+{
+    return m_drawCount;
+}
+
+/*!
+ * \internal
+ *
+ * Returns the number of draw calls the last parsed scene would have needed
+ * without instancing nor merging, that is one per primitive of each node.
+ */
+int GLTF2Parser::drawCountBeforeMerging() const
+{
+    return m_drawCountBeforeMerging;
+}
+
+/*!
+ * \internal
+ *
+ * Returns, for the entities of the nodes whose primitives were merged, where
+ * the indices of these primitives are in the merged geometries.
+ */
+/*!
+ * \internal
+ *
+ * Returns the entity created for each node of the file by the last
+ * instantiated scene, nullptr for the nodes which got none.
+ */
+QVector<Qt3DCore::QEntity *> GLTF2Parser::nodeEntities() const
+{
+    QVector<Qt3DCore::QEntity *> entities;
+    entities.reserve(m_treeNodes.size());
+    for (const TreeNode &node : m_treeNodes)
+        entities.push_back(node.entity);
+    return entities;
+}
+
+QHash<Qt3DCore::QEntity *, QVector<MergedRange>> GLTF2Parser::mergedRanges() const
+{
+    return m_mergedRanges;
+}
+
 void GLTF2Parser::buildEntitiesAndJointsGraph()
 {
     const int nbNodes = m_context->treeNodeCount();
@@ -531,11 +906,16 @@ void GLTF2Parser::buildEntitiesAndJointsGraph()
                 childHierarchyNode->parent = hierarchyNode;
                 hierarchyNode->children.push_back(childHierarchyNode);
             }
-        } else { // We have a leaf node
-            leafNodes.push_back(hierarchyNode);
         }
     }
 
+    // Only the leaves reachable from the scene roots get entities
+    const QVector<bool> reachable = reachableNodes();
+    for (int nodeId = 0; nodeId < nbNodes; ++nodeId) {
+        if (reachable.at(nodeId) && tree.at(nodeId).children.isEmpty())
+            leafNodes.push_back(tree.data() + nodeId);
+    }
+
     // Traverse branches from leaves to roots and create QEntity
     for (HierarchyNode *leaf : leafNodes) {
         Qt3DCore::QEntity *lastChild = nullptr;
@@ -600,14 +980,363 @@ void GLTF2Parser::buildJointHierarchy(const HierarchyNode *node, int &jointAcces
     }
 }
 
+/*!
+ * \internal
+ *
+ * Returns which nodes are reachable from the roots of the instantiated scene.
+ */
+QVector<bool> GLTF2Parser::reachableNodes() const
+{
+    QVector<bool> reachable(m_treeNodes.size(), false);
+    QVector<int> toVisit = m_context->scene(m_sceneIdx).rootNodeIndices;
+    while (!toVisit.isEmpty()) {
+        const int nodeId = toVisit.takeLast();
+        if (nodeId < 0 || nodeId >= reachable.size() || reachable.at(nodeId))
+            continue;
+        reachable[nodeId] = true;
+        toVisit += m_treeNodes.at(nodeId).childrenIndices;
+    }
+    return reachable;
+}
+
+/*!
+ * \internal
+ *
+ * Creates the primitives of the mesh \a meshIdx if it was parsed lazily and
+ * they weren't created yet.
+ */
+bool GLTF2Parser::instantiateMesh(int meshIdx)
+{
+    Mesh mesh = m_context->mesh(meshIdx);
+    MeshParser parser(m_optimizeMeshes);
+    const bool created = parser.instantiateMesh(mesh, m_context);
+    m_context->setMesh(meshIdx, mesh);
+    return created;
+}
+
+/*!
+ * \internal
+ *
+ * Returns the static nodes of the instantiated scene with a mesh, in depth first
+ * order, along with their world matrices and the layers affecting them.
+ * Static nodes aren't skinned, instanced through EXT_mesh_gpu_instancing,
+ * switching between levels of detail nor animated, and neither are their
+ * ancestors.
+ */
+QVector<GLTF2Parser::StaticNode> GLTF2Parser::gatherStaticNodes() const
+{
+    // Animated transforms can't be baked into instances or merged geometries
+    QVector<bool> animatedNodes(m_treeNodes.size(), false);
+    for (int animationId = 0, m = m_context->animationsCount(); animationId < m; ++animationId) {
+        const Animation animation = m_context->animation(animationId);
+        for (const ChannelMapping &mapping : animation.mappings) {
+            if (mapping.targetNodeId >= 0 && mapping.targetNodeId < animatedNodes.size())
+                animatedNodes[mapping.targetNodeId] = true;
+        }
+    }
+
+    struct NodeState {
+        int nodeIdx;
+        QMatrix4x4 parentMatrix;
+        QVector<int> layerIndices;
+        bool animated;
+    };
+
+    QVector<NodeState> toVisit;
+    const QVector<int> rootNodeIndices = m_context->scene(m_sceneIdx).rootNodeIndices;
+    for (auto it = rootNodeIndices.crbegin(); it != rootNodeIndices.crend(); ++it)
+        toVisit.push_back({ *it, QMatrix4x4(), {}, false });
+
+    QVector<bool> visitedNodes(m_treeNodes.size(), false);
+    QVector<StaticNode> staticNodes;
+
+    // Walk the scene depth first, in order
+    while (!toVisit.isEmpty()) {
+        const NodeState state = toVisit.takeLast();
+        if (state.nodeIdx < 0 || state.nodeIdx >= m_treeNodes.size() || visitedNodes.at(state.nodeIdx))
+            continue;
+        visitedNodes[state.nodeIdx] = true;
+
+        const TreeNode &node = m_treeNodes.at(state.nodeIdx);
+        const QMatrix4x4 worldMatrix = state.parentMatrix * node.localMatrix();
+        const bool animated = state.animated || animatedNodes.at(state.nodeIdx);
+        QVector<int> layerIndices = state.layerIndices;
+        for (const int layerId : node.layerIndices) {
+            if (layerId >= 0 && layerId < m_context->layersCount() && !layerIndices.contains(layerId))
+                layerIndices.push_back(layerId);
+        }
+        std::sort(layerIndices.begin(), layerIndices.end());
+
+        const bool isStatic = !animated && node.entity != nullptr && node.cameraIdx < 0 && node.skinIdx < 0 &&
+                node.instanceMatrices.isEmpty() && node.lodNodeIndices.isEmpty() && node.meshIdx >= 0 && node.meshIdx < m_context->meshesCount();
+        if (isStatic)
+            staticNodes.push_back({ state.nodeIdx, worldMatrix, layerIndices });
+
+        for (auto it = node.childrenIndices.crbegin(); it != node.childrenIndices.crend(); ++it)
+            toVisit.push_back({ *it, worldMatrix, layerIndices, animated });
+    }
+
+    return staticNodes;
+}
+
+/*!
+ * \internal
+ *
+ * Groups the static nodes referencing the same mesh and affected by the same
+ * layers, along with their world matrices. Meshes referenced by a single node
+ * are left out.
+ */
+QVector<GLTF2Parser::InstancedMesh> GLTF2Parser::gatherInstancedMeshes(const QVector<StaticNode> &staticNodes) const
+{
+    QVector<InstancedMesh> instancedMeshes;
+    QHash<QPair<int, QVector<int>>, int> instancedMeshForKey;
+
+    for (const StaticNode &staticNode : staticNodes) {
+        const int meshIdx = m_treeNodes.at(staticNode.nodeIdx).meshIdx;
+        const QPair<int, QVector<int>> key(meshIdx, staticNode.layerIndices);
+        auto it = instancedMeshForKey.find(key);
+        if (it == instancedMeshForKey.end()) {
+            it = instancedMeshForKey.insert(key, instancedMeshes.size());
+            InstancedMesh instancedMesh;
+            instancedMesh.meshIdx = meshIdx;
+            instancedMesh.layerIndices = staticNode.layerIndices;
+            instancedMeshes.push_back(instancedMesh);
+        }
+        InstancedMesh &instancedMesh = instancedMeshes[it.value()];
+        instancedMesh.nodeIndices.push_back(staticNode.nodeIdx);
+        instancedMesh.instanceMatrices.push_back(staticNode.worldMatrix);
+    }
+
+    instancedMeshes.erase(std::remove_if(instancedMeshes.begin(), instancedMeshes.end(),
+                                         [](const InstancedMesh &instancedMesh) { return instancedMesh.nodeIndices.size() < 2; }),
+                          instancedMeshes.end());
+    return instancedMeshes;
+}
+
+/*!
+ * \internal
+ *
+ * Merges the primitives of the static nodes which aren't instanced, sharing
+ * the same material, vertex layout and layers, into world space geometries.
+ * The merged primitives are added to \a mergedPrimitives as pairs of node and
+ * primitive indices.
+ */
+QVector<GLTF2Parser::MergedGeometry> GLTF2Parser::mergeStaticPrimitives(const QVector<StaticNode> &staticNodes,
+                                                                         const QVector<bool> &instancedNodes,
+                                                                         QSet<QPair<int, int>> &mergedPrimitives)
+{
+    struct MergeCandidate {
+        int staticNodeIdx;
+        int primitiveIdx;
+    };
+
+    // Primitives are grouped by layout, then by material and layers
+    QVector<QVector<MergeCandidate>> candidateGroups;
+    QHash<QPair<QByteArray, QVector<int>>, int> candidateGroupForKey;
+
+    for (int staticNodeIdx = 0, m = staticNodes.size(); staticNodeIdx < m; ++staticNodeIdx) {
+        const StaticNode &staticNode = staticNodes.at(staticNodeIdx);
+        if (instancedNodes.at(staticNode.nodeIdx))
+            continue;
+
+        const Mesh meshData = m_context->mesh(m_treeNodes.at(staticNode.nodeIdx).meshIdx);
+        for (int primitiveIdx = 0, n = meshData.meshPrimitives.size(); primitiveIdx < n; ++primitiveIdx) {
+            const Primitive &primitiveData = meshData.meshPrimitives.at(primitiveIdx);
+            const QByteArray signature = GeometryMerger::layoutSignature(primitiveData.primitiveRenderer);
+            if (signature.isEmpty())
+                continue;
+
+            const QPair<QByteArray, QVector<int>> key(signature,
+                                                      QVector<int>{ primitiveData.materialIdx, primitiveData.hasColorAttr } + staticNode.layerIndices);
+            auto it = candidateGroupForKey.find(key);
+            if (it == candidateGroupForKey.end()) {
+                it = candidateGroupForKey.insert(key, candidateGroups.size());
+                candidateGroups.push_back({});
+            }
+            candidateGroups[it.value()].push_back({ staticNodeIdx, primitiveIdx });
+        }
+    }
+
+    QVector<MergedGeometry> mergedGeometries;
+    for (const QVector<MergeCandidate> &candidates : qAsConst(candidateGroups)) {
+        // Merging a lone primitive doesn't save any draw call
+        if (candidates.size() < 2)
+            continue;
+
+        GeometryMerger merger;
+        QVector<QPair<int, MergedRange>> nodeRanges;
+        QVector3D mergedMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+        QVector3D mergedMax = -mergedMin;
+        bool hasMergedBounds = true;
+        for (const MergeCandidate &candidate : candidates) {
+            const StaticNode &staticNode = staticNodes.at(candidate.staticNodeIdx);
+            const Mesh meshData = m_context->mesh(m_treeNodes.at(staticNode.nodeIdx).meshIdx);
+            Qt3DRender::QGeometryRenderer *primitiveRenderer = meshData.meshPrimitives.at(candidate.primitiveIdx).primitiveRenderer;
+            MergedRange range;
+            if (merger.append(primitiveRenderer, staticNode.worldMatrix, &range)) {
+                mergedPrimitives.insert({ staticNode.nodeIdx, candidate.primitiveIdx });
+                nodeRanges.push_back({ staticNode.nodeIdx, range });
+
+                QVector3D primitiveMin;
+                QVector3D primitiveMax;
+                hasMergedBounds &= bounds(primitiveRenderer->geometry(), primitiveMin, primitiveMax);
+                transformBounds(staticNode.worldMatrix, primitiveMin, primitiveMax);
+                uniteBounds(mergedMin, mergedMax, primitiveMin, primitiveMax);
+            }
+        }
+
+        Qt3DRender::QGeometryRenderer *renderer = merger.createRenderer();
+        if (renderer == nullptr)
+            continue;
+        if (hasMergedBounds)
+            setBounds(renderer->geometry(), mergedMin, mergedMax);
+
+        for (QPair<int, MergedRange> &nodeRange : nodeRanges) {
+            nodeRange.second.renderer = renderer;
+            m_mergedRanges[m_treeNodes.at(nodeRange.first).entity].push_back(nodeRange.second);
+        }
+
+        const StaticNode &firstNode = staticNodes.at(candidates.first().staticNodeIdx);
+        MergedGeometry mergedGeometry;
+        mergedGeometry.renderer = renderer;
+        mergedGeometry.primitive = m_context->mesh(m_treeNodes.at(firstNode.nodeIdx).meshIdx).meshPrimitives.at(candidates.first().primitiveIdx);
+        mergedGeometry.layerIndices = firstNode.layerIndices;
+        mergedGeometries.push_back(mergedGeometry);
+    }
+
+    return mergedGeometries;
+}
+
 void GLTF2Parser::generateTreeNodeContent()
 {
     Qt3DCore::QComponent *defaultMaterial = nullptr;
     Qt3DCore::QComponent *defaultSkinnedMaterial = nullptr;
+    Qt3DCore::QComponent *defaultInstancedMaterial = nullptr;
     m_sceneRootEntity = new Qt3DCore::QEntity();
     m_sceneRootEntity->setObjectName(QStringLiteral("GLTF2Scene"));
 
-    for (TreeNode &node : m_treeNodes) {
+    const auto primitiveMaterial = [&](const Primitive &primitiveData, bool isSkinned, bool isInstanced) -> Qt3DCore::QComponent * {
+        const qint32 materialId = primitiveData.materialIdx;
+        if (materialId >= 0 && materialId < m_context->materialsCount()) {
+            Material &mat = m_context->material(materialId);
+            // Get or create Qt3D for material
+            if (isInstanced)
+                return mat.instancedMaterial(primitiveData.hasColorAttr, m_context);
+            return mat.material(isSkinned, primitiveData.hasColorAttr, m_context);
+        }
+
+        // Only create defaultMaterial if we know we need it
+        // otherwise we might leak it
+        Qt3DCore::QComponent *&cachedMaterial = isInstanced ? defaultInstancedMaterial : (isSkinned ? defaultSkinnedMaterial : defaultMaterial);
+        if (!cachedMaterial) {
+            MetallicRoughnessMaterial *material = new MetallicRoughnessMaterial;
+            material->setUseSkinning(isSkinned);
+            material->setUseInstancing(isInstanced);
+            cachedMaterial = material;
+        }
+        return cachedMaterial;
+    };
+
+    // Generate one Entity per primitive, drawing all instances
+    const auto addInstancedPrimitives = [&](const Mesh &meshData, const QVector<QMatrix4x4> &instanceMatrices, Qt3DCore::QEntity *parent) {
+        for (const Primitive &primitiveData : meshData.meshPrimitives) {
+            Qt3DCore::QEntity *primitiveEntity = new Qt3DCore::QEntity();
+            QVector<QMatrix4x4> primitiveInstanceMatrices = instanceMatrices;
+            if (!primitiveData.positionDequantization.isIdentity()) {
+                for (QMatrix4x4 &instanceMatrix : primitiveInstanceMatrices)
+                    instanceMatrix *= primitiveData.positionDequantization;
+            }
+            primitiveEntity->addComponent(createInstancedRenderer(primitiveData.primitiveRenderer, primitiveInstanceMatrices));
+            primitiveEntity->addComponent(primitiveMaterial(primitiveData, false, true));
+            primitiveEntity->setParent(parent);
+            ++m_drawCount;
+        }
+    };
+
+    // Generate one Entity per primitive (1 primitive == 1 geometry renderer)
+    const auto createPrimitiveEntity = [&](const Primitive &primitiveData, bool isSkinned) {
+        Qt3DCore::QEntity *primitiveEntity = new Qt3DCore::QEntity();
+        primitiveEntity->addComponent(primitiveData.primitiveRenderer);
+
+        // KHR_mesh_quantization
+        if (!primitiveData.positionDequantization.isIdentity()) {
+            auto *dequantization = new Qt3DCore::QTransform();
+            dequantization->setMatrix(primitiveData.positionDequantization);
+            primitiveEntity->addComponent(dequantization);
+        }
+
+        // Add material for mesh
+        primitiveEntity->addComponent(primitiveMaterial(primitiveData, isSkinned, false));
+        return primitiveEntity;
+    };
+
+    // MSFT_lod, the levels are children of an entity switching between them,
+    // followed by an empty one used to cull the node. Returns the entity of
+    // the first level, which draws the mesh of the node itself.
+    const auto addLevelsOfDetail = [&](const TreeNode &node, Qt3DCore::QEntity *entity) {
+        Qt3DCore::QEntity *lodEntity = new Qt3DCore::QEntity(entity);
+        auto lodSwitch = new Qt3DRender::QLevelOfDetailSwitch();
+        // Thresholds are computed from the screen coverages by the SceneEntity
+        // once it knows the camera
+        lodSwitch->setThresholdType(Qt3DRender::QLevelOfDetail::DistanceToCameraThreshold);
+        lodSwitch->setProperty("screenCoverages", QVariant::fromValue(node.lodScreenCoverages));
+
+        QVector3D boundsMin;
+        QVector3D boundsMax;
+        if (bounds(entity, boundsMin, boundsMax))
+            lodSwitch->setVolumeOverride(Qt3DRender::QLevelOfDetailBoundingSphere(0.5f * (boundsMin + boundsMax),
+                                                                                  0.5f * (boundsMax - boundsMin).length()));
+        lodEntity->addComponent(lodSwitch);
+
+        Qt3DCore::QEntity *nodeLevelEntity = new Qt3DCore::QEntity(lodEntity);
+        for (int level = 1, m = node.lodNodeIndices.size(); level <= m; ++level) {
+            Qt3DCore::QEntity *levelEntity = new Qt3DCore::QEntity(lodEntity);
+            levelEntity->setEnabled(false);
+
+            const int lodNodeId = node.lodNodeIndices.at(level - 1);
+            const int lodMeshId = lodNodeId < m_treeNodes.size() ? m_treeNodes.at(lodNodeId).meshIdx : -1;
+            if (lodMeshId < 0 || lodMeshId >= m_context->meshesCount()) {
+                qCWarning(kuesa) << "Level of detail" << level << "of node" << node.name << "has no mesh";
+                continue;
+            }
+
+            const Mesh &lodMeshData = m_context->mesh(lodMeshId);
+            if (lodMeshData.name.isEmpty() && !node.name.isEmpty() && !m_lodMeshNames.contains(lodMeshId))
+                m_lodMeshNames.insert(lodMeshId, QStringLiteral("%1_lod%2").arg(node.name, QString::number(level)));
+            for (const Primitive &primitiveData : lodMeshData.meshPrimitives)
+                createPrimitiveEntity(primitiveData, false)->setParent(levelEntity);
+        }
+
+        Qt3DCore::QEntity *culledEntity = new Qt3DCore::QEntity(lodEntity);
+        culledEntity->setEnabled(false);
+        return nodeLevelEntity;
+    };
+
+    // Nodes only used as levels of detail are drawn by the nodes referencing them
+    QVector<bool> lodLevelNodes(m_treeNodes.size(), false);
+    for (const TreeNode &node : qAsConst(m_treeNodes)) {
+        for (const int lodNodeId : node.lodNodeIndices) {
+            if (lodNodeId < lodLevelNodes.size())
+                lodLevelNodes[lodNodeId] = true;
+        }
+    }
+
+    const QVector<StaticNode> staticNodes = (m_automaticInstancing || m_mergeStaticGeometry) ? gatherStaticNodes() : QVector<StaticNode>();
+
+    // Nodes drawn by an instanced mesh get no primitive entities of their own
+    const QVector<InstancedMesh> instancedMeshes = m_automaticInstancing ? gatherInstancedMeshes(staticNodes) : QVector<InstancedMesh>();
+    QVector<bool> instancedNodes(m_treeNodes.size(), false);
+    for (const InstancedMesh &instancedMesh : instancedMeshes) {
+        for (const int nodeId : instancedMesh.nodeIndices)
+            instancedNodes[nodeId] = true;
+    }
+
+    // Neither do the primitives merged with others
+    QSet<QPair<int, int>> mergedPrimitives;
+    const QVector<MergedGeometry> mergedGeometries = m_mergeStaticGeometry ? mergeStaticPrimitives(staticNodes, instancedNodes, mergedPrimitives) : QVector<MergedGeometry>();
+
+    for (int nodeId = 0, m = m_treeNodes.size(); nodeId < m; ++nodeId) {
+        TreeNode &node = m_treeNodes[nodeId];
         // Build Entity Content
         if (node.entity) {
             Qt3DCore::QEntity *entity = node.entity;
@@ -679,7 +1408,9 @@ void GLTF2Parser::generateTreeNodeContent()
 
             // If the node has a mesh, add it
             const qint32 meshId = node.meshIdx;
-            if (meshId >= 0 && meshId < m_context->meshesCount()) {
+            if (meshId >= 0 && meshId < m_context->meshesCount())
+                m_drawCountBeforeMerging += m_context->mesh(meshId).meshPrimitives.size();
+            if (meshId >= 0 && meshId < m_context->meshesCount() && !instancedNodes.at(nodeId) && !lodLevelNodes.at(nodeId)) {
                 const qint32 skinId = node.skinIdx;
                 const Mesh &meshData = m_context->mesh(meshId);
                 const bool isSkinned = skinId >= 0 && skinId < m_context->skinsCount();
@@ -713,6 +1444,11 @@ void GLTF2Parser::generateTreeNodeContent()
                                 continue;
                             }
 
+                            // Meshes are shared by the nodes and the scenes using them
+                            if (jointIndicesAttr->property("jointIndicesRemapped").toBool())
+                                continue;
+                            jointIndicesAttr->setProperty("jointIndicesRemapped", true);
+
                             switch (jointIndicesAttr->vertexBaseType()) {
                             case Qt3DRender::QAttribute::UnsignedByte:
                                 updateDataForJointsAttr<unsigned char>(jointIndicesAttr, skinId);
@@ -730,52 +1466,61 @@ void GLTF2Parser::generateTreeNodeContent()
                     }
                 }
 
-                // Generate one Entity per primitive (1 primitive == 1 geometry renderer)
-                for (Primitive primitiveData : meshData.meshPrimitives) {
-                    Qt3DCore::QEntity *primitiveEntity = new Qt3DCore::QEntity();
-                    primitiveEntity->addComponent(primitiveData.primitiveRenderer);
-
-                    // Add material for mesh
-                    {
-                        Qt3DCore::QComponent *material = nullptr;
-                        const qint32 materialId = primitiveData.materialIdx;
-                        if (materialId >= 0 && materialId < m_context->materialsCount()) {
-                            Material &mat = m_context->material(materialId);
-                            // Get or create Qt3D for material
-                            material = mat.material(isSkinned, primitiveData.hasColorAttr, m_context);
-                        } else {
-                            // Only create defaultMaterial if we know we need it
-                            // otherwise we might leak it
-                            if (isSkinned) {
-                                if (!defaultSkinnedMaterial) {
-                                    MetallicRoughnessMaterial *material = new MetallicRoughnessMaterial;
-                                    material->setUseSkinning(true);
-                                    defaultSkinnedMaterial = material;
-                                }
-                                material = defaultSkinnedMaterial;
-                            } else {
-                                if (!defaultMaterial) {
-                                    MetallicRoughnessMaterial *material = new MetallicRoughnessMaterial;
-                                    material->setUseSkinning(false);
-                                    defaultMaterial = material;
-                                }
-                                material = defaultMaterial;
-                            }
+                // EXT_mesh_gpu_instancing
+                const bool isInstanced = !node.instanceMatrices.isEmpty();
+                if (isInstanced && isSkinned)
+                    qCWarning(kuesa, "Instancing isn't supported for skinned meshes, ignoring instances");
+
+                // Bounds of the content of the node, in its space
+                QVector3D boundsMin;
+                QVector3D boundsMax;
+                if (!isSkinned && meshData.bounds(boundsMin, boundsMax)) {
+                    if (isInstanced) {
+                        const QVector3D meshMin = boundsMin;
+                        const QVector3D meshMax = boundsMax;
+                        boundsMin = QVector3D(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+                        boundsMax = -boundsMin;
+                        for (const QMatrix4x4 &instanceMatrix : qAsConst(node.instanceMatrices)) {
+                            QVector3D instanceMin = meshMin;
+                            QVector3D instanceMax = meshMax;
+                            transformBounds(instanceMatrix, instanceMin, instanceMax);
+                            uniteBounds(boundsMin, boundsMax, instanceMin, instanceMax);
                         }
-                        primitiveEntity->addComponent(material);
                     }
+                    setBounds(entity, boundsMin, boundsMax);
+                }
 
-                    // Add armature if it is not null
-                    if (armature != nullptr) {
-                        primitiveEntity->addComponent(armature);
-                        // We set the parent to the skeleton root's transform
-                        // (in other words, our parent is the entity that
-                        // corresponds to the node to which the root joint is
-                        // assigned)
-                        primitiveEntity->setParent(skinRootJointEntity->parentEntity() ? skinRootJointEntity->parentEntity() : m_sceneRootEntity);
-                    } else {
-                        // We set the parent to entity so that transform is applied
-                        primitiveEntity->setParent(entity);
+                const bool hasLevelsOfDetail = !node.lodNodeIndices.isEmpty();
+                if (hasLevelsOfDetail && (isSkinned || isInstanced))
+                    qCWarning(kuesa, "Levels of detail aren't supported for skinned or instanced meshes, ignoring them");
+
+                if (isInstanced && !isSkinned) {
+                    addInstancedPrimitives(meshData, node.instanceMatrices, entity);
+                } else {
+                    Qt3DCore::QEntity *primitivesParent = entity;
+                    if (hasLevelsOfDetail && !isSkinned)
+                        primitivesParent = addLevelsOfDetail(node, entity);
+
+                    for (int primitiveId = 0, n = meshData.meshPrimitives.size(); primitiveId < n; ++primitiveId) {
+                        if (mergedPrimitives.contains({ nodeId, primitiveId }))
+                            continue;
+
+                        const Primitive &primitiveData = meshData.meshPrimitives.at(primitiveId);
+                        Qt3DCore::QEntity *primitiveEntity = createPrimitiveEntity(primitiveData, isSkinned);
+
+                        // Add armature if it is not null
+                        if (armature != nullptr) {
+                            primitiveEntity->addComponent(armature);
+                            // We set the parent to the skeleton root's transform
+                            // (in other words, our parent is the entity that
+                            // corresponds to the node to which the root joint is
+                            // assigned)
+                            primitiveEntity->setParent(skinRootJointEntity->parentEntity() ? skinRootJointEntity->parentEntity() : m_sceneRootEntity);
+                        } else {
+                            // We set the parent to entity so that transform is applied
+                            primitiveEntity->setParent(primitivesParent);
+                        }
+                        ++m_drawCount;
                     }
                 }
             }
@@ -806,6 +1551,37 @@ void GLTF2Parser::generateTreeNodeContent()
             }
         }
     }
+
+    // Draw meshes shared by several static nodes in a single call
+    for (const InstancedMesh &instancedMesh : instancedMeshes) {
+        // Instance matrices are world matrices
+        Qt3DCore::QEntity *instancesEntity = new Qt3DCore::QEntity(m_sceneRootEntity);
+
+        // Layers were applied recursively by the nodes
+        for (const int layerId : instancedMesh.layerIndices) {
+            const Layer layer = m_context->layer(layerId);
+            if (layer.layer)
+                instancesEntity->addComponent(layer.layer);
+        }
+
+        addInstancedPrimitives(m_context->mesh(instancedMesh.meshIdx), instancedMesh.instanceMatrices, instancesEntity);
+    }
+
+    // Draw primitives merged together in a single call
+    for (const MergedGeometry &mergedGeometry : mergedGeometries) {
+        // Merged geometries are in world space
+        Qt3DCore::QEntity *mergedEntity = new Qt3DCore::QEntity(m_sceneRootEntity);
+
+        for (const int layerId : mergedGeometry.layerIndices) {
+            const Layer layer = m_context->layer(layerId);
+            if (layer.layer)
+                mergedEntity->addComponent(layer.layer);
+        }
+
+        mergedEntity->addComponent(mergedGeometry.renderer);
+        mergedEntity->addComponent(primitiveMaterial(mergedGeometry.primitive, false, false));
+        ++m_drawCount;
+    }
 }
 
 void GLTF2Parser::generateSkeletonContent()
@@ -829,9 +1605,9 @@ void GLTF2Parser::generateSkeletonContent()
         int rootJointId = skin.skeletonIdx;
         if (rootJointId < 0) {
             // Use the scene's root
-            const Scene defaultScene = m_context->scene(m_defaultSceneIdx);
+            const Scene scene = m_context->scene(m_sceneIdx);
             // Find first root node of type Joint
-            const QVector<int> rootNodeIndices = defaultScene.rootNodeIndices;
+            const QVector<int> rootNodeIndices = scene.rootNodeIndices;
             rootJointId = rootNodeIndices.first();
         }
 
@@ -848,7 +1624,7 @@ void GLTF2Parser::generateAnimationContent()
     for (int animationId = 0, m = m_context->animationsCount(); animationId < m; ++animationId) {
         Animation animation = m_context->animation(animationId);
 
-        auto *channelMapper = new Qt3DAnimation::QChannelMapper();
+        auto *channelMapper = m_transformTrackAnimations ? new TransformTrackMapper() : new Qt3DAnimation::QChannelMapper();
         auto *clip = new Qt3DAnimation::QAnimationClip();
         clip->setClipData(animation.clipData);
         m_animators.push_back({ clip, channelMapper });
@@ -892,7 +1668,7 @@ void GLTF2Parser::generateAnimationContent()
 
 Qt3DCore::QEntity *GLTF2Parser::scene(const int id)
 {
-    if (id < 0 || id > m_context->scenesCount())
+    if (id < 0 || id >= m_context->scenesCount())
         return nullptr;
 
     const Scene scene = m_context->scene(id);
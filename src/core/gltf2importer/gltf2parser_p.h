@@ -40,7 +40,9 @@
 #include <QtCore/qglobal.h>
 #include <QtCore/QString>
 #include <QtCore/QByteArray>
+#include <QtCore/QSet>
 #include <Kuesa/private/gltf2context_p.h>
+#include <Kuesa/private/geometrymerger_p.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -80,15 +82,55 @@ public:
     virtual ~GLTF2Parser();
 
     virtual QVector<KeyParserFuncPair> prepareParsers();
-    Qt3DCore::QEntity *parse(const QString &filePath);
-    Qt3DCore::QEntity *parse(const QByteArray &jsonData, const QString &basePath);
+    Qt3DCore::QEntity *parse(const QString &filePath, int sceneIdx = -1);
+    Qt3DCore::QEntity *parse(const QByteArray &jsonData, const QString &basePath, int sceneIdx = -1);
+    bool parseDocument(const QString &filePath);
+    bool parseDocument(const QByteArray &jsonData, const QString &basePath);
+    Qt3DCore::QEntity *instantiateScene(int sceneIdx = -1);
 
     void setContext(GLTF2ContextPrivate *);
     const GLTF2ContextPrivate *context() const;
 
+    void setTransformTrackAnimations(bool transformTrackAnimations);
+    void setAutomaticInstancing(bool automaticInstancing);
+    void setMergeStaticGeometry(bool mergeStaticGeometry);
+    void setOptimizeMeshes(bool optimizeMeshes);
+    void setLazyMeshes(bool lazyMeshes);
+
+    int drawCount() const;
+    int drawCountBeforeMerging() const;
+    QHash<Qt3DCore::QEntity *, QVector<MergedRange>> mergedRanges() const;
+    QVector<Qt3DCore::QEntity *> nodeEntities() const;
+
 private:
+    struct StaticNode {
+        int nodeIdx = -1;
+        QMatrix4x4 worldMatrix;
+        QVector<int> layerIndices;
+    };
+
+    struct InstancedMesh {
+        int meshIdx = -1;
+        QVector<int> nodeIndices;
+        QVector<QMatrix4x4> instanceMatrices;
+        QVector<int> layerIndices;
+    };
+
+    struct MergedGeometry {
+        Qt3DRender::QGeometryRenderer *renderer = nullptr;
+        Primitive primitive;
+        QVector<int> layerIndices;
+    };
+
     void buildEntitiesAndJointsGraph();
     void buildJointHierarchy(const HierarchyNode *node, int &jointAccessor, const Skin &skin, unsigned int skinIdx, Qt3DCore::QJoint *parentJoint = nullptr);
+    QVector<bool> reachableNodes() const;
+    bool instantiateMesh(int meshIdx);
+    QVector<StaticNode> gatherStaticNodes() const;
+    QVector<InstancedMesh> gatherInstancedMeshes(const QVector<StaticNode> &staticNodes) const;
+    QVector<MergedGeometry> mergeStaticPrimitives(const QVector<StaticNode> &staticNodes,
+                                                  const QVector<bool> &instancedNodes,
+                                                  QSet<QPair<int, int>> &mergedPrimitives);
     void generateTreeNodeContent();
     void generateSkeletonContent();
     void generateAnimationContent();
@@ -129,8 +171,18 @@ private:
     QVector<AnimationDetails> m_animators;
     SceneEntity *m_sceneEntity;
     Qt3DCore::QEntity *m_sceneRootEntity;
-    int m_defaultSceneIdx;
+    int m_sceneIdx;
     bool m_assignNames;
+    bool m_transformTrackAnimations;
+    bool m_automaticInstancing;
+    bool m_mergeStaticGeometry;
+    bool m_optimizeMeshes;
+    bool m_lazyMeshes;
+    int m_drawCount;
+    int m_drawCountBeforeMerging;
+    QHash<Qt3DCore::QEntity *, QVector<MergedRange>> m_mergedRanges;
+    // Names of the unnamed meshes used as levels of detail
+    QHash<int, QString> m_lodMeshNames;
     QVector<QHash<int, unsigned short>> m_gltfJointIdxToSkeletonJointIdxPerSkeleton;
 };
 
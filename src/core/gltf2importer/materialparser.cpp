@@ -87,9 +87,17 @@ bool parseFloatArray(Vector &v,
     return true;
 }
 
-Kuesa::MetallicRoughnessMaterial *createPbrMaterial(const Material &mat, const GLTF2ContextPrivate *context)
+Qt3DRender::QAbstractTexture *textureFromInfo(const TextureInfo &info, const GLTF2ContextPrivate *context)
+{
+    if (info.index > -1)
+        return context->texture(info.index).texture;
+    return nullptr;
+}
+
+// Sets all the properties of pbrMaterial, which may have been created from
+// an earlier version of mat
+void applyPbrProperties(Kuesa::MetallicRoughnessMaterial *pbrMaterial, const Material &mat, const GLTF2ContextPrivate *context)
 {
-    auto pbrMaterial = new Kuesa::MetallicRoughnessMaterial();
     pbrMaterial->setMetallicFactor(mat.pbr.metallicFactor);
     pbrMaterial->setRoughnessFactor(mat.pbr.roughtnessFactor);
     pbrMaterial->setNormalScale(mat.normalTexture.scale);
@@ -104,38 +112,31 @@ Kuesa::MetallicRoughnessMaterial *createPbrMaterial(const Material &mat, const G
             mat.emissiveTexture.emissiveFactor[1],
             mat.emissiveTexture.emissiveFactor[2]));
 
-    const int baseColorTextureIdx = mat.pbr.baseColorTexture.index;
-    if (baseColorTextureIdx > -1)
-        pbrMaterial->setBaseColorMap(context->texture(baseColorTextureIdx).texture);
-
-    const int metallicRoughnessTextureIdx = mat.pbr.metallicRoughnessTexture.index;
-    if (metallicRoughnessTextureIdx > -1)
-        pbrMaterial->setMetalRoughMap(context->texture(metallicRoughnessTextureIdx).texture);
-
-    const int normalMapTextureIdx = mat.normalTexture.index;
-    if (normalMapTextureIdx > -1)
-        pbrMaterial->setNormalMap(context->texture(normalMapTextureIdx).texture);
-
-    const int emissiveMapTextureIdx = mat.emissiveTexture.index;
-    if (emissiveMapTextureIdx > -1)
-        pbrMaterial->setEmissiveMap(context->texture(emissiveMapTextureIdx).texture);
-
-    const int occulsionMapTextureIdx = mat.occlusionTexture.index;
-    if (occulsionMapTextureIdx > -1)
-        pbrMaterial->setAmbientOcclusionMap(context->texture(occulsionMapTextureIdx).texture);
+    pbrMaterial->setBaseColorMap(textureFromInfo(mat.pbr.baseColorTexture, context));
+    pbrMaterial->setMetalRoughMap(textureFromInfo(mat.pbr.metallicRoughnessTexture, context));
+    pbrMaterial->setNormalMap(textureFromInfo(mat.normalTexture, context));
+    pbrMaterial->setEmissiveMap(textureFromInfo(mat.emissiveTexture, context));
+    pbrMaterial->setAmbientOcclusionMap(textureFromInfo(mat.occlusionTexture, context));
 
     switch (mat.alpha.mode) {
     case Material::Alpha::Opaque:
+        pbrMaterial->setAlphaCutoffEnabled(false);
         pbrMaterial->setOpaque(true);
         break;
     case Material::Alpha::Blend:
+        pbrMaterial->setAlphaCutoffEnabled(false);
         pbrMaterial->setOpaque(false);
         break;
     case Material::Alpha::Mask:
         pbrMaterial->setAlphaCutoffEnabled(true);
         pbrMaterial->setAlphaCutoff(mat.alpha.alphaCutoff);
     }
+}
 
+Kuesa::MetallicRoughnessMaterial *createPbrMaterial(const Material &mat, const GLTF2ContextPrivate *context)
+{
+    auto pbrMaterial = new Kuesa::MetallicRoughnessMaterial();
+    applyPbrProperties(pbrMaterial, mat, context);
     return pbrMaterial;
 }
 
@@ -168,6 +169,39 @@ Qt3DRender::QMaterial *Material::material(bool isSkinned) const
     return m_regularMaterial;
 }
 
+Qt3DRender::QMaterial *Material::instancedMaterial(bool hasColorAttribute, const GLTF2ContextPrivate *context)
+{
+    if (m_instancedMaterial == nullptr) {
+        Kuesa::MetallicRoughnessMaterial *material = createPbrMaterial(*this, context);
+        material->setUseInstancing(true);
+        material->setUsingColorAttribute(hasColorAttribute);
+        m_instancedMaterial = material;
+    }
+    return m_instancedMaterial;
+}
+
+/*!
+ * \internal
+ *
+ * Takes the properties of \a updated, parsed from a new version of the file,
+ * and applies them to the materials already created.
+ */
+void Material::update(const Material &updated, const GLTF2ContextPrivate *context)
+{
+    name = updated.name;
+    doubleSided = updated.doubleSided;
+    pbr = updated.pbr;
+    normalTexture = updated.normalTexture;
+    occlusionTexture = updated.occlusionTexture;
+    emissiveTexture = updated.emissiveTexture;
+    alpha = updated.alpha;
+
+    for (Qt3DRender::QMaterial *material : { m_regularMaterial, m_skinnedMaterial, m_instancedMaterial }) {
+        if (material != nullptr)
+            applyPbrProperties(static_cast<Kuesa::MetallicRoughnessMaterial *>(material), *this, context);
+    }
+}
+
 bool MaterialParser::parse(const QJsonArray &materials, GLTF2ContextPrivate *context)
 {
     static const QHash<QString, Material::Alpha::Mode> modeEnumMap = {
@@ -95,13 +95,19 @@ public:
 
     Qt3DRender::QMaterial *material(bool isSkinned, bool hasColorAttribute, const GLTF2ContextPrivate *context);
     Qt3DRender::QMaterial *material(bool isSkinned) const;
+    Qt3DRender::QMaterial *instancedMaterial(bool hasColorAttribute, const GLTF2ContextPrivate *context);
+    Qt3DRender::QMaterial *instancedMaterial() const { return m_instancedMaterial; }
+
+    void update(const Material &updated, const GLTF2ContextPrivate *context);
 
     bool hasRegularMaterial() const { return m_regularMaterial != nullptr; }
     bool hasSkinnedMaterial() const { return m_skinnedMaterial != nullptr; }
+    bool hasInstancedMaterial() const { return m_instancedMaterial != nullptr; }
 
 private:
     Qt3DRender::QMaterial *m_regularMaterial = nullptr;
     Qt3DRender::QMaterial *m_skinnedMaterial = nullptr;
+    Qt3DRender::QMaterial *m_instancedMaterial = nullptr;
 };
 
 class Q_AUTOTEST_EXPORT MaterialParser
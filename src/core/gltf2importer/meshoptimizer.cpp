@@ -0,0 +1,363 @@
+/*
+    meshoptimizer.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "meshoptimizer_p.h"
+#include "geometryutils_p.h"
+
+#include <Qt3DRender/QGeometry>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+using namespace GLTF2Import;
+
+namespace {
+
+// Tuning of the vertex cache optimization, from Tom Forsyth's "Linear-Speed
+// Vertex Cache Optimisation"
+const int ScoredCacheSize = 32;
+const float CacheDecayPower = 1.5f;
+const float LastTriangleScore = 0.75f;
+const float ValenceBoostScale = 2.0f;
+const float ValenceBoostPower = 0.5f;
+
+float vertexScore(int cachePosition, int remainingTriangles)
+{
+    // Vertices with no triangle left to draw are of no interest
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // The vertices of the last triangle are favored equally so that the
+        // order in which they are emitted doesn't matter
+        if (cachePosition < 3) {
+            score = LastTriangleScore;
+        } else {
+            const float scaler = 1.0f / (ScoredCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+        }
+    }
+
+    // Vertices with few triangles left are favored to get rid of them
+    score += ValenceBoostScale * std::pow(float(remainingTriangles), -ValenceBoostPower);
+    return score;
+}
+
+} // namespace
+
+/*!
+ * \internal
+ *
+ * Returns \a indices with their triangles reordered so that vertices are
+ * reused while they are still in the post transform cache of the GPU, using
+ * Tom Forsyth's algorithm. Incomplete triangles are dropped.
+ */
+QVector<quint32> MeshOptimizer::optimizeVertexCache(const QVector<quint32> &indices, int vertexCount)
+{
+    const int triangleCount = indices.size() / 3;
+
+    // Triangles using each vertex, the ones still to be emitted come first
+    QVector<int> remainingTriangles(vertexCount, 0);
+    for (int i = 0, m = triangleCount * 3; i < m; ++i)
+        ++remainingTriangles[int(indices.at(i))];
+
+    QVector<int> firstVertexTriangle(vertexCount + 1, 0);
+    for (int vertex = 0; vertex < vertexCount; ++vertex)
+        firstVertexTriangle[vertex + 1] = firstVertexTriangle.at(vertex) + remainingTriangles.at(vertex);
+
+    QVector<int> vertexTriangles(triangleCount * 3);
+    {
+        QVector<int> filledTriangles(vertexCount, 0);
+        for (int i = 0, m = triangleCount * 3; i < m; ++i) {
+            const int vertex = int(indices.at(i));
+            vertexTriangles[firstVertexTriangle.at(vertex) + filledTriangles[vertex]++] = i / 3;
+        }
+    }
+
+    QVector<int> cachePositions(vertexCount, -1);
+    QVector<float> vertexScores(vertexCount);
+    for (int vertex = 0; vertex < vertexCount; ++vertex)
+        vertexScores[vertex] = vertexScore(-1, remainingTriangles.at(vertex));
+
+    const auto triangleScore = [&](int triangle) {
+        return vertexScores.at(int(indices.at(triangle * 3))) +
+                vertexScores.at(int(indices.at(triangle * 3 + 1))) +
+                vertexScores.at(int(indices.at(triangle * 3 + 2)));
+    };
+
+    QVector<bool> emittedTriangles(triangleCount, false);
+    int bestTriangle = -1;
+    float bestScore = -1.0f;
+    for (int triangle = 0; triangle < triangleCount; ++triangle) {
+        const float score = triangleScore(triangle);
+        if (score > bestScore) {
+            bestScore = score;
+            bestTriangle = triangle;
+        }
+    }
+
+    QVector<quint32> optimizedIndices;
+    optimizedIndices.reserve(triangleCount * 3);
+    QVector<int> cache;
+    QVector<int> nextCache;
+    cache.reserve(ScoredCacheSize + 3);
+    nextCache.reserve(ScoredCacheSize + 3);
+    int nextUnemittedTriangle = 0;
+
+    while (optimizedIndices.size() < triangleCount * 3) {
+        // Nothing in the cache is worth drawing, start over from an unemitted triangle
+        if (bestTriangle < 0) {
+            while (emittedTriangles.at(nextUnemittedTriangle))
+                ++nextUnemittedTriangle;
+            bestTriangle = nextUnemittedTriangle;
+        }
+
+        emittedTriangles[bestTriangle] = true;
+        nextCache.clear();
+        for (int corner = 0; corner < 3; ++corner) {
+            const int vertex = int(indices.at(bestTriangle * 3 + corner));
+            optimizedIndices.push_back(quint32(vertex));
+
+            // Move the triangle past the ones still to be emitted
+            const int first = firstVertexTriangle.at(vertex);
+            const int last = first + --remainingTriangles[vertex];
+            for (int i = first; i <= last; ++i) {
+                if (vertexTriangles.at(i) == bestTriangle) {
+                    std::swap(vertexTriangles[i], vertexTriangles[last]);
+                    break;
+                }
+            }
+
+            if (!nextCache.contains(vertex))
+                nextCache.push_back(vertex);
+        }
+
+        // Vertices of the emitted triangle go to the front of the LRU cache
+        for (const int vertex : qAsConst(cache)) {
+            if (nextCache.size() == ScoredCacheSize + 3)
+                break;
+            if (!nextCache.contains(vertex))
+                nextCache.push_back(vertex);
+        }
+
+        // Vertices pushed out of the cache are rescored as well
+        for (const int vertex : qAsConst(cache)) {
+            if (!nextCache.contains(vertex)) {
+                cachePositions[vertex] = -1;
+                vertexScores[vertex] = vertexScore(-1, remainingTriangles.at(vertex));
+            }
+        }
+        for (int i = 0, m = nextCache.size(); i < m; ++i) {
+            const int vertex = nextCache.at(i);
+            cachePositions[vertex] = i < ScoredCacheSize ? i : -1;
+            vertexScores[vertex] = vertexScore(cachePositions.at(vertex), remainingTriangles.at(vertex));
+        }
+        std::swap(cache, nextCache);
+
+        // The next triangle is picked among those using cached vertices
+        bestTriangle = -1;
+        bestScore = -1.0f;
+        for (const int vertex : qAsConst(cache)) {
+            for (int i = firstVertexTriangle.at(vertex), m = i + remainingTriangles.at(vertex); i < m; ++i) {
+                const int triangle = vertexTriangles.at(i);
+                const float score = triangleScore(triangle);
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = triangle;
+                }
+            }
+        }
+    }
+
+    return optimizedIndices;
+}
+
+/*!
+ * \internal
+ *
+ * Renumbers the vertices referenced by \a indices in the order they are first
+ * used, so that they are fetched sequentially. Vertices which aren't
+ * referenced are moved at the end. Returns the previous index of each vertex.
+ */
+QVector<quint32> MeshOptimizer::optimizeVertexFetch(QVector<quint32> &indices, int vertexCount)
+{
+    const quint32 unassigned = std::numeric_limits<quint32>::max();
+    QVector<quint32> newIndices(vertexCount, unassigned);
+    QVector<quint32> previousIndices;
+    previousIndices.reserve(vertexCount);
+
+    for (quint32 &index : indices) {
+        if (newIndices.at(int(index)) == unassigned) {
+            newIndices[int(index)] = quint32(previousIndices.size());
+            previousIndices.push_back(index);
+        }
+        index = newIndices.at(int(index));
+    }
+
+    for (int vertex = 0; vertex < vertexCount; ++vertex) {
+        if (newIndices.at(vertex) == unassigned)
+            previousIndices.push_back(quint32(vertex));
+    }
+
+    return previousIndices;
+}
+
+/*!
+ * \internal
+ *
+ * Returns the average number of vertices transformed per triangle when
+ * drawing \a indices with a FIFO post transform cache of \a cacheSize
+ * vertices. It ranges from 3 for unconnected triangles to about 0.5 for
+ * regular meshes drawn in the best order.
+ */
+float MeshOptimizer::averageCacheMissRatio(const QVector<quint32> &indices, int vertexCount, int cacheSize)
+{
+    const int triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return 0.0f;
+
+    // Time at which each vertex entered the cache
+    QVector<int> cacheTimestamps(vertexCount, -cacheSize - 1);
+    int time = 0;
+    int misses = 0;
+    for (int i = 0, m = triangleCount * 3; i < m; ++i) {
+        const int vertex = int(indices.at(i));
+        if (time - cacheTimestamps.at(vertex) > cacheSize) {
+            cacheTimestamps[vertex] = time++;
+            ++misses;
+        }
+    }
+
+    return float(misses) / triangleCount;
+}
+
+/*!
+ * \internal
+ *
+ * Reorders the indexed triangles of \a geometry for the post transform cache
+ * and stores its indices on 16 bits whenever possible.
+ *
+ * Vertices are renumbered for fetch locality only if the buffers holding them
+ * aren't used by other geometries. Similarly, the index buffer is only
+ * overwritten if no other attribute uses it. \a bufferUseCounts holds how
+ * many attributes use each buffer.
+ *
+ * Returns false if the geometry couldn't be optimized.
+ */
+bool MeshOptimizer::optimizeGeometry(Qt3DRender::QGeometry *geometry, const QHash<Qt3DRender::QBuffer *, int> &bufferUseCounts)
+{
+    Qt3DRender::QAttribute *indexAttribute = nullptr;
+    QVector<Qt3DRender::QAttribute *> vertexAttributes;
+    const auto attributes = geometry->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->attributeType() == Qt3DRender::QAttribute::IndexAttribute)
+            indexAttribute = attribute;
+        else
+            vertexAttributes.push_back(attribute);
+    }
+
+    if (indexAttribute == nullptr || vertexAttributes.isEmpty() || !isAttributeReadable(indexAttribute))
+        return false;
+
+    const int vertexCount = int(vertexAttributes.first()->count());
+    QHash<Qt3DRender::QBuffer *, int> vertexBufferUseCounts;
+    for (Qt3DRender::QAttribute *attribute : qAsConst(vertexAttributes)) {
+        if (int(attribute->count()) != vertexCount || attribute->divisor() != 0 || !isAttributeReadable(attribute))
+            return false;
+        ++vertexBufferUseCounts[attribute->buffer()];
+    }
+
+    QVector<quint32> indices;
+    if (!readIndices(indexAttribute, indices))
+        return false;
+    if (std::any_of(indices.cbegin(), indices.cend(), [vertexCount](quint32 index) { return index >= quint32(vertexCount); }))
+        return false;
+
+    indices = optimizeVertexCache(indices, vertexCount);
+
+    bool vertexBuffersAreOwned = true;
+    for (auto it = vertexBufferUseCounts.cbegin(), end = vertexBufferUseCounts.cend(); it != end; ++it)
+        vertexBuffersAreOwned &= bufferUseCounts.value(it.key()) <= it.value();
+
+    if (vertexBuffersAreOwned) {
+        const QVector<quint32> previousIndices = optimizeVertexFetch(indices, vertexCount);
+
+        // Attributes interleaved in the same buffer are permuted in the same copy
+        QHash<Qt3DRender::QBuffer *, QByteArray> permutedData;
+        for (Qt3DRender::QAttribute *attribute : qAsConst(vertexAttributes)) {
+            Qt3DRender::QBuffer *buffer = attribute->buffer();
+            if (!permutedData.contains(buffer))
+                permutedData.insert(buffer, buffer->data());
+            QByteArray &data = permutedData[buffer];
+            const QByteArray sourceData = buffer->data();
+
+            const uint stride = attributeElementStride(attribute);
+            const uint size = attributeElementSize(attribute);
+            const char *rawSource = sourceData.constData() + attribute->byteOffset();
+            char *rawData = data.data() + attribute->byteOffset();
+            for (int vertex = 0; vertex < vertexCount; ++vertex)
+                memcpy(rawData + vertex * stride, rawSource + previousIndices.at(vertex) * stride, size);
+        }
+        for (auto it = permutedData.begin(), end = permutedData.end(); it != end; ++it)
+            it.key()->setData(it.value());
+    }
+
+    // 16-bit indices are enough to address the vertices of most meshes, 65535
+    // being the primitive restart index glTF forbids
+    QByteArray indexData;
+    Qt3DRender::QAttribute::VertexBaseType indexType = Qt3DRender::QAttribute::UnsignedInt;
+    if (vertexCount <= std::numeric_limits<quint16>::max()) {
+        indexType = Qt3DRender::QAttribute::UnsignedShort;
+        indexData.resize(indices.size() * int(sizeof(quint16)));
+        quint16 *rawIndexData = reinterpret_cast<quint16 *>(indexData.data());
+        for (const quint32 index : qAsConst(indices))
+            *rawIndexData++ = quint16(index);
+    } else {
+        indexData = QByteArray(reinterpret_cast<const char *>(indices.constData()), indices.size() * int(sizeof(quint32)));
+    }
+
+    if (bufferUseCounts.value(indexAttribute->buffer()) <= 1) {
+        indexAttribute->buffer()->setData(indexData);
+    } else {
+        auto indexBuffer = new Qt3DRender::QBuffer();
+        indexBuffer->setData(indexData);
+        indexAttribute->setBuffer(indexBuffer);
+    }
+    indexAttribute->setVertexBaseType(indexType);
+    indexAttribute->setByteOffset(0);
+    indexAttribute->setByteStride(0);
+    indexAttribute->setCount(uint(indices.size()));
+
+    return true;
+}
+
+QT_END_NAMESPACE
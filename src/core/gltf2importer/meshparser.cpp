@@ -27,6 +27,8 @@
 */
 
 #include "meshparser_p.h"
+#include "meshoptimizer_p.h"
+#include "geometryutils_p.h"
 #include "bufferviewsparser_p.h"
 #include "gltf2context_p.h"
 #include "kuesa_p.h"
@@ -35,12 +37,15 @@
 #include <QJsonArray>
 #include <QDebug>
 #include <QElapsedTimer>
+#include <QSet>
 
 #include <Qt3DRender/QAttribute>
 #include <Qt3DRender/QGeometry>
 #include <Qt3DRender/QGeometryRenderer>
 
 #include <QtGui/qopengl.h>
+#include <algorithm>
+#include <limits>
 
 #if defined(KUESA_DRACO_COMPRESSION)
 #include <draco/compression/decode.h>
@@ -58,6 +63,8 @@ const QLatin1String KEY_INDICES = QLatin1Literal("indices");
 const QLatin1String KEY_MATERIAL = QLatin1Literal("material");
 const QLatin1String KEY_MODE = QLatin1Literal("mode");
 const QLatin1String KEY_NAME = QLatin1Literal("name");
+const QLatin1String KEY_POSITION = QLatin1Literal("POSITION");
+const QLatin1String KEY_JOINTS_0 = QLatin1Literal("JOINTS_0");
 #if defined(KUESA_DRACO_COMPRESSION)
 const QLatin1String KEY_EXTENSIONS = QLatin1String("extensions");
 const QLatin1String KEY_KHR_DRACO_MESH_COMPRESSION_EXTENSION = QLatin1String("KHR_draco_mesh_compression");
@@ -87,6 +94,147 @@ QString standardAttributeNameFromSemantic(const QString &semantic)
     return QString();
 }
 
+// KHR_mesh_quantization allows integer attributes which aren't normalized
+bool isQuantized(const Accessor &accessor)
+{
+    return !accessor.normalized &&
+            accessor.type != Qt3DRender::QAttribute::Float &&
+            accessor.type != Qt3DRender::QAttribute::HalfFloat &&
+            accessor.type != Qt3DRender::QAttribute::Double;
+}
+
+// Value a shader reads for the raw component value of a normalized
+// accessor, as defined by the glTF specification
+float normalizedValue(double value, Qt3DRender::QAttribute::VertexBaseType type)
+{
+    switch (type) {
+    case Qt3DRender::QAttribute::Byte:
+        return float(std::max(value / 127.0, -1.0));
+    case Qt3DRender::QAttribute::UnsignedByte:
+        return float(value / 255.0);
+    case Qt3DRender::QAttribute::Short:
+        return float(std::max(value / 32767.0, -1.0));
+    case Qt3DRender::QAttribute::UnsignedShort:
+        return float(value / 65535.0);
+    default:
+        return float(value);
+    }
+}
+
+template<typename ValueType>
+QByteArray convertToFloat(const char *rawData, const Accessor &accessor, uint stride)
+{
+    QByteArray data(accessor.count * accessor.dataSize * int(sizeof(float)), Qt::Uninitialized);
+    float *floatData = reinterpret_cast<float *>(data.data());
+    for (int i = 0; i < accessor.count; ++i) {
+        for (int c = 0; c < accessor.dataSize; ++c) {
+            ValueType value;
+            memcpy(&value, rawData + c * sizeof(ValueType), sizeof(ValueType));
+            *floatData++ = float(value);
+        }
+        rawData += stride;
+    }
+    return data;
+}
+
+// Moves signed values to the range of the unsigned type of the same size
+template<typename ValueType, typename UnsignedType>
+QByteArray convertToUnsigned(const char *rawData, const Accessor &accessor, uint stride)
+{
+    const UnsignedType signBit = UnsignedType(1) << (8 * sizeof(UnsignedType) - 1);
+    QByteArray data(accessor.count * accessor.dataSize * int(sizeof(UnsignedType)), Qt::Uninitialized);
+    UnsignedType *unsignedData = reinterpret_cast<UnsignedType *>(data.data());
+    for (int i = 0; i < accessor.count; ++i) {
+        for (int c = 0; c < accessor.dataSize; ++c) {
+            UnsignedType value;
+            memcpy(&value, rawData + c * sizeof(ValueType), sizeof(ValueType));
+            *unsignedData++ = value ^ signBit;
+        }
+        rawData += stride;
+    }
+    return data;
+}
+
+// Qt3D normalizes the integer attributes read as floats by the shaders.
+// Texture coordinates and skinned positions are converted to floats, other
+// positions are read as normalized unsigned values which dequantization maps
+// back to their quantized values.
+Qt3DRender::QAttribute *quantizedAttribute(Qt3DRender::QBuffer *buffer,
+                                           const Accessor &accessor,
+                                           const BufferView &viewData,
+                                           bool asFloat,
+                                           QMatrix4x4 &dequantization)
+{
+    const uint typeSize = vertexBaseTypeSize(accessor.type);
+    const uint elementSize = uint(accessor.dataSize) * typeSize;
+    const uint stride = viewData.byteStride > 0 ? uint(viewData.byteStride) : elementSize;
+    if (accessor.count <= 0 || elementSize == 0 ||
+        qint64(accessor.offset) + qint64(accessor.count - 1) * stride + elementSize > viewData.bufferData.size())
+        return nullptr;
+
+    const char *rawData = viewData.bufferData.constData() + accessor.offset;
+    Qt3DRender::QAttribute::VertexBaseType type = accessor.type;
+    QByteArray data;
+
+    if (asFloat || typeSize > 2) {
+        type = Qt3DRender::QAttribute::Float;
+        switch (accessor.type) {
+        case Qt3DRender::QAttribute::Byte:
+            data = convertToFloat<qint8>(rawData, accessor, stride);
+            break;
+        case Qt3DRender::QAttribute::UnsignedByte:
+            data = convertToFloat<quint8>(rawData, accessor, stride);
+            break;
+        case Qt3DRender::QAttribute::Short:
+            data = convertToFloat<qint16>(rawData, accessor, stride);
+            break;
+        case Qt3DRender::QAttribute::UnsignedShort:
+            data = convertToFloat<quint16>(rawData, accessor, stride);
+            break;
+        case Qt3DRender::QAttribute::Int:
+            data = convertToFloat<qint32>(rawData, accessor, stride);
+            break;
+        case Qt3DRender::QAttribute::UnsignedInt:
+            data = convertToFloat<quint32>(rawData, accessor, stride);
+            break;
+        default:
+            return nullptr;
+        }
+    } else {
+        const float unsignedMax = float((1U << (8 * typeSize)) - 1);
+        if (accessor.type == Qt3DRender::QAttribute::Byte) {
+            type = Qt3DRender::QAttribute::UnsignedByte;
+            data = convertToUnsigned<qint8, quint8>(rawData, accessor, stride);
+        } else if (accessor.type == Qt3DRender::QAttribute::Short) {
+            type = Qt3DRender::QAttribute::UnsignedShort;
+            data = convertToUnsigned<qint16, quint16>(rawData, accessor, stride);
+        }
+
+        // Signed values were offset by half of the unsigned range
+        if (type != accessor.type) {
+            const float signedOffset = float(1U << (8 * typeSize - 1));
+            dequantization.translate(-signedOffset, -signedOffset, -signedOffset);
+        }
+        dequantization.scale(unsignedMax);
+    }
+
+    // Unsigned positions are used as stored
+    if (data.isEmpty())
+        return new Qt3DRender::QAttribute(buffer,
+                                          type,
+                                          accessor.dataSize,
+                                          accessor.count,
+                                          accessor.offset,
+                                          viewData.byteStride);
+
+    auto *convertedBuffer = new Qt3DRender::QBuffer;
+    convertedBuffer->setData(data);
+    return new Qt3DRender::QAttribute(convertedBuffer,
+                                      type,
+                                      accessor.dataSize,
+                                      accessor.count);
+}
+
 #if defined(KUESA_DRACO_COMPRESSION)
 template<typename ValueType, Qt3DRender::QAttribute::VertexBaseType ComponentType>
 Qt3DRender::QAttribute *decodeAttribute(const draco::PointCloud *pointCould,
@@ -122,11 +270,52 @@ Qt3DRender::QAttribute *decodeAttribute(const draco::PointCloud *pointCould,
 
     return attribute;
 }
+
+template<typename IndexType>
+QByteArray decodeFaces(const draco::Mesh *mesh)
+{
+    QByteArray qbuffer;
+    qbuffer.resize(static_cast<int>(3 * sizeof(IndexType) * mesh->num_faces()));
+    IndexType *bufferData = reinterpret_cast<IndexType *>(qbuffer.data());
+    for (uint32_t i = 0; i < mesh->num_faces(); ++i) {
+        const auto &face = mesh->face(draco::FaceIndex(i));
+        bufferData[i * 3 + 0] = static_cast<IndexType>(face[0].value());
+        bufferData[i * 3 + 1] = static_cast<IndexType>(face[1].value());
+        bufferData[i * 3 + 2] = static_cast<IndexType>(face[2].value());
+    }
+    return qbuffer;
+}
 #endif
 } // namespace
 
-MeshParser::MeshParser()
+/*!
+ * \internal
+ *
+ * Unites the bounds of the primitives of the mesh into \a boundsMin and \a
+ * boundsMax, in mesh space. Returns false if a primitive wasn't created yet
+ * or has no precomputed bounds.
+ */
+bool Mesh::bounds(QVector3D &boundsMin, QVector3D &boundsMax) const
+{
+    boundsMin = QVector3D(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    boundsMax = -boundsMin;
+    for (const Primitive &primitive : meshPrimitives) {
+        QVector3D primitiveMin;
+        QVector3D primitiveMax;
+        if (primitive.primitiveRenderer == nullptr || primitive.primitiveRenderer->geometry() == nullptr ||
+            !GLTF2Import::bounds(primitive.primitiveRenderer->geometry(), primitiveMin, primitiveMax))
+            return false;
+        if (!primitive.positionDequantization.isIdentity())
+            transformBounds(primitive.positionDequantization, primitiveMin, primitiveMax);
+        uniteBounds(boundsMin, boundsMax, primitiveMin, primitiveMax);
+    }
+    return !meshPrimitives.isEmpty();
+}
+
+MeshParser::MeshParser(bool optimizeMeshes, bool lazy)
     : m_context(nullptr)
+    , m_optimizeMeshes(optimizeMeshes)
+    , m_lazy(lazy)
 {
 }
 
@@ -155,55 +344,105 @@ bool MeshParser::parse(const QJsonArray &meshArray, GLTF2ContextPrivate *context
 
         mesh.meshPrimitives.resize(primitiveCount);
         mesh.name = meshObject.value(KEY_NAME).toString();
+        if (m_lazy)
+            mesh.primitivesJson = primitivesArray;
         for (int primitiveId = 0; primitiveId < primitiveCount; ++primitiveId) {
             Primitive &primitive = mesh.meshPrimitives[primitiveId];
             const QJsonObject &primitivesObject = primitivesArray[primitiveId].toObject();
-
-            bool hasColorAttr = false;
-            Qt3DRender::QGeometry *geometry = new Qt3DRender::QGeometry();
-
-#if defined(KUESA_DRACO_COMPRESSION)
-            const QJsonObject extensions = primitivesObject.value(KEY_EXTENSIONS).toObject();
-
-            // Draco Extensions
-            if (extensions.contains(KEY_KHR_DRACO_MESH_COMPRESSION_EXTENSION)) {
-                if (!geometryDracoFromJSON(geometry, primitivesObject, hasColorAttr) &&
-                    geometry->attributes().isEmpty()) {
-                    delete geometry;
-                    return false;
-                }
-            } else
-#endif
-            {
-                if (!geometryFromJSON(geometry, primitivesObject, hasColorAttr) &&
-                    geometry->attributes().isEmpty()) {
-                    delete geometry;
-                    return false;
-                }
-            }
-
-            Qt3DRender::QGeometryRenderer *renderer = new Qt3DRender::QGeometryRenderer;
-            renderer->setPrimitiveType(static_cast<Qt3DRender::QGeometryRenderer::PrimitiveType>(primitivesObject.value(KEY_MODE).toInt(GL_TRIANGLES)));
-            renderer->setGeometry(geometry);
-            primitive.primitiveRenderer = renderer;
             primitive.materialIdx = primitivesObject.value(KEY_MATERIAL).toInt(-1);
-            primitive.hasColorAttr = hasColorAttr;
+
+            // Lazy meshes are only created once something uses them
+            if (!m_lazy && !primitiveFromJSON(primitive, primitivesObject))
+                return false;
         }
 
         context->addMesh(mesh);
     }
 
+    if (m_optimizeMeshes) {
+        QVector<Qt3DRender::QGeometryRenderer *> renderers;
+        for (const Mesh &mesh : qAsConst(meshes)) {
+            for (const Primitive &primitive : mesh.meshPrimitives) {
+                if (primitive.primitiveRenderer != nullptr)
+                    renderers.push_back(primitive.primitiveRenderer);
+            }
+        }
+        optimizeGeometries(renderers);
+    }
+
     qCDebug(kuesa) << "Loading mesh took" << timer.elapsed() << "milliseconds";
 
     return meshSize > 0;
 }
 
+/*!
+ * \internal
+ *
+ * Creates the primitives of \a mesh which weren't created yet, when the mesh
+ * was parsed lazily. Returns false if one of them can't be created.
+ */
+bool MeshParser::instantiateMesh(Mesh &mesh, GLTF2ContextPrivate *context)
+{
+    m_context = context;
+
+    QVector<Qt3DRender::QGeometryRenderer *> renderers;
+    for (int primitiveId = 0, m = mesh.meshPrimitives.size(); primitiveId < m; ++primitiveId) {
+        Primitive &primitive = mesh.meshPrimitives[primitiveId];
+        if (primitive.primitiveRenderer != nullptr)
+            continue;
+        if (!primitiveFromJSON(primitive, mesh.primitivesJson.at(primitiveId).toObject()))
+            return false;
+        renderers.push_back(primitive.primitiveRenderer);
+    }
+
+    if (m_optimizeMeshes)
+        optimizeGeometries(renderers);
+
+    return true;
+}
+
+bool MeshParser::primitiveFromJSON(Primitive &primitive, const QJsonObject &json)
+{
+    bool hasColorAttr = false;
+    Qt3DRender::QGeometry *geometry = new Qt3DRender::QGeometry();
+
+#if defined(KUESA_DRACO_COMPRESSION)
+    const QJsonObject extensions = json.value(KEY_EXTENSIONS).toObject();
+
+    // Draco Extensions
+    if (extensions.contains(KEY_KHR_DRACO_MESH_COMPRESSION_EXTENSION)) {
+        if (!geometryDracoFromJSON(geometry, json, hasColorAttr, primitive.positionDequantization) &&
+            geometry->attributes().isEmpty()) {
+            delete geometry;
+            return false;
+        }
+    } else
+#endif
+    {
+        if (!geometryFromJSON(geometry, json, hasColorAttr, primitive.positionDequantization) &&
+            geometry->attributes().isEmpty()) {
+            delete geometry;
+            return false;
+        }
+    }
+
+    setGeometryBounds(geometry, json, primitive.positionDequantization);
+
+    Qt3DRender::QGeometryRenderer *renderer = new Qt3DRender::QGeometryRenderer;
+    renderer->setPrimitiveType(static_cast<Qt3DRender::QGeometryRenderer::PrimitiveType>(json.value(KEY_MODE).toInt(GL_TRIANGLES)));
+    renderer->setGeometry(geometry);
+    primitive.primitiveRenderer = renderer;
+    primitive.hasColorAttr = hasColorAttr;
+    return true;
+}
+
 bool MeshParser::geometryFromJSON(Qt3DRender::QGeometry *geometry,
                                   const QJsonObject &json,
-                                  bool &hasColorAttr)
+                                  bool &hasColorAttr,
+                                  QMatrix4x4 &positionDequantization)
 {
     // Parse vertex attributes
-    if (!geometryAttributesFromJSON(geometry, json, {}, hasColorAttr))
+    if (!geometryAttributesFromJSON(geometry, json, {}, hasColorAttr, positionDequantization))
         return false;
 
     // Index attribute
@@ -213,12 +452,7 @@ bool MeshParser::geometryFromJSON(Qt3DRender::QGeometry *geometry,
         const Accessor &accessor = m_context->accessor(accessorIndex);
         const BufferView &viewData = m_context->bufferView(accessor.bufferViewIndex);
 
-        auto *buffer = m_qbuffers.value(accessor.bufferViewIndex, nullptr);
-        if (buffer == nullptr) {
-            buffer = new Qt3DRender::QBuffer;
-            buffer->setData(viewData.bufferData);
-            m_qbuffers.insert(accessor.bufferViewIndex, buffer);
-        }
+        auto *buffer = m_context->bufferViewBuffer(accessor.bufferViewIndex);
 
         Qt3DRender::QAttribute *attribute = new Qt3DRender::QAttribute(buffer,
                                                                        accessor.type,
@@ -240,13 +474,17 @@ bool MeshParser::geometryFromJSON(Qt3DRender::QGeometry *geometry,
 bool MeshParser::geometryAttributesFromJSON(Qt3DRender::QGeometry *geometry,
                                             const QJsonObject &json,
                                             QStringList existingAttributes,
-                                            bool &hasColorAttr)
+                                            bool &hasColorAttr,
+                                            QMatrix4x4 &positionDequantization)
 {
     const QJsonObject &attrs = json.value(KEY_ATTRIBUTES).toObject();
 
     if (attrs.size() == 0)
         return false;
 
+    // Skinning happens before the model matrix would dequantize the positions
+    const bool isSkinned = attrs.contains(KEY_JOINTS_0);
+
     for (auto it = attrs.begin(), end = attrs.end(); it != end; ++it) {
         const int accessorIndex = it.value().toInt();
         const Accessor &accessor = m_context->accessor(accessorIndex);
@@ -264,36 +502,92 @@ bool MeshParser::geometryAttributesFromJSON(Qt3DRender::QGeometry *geometry,
 
         const BufferView &viewData = m_context->bufferView(accessor.bufferViewIndex);
 
-        auto *buffer = m_qbuffers.value(accessor.bufferViewIndex, nullptr);
-        if (buffer == nullptr) {
-            buffer = new Qt3DRender::QBuffer;
-            buffer->setData(viewData.bufferData);
-            m_qbuffers.insert(accessor.bufferViewIndex, buffer);
-        }
+        auto *buffer = m_context->bufferViewBuffer(accessor.bufferViewIndex);
 
-        Qt3DRender::QAttribute *attribute = new Qt3DRender::QAttribute(buffer,
-                                                                       attributeName,
-                                                                       accessor.type,
-                                                                       accessor.dataSize,
-                                                                       accessor.count,
-                                                                       accessor.offset,
-                                                                       viewData.byteStride);
+        Qt3DRender::QAttribute *attribute = nullptr;
+        const bool isPosition = attributeName == Qt3DRender::QAttribute::defaultPositionAttributeName();
+        const bool isTexCoord = attrName.startsWith(QLatin1String("TEXCOORD_"));
+        if (isQuantized(accessor) && (isPosition || isTexCoord)) {
+            QMatrix4x4 dequantization;
+            attribute = quantizedAttribute(buffer, accessor, viewData, isTexCoord || isSkinned, dequantization);
+            if (attribute == nullptr) {
+                qCWarning(kuesa) << "Invalid quantized attribute" << attrName;
+                return false;
+            }
+            attribute->setName(attributeName);
+            if (isPosition)
+                positionDequantization = dequantization;
+        } else {
+            attribute = new Qt3DRender::QAttribute(buffer,
+                                                   attributeName,
+                                                   accessor.type,
+                                                   accessor.dataSize,
+                                                   accessor.count,
+                                                   accessor.offset,
+                                                   viewData.byteStride);
+        }
         attribute->setAttributeType(Qt3DRender::QAttribute::VertexAttribute);
         // store some GLTF metadata for asset pipeline editor
         attribute->setProperty("bufferIndex", viewData.bufferIdx);
         attribute->setProperty("bufferViewIndex", accessor.bufferViewIndex);
         attribute->setProperty("bufferViewOffset", viewData.byteOffset);
         attribute->setProperty("bufferName", accessor.name);
+        attribute->setProperty("normalized", accessor.normalized);
         geometry->addAttribute(attribute);
     }
 
     return true;
 }
 
+// glTF requires the POSITION accessors to provide their bounds, sparing us
+// from reading the positions to compute them
+void MeshParser::setGeometryBounds(Qt3DRender::QGeometry *geometry,
+                                   const QJsonObject &json,
+                                   const QMatrix4x4 &positionDequantization) const
+{
+    const QJsonObject &attrs = json.value(KEY_ATTRIBUTES).toObject();
+    const QJsonValue positionAccessorIndex = attrs.value(KEY_POSITION);
+    if (positionAccessorIndex.isUndefined())
+        return;
+
+    const Accessor &accessor = m_context->accessor(positionAccessorIndex.toInt());
+    if (accessor.min.size() < 3 || accessor.max.size() < 3)
+        return;
+
+    Qt3DRender::QAttribute *positionAttribute = nullptr;
+    const auto attributes = geometry->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->name() == Qt3DRender::QAttribute::defaultPositionAttributeName()) {
+            positionAttribute = attribute;
+            break;
+        }
+    }
+    if (positionAttribute == nullptr)
+        return;
+
+    // Bounds are stored in the space of the position attribute
+    QVector3D boundsMin(accessor.min.at(0), accessor.min.at(1), accessor.min.at(2));
+    QVector3D boundsMax(accessor.max.at(0), accessor.max.at(1), accessor.max.at(2));
+    if (accessor.normalized) {
+        // The bounds of normalized accessors hold raw values
+        for (int i = 0; i < 3; ++i) {
+            boundsMin[i] = normalizedValue(accessor.min.at(i), accessor.type);
+            boundsMax[i] = normalizedValue(accessor.max.at(i), accessor.type);
+        }
+    } else if (!positionDequantization.isIdentity())
+        transformBounds(positionDequantization.inverted(), boundsMin, boundsMax);
+    setBounds(geometry, boundsMin, boundsMax);
+
+    // Qt3D only computes bounding volumes from float positions
+    if (positionAttribute->vertexBaseType() != Qt3DRender::QAttribute::Float)
+        geometry->setBoundingVolumePositionAttribute(createBoundsAttribute(boundsMin, boundsMax, positionAttribute->count(), geometry));
+}
+
 #if defined(KUESA_DRACO_COMPRESSION)
 bool MeshParser::geometryDracoFromJSON(Qt3DRender::QGeometry *geometry,
                                        const QJsonObject &json,
-                                       bool &hasColorAttr)
+                                       bool &hasColorAttr,
+                                       QMatrix4x4 &positionDequantization)
 {
     const QJsonObject extensions = json.value(KEY_EXTENSIONS).toObject();
     const QJsonObject dracoExtensionObject = extensions.value(KEY_KHR_DRACO_MESH_COMPRESSION_EXTENSION).toObject();
@@ -347,20 +641,19 @@ bool MeshParser::geometryDracoFromJSON(Qt3DRender::QGeometry *geometry,
     // Create Index attribute if we are dealing with a triangular mesh
     if (geom_type.value() == draco::TRIANGULAR_MESH) {
         draco::Mesh *mesh = static_cast<draco::Mesh *>(geometryData.get());
+        // 16-bit indices are enough to address the vertices of most meshes,
+        // 65535 being the primitive restart index glTF forbids
+        const bool useShortIndices = mesh->num_points() <= std::numeric_limits<GLushort>::max();
         QByteArray qbuffer;
-        qbuffer.resize(static_cast<int>(3 * sizeof(GLuint) * mesh->num_faces()));
-        GLuint *bufferData = reinterpret_cast<GLuint *>(qbuffer.data());
-        for (uint32_t i = 0; i < mesh->num_faces(); ++i) {
-            const auto &face = mesh->face(draco::FaceIndex(i));
-            bufferData[i * 3 + 0] = face[0].value();
-            bufferData[i * 3 + 1] = face[1].value();
-            bufferData[i * 3 + 2] = face[2].value();
-        }
+        if (useShortIndices)
+            qbuffer = decodeFaces<GLushort>(mesh);
+        else
+            qbuffer = decodeFaces<GLuint>(mesh);
 
         Qt3DRender::QBuffer *buffer = new Qt3DRender::QBuffer();
         buffer->setData(qbuffer);
         Qt3DRender::QAttribute *attribute = new Qt3DRender::QAttribute(buffer,
-                                                                       Qt3DRender::QAttribute::UnsignedInt,
+                                                                       useShortIndices ? Qt3DRender::QAttribute::UnsignedShort : Qt3DRender::QAttribute::UnsignedInt,
                                                                        1,
                                                                        mesh->num_faces() * 3,
                                                                        0,
@@ -372,7 +665,7 @@ bool MeshParser::geometryDracoFromJSON(Qt3DRender::QGeometry *geometry,
     // Parse any additional non draco vertex attributes that may be present
     const QJsonObject &attrs = json.value(KEY_ATTRIBUTES).toObject();
     if (attrs.size() != 0)
-        return geometryAttributesFromJSON(geometry, json, existingAttributes, hasColorAttr);
+        return geometryAttributesFromJSON(geometry, json, existingAttributes, hasColorAttr, positionDequantization);
 
     return true;
 }
@@ -458,4 +751,38 @@ bool MeshParser::geometryAttributesDracoFromJSON(Qt3DRender::QGeometry *geometry
 }
 #endif
 
+
+void MeshParser::optimizeGeometries(const QVector<Qt3DRender::QGeometryRenderer *> &renderers) const
+{
+    // Buffers can be shared through buffer views by the primitives, including
+    // those of the meshes created before
+    QSet<Qt3DRender::QGeometryRenderer *> users;
+    for (Qt3DRender::QGeometryRenderer *renderer : renderers)
+        users.insert(renderer);
+    for (int meshId = 0, m = m_context->meshesCount(); meshId < m; ++meshId) {
+        const Mesh mesh = m_context->mesh(meshId);
+        for (const Primitive &primitive : mesh.meshPrimitives) {
+            if (primitive.primitiveRenderer != nullptr)
+                users.insert(primitive.primitiveRenderer);
+        }
+    }
+
+    QHash<Qt3DRender::QBuffer *, int> bufferUseCounts;
+    for (Qt3DRender::QGeometryRenderer *user : qAsConst(users)) {
+        if (user->geometry() == nullptr)
+            continue;
+        const auto attributes = user->geometry()->attributes();
+        for (Qt3DRender::QAttribute *attribute : attributes)
+            ++bufferUseCounts[attribute->buffer()];
+    }
+
+    for (Qt3DRender::QGeometryRenderer *renderer : renderers) {
+        if (renderer->primitiveType() == Qt3DRender::QGeometryRenderer::Triangles)
+            MeshOptimizer::optimizeGeometry(renderer->geometry(), bufferUseCounts);
+    }
+
+    // Meshes created afterwards mustn't use the optimized data
+    m_context->releaseModifiedBufferViewBuffers();
+}
+
 QT_END_NAMESPACE
@@ -38,7 +38,10 @@
 //
 
 #include <QtCore/qglobal.h>
+#include <QtCore/QJsonArray>
 #include <QtCore/QVector>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QVector3D>
 
 #include "bufferaccessorparser_p.h"
 
@@ -50,7 +53,6 @@ class PointCloud;
 };
 #endif
 
-class QJsonArray;
 namespace Qt3DRender {
 class QGeometryRenderer;
 class QGeometry;
@@ -66,32 +68,42 @@ struct Primitive {
     Qt3DRender::QGeometryRenderer *primitiveRenderer = nullptr;
     qint32 materialIdx = -1;
     bool hasColorAttr = false;
+    // KHR_mesh_quantization, maps the normalized positions to the mesh space
+    QMatrix4x4 positionDequantization;
 };
 
 struct Mesh {
     void clear();
+    bool bounds(QVector3D &boundsMin, QVector3D &boundsMax) const;
 
     QVector<Primitive> meshPrimitives;
     QString name;
+    // Kept to create the primitives of meshes instantiated lazily
+    QJsonArray primitivesJson;
 };
 
 class Q_AUTOTEST_EXPORT MeshParser
 {
 public:
-    MeshParser();
+    explicit MeshParser(bool optimizeMeshes = false, bool lazy = false);
 
     bool parse(const QJsonArray &meshArray, GLTF2ContextPrivate *context);
+    bool instantiateMesh(Mesh &mesh, GLTF2ContextPrivate *context);
 
 private:
-    bool geometryFromJSON(Qt3DRender::QGeometry *geometry, const QJsonObject &json, bool &hasColorAttr);
-    bool geometryAttributesFromJSON(Qt3DRender::QGeometry *geometry, const QJsonObject &json, QStringList existingAttributes, bool &hasColorAttr);
+    bool primitiveFromJSON(Primitive &primitive, const QJsonObject &json);
+    bool geometryFromJSON(Qt3DRender::QGeometry *geometry, const QJsonObject &json, bool &hasColorAttr, QMatrix4x4 &positionDequantization);
+    bool geometryAttributesFromJSON(Qt3DRender::QGeometry *geometry, const QJsonObject &json, QStringList existingAttributes, bool &hasColorAttr, QMatrix4x4 &positionDequantization);
 #if defined(KUESA_DRACO_COMPRESSION)
-    bool geometryDracoFromJSON(Qt3DRender::QGeometry *geometry, const QJsonObject &json, bool &hasColorAttr);
+    bool geometryDracoFromJSON(Qt3DRender::QGeometry *geometry, const QJsonObject &json, bool &hasColorAttr, QMatrix4x4 &positionDequantization);
     bool geometryAttributesDracoFromJSON(Qt3DRender::QGeometry *geometry, const QJsonObject &json, const draco::PointCloud *pointCloud, QStringList &existingAttributes, bool &hasColorAttr);
 #endif
+    void setGeometryBounds(Qt3DRender::QGeometry *geometry, const QJsonObject &json, const QMatrix4x4 &positionDequantization) const;
+    void optimizeGeometries(const QVector<Qt3DRender::QGeometryRenderer *> &renderers) const;
 
     GLTF2ContextPrivate *m_context;
-    QHash<int, Qt3DRender::QBuffer *> m_qbuffers;
+    bool m_optimizeMeshes;
+    bool m_lazy;
 };
 
 } // namespace GLTF2Import
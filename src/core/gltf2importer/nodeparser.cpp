@@ -39,6 +39,7 @@
 
 #include <functional>
 #include <memory>
+#include <tuple>
 
 QT_BEGIN_NAMESPACE
 using namespace Kuesa;
@@ -58,6 +59,15 @@ const QLatin1String KEY_CHILDREN = QLatin1Literal("children");
 const QLatin1String KEY_EXTENSIONS = QLatin1String("extensions");
 const QLatin1String KEY_KDAB_KUESA_LAYER_EXTENSION = QLatin1String("KDAB_Kuesa_Layers");
 const QLatin1String KEY_NODE_KUESA_LAYERS = QLatin1Literal("layers");
+const QLatin1String KEY_EXT_MESH_GPU_INSTANCING_EXTENSION = QLatin1String("EXT_mesh_gpu_instancing");
+const QLatin1String KEY_ATTRIBUTES = QLatin1String("attributes");
+const QLatin1String KEY_INSTANCE_TRANSLATION = QLatin1String("TRANSLATION");
+const QLatin1String KEY_INSTANCE_ROTATION = QLatin1String("ROTATION");
+const QLatin1String KEY_INSTANCE_SCALE = QLatin1String("SCALE");
+const QLatin1String KEY_MSFT_LOD_EXTENSION = QLatin1String("MSFT_lod");
+const QLatin1String KEY_LOD_IDS = QLatin1String("ids");
+const QLatin1String KEY_EXTRAS = QLatin1String("extras");
+const QLatin1String KEY_MSFT_SCREENCOVERAGE = QLatin1String("MSFT_screencoverage");
 
 QMatrix4x4 matrixFromArray(const QJsonArray &matrixValues)
 {
@@ -77,7 +87,88 @@ QMatrix4x4 matrixFromArray(const QJsonArray &matrixValues)
     return matrix;
 }
 
-QPair<bool, TreeNode> treenodeFromJson(const QJsonObject &nodeObj)
+// Reads the float vectors of dataSize components held by the accessor referenced by accessorValue
+bool floatsFromAccessor(const QJsonValue &accessorValue, int dataSize, const GLTF2ContextPrivate *context, QVector<float> &values)
+{
+    const int accessorIdx = accessorValue.toInt(-1);
+    if (accessorIdx < 0 || accessorIdx >= context->accessorCount()) {
+        qCWarning(kuesa, "Instancing attribute references invalid accessor");
+        return false;
+    }
+
+    const Accessor &accessor = context->accessor(accessorIdx);
+    if (accessor.dataSize != dataSize || accessor.type != Qt3DRender::QAttribute::Float) {
+        qCWarning(kuesa, "Instancing attribute accessor types or datasize inappropriate");
+        return false;
+    }
+
+    const BufferView &bufferViewData = context->bufferView(accessor.bufferViewIndex);
+    const int elemByteSize = sizeof(float);
+    const int byteStride = (bufferViewData.byteStride > 0 ? bufferViewData.byteStride : accessor.dataSize * elemByteSize);
+
+    // bufferData was generated using the bufferView's byteOffset applied
+    const QByteArray bufferData = bufferViewData.bufferData;
+    if (accessor.count > 0 && accessor.offset + (accessor.count - 1) * byteStride + dataSize * elemByteSize > bufferData.size()) {
+        qCWarning(kuesa, "Instancing attribute buffer data is too small");
+        return false;
+    }
+
+    values.resize(accessor.count * dataSize);
+    const char *rawBytes = bufferData.constData() + accessor.offset;
+    for (int i = 0; i < accessor.count; ++i) {
+        memcpy(values.data() + i * dataSize, rawBytes, dataSize * elemByteSize);
+        rawBytes += byteStride;
+    }
+    return true;
+}
+
+bool instanceMatricesFromJson(const QJsonObject &instancingObj, const GLTF2ContextPrivate *context, QVector<QMatrix4x4> &instanceMatrices)
+{
+    const QJsonObject attributesObj = instancingObj.value(KEY_ATTRIBUTES).toObject();
+    QVector<float> translations;
+    QVector<float> rotations;
+    QVector<float> scales;
+    const QVector<std::tuple<QLatin1String, int, QVector<float> *>> attributes = {
+        std::make_tuple(KEY_INSTANCE_TRANSLATION, 3, &translations),
+        std::make_tuple(KEY_INSTANCE_ROTATION, 4, &rotations),
+        std::make_tuple(KEY_INSTANCE_SCALE, 3, &scales)
+    };
+
+    int instanceCount = -1;
+    for (const auto &attribute : attributes) {
+        const QJsonValue accessorValue = attributesObj.value(std::get<0>(attribute));
+        if (accessorValue.isUndefined())
+            continue;
+        const int dataSize = std::get<1>(attribute);
+        QVector<float> &values = *std::get<2>(attribute);
+        if (!floatsFromAccessor(accessorValue, dataSize, context, values))
+            return false;
+        if (instanceCount >= 0 && values.size() / dataSize != instanceCount) {
+            qCWarning(kuesa, "Instancing attributes have different counts");
+            return false;
+        }
+        instanceCount = values.size() / dataSize;
+    }
+
+    if (instanceCount < 0) {
+        qCWarning(kuesa, "Instancing extension defines no attributes");
+        return false;
+    }
+
+    instanceMatrices.resize(instanceCount);
+    for (int i = 0; i < instanceCount; ++i) {
+        QMatrix4x4 &matrix = instanceMatrices[i];
+        if (!translations.isEmpty())
+            matrix.translate(translations.at(3 * i), translations.at(3 * i + 1), translations.at(3 * i + 2));
+        if (!rotations.isEmpty())
+            matrix.rotate(QQuaternion(rotations.at(4 * i + 3), rotations.at(4 * i), rotations.at(4 * i + 1), rotations.at(4 * i + 2)));
+        if (!scales.isEmpty())
+            matrix.scale(scales.at(3 * i), scales.at(3 * i + 1), scales.at(3 * i + 2));
+    }
+    return true;
+}
+
+QPair<bool, TreeNode> treenodeFromJson(const QJsonObject &nodeObj, const GLTF2ContextPrivate *context)
 {
     TreeNode node;
     node.name = nodeObj.value(KEY_NAME).toString();
@@ -184,11 +275,68 @@ QPair<bool, TreeNode> treenodeFromJson(const QJsonObject &nodeObj)
         }
     }
 
+    // GPU Instancing Extension
+    if (nodeExtensions.contains(KEY_EXT_MESH_GPU_INSTANCING_EXTENSION)) {
+        if (node.meshIdx < 0) {
+            qCWarning(kuesa, "Node using instancing without referencing a mesh");
+            return QPair<bool, TreeNode>(false, node);
+        }
+        const QJsonObject instancingExtension = nodeExtensions.value(KEY_EXT_MESH_GPU_INSTANCING_EXTENSION).toObject();
+        if (!instanceMatricesFromJson(instancingExtension, context, node.instanceMatrices))
+            return QPair<bool, TreeNode>(false, node);
+    }
+
+    // Level of Detail Extension
+    if (nodeExtensions.contains(KEY_MSFT_LOD_EXTENSION)) {
+        if (node.meshIdx < 0) {
+            qCWarning(kuesa, "Node using levels of detail without referencing a mesh");
+            return QPair<bool, TreeNode>(false, node);
+        }
+        const QJsonArray lodIds = nodeExtensions.value(KEY_MSFT_LOD_EXTENSION).toObject().value(KEY_LOD_IDS).toArray();
+        for (const QJsonValue &lodValue : lodIds) {
+            const int lodId = lodValue.toInt(-1);
+            if (lodId < 0) {
+                qCWarning(kuesa, "Node referencing invalid level of detail");
+                return QPair<bool, TreeNode>(false, node);
+            }
+            node.lodNodeIndices.push_back(lodId);
+        }
+
+        // Minimum screen coverage of each level, the node is culled below the last one
+        const QJsonArray screenCoverages = nodeObj.value(KEY_EXTRAS).toObject().value(KEY_MSFT_SCREENCOVERAGE).toArray();
+        for (const QJsonValue &screenCoverage : screenCoverages)
+            node.lodScreenCoverages.push_back(screenCoverage.toDouble());
+        if (node.lodScreenCoverages.size() > node.lodNodeIndices.size() + 1) {
+            qCWarning(kuesa, "Node defining more screen coverages than levels of detail");
+            node.lodScreenCoverages.resize(node.lodNodeIndices.size() + 1);
+        }
+    }
+
     return QPair<bool, TreeNode>(true, node);
 }
 
 } // namespace
 
+/*!
+ * \internal
+ *
+ * Returns the transform of the node relative to its parent.
+ */
+QMatrix4x4 TreeNode::localMatrix() const
+{
+    if (transformInfo.bits & TransformInfo::MatrixSet)
+        return transformInfo.matrix;
+
+    QMatrix4x4 matrix;
+    if (transformInfo.bits & TransformInfo::TranslationSet)
+        matrix.translate(transformInfo.translation);
+    if (transformInfo.bits & TransformInfo::RotationSet)
+        matrix.rotate(transformInfo.rotation);
+    if (transformInfo.bits & TransformInfo::ScaleSet)
+        matrix.scale(transformInfo.scale3D);
+    return matrix;
+}
+
 NodeParser::NodeParser()
 {
 }
@@ -198,7 +346,7 @@ bool NodeParser::parse(const QJsonArray &nodes, GLTF2ContextPrivate *context) co
     const int nbNodes = nodes.size();
     for (int nodeId = 0; nodeId < nbNodes; ++nodeId) {
         const QJsonObject &nodeObject = nodes.at(nodeId).toObject();
-        const QPair<bool, TreeNode> treeNodeCreationResult = treenodeFromJson(nodeObject);
+        const QPair<bool, TreeNode> treeNodeCreationResult = treenodeFromJson(nodeObject, context);
         if (!treeNodeCreationResult.first)
             return false;
         context->addTreeNode(treeNodeCreationResult.second);
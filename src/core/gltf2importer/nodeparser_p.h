@@ -84,6 +84,13 @@ struct TreeNode {
     int cameraIdx = -1;
     QVector<int> childrenIndices;
     QVector<int> layerIndices;
+    // EXT_mesh_gpu_instancing, relative to the node
+    QVector<QMatrix4x4> instanceMatrices;
+    // MSFT_lod, nodes whose meshes are the lower levels of detail of the node
+    QVector<int> lodNodeIndices;
+    QVector<qreal> lodScreenCoverages;
+
+    QMatrix4x4 localMatrix() const;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(TreeNode::TransformInfo::TransformBits)
@@ -0,0 +1,494 @@
+/*
+    sceneupdater.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "sceneupdater_p.h"
+#include "gltf2context_p.h"
+#include "kuesa_p.h"
+#include "kuesa_utils_p.h"
+#include "geometryutils_p.h"
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSet>
+#include <Qt3DCore/QEntity>
+#include <Qt3DCore/QTransform>
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QCamera>
+#include <Qt3DRender/QGeometry>
+#include <Qt3DRender/QGeometryRenderer>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+using namespace GLTF2Import;
+
+namespace {
+const QLatin1String KEY_BUFFERS = QLatin1Literal("buffers");
+const QLatin1String KEY_BUFFERVIEWS = QLatin1Literal("bufferViews");
+const QLatin1String KEY_BUFFERVIEW = QLatin1Literal("bufferView");
+const QLatin1String KEY_ACCESSORS = QLatin1Literal("accessors");
+const QLatin1String KEY_NODES = QLatin1Literal("nodes");
+const QLatin1String KEY_MESHES = QLatin1Literal("meshes");
+const QLatin1String KEY_MATERIALS = QLatin1Literal("materials");
+const QLatin1String KEY_IMAGES = QLatin1Literal("images");
+const QLatin1String KEY_SKINS = QLatin1Literal("skins");
+const QLatin1String KEY_JOINTS = QLatin1Literal("joints");
+const QLatin1String KEY_NAME = QLatin1Literal("name");
+const QLatin1String KEY_PRIMITIVES = QLatin1Literal("primitives");
+const QLatin1String KEY_ATTRIBUTES = QLatin1Literal("attributes");
+const QLatin1String KEY_INDICES = QLatin1Literal("indices");
+const QLatin1String KEY_TARGETS = QLatin1Literal("targets");
+const QLatin1String KEY_MATERIAL = QLatin1Literal("material");
+const QLatin1String KEY_EXTENSIONS = QLatin1Literal("extensions");
+const QLatin1String KEY_TRANSLATION = QLatin1Literal("translation");
+const QLatin1String KEY_ROTATION = QLatin1Literal("rotation");
+const QLatin1String KEY_SCALE = QLatin1Literal("scale");
+const QLatin1String KEY_MATRIX = QLatin1Literal("matrix");
+const QLatin1String KEY_KHR_DRACO_MESH_COMPRESSION_EXTENSION = QLatin1String("KHR_draco_mesh_compression");
+
+QJsonValue documentItem(const QJsonObject &document, QLatin1String key, int idx)
+{
+    return document.value(key).toArray().at(idx);
+}
+
+// What is left once the parts which can be updated in place are removed
+QJsonObject withoutUpdatableParts(QJsonObject document)
+{
+    for (const QLatin1String &key : { KEY_BUFFERS, KEY_BUFFERVIEWS, KEY_ACCESSORS, KEY_MESHES, KEY_MATERIALS, KEY_NODES })
+        document.remove(key);
+    return document;
+}
+
+QJsonObject withoutTransform(QJsonObject node)
+{
+    for (const QLatin1String &key : { KEY_TRANSLATION, KEY_ROTATION, KEY_SCALE, KEY_MATRIX })
+        node.remove(key);
+    return node;
+}
+
+// Returns the accessors read by the primitives of a mesh
+QVector<int> meshAccessors(const QJsonObject &mesh)
+{
+    QVector<int> accessors;
+    const QJsonArray primitives = mesh.value(KEY_PRIMITIVES).toArray();
+    for (const QJsonValue &primitiveValue : primitives) {
+        const QJsonObject primitive = primitiveValue.toObject();
+        const QJsonObject attributes = primitive.value(KEY_ATTRIBUTES).toObject();
+        for (auto it = attributes.constBegin(), end = attributes.constEnd(); it != end; ++it)
+            accessors.push_back(it.value().toInt(-1));
+        if (primitive.contains(KEY_INDICES))
+            accessors.push_back(primitive.value(KEY_INDICES).toInt(-1));
+        const QJsonArray targets = primitive.value(KEY_TARGETS).toArray();
+        for (const QJsonValue &target : targets) {
+            const QJsonObject targetAttributes = target.toObject();
+            for (auto it = targetAttributes.constBegin(), end = targetAttributes.constEnd(); it != end; ++it)
+                accessors.push_back(it.value().toInt(-1));
+        }
+    }
+    return accessors;
+}
+
+// Returns the buffer views holding the Draco compressed primitives of a mesh
+QVector<int> meshDracoBufferViews(const QJsonObject &mesh)
+{
+    QVector<int> bufferViews;
+    const QJsonArray primitives = mesh.value(KEY_PRIMITIVES).toArray();
+    for (const QJsonValue &primitiveValue : primitives) {
+        const QJsonObject draco = primitiveValue.toObject().value(KEY_EXTENSIONS).toObject().value(KEY_KHR_DRACO_MESH_COMPRESSION_EXTENSION).toObject();
+        if (draco.contains(KEY_BUFFERVIEW))
+            bufferViews.push_back(draco.value(KEY_BUFFERVIEW).toInt(-1));
+    }
+    return bufferViews;
+}
+
+// Primitives can only be updated if they are drawn the same way
+bool samePrimitiveLayout(const QJsonObject &primitive, const QJsonObject &updatedPrimitive)
+{
+    return primitive.value(KEY_MATERIAL) == updatedPrimitive.value(KEY_MATERIAL) &&
+            primitive.value(KEY_ATTRIBUTES).toObject().keys() == updatedPrimitive.value(KEY_ATTRIBUTES).toObject().keys() &&
+            primitive.value(KEY_TARGETS).toArray().size() == updatedPrimitive.value(KEY_TARGETS).toArray().size() &&
+            primitive.value(KEY_EXTENSIONS).toObject().keys() == updatedPrimitive.value(KEY_EXTENSIONS).toObject().keys();
+}
+
+// Gives the geometry of updated to renderer, which keeps its name and the
+// entities using it
+void moveGeometry(Qt3DRender::QGeometryRenderer *updated, Qt3DRender::QGeometryRenderer *renderer)
+{
+    Qt3DRender::QGeometry *geometry = updated->geometry();
+    updated->setGeometry(nullptr);
+
+    Qt3DRender::QGeometry *previousGeometry = renderer->geometry();
+    geometry->setParent(renderer);
+    renderer->setGeometry(geometry);
+    renderer->setPrimitiveType(updated->primitiveType());
+    if (previousGeometry != nullptr && previousGeometry->parent() == renderer)
+        delete previousGeometry;
+}
+
+} // namespace
+
+/*!
+ * \class Kuesa::GLTF2Import::SceneUpdater
+ * \internal
+ *
+ * Applies the changes of a glTF file to the assets created from a previous
+ * version of it, and to the entities of the scene instantiated from it, so
+ * that they don't have to be created again.
+ *
+ * Only the properties of materials, the transforms of nodes and the data of
+ * meshes can be updated in place. Any other difference requires loading the
+ * file from scratch.
+ */
+
+/*!
+ * \internal
+ *
+ * Creates an updater for the assets of \a context and the entities \a
+ * nodeEntities created for its nodes. Updated meshes are optimized if \a
+ * optimizeMeshes is true.
+ */
+SceneUpdater::SceneUpdater(GLTF2ContextPrivate *context, const QVector<Qt3DCore::QEntity *> &nodeEntities, bool optimizeMeshes)
+    : m_context(context)
+    , m_updated(nullptr)
+    , m_nodeEntities(nodeEntities)
+    , m_optimizeMeshes(optimizeMeshes)
+{
+}
+
+/*!
+ * \internal
+ *
+ * Applies the differences between the document of the context and the
+ * document parsed in \a updated, whose meshes must have been parsed lazily.
+ * Returns false, without changing anything, if the differences can't be
+ * applied in place.
+ */
+bool SceneUpdater::update(GLTF2ContextPrivate *updated)
+{
+    m_updated = updated;
+    m_statistics = {};
+
+    if (!isCompatible())
+        return false;
+
+    const QJsonObject document = m_context->document();
+    const QJsonObject updatedDocument = m_updated->document();
+
+    // The updated meshes share the buffers of the buffer views which didn't
+    // change with the current ones, unless they are optimized as this
+    // rewrites their buffers
+    const QHash<int, QPointer<Qt3DRender::QBuffer>> buffers = m_context->bufferViewBuffers();
+    if (!m_optimizeMeshes) {
+        QHash<int, QPointer<Qt3DRender::QBuffer>> unchangedBuffers;
+        for (auto it = buffers.cbegin(), end = buffers.cend(); it != end; ++it) {
+            if (!it->isNull() && sameBufferView(it.key()))
+                unchangedBuffers.insert(it.key(), *it);
+        }
+        m_updated->setBufferViewBuffers(unchangedBuffers);
+    }
+
+    // The shared buffers mustn't be discarded along with the updated assets
+    const auto giveUp = [this] {
+        m_updated->setBufferViewBuffers({});
+        return false;
+    };
+
+    // Find what changed and create the updated meshes before touching anything
+    QVector<int> changedMeshes;
+    for (int meshIdx = 0, m = m_context->meshesCount(); meshIdx < m; ++meshIdx) {
+        if (!meshChanged(meshIdx))
+            continue;
+        if (!canUpdateMesh(meshIdx))
+            return giveUp();
+
+        Mesh updatedMesh = m_updated->mesh(meshIdx);
+        MeshParser parser(m_optimizeMeshes);
+        if (!parser.instantiateMesh(updatedMesh, m_updated))
+            return giveUp();
+        m_updated->setMesh(meshIdx, updatedMesh);
+
+        // The entities depend on these
+        const Mesh mesh = m_context->mesh(meshIdx);
+        for (int primitiveIdx = 0, n = mesh.meshPrimitives.size(); primitiveIdx < n; ++primitiveIdx) {
+            const Primitive &primitive = mesh.meshPrimitives.at(primitiveIdx);
+            const Primitive &updatedPrimitive = updatedMesh.meshPrimitives.at(primitiveIdx);
+            if (primitive.hasColorAttr != updatedPrimitive.hasColorAttr ||
+                primitive.positionDequantization != updatedPrimitive.positionDequantization)
+                return giveUp();
+        }
+        changedMeshes.push_back(meshIdx);
+    }
+
+    QVector<int> changedNodes;
+    for (int nodeIdx = 0, m = m_context->treeNodeCount(); nodeIdx < m; ++nodeIdx) {
+        if (documentItem(document, KEY_NODES, nodeIdx) == documentItem(updatedDocument, KEY_NODES, nodeIdx))
+            continue;
+        if (!canUpdateNode(nodeIdx))
+            return giveUp();
+        changedNodes.push_back(nodeIdx);
+    }
+
+    for (int materialIdx = 0, m = m_context->materialsCount(); materialIdx < m; ++materialIdx) {
+        if (documentItem(document, KEY_MATERIALS, materialIdx) == documentItem(updatedDocument, KEY_MATERIALS, materialIdx))
+            continue;
+        m_context->material(materialIdx).update(m_updated->material(materialIdx), m_context);
+        ++m_statistics.materials;
+    }
+
+    // Buffers are parented to the first attribute using them, they must not
+    // be deleted along with the replaced geometries while others use them
+    const QHash<int, QPointer<Qt3DRender::QBuffer>> updatedBuffers = m_updated->bufferViewBuffers();
+    Qt3DCore::QNode *assetsParent = m_context->assetsParent();
+    if (assetsParent != nullptr && !changedMeshes.isEmpty()) {
+        for (const auto &bufferViewBuffers : { buffers, updatedBuffers }) {
+            for (Qt3DRender::QBuffer *buffer : bufferViewBuffers) {
+                if (buffer != nullptr && buffer->parent() != assetsParent)
+                    buffer->setParent(assetsParent);
+            }
+        }
+    }
+
+    for (const int meshIdx : qAsConst(changedMeshes)) {
+        Mesh mesh = m_context->mesh(meshIdx);
+        const Mesh updatedMesh = m_updated->mesh(meshIdx);
+        for (int primitiveIdx = 0, n = mesh.meshPrimitives.size(); primitiveIdx < n; ++primitiveIdx) {
+            // Primitives not created yet are created from the updated document
+            Qt3DRender::QGeometryRenderer *renderer = mesh.meshPrimitives.at(primitiveIdx).primitiveRenderer;
+            if (renderer != nullptr)
+                moveGeometry(updatedMesh.meshPrimitives.at(primitiveIdx).primitiveRenderer, renderer);
+        }
+        mesh.primitivesJson = updatedMesh.primitivesJson;
+        m_context->setMesh(meshIdx, mesh);
+        ++m_statistics.meshes;
+    }
+
+    if (!changedMeshes.isEmpty()) {
+        updateBounds(changedMeshes);
+        releaseUnusedBuffers(buffers, updatedBuffers);
+    }
+    m_updated->setBufferViewBuffers({});
+
+    for (const int nodeIdx : qAsConst(changedNodes)) {
+        Qt3DCore::QEntity *entity = m_nodeEntities.value(nodeIdx, nullptr);
+        if (entity == nullptr)
+            continue;
+        Qt3DRender::QCamera *camera = qobject_cast<Qt3DRender::QCamera *>(entity);
+        Qt3DCore::QTransform *transform = camera ? camera->transform() : componentFromEntity<Qt3DCore::QTransform>(entity);
+        if (transform != nullptr)
+            transform->setMatrix(m_updated->treeNode(nodeIdx).localMatrix());
+        ++m_statistics.nodes;
+    }
+
+    m_context->updateDocument(*m_updated);
+    return true;
+}
+
+/*!
+ * \internal
+ *
+ * Returns how many materials, meshes and nodes the last update changed.
+ */
+SceneUpdater::Statistics SceneUpdater::statistics() const
+{
+    return m_statistics;
+}
+
+// The entities drawing the updated meshes are bounded by their new geometries
+void SceneUpdater::updateBounds(const QVector<int> &changedMeshes)
+{
+    for (int nodeIdx = 0, m = m_context->treeNodeCount(); nodeIdx < m; ++nodeIdx) {
+        const int meshIdx = m_context->treeNode(nodeIdx).meshIdx;
+        Qt3DCore::QEntity *entity = m_nodeEntities.value(nodeIdx, nullptr);
+        QVector3D boundsMin;
+        QVector3D boundsMax;
+        if (entity != nullptr && changedMeshes.contains(meshIdx) && m_context->mesh(meshIdx).bounds(boundsMin, boundsMax))
+            setBounds(entity, boundsMin, boundsMax);
+    }
+}
+
+// Keeps the buffers of the buffer views which the meshes still use and
+// deletes the others, which belonged to the previous versions of the meshes
+void SceneUpdater::releaseUnusedBuffers(const QHash<int, QPointer<Qt3DRender::QBuffer>> &buffers,
+                                        const QHash<int, QPointer<Qt3DRender::QBuffer>> &updatedBuffers)
+{
+    QSet<Qt3DRender::QBuffer *> usedBuffers;
+    for (int meshIdx = 0, m = m_context->meshesCount(); meshIdx < m; ++meshIdx) {
+        const Mesh mesh = m_context->mesh(meshIdx);
+        for (const Primitive &primitive : mesh.meshPrimitives) {
+            if (primitive.primitiveRenderer == nullptr || primitive.primitiveRenderer->geometry() == nullptr)
+                continue;
+            const auto attributes = primitive.primitiveRenderer->geometry()->attributes();
+            for (Qt3DRender::QAttribute *attribute : attributes)
+                usedBuffers.insert(attribute->buffer());
+        }
+    }
+
+    QHash<int, QPointer<Qt3DRender::QBuffer>> keptBuffers;
+    QSet<Qt3DRender::QBuffer *> releasedBuffers;
+    for (const auto &bufferViewBuffers : { updatedBuffers, buffers }) {
+        for (auto it = bufferViewBuffers.cbegin(), end = bufferViewBuffers.cend(); it != end; ++it) {
+            Qt3DRender::QBuffer *buffer = *it;
+            if (buffer == nullptr)
+                continue;
+            if (!usedBuffers.contains(buffer))
+                releasedBuffers.insert(buffer);
+            else if (!keptBuffers.contains(it.key()))
+                keptBuffers.insert(it.key(), buffer);
+        }
+    }
+
+    m_context->setBufferViewBuffers(keptBuffers);
+    for (Qt3DRender::QBuffer *buffer : qAsConst(releasedBuffers)) {
+        if (buffer->parent() == m_context->assetsParent())
+            delete buffer;
+    }
+}
+
+bool SceneUpdater::isCompatible() const
+{
+    const QJsonObject document = m_context->document();
+    const QJsonObject updatedDocument = m_updated->document();
+    if (document.isEmpty() || withoutUpdatableParts(document) != withoutUpdatableParts(updatedDocument))
+        return false;
+
+    for (const QLatin1String &key : { KEY_NODES, KEY_MESHES, KEY_MATERIALS, KEY_ACCESSORS }) {
+        if (document.value(key).toArray().size() != updatedDocument.value(key).toArray().size())
+            return false;
+    }
+
+    // Nodes may only move
+    for (int nodeIdx = 0, m = m_context->treeNodeCount(); nodeIdx < m; ++nodeIdx) {
+        if (withoutTransform(documentItem(document, KEY_NODES, nodeIdx).toObject()) !=
+            withoutTransform(documentItem(updatedDocument, KEY_NODES, nodeIdx).toObject()))
+            return false;
+    }
+
+    // The collections hold the assets by name
+    for (int materialIdx = 0, m = m_context->materialsCount(); materialIdx < m; ++materialIdx) {
+        if (documentItem(document, KEY_MATERIALS, materialIdx).toObject().value(KEY_NAME) !=
+            documentItem(updatedDocument, KEY_MATERIALS, materialIdx).toObject().value(KEY_NAME))
+            return false;
+    }
+
+    QSet<int> accessorsOfMeshes;
+    for (int meshIdx = 0, m = m_context->meshesCount(); meshIdx < m; ++meshIdx) {
+        const QJsonObject mesh = documentItem(document, KEY_MESHES, meshIdx).toObject();
+        const QJsonObject updatedMesh = documentItem(updatedDocument, KEY_MESHES, meshIdx).toObject();
+        const QJsonArray primitives = mesh.value(KEY_PRIMITIVES).toArray();
+        const QJsonArray updatedPrimitives = updatedMesh.value(KEY_PRIMITIVES).toArray();
+        if (mesh.value(KEY_NAME) != updatedMesh.value(KEY_NAME) || primitives.size() != updatedPrimitives.size())
+            return false;
+        for (int primitiveIdx = 0, n = primitives.size(); primitiveIdx < n; ++primitiveIdx) {
+            if (!samePrimitiveLayout(primitives.at(primitiveIdx).toObject(), updatedPrimitives.at(primitiveIdx).toObject()))
+                return false;
+        }
+        for (const int accessorIdx : meshAccessors(mesh))
+            accessorsOfMeshes.insert(accessorIdx);
+    }
+
+    // Skins and animations read the other accessors
+    for (int accessorIdx = 0, m = m_context->accessorCount(); accessorIdx < m; ++accessorIdx) {
+        if (!accessorsOfMeshes.contains(accessorIdx) && !sameAccessor(accessorIdx))
+            return false;
+    }
+
+    const QJsonArray images = document.value(KEY_IMAGES).toArray();
+    for (const QJsonValue &image : images) {
+        const QJsonObject imageObject = image.toObject();
+        if (imageObject.contains(KEY_BUFFERVIEW) && !sameBufferView(imageObject.value(KEY_BUFFERVIEW).toInt(-1)))
+            return false;
+    }
+
+    return true;
+}
+
+bool SceneUpdater::sameAccessor(int accessorIdx) const
+{
+    const QJsonObject accessor = documentItem(m_context->document(), KEY_ACCESSORS, accessorIdx).toObject();
+    const QJsonObject updatedAccessor = documentItem(m_updated->document(), KEY_ACCESSORS, accessorIdx).toObject();
+    if (accessor != updatedAccessor)
+        return false;
+
+    // Accessors without buffer view are filled with zeros
+    return !accessor.contains(KEY_BUFFERVIEW) || sameBufferView(accessor.value(KEY_BUFFERVIEW).toInt(-1));
+}
+
+bool SceneUpdater::sameBufferView(int bufferViewIdx) const
+{
+    if (documentItem(m_context->document(), KEY_BUFFERVIEWS, bufferViewIdx) !=
+        documentItem(m_updated->document(), KEY_BUFFERVIEWS, bufferViewIdx))
+        return false;
+    if (bufferViewIdx < 0 || bufferViewIdx >= m_context->bufferViewCount() || bufferViewIdx >= m_updated->bufferViewCount())
+        return true;
+    return m_context->bufferView(bufferViewIdx).bufferData == m_updated->bufferView(bufferViewIdx).bufferData;
+}
+
+bool SceneUpdater::meshChanged(int meshIdx) const
+{
+    const QJsonObject mesh = documentItem(m_context->document(), KEY_MESHES, meshIdx).toObject();
+    if (mesh != documentItem(m_updated->document(), KEY_MESHES, meshIdx).toObject())
+        return true;
+
+    const QVector<int> accessors = meshAccessors(mesh);
+    for (const int accessorIdx : accessors) {
+        if (!sameAccessor(accessorIdx))
+            return true;
+    }
+    const QVector<int> bufferViews = meshDracoBufferViews(mesh);
+    for (const int bufferViewIdx : bufferViews) {
+        if (!sameBufferView(bufferViewIdx))
+            return true;
+    }
+    return false;
+}
+
+bool SceneUpdater::canUpdateMesh(int meshIdx) const
+{
+    // Skinned meshes have their joint indices remapped and instanced meshes
+    // are drawn by renderers of their own
+    for (int nodeIdx = 0, m = m_context->treeNodeCount(); nodeIdx < m; ++nodeIdx) {
+        const TreeNode node = m_context->treeNode(nodeIdx);
+        if (node.meshIdx == meshIdx && (node.skinIdx >= 0 || !node.instanceMatrices.isEmpty()))
+            return false;
+    }
+    return true;
+}
+
+bool SceneUpdater::canUpdateNode(int nodeIdx) const
+{
+    // Joints are driven by skeletons
+    const QJsonArray skins = m_context->document().value(KEY_SKINS).toArray();
+    for (const QJsonValue &skin : skins) {
+        if (skin.toObject().value(KEY_JOINTS).toArray().contains(nodeIdx))
+            return false;
+    }
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,97 @@
+/*
+    sceneupdater_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_GLTF2IMPORT_SCENEUPDATER_P_H
+#define KUESA_GLTF2IMPORT_SCENEUPDATER_P_H
+
+//
+//  NOTICE
+//  ------
+//
+// We mean it: this file is not part of the public API and could be
+// modified without notice
+//
+
+#include <QtCore/qglobal.h>
+#include <QtCore/QHash>
+#include <QtCore/QPointer>
+#include <QtCore/QVector>
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DCore {
+class QEntity;
+}
+
+namespace Qt3DRender {
+class QBuffer;
+}
+
+namespace Kuesa {
+namespace GLTF2Import {
+
+class GLTF2ContextPrivate;
+
+class Q_AUTOTEST_EXPORT SceneUpdater
+{
+public:
+    struct Statistics {
+        int materials = 0;
+        int meshes = 0;
+        int nodes = 0;
+    };
+
+    SceneUpdater(GLTF2ContextPrivate *context, const QVector<Qt3DCore::QEntity *> &nodeEntities, bool optimizeMeshes = false);
+
+    bool update(GLTF2ContextPrivate *updated);
+    Statistics statistics() const;
+
+private:
+    bool isCompatible() const;
+    bool sameAccessor(int accessorIdx) const;
+    bool sameBufferView(int bufferViewIdx) const;
+    bool meshChanged(int meshIdx) const;
+    bool canUpdateMesh(int meshIdx) const;
+    bool canUpdateNode(int nodeIdx) const;
+    void updateBounds(const QVector<int> &changedMeshes);
+    void releaseUnusedBuffers(const QHash<int, QPointer<Qt3DRender::QBuffer>> &buffers,
+                              const QHash<int, QPointer<Qt3DRender::QBuffer>> &updatedBuffers);
+
+    GLTF2ContextPrivate *m_context;
+    GLTF2ContextPrivate *m_updated;
+    QVector<Qt3DCore::QEntity *> m_nodeEntities;
+    bool m_optimizeMeshes;
+    Statistics m_statistics;
+};
+
+} // namespace GLTF2Import
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_GLTF2IMPORT_SCENEUPDATER_P_H
@@ -105,7 +105,25 @@ namespace Kuesa {
  */
 
 /*!
- * \property opaque If false, alpha blending is enabled for this effect
+ * \property useBakedSkinning If true, a vertex shader fetching the skinning
+ * matrices from a Kuesa::BakedSkinningAnimation texture is used. This takes
+ * precedence over useSkinning. Baked skinning is not available with OpenGL ES
+ * 2, meshes are then rendered in their bind pose
+ */
+
+/*!
+ * \property useInstancing If true, a vertex shader drawing each instance of
+ * the mesh with the transformation held by its instanceModelMatrix per
+ * instance attribute is used. Skinning can't be combined with instancing.
+ * Instancing is not available with OpenGL ES 2, all instances are then drawn
+ * at the same place
+ */
+
+/*!
+ * \property opaque If false, alpha blending is enabled for this effect. The
+ * effect then provides both Transparent render passes, alpha blended over the
+ * scene, and TransparentOIT render passes used by the order independent
+ * transparency mode of the Kuesa::ForwardRenderer
  */
 
 /*!
@@ -175,7 +193,22 @@ namespace Kuesa {
  */
 
 /*!
- * \qmlproperty bool opaque If false, alpha blending is enabled for this effect
+ * \qmlproperty bool useBakedSkinning If true, a vertex shader fetching the
+ * skinning matrices from a Kuesa.BakedSkinningAnimation texture is used. This
+ * takes precedence over useSkinning
+ */
+
+/*!
+ * \qmlproperty bool useInstancing If true, a vertex shader drawing each
+ * instance of the mesh with the transformation held by its instanceModelMatrix
+ * per instance attribute is used. Skinning can't be combined with instancing
+ */
+
+/*!
+ * \qmlproperty bool opaque If false, alpha blending is enabled for this effect.
+ * The effect then provides both Transparent render passes, alpha blended over
+ * the scene, and TransparentOIT render passes used by the order independent
+ * transparency mode of the Kuesa.ForwardRenderer
  */
 
 /*!
@@ -194,6 +227,8 @@ MetallicRoughnessEffect::MetallicRoughnessEffect(Qt3DCore::QNode *parent)
     , m_usingColorAttribute(false)
     , m_doubleSided(false)
     , m_useSkinning(false)
+    , m_useBakedSkinning(false)
+    , m_useInstancing(false)
     , m_invokeInitVertexShaderRequested(false)
     , m_opaque(true)
     , m_alphaCutoffEnabled(false)
@@ -201,9 +236,16 @@ MetallicRoughnessEffect::MetallicRoughnessEffect(Qt3DCore::QNode *parent)
     , m_metalRoughGL3ShaderBuilder(new QShaderProgramBuilder(this))
     , m_metalRoughES3ShaderBuilder(new QShaderProgramBuilder(this))
     , m_metalRoughES2ShaderBuilder(new QShaderProgramBuilder(this))
+    , m_metalRoughGL3OITShaderBuilder(new QShaderProgramBuilder(this))
+    , m_metalRoughES3OITShaderBuilder(new QShaderProgramBuilder(this))
     , m_metalRoughGL3Shader(new QShaderProgram(this))
     , m_metalRoughES3Shader(new QShaderProgram(this))
     , m_metalRoughES2Shader(new QShaderProgram(this))
+    , m_metalRoughGL3OITShader(new QShaderProgram(this))
+    , m_metalRoughES3OITShader(new QShaderProgram(this))
+    , m_zfillGL3Shader(new QShaderProgram(this))
+    , m_zfillES3Shader(new QShaderProgram(this))
+    , m_zfillES2Shader(new QShaderProgram(this))
 {
     const auto enabledLayers = QStringList { QStringLiteral("noBaseColorMap"),
                                              QStringLiteral("noMetalRoughMap"),
@@ -212,19 +254,26 @@ MetallicRoughnessEffect::MetallicRoughnessEffect(Qt3DCore::QNode *parent)
                                              QStringLiteral("noNormalMap"),
                                              QStringLiteral("noHasColorAttr"),
                                              QStringLiteral("noDoubleSided"),
-                                             QStringLiteral("noHasAlphaCutoff") };
+                                             QStringLiteral("noHasAlphaCutoff"),
+                                             QStringLiteral("noWeightedBlendedOIT") };
     const auto fragmentShaderGraph = QUrl(QStringLiteral("qrc:/kuesa/shaders/graphs/metallicroughness.frag.json"));
     m_metalRoughGL3ShaderBuilder->setShaderProgram(m_metalRoughGL3Shader);
     m_metalRoughGL3ShaderBuilder->setFragmentShaderGraph(fragmentShaderGraph);
-    m_metalRoughGL3ShaderBuilder->setEnabledLayers(enabledLayers);
 
     m_metalRoughES3ShaderBuilder->setShaderProgram(m_metalRoughES3Shader);
     m_metalRoughES3ShaderBuilder->setFragmentShaderGraph(fragmentShaderGraph);
-    m_metalRoughES3ShaderBuilder->setEnabledLayers(enabledLayers);
 
     m_metalRoughES2ShaderBuilder->setShaderProgram(m_metalRoughES2Shader);
     m_metalRoughES2ShaderBuilder->setFragmentShaderGraph(fragmentShaderGraph);
-    m_metalRoughES2ShaderBuilder->setEnabledLayers(enabledLayers);
+
+    // Same graph, writing weighted blended transparency outputs instead of fragColor
+    m_metalRoughGL3OITShaderBuilder->setShaderProgram(m_metalRoughGL3OITShader);
+    m_metalRoughGL3OITShaderBuilder->setFragmentShaderGraph(fragmentShaderGraph);
+
+    m_metalRoughES3OITShaderBuilder->setShaderProgram(m_metalRoughES3OITShader);
+    m_metalRoughES3OITShaderBuilder->setFragmentShaderGraph(fragmentShaderGraph);
+
+    updateLayers(enabledLayers);
 
     m_metalRoughGL3Technique = new QTechnique(this);
     m_metalRoughGL3Technique->graphicsApiFilter()->setApi(QGraphicsApiFilter::OpenGL);
@@ -251,26 +300,22 @@ MetallicRoughnessEffect::MetallicRoughnessEffect(Qt3DCore::QNode *parent)
     m_metalRoughES3Technique->addFilterKey(filterKey);
     m_metalRoughES2Technique->addFilterKey(filterKey);
 
-    auto zfillGL3Shader = new Qt3DRender::QShaderProgram(this);
-    zfillGL3Shader->setVertexShaderCode(QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/shaders/gl3/default.vert")))); // from Qt3D
-    zfillGL3Shader->setFragmentShaderCode(QByteArray(R"(
-                                                     #version 330
-                                                     void main() { }
-                                                     )"));
-
-    auto zfillES3Shader = new Qt3DRender::QShaderProgram(this);
-    zfillES3Shader->setVertexShaderCode(QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/shaders/es3/default.vert")))); // from Qt3D
-    zfillES3Shader->setFragmentShaderCode(QByteArray(R"(
-                                                     #version 300 es
-                                                     void main() { }
-                                                     )"));
-
-    auto zfillES2Shader = new Qt3DRender::QShaderProgram(this);
-    zfillES2Shader->setVertexShaderCode(QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/shaders/es2/default.vert")))); // from Qt3D
-    zfillES2Shader->setFragmentShaderCode(QByteArray(R"(
-                                                     #version 100
-                                                     void main() { }
-                                                     )"));
+    // The vertex shaders are the ones of the other passes, set by
+    // initVertexShader, so that depths match exactly
+    m_zfillGL3Shader->setFragmentShaderCode(QByteArray(R"(
+                                                       #version 330
+                                                       void main() { }
+                                                       )"));
+
+    m_zfillES3Shader->setFragmentShaderCode(QByteArray(R"(
+                                                       #version 300 es
+                                                       void main() { }
+                                                       )"));
+
+    m_zfillES2Shader->setFragmentShaderCode(QByteArray(R"(
+                                                       #version 100
+                                                       void main() { }
+                                                       )"));
 
     {
         auto filterKey = new Qt3DRender::QFilterKey(this);
@@ -278,19 +323,19 @@ MetallicRoughnessEffect::MetallicRoughnessEffect(Qt3DCore::QNode *parent)
         filterKey->setValue(QStringLiteral("ZFill"));
 
         m_zfillGL3RenderPass = new QRenderPass(this);
-        m_zfillGL3RenderPass->setShaderProgram(zfillGL3Shader);
+        m_zfillGL3RenderPass->setShaderProgram(m_zfillGL3Shader);
         m_zfillGL3RenderPass->addRenderState(m_backFaceCulling);
         m_zfillGL3RenderPass->addFilterKey(filterKey);
         m_metalRoughGL3Technique->addRenderPass(m_zfillGL3RenderPass);
 
         m_zfillES3RenderPass = new QRenderPass(this);
-        m_zfillES3RenderPass->setShaderProgram(zfillES3Shader);
+        m_zfillES3RenderPass->setShaderProgram(m_zfillES3Shader);
         m_zfillES3RenderPass->addRenderState(m_backFaceCulling);
         m_zfillES3RenderPass->addFilterKey(filterKey);
         m_metalRoughES3Technique->addRenderPass(m_zfillES3RenderPass);
 
         m_zfillES2RenderPass = new QRenderPass(this);
-        m_zfillES2RenderPass->setShaderProgram(zfillES2Shader);
+        m_zfillES2RenderPass->setShaderProgram(m_zfillES2Shader);
         m_zfillES2RenderPass->addRenderState(m_backFaceCulling);
         m_zfillES2RenderPass->addFilterKey(filterKey);
         m_metalRoughES2Technique->addRenderPass(m_zfillES2RenderPass);
@@ -347,6 +392,29 @@ MetallicRoughnessEffect::MetallicRoughnessEffect(Qt3DCore::QNode *parent)
         m_metalRoughES2Technique->addRenderPass(m_transparentES2RenderPass);
     }
 
+    {
+        // Selected instead of the Transparent passes when the ForwardRenderer
+        // uses order independent transparency. ES2 lacks multiple render
+        // targets, transparent objects aren't rendered in this case.
+        auto filterKey = new Qt3DRender::QFilterKey(this);
+        filterKey->setName(QStringLiteral("KuesaDrawStage"));
+        filterKey->setValue(QStringLiteral("TransparentOIT"));
+
+        m_transparentOITGL3RenderPass = new QRenderPass(this);
+        m_transparentOITGL3RenderPass->setShaderProgram(m_metalRoughGL3OITShader);
+        m_transparentOITGL3RenderPass->addRenderState(m_backFaceCulling);
+        m_transparentOITGL3RenderPass->addFilterKey(filterKey);
+        m_transparentOITGL3RenderPass->setEnabled(false);
+        m_metalRoughGL3Technique->addRenderPass(m_transparentOITGL3RenderPass);
+
+        m_transparentOITES3RenderPass = new QRenderPass(this);
+        m_transparentOITES3RenderPass->setShaderProgram(m_metalRoughES3OITShader);
+        m_transparentOITES3RenderPass->addRenderState(m_backFaceCulling);
+        m_transparentOITES3RenderPass->addFilterKey(filterKey);
+        m_transparentOITES3RenderPass->setEnabled(false);
+        m_metalRoughES3Technique->addRenderPass(m_transparentOITES3RenderPass);
+    }
+
     addTechnique(m_metalRoughGL3Technique);
     addTechnique(m_metalRoughES3Technique);
     addTechnique(m_metalRoughES2Technique);
@@ -408,6 +476,16 @@ bool MetallicRoughnessEffect::useSkinning() const
     return m_useSkinning;
 }
 
+bool MetallicRoughnessEffect::useBakedSkinning() const
+{
+    return m_useBakedSkinning;
+}
+
+bool MetallicRoughnessEffect::useInstancing() const
+{
+    return m_useInstancing;
+}
+
 bool MetallicRoughnessEffect::isOpaque() const
 {
     return m_opaque;
@@ -432,9 +510,7 @@ void MetallicRoughnessEffect::setBaseColorMapEnabled(bool enabled)
         layers.append(QStringLiteral("noBaseColorMap"));
     }
     m_baseColorMapEnabled = enabled;
-    m_metalRoughGL3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES2ShaderBuilder->setEnabledLayers(layers);
+    updateLayers(layers);
     emit baseColorMapEnabledChanged(enabled);
 }
 
@@ -452,9 +528,7 @@ void MetallicRoughnessEffect::setMetalRoughMapEnabled(bool enabled)
         layers.append(QStringLiteral("noMetalRoughMap"));
     }
     m_metalRoughMapEnabled = enabled;
-    m_metalRoughGL3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES2ShaderBuilder->setEnabledLayers(layers);
+    updateLayers(layers);
     emit metalRoughMapEnabledChanged(enabled);
 }
 
@@ -472,9 +546,7 @@ void MetallicRoughnessEffect::setNormalMapEnabled(bool enabled)
         layers.append(QStringLiteral("noNormalMap"));
     }
     m_normalMapEnabled = enabled;
-    m_metalRoughGL3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES2ShaderBuilder->setEnabledLayers(layers);
+    updateLayers(layers);
     emit normalMapEnabledChanged(enabled);
 }
 
@@ -492,9 +564,7 @@ void MetallicRoughnessEffect::setAmbientOcclusionMapEnabled(bool enabled)
         layers.append(QStringLiteral("noAmbientOcclusionMap"));
     }
     m_ambientOcclusionMapEnabled = enabled;
-    m_metalRoughGL3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES2ShaderBuilder->setEnabledLayers(layers);
+    updateLayers(layers);
     emit ambientOcclusionMapEnabledChanged(enabled);
 }
 
@@ -512,9 +582,7 @@ void MetallicRoughnessEffect::setEmissiveMapEnabled(bool enabled)
         layers.append(QStringLiteral("noEmissiveMap"));
     }
     m_emissiveMapEnabled = enabled;
-    m_metalRoughGL3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES2ShaderBuilder->setEnabledLayers(layers);
+    updateLayers(layers);
     emit emissiveMapEnabledChanged(enabled);
 }
 
@@ -532,9 +600,7 @@ void MetallicRoughnessEffect::setUsingColorAttribute(bool usingColorAttribute)
         layers.append(QStringLiteral("noHasColorAttr"));
     }
     m_usingColorAttribute = usingColorAttribute;
-    m_metalRoughGL3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES2ShaderBuilder->setEnabledLayers(layers);
+    updateLayers(layers);
     emit usingColorAttributeChanged(usingColorAttribute);
 }
 
@@ -554,9 +620,7 @@ void MetallicRoughnessEffect::setDoubleSided(bool doubleSided)
         m_backFaceCulling->setMode(QCullFace::Back);
     }
     m_doubleSided = doubleSided;
-    m_metalRoughGL3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES3ShaderBuilder->setEnabledLayers(layers);
-    m_metalRoughES2ShaderBuilder->setEnabledLayers(layers);
+    updateLayers(layers);
     emit doubleSidedChanged(doubleSided);
 }
 
@@ -570,6 +634,26 @@ void MetallicRoughnessEffect::setUseSkinning(bool useSkinning)
         initVertexShader();
 }
 
+void MetallicRoughnessEffect::setUseBakedSkinning(bool useBakedSkinning)
+{
+    if (useBakedSkinning == m_useBakedSkinning)
+        return;
+    m_useBakedSkinning = useBakedSkinning;
+    emit useBakedSkinningChanged(m_useBakedSkinning);
+    if (!m_invokeInitVertexShaderRequested)
+        initVertexShader();
+}
+
+void MetallicRoughnessEffect::setUseInstancing(bool useInstancing)
+{
+    if (useInstancing == m_useInstancing)
+        return;
+    m_useInstancing = useInstancing;
+    emit useInstancingChanged(m_useInstancing);
+    if (!m_invokeInitVertexShaderRequested)
+        initVertexShader();
+}
+
 void MetallicRoughnessEffect::setOpaque(bool opaque)
 {
     if (opaque == m_opaque)
@@ -584,6 +668,8 @@ void MetallicRoughnessEffect::setOpaque(bool opaque)
     m_transparentGL3RenderPass->setEnabled(!opaque);
     m_transparentES3RenderPass->setEnabled(!opaque);
     m_transparentES2RenderPass->setEnabled(!opaque);
+    m_transparentOITGL3RenderPass->setEnabled(!opaque);
+    m_transparentOITES3RenderPass->setEnabled(!opaque);
     if (opaque)
         setAlphaCutoffEnabled(false);
 }
@@ -602,29 +688,64 @@ void MetallicRoughnessEffect::setAlphaCutoffEnabled(bool enabled)
         layers.append(QStringLiteral("noHasAlphaCutoff"));
     }
     m_alphaCutoffEnabled = enabled;
+    updateLayers(layers);
+    emit alphaCutoffEnabledChanged(enabled);
+}
+
+/*!
+ * \internal
+ *
+ * Sets \a layers as the enabled layers of the shader graph for all shaders,
+ * the order independent transparency shaders writing to the weighted blended
+ * outputs instead of the fragment color.
+ */
+void MetallicRoughnessEffect::updateLayers(const QStringList &layers)
+{
     m_metalRoughGL3ShaderBuilder->setEnabledLayers(layers);
     m_metalRoughES3ShaderBuilder->setEnabledLayers(layers);
     m_metalRoughES2ShaderBuilder->setEnabledLayers(layers);
-    emit alphaCutoffEnabledChanged(enabled);
+
+    auto oitLayers = layers;
+    oitLayers.removeAll(QStringLiteral("noWeightedBlendedOIT"));
+    oitLayers.append(QStringLiteral("weightedBlendedOIT"));
+    m_metalRoughGL3OITShaderBuilder->setEnabledLayers(oitLayers);
+    m_metalRoughES3OITShaderBuilder->setEnabledLayers(oitLayers);
 }
 
 void MetallicRoughnessEffect::initVertexShader()
 {
-    if (m_useSkinning) {
-        m_metalRoughGL3Shader->setVertexShaderCode(
-                QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/skinned.vert"))));
-        m_metalRoughES3Shader->setVertexShaderCode(
-                QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es3/skinned.vert"))));
-        m_metalRoughES2Shader->setVertexShaderCode(
-                QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es2/skinned.vert"))));
+    QByteArray gl3VertexShader;
+    QByteArray es3VertexShader;
+    QByteArray es2VertexShader;
+
+    if (m_useBakedSkinning) {
+        // ES2 has neither texelFetch nor guaranteed float textures
+        gl3VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/bakedskinned.vert")));
+        es3VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es3/bakedskinned.vert")));
+        es2VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es2/simple.vert")));
+    } else if (m_useSkinning) {
+        gl3VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/skinned.vert")));
+        es3VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es3/skinned.vert")));
+        es2VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es2/skinned.vert")));
+    } else if (m_useInstancing) {
+        // ES2 has no instanced draw calls
+        gl3VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/instanced.vert")));
+        es3VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es3/instanced.vert")));
+        es2VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es2/simple.vert")));
     } else {
-        m_metalRoughGL3Shader->setVertexShaderCode(
-                QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/simple.vert"))));
-        m_metalRoughES3Shader->setVertexShaderCode(
-                QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es3/simple.vert"))));
-        m_metalRoughES2Shader->setVertexShaderCode(
-                QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es2/simple.vert"))));
+        gl3VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/gl3/simple.vert")));
+        es3VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es3/simple.vert")));
+        es2VertexShader = QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/kuesa/shaders/es2/simple.vert")));
     }
+
+    m_metalRoughGL3Shader->setVertexShaderCode(gl3VertexShader);
+    m_metalRoughES3Shader->setVertexShaderCode(es3VertexShader);
+    m_metalRoughES2Shader->setVertexShaderCode(es2VertexShader);
+    m_metalRoughGL3OITShader->setVertexShaderCode(gl3VertexShader);
+    m_metalRoughES3OITShader->setVertexShaderCode(es3VertexShader);
+    m_zfillGL3Shader->setVertexShaderCode(gl3VertexShader);
+    m_zfillES3Shader->setVertexShaderCode(es3VertexShader);
+    m_zfillES2Shader->setVertexShaderCode(es2VertexShader);
     m_invokeInitVertexShaderRequested = false;
 }
 
@@ -55,6 +55,8 @@ class KUESASHARED_EXPORT MetallicRoughnessEffect : public Qt3DRender::QEffect
     Q_PROPERTY(bool usingColorAttribute READ isUsingColorAttribute WRITE setUsingColorAttribute NOTIFY usingColorAttributeChanged)
     Q_PROPERTY(bool doubleSided READ isDoubleSided WRITE setDoubleSided NOTIFY doubleSidedChanged)
     Q_PROPERTY(bool useSkinning READ useSkinning WRITE setUseSkinning NOTIFY useSkinningChanged)
+    Q_PROPERTY(bool useBakedSkinning READ useBakedSkinning WRITE setUseBakedSkinning NOTIFY useBakedSkinningChanged)
+    Q_PROPERTY(bool useInstancing READ useInstancing WRITE setUseInstancing NOTIFY useInstancingChanged)
     Q_PROPERTY(bool opaque READ isOpaque WRITE setOpaque NOTIFY opaqueChanged)
     Q_PROPERTY(bool alphaCutoffEnabled READ isAlphaCutoffEnabled WRITE setAlphaCutoffEnabled NOTIFY alphaCutoffEnabledChanged)
 public:
@@ -69,6 +71,8 @@ public:
     bool isUsingColorAttribute() const;
     bool isDoubleSided() const;
     bool useSkinning() const;
+    bool useBakedSkinning() const;
+    bool useInstancing() const;
     bool isOpaque() const;
     bool isAlphaCutoffEnabled() const;
 
@@ -81,6 +85,8 @@ public Q_SLOTS:
     void setUsingColorAttribute(bool usingColorAttribute);
     void setDoubleSided(bool doubleSided);
     void setUseSkinning(bool useSkinning);
+    void setUseBakedSkinning(bool useBakedSkinning);
+    void setUseInstancing(bool useInstancing);
     void setOpaque(bool opaque);
     void setAlphaCutoffEnabled(bool enabled);
 
@@ -93,6 +99,8 @@ Q_SIGNALS:
     void usingColorAttributeChanged(bool usingColorAttribute);
     void doubleSidedChanged(bool doubleSided);
     void useSkinningChanged(bool useSkinning);
+    void useBakedSkinningChanged(bool useBakedSkinning);
+    void useInstancingChanged(bool useInstancing);
     void opaqueChanged(bool opaque);
     void alphaCutoffEnabledChanged(bool enabled);
 
@@ -105,6 +113,8 @@ private:
     bool m_usingColorAttribute;
     bool m_doubleSided;
     bool m_useSkinning;
+    bool m_useBakedSkinning;
+    bool m_useInstancing;
     bool m_invokeInitVertexShaderRequested;
     bool m_opaque;
     bool m_alphaCutoffEnabled;
@@ -113,9 +123,16 @@ private:
     Qt3DRender::QShaderProgramBuilder *m_metalRoughGL3ShaderBuilder;
     Qt3DRender::QShaderProgramBuilder *m_metalRoughES3ShaderBuilder;
     Qt3DRender::QShaderProgramBuilder *m_metalRoughES2ShaderBuilder;
+    Qt3DRender::QShaderProgramBuilder *m_metalRoughGL3OITShaderBuilder;
+    Qt3DRender::QShaderProgramBuilder *m_metalRoughES3OITShaderBuilder;
     Qt3DRender::QShaderProgram *m_metalRoughGL3Shader;
     Qt3DRender::QShaderProgram *m_metalRoughES3Shader;
     Qt3DRender::QShaderProgram *m_metalRoughES2Shader;
+    Qt3DRender::QShaderProgram *m_metalRoughGL3OITShader;
+    Qt3DRender::QShaderProgram *m_metalRoughES3OITShader;
+    Qt3DRender::QShaderProgram *m_zfillGL3Shader;
+    Qt3DRender::QShaderProgram *m_zfillES3Shader;
+    Qt3DRender::QShaderProgram *m_zfillES2Shader;
     Qt3DRender::QTechnique *m_metalRoughGL3Technique;
     Qt3DRender::QTechnique *m_metalRoughES3Technique;
     Qt3DRender::QTechnique *m_metalRoughES2Technique;
@@ -128,7 +145,10 @@ private:
     Qt3DRender::QRenderPass *m_transparentGL3RenderPass;
     Qt3DRender::QRenderPass *m_transparentES3RenderPass;
     Qt3DRender::QRenderPass *m_transparentES2RenderPass;
+    Qt3DRender::QRenderPass *m_transparentOITGL3RenderPass;
+    Qt3DRender::QRenderPass *m_transparentOITES3RenderPass;
 
+    void updateLayers(const QStringList &layers);
     Q_INVOKABLE void initVertexShader();
 };
 
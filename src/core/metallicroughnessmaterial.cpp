@@ -148,6 +148,17 @@ auto wrapParameterSignal(MetallicRoughnessMaterial *self, SignalType<OutputType>
  * \note If this property is changed from true to false or from false to true will trigger a recompilation of the shader.
  */
 
+/*! \property useBakedSkinning If true, the skinning matrices are fetched from the texture of a Kuesa::BakedSkinningAnimation
+ * instead of the skinning palette of an armature. This property is usually set by Kuesa::BakedSkinningAnimation::attach.
+ * \note If this property is changed from true to false or from false to true will trigger a recompilation of the shader.
+ * \sa Kuesa::BakedSkinningAnimation
+ */
+
+/*! \property useInstancing If true, the mesh is drawn once per instance, each instance being transformed by the instanceModelMatrix
+ * per instance attribute of the geometry. This property is set by the glTF importer on the materials of instanced meshes.
+ * \note If this property is changed from true to false or from false to true will trigger a recompilation of the shader.
+ */
+
 /*! \property opaque If true, the material is opaque. If false, the material is transparent and will use alpha blending for transparency.
  * \note This enable some extra render passes and will trigger a recompilation if changed from true to false or from false to true.
  */
@@ -254,6 +265,16 @@ auto wrapParameterSignal(MetallicRoughnessMaterial *self, SignalType<OutputType>
  * \note If this property is changed from true to false or from false to true will trigger a recompilation of the shader.
  */
 
+/*! \qmlproperty useBakedSkinning If true, the skinning matrices are fetched from the texture of a BakedSkinningAnimation
+ * instead of the skinning palette of an armature. This property is usually set by BakedSkinningAnimation.attach.
+ * \note If this property is changed from true to false or from false to true will trigger a recompilation of the shader.
+ */
+
+/*! \qmlproperty useInstancing If true, the mesh is drawn once per instance, each instance being transformed by the instanceModelMatrix
+ * per instance attribute of the geometry. This property is set by the glTF importer on the materials of instanced meshes.
+ * \note If this property is changed from true to false or from false to true will trigger a recompilation of the shader.
+ */
+
 /*! \qmlproperty opaque If true, the material is opaque. If false, the material is transparent and will use alpha blending for transparency.
  * \note This enable some extra render passes and will trigger a recompilation if changed from true to false or from false to true.
  */
@@ -315,6 +336,10 @@ MetallicRoughnessMaterial::MetallicRoughnessMaterial(Qt3DCore::QNode *parent)
                      this, &MetallicRoughnessMaterial::doubleSidedChanged);
     QObject::connect(m_effect, &MetallicRoughnessEffect::useSkinningChanged,
                      this, &MetallicRoughnessMaterial::useSkinningChanged);
+    QObject::connect(m_effect, &MetallicRoughnessEffect::useBakedSkinningChanged,
+                     this, &MetallicRoughnessMaterial::useBakedSkinningChanged);
+    QObject::connect(m_effect, &MetallicRoughnessEffect::useInstancingChanged,
+                     this, &MetallicRoughnessMaterial::useInstancingChanged);
     QObject::connect(m_effect, &MetallicRoughnessEffect::opaqueChanged,
                      this, &MetallicRoughnessMaterial::opaqueChanged);
     QObject::connect(m_effect, &MetallicRoughnessEffect::alphaCutoffEnabledChanged,
@@ -406,6 +431,16 @@ bool MetallicRoughnessMaterial::useSkinning() const
     return m_effect->useSkinning();
 }
 
+bool MetallicRoughnessMaterial::useBakedSkinning() const
+{
+    return m_effect->useBakedSkinning();
+}
+
+bool MetallicRoughnessMaterial::useInstancing() const
+{
+    return m_effect->useInstancing();
+}
+
 bool MetallicRoughnessMaterial::isOpaque() const
 {
     return m_effect->isOpaque();
@@ -431,7 +466,8 @@ void MetallicRoughnessMaterial::setBaseColorMap(QAbstractTexture *baseColorMap)
     if (m_baseColorMapParameter->value().value<QAbstractTexture *>() == baseColorMap)
         return;
 
-    baseColorMap->setFormat(QAbstractTexture::TextureFormat::SRGB8_Alpha8);
+    if (baseColorMap)
+        baseColorMap->setFormat(QAbstractTexture::TextureFormat::SRGB8_Alpha8);
     m_effect->setBaseColorMapEnabled(baseColorMap);
     m_baseColorMapParameter->setValue(QVariant::fromValue(baseColorMap));
     if (baseColorMap) {
@@ -542,6 +578,16 @@ void MetallicRoughnessMaterial::setUseSkinning(bool useSkinning)
     m_effect->setUseSkinning(useSkinning);
 }
 
+void MetallicRoughnessMaterial::setUseBakedSkinning(bool useBakedSkinning)
+{
+    m_effect->setUseBakedSkinning(useBakedSkinning);
+}
+
+void MetallicRoughnessMaterial::setUseInstancing(bool useInstancing)
+{
+    m_effect->setUseInstancing(useInstancing);
+}
+
 void MetallicRoughnessMaterial::setOpaque(bool opaque)
 {
     m_effect->setOpaque(opaque);
@@ -73,6 +73,8 @@ class KUESASHARED_EXPORT MetallicRoughnessMaterial : public Qt3DRender::QMateria
     Q_PROPERTY(bool usingColorAttribute READ isUsingColorAttribute WRITE setUsingColorAttribute NOTIFY usingColorAttributeChanged)
     Q_PROPERTY(bool doubleSided READ isDoubleSided WRITE setDoubleSided NOTIFY doubleSidedChanged)
     Q_PROPERTY(bool useSkinning READ useSkinning WRITE setUseSkinning NOTIFY useSkinningChanged)
+    Q_PROPERTY(bool useBakedSkinning READ useBakedSkinning WRITE setUseBakedSkinning NOTIFY useBakedSkinningChanged)
+    Q_PROPERTY(bool useInstancing READ useInstancing WRITE setUseInstancing NOTIFY useInstancingChanged)
     Q_PROPERTY(bool opaque READ isOpaque WRITE setOpaque NOTIFY opaqueChanged)
     Q_PROPERTY(float alphaCutoff READ alphaCutoff WRITE setAlphaCutoff NOTIFY alphaCutoffChanged)
     Q_PROPERTY(bool alphaCutoffEnabled READ isAlphaCutoffEnabled WRITE setAlphaCutoffEnabled NOTIFY alphaCutoffEnabledChanged)
@@ -99,6 +101,8 @@ public:
     bool isUsingColorAttribute() const;
     bool isDoubleSided() const;
     bool useSkinning() const;
+    bool useBakedSkinning() const;
+    bool useInstancing() const;
     bool isOpaque() const;
     bool isAlphaCutoffEnabled() const;
     float alphaCutoff() const;
@@ -123,6 +127,8 @@ public Q_SLOTS:
     void setUsingColorAttribute(bool usingColorAttribute);
     void setDoubleSided(bool doubleSided);
     void setUseSkinning(bool useSkinning);
+    void setUseBakedSkinning(bool useBakedSkinning);
+    void setUseInstancing(bool useInstancing);
     void setOpaque(bool opaque);
     void setAlphaCutoffEnabled(bool enabled);
     void setAlphaCutoff(float alphaCutoff);
@@ -147,6 +153,8 @@ Q_SIGNALS:
     void usingColorAttributeChanged(bool usingColorAttribute);
     void doubleSidedChanged(bool doubleSided);
     void useSkinningChanged(bool useSkinning);
+    void useBakedSkinningChanged(bool useBakedSkinning);
+    void useInstancingChanged(bool useInstancing);
     void opaqueChanged(bool opaque);
     void alphaCutoffEnabledChanged(bool enabled);
     void alphaCutoffChanged(float value);
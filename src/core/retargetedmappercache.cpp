@@ -0,0 +1,182 @@
+/*
+    retargetedmappercache.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "retargetedmappercache_p.h"
+
+#include <Qt3DAnimation/QChannelMapper>
+#include <Qt3DAnimation/QChannelMapping>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+
+namespace {
+Q_GLOBAL_STATIC(RetargetedMapperCache, retargetedMapperCache)
+} // namespace
+
+/*!
+ * \class Kuesa::RetargetedMapperCache
+ * \internal
+ *
+ * Shares the Qt3DAnimation::QChannelMapper instances AnimationPlayer creates
+ * when an animation is applied to explicit targets.
+ *
+ * Retargeted mappers are keyed by the source mapper and the list of targets.
+ * Players requesting the same combination get the same mapper instance
+ * which avoids creating one backend node per mapping per player.
+ *
+ * Mappers are reference counted and destroyed once they are no longer used
+ * or when the source mapper or any of the targets is destroyed.
+ */
+
+RetargetedMapperCache::RetargetedMapperCache()
+    : QObject()
+{
+}
+
+RetargetedMapperCache::~RetargetedMapperCache()
+{
+    // Mappers are owned by their source mapper, only drop the connections
+    for (const Entry &entry : qAsConst(m_entries)) {
+        for (const auto &connection : entry.destructionConnections)
+            QObject::disconnect(connection);
+    }
+}
+
+/*!
+ * Returns the process wide cache instance.
+ */
+RetargetedMapperCache *RetargetedMapperCache::instance()
+{
+    return retargetedMapperCache();
+}
+
+/*!
+ * Returns a mapper mapping the channels of \a sourceMapper onto \a targets,
+ * creating it if no such mapper exists yet. Each call must be balanced
+ * by a call to release().
+ */
+Qt3DAnimation::QChannelMapper *RetargetedMapperCache::acquire(Qt3DAnimation::QChannelMapper *sourceMapper,
+                                                              const QVector<Qt3DCore::QNode *> &targets)
+{
+    if (sourceMapper == nullptr)
+        return nullptr;
+
+    const Key key(sourceMapper, targets);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        Entry entry;
+        entry.mapper = createRetargetedMapper(sourceMapper, targets);
+
+        // Evict entries referencing destroyed nodes so that we don't hand out
+        // mappers pointing to dangling targets if an address gets reused
+        auto evictEntry = [this, key]() { evict(key); };
+        entry.destructionConnections.push_back(QObject::connect(sourceMapper, &Qt3DCore::QNode::nodeDestroyed, this, evictEntry));
+        for (Qt3DCore::QNode *target : targets)
+            entry.destructionConnections.push_back(QObject::connect(target, &Qt3DCore::QNode::nodeDestroyed, this, evictEntry));
+
+        m_keys.insert(entry.mapper, key);
+        it = m_entries.insert(key, entry);
+    }
+
+    ++it->refCount;
+    return it->mapper;
+}
+
+/*!
+ * Releases a mapper previously returned by acquire(). The mapper is destroyed
+ * when no user is left.
+ */
+void RetargetedMapperCache::release(Qt3DAnimation::QChannelMapper *retargetedMapper)
+{
+    const auto keyIt = m_keys.constFind(retargetedMapper);
+    if (keyIt == m_keys.cend())
+        return;
+
+    const Key key = keyIt.value();
+    Entry &entry = m_entries[key];
+    if (--entry.refCount <= 0)
+        evict(key);
+}
+
+/*!
+ * Returns the number of retargeted mappers currently alive.
+ */
+int RetargetedMapperCache::mapperCount() const
+{
+    return m_entries.size();
+}
+
+/*!
+ * Returns the number of users of \a retargetedMapper.
+ */
+int RetargetedMapperCache::referenceCount(Qt3DAnimation::QChannelMapper *retargetedMapper) const
+{
+    const auto keyIt = m_keys.constFind(retargetedMapper);
+    if (keyIt == m_keys.cend())
+        return 0;
+    return m_entries.value(keyIt.value()).refCount;
+}
+
+Qt3DAnimation::QChannelMapper *RetargetedMapperCache::createRetargetedMapper(Qt3DAnimation::QChannelMapper *sourceMapper,
+                                                                             const QVector<Qt3DCore::QNode *> &targets)
+{
+    // Parent to the source mapper so that the retargeted mapper doesn't
+    // depend on the lifetime of the first player that requested it
+    auto newMapper = new Qt3DAnimation::QChannelMapper(sourceMapper);
+
+    const QVector<Qt3DAnimation::QAbstractChannelMapping *> mappings = sourceMapper->mappings();
+    for (int mappingId = 0, m = std::min(mappings.size(), targets.size()); mappingId < m; ++mappingId) {
+        auto oldMapping = qobject_cast<Qt3DAnimation::QChannelMapping *>(mappings.at(mappingId));
+        if (!oldMapping)
+            continue;
+        auto newMapping = new Qt3DAnimation::QChannelMapping;
+        newMapping->setChannelName(oldMapping->channelName());
+        newMapping->setProperty(oldMapping->property());
+        newMapping->setTarget(targets.at(mappingId));
+        newMapper->addMapping(newMapping);
+    }
+
+    return newMapper;
+}
+
+void RetargetedMapperCache::evict(const Key &key)
+{
+    const Entry entry = m_entries.take(key);
+    if (entry.mapper == nullptr)
+        return;
+
+    for (const auto &connection : entry.destructionConnections)
+        QObject::disconnect(connection);
+    m_keys.remove(entry.mapper);
+    delete entry.mapper;
+}
+
+QT_END_NAMESPACE
@@ -28,8 +28,13 @@
 
 #include "sceneentity.h"
 #include "kuesa_utils_p.h"
+#include "scenequery_p.h"
 
 #include <Qt3DCore/QTransform>
+#include <Qt3DRender/QLevelOfDetailSwitch>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 QT_BEGIN_NAMESPACE
 
@@ -42,6 +47,40 @@ static void initResources()
 
 using namespace Kuesa;
 
+namespace {
+
+// The glTF importer adds the levels of detail of a node to a child entity
+Qt3DRender::QLevelOfDetailSwitch *levelOfDetailSwitch(Qt3DCore::QEntity *entity)
+{
+    if (entity == nullptr)
+        return nullptr;
+    const auto childNodes = entity->childNodes();
+    for (Qt3DCore::QNode *childNode : childNodes) {
+        auto childEntity = qobject_cast<Qt3DCore::QEntity *>(childNode);
+        if (childEntity == nullptr)
+            continue;
+        auto lodSwitch = componentFromEntity<Qt3DRender::QLevelOfDetailSwitch>(childEntity);
+        if (lodSwitch != nullptr)
+            return lodSwitch;
+    }
+    return nullptr;
+}
+
+float maximumScale(Qt3DCore::QEntity *entity)
+{
+    QMatrix4x4 worldMatrix;
+    for (Qt3DCore::QEntity *e = entity; e != nullptr; e = e->parentEntity()) {
+        auto transform = componentFromEntity<Qt3DCore::QTransform>(e);
+        if (transform != nullptr)
+            worldMatrix = transform->matrix() * worldMatrix;
+    }
+    return std::max({ worldMatrix.column(0).toVector3D().length(),
+                      worldMatrix.column(1).toVector3D().length(),
+                      worldMatrix.column(2).toVector3D().length() });
+}
+
+} // namespace
+
 /*!
  * \class Kuesa::SceneEntity
  * \inheaderfile Kuesa/SceneEntity
@@ -109,8 +148,12 @@ SceneEntity::SceneEntity(Qt3DCore::QNode *parent)
     , m_entities(new EntityCollection(this))
     , m_textureImages(new TextureImageCollection(this))
     , m_animationMappings(new AnimationMappingCollection(this))
+    , m_sceneQuery(new SceneQuery(this))
+    , m_levelOfDetailCamera(nullptr)
 {
     initResources();
+
+    QObject::connect(this, &SceneEntity::loadingDone, this, &SceneEntity::updateLevelsOfDetail);
 }
 
 /*!
@@ -349,4 +392,202 @@ Qt3DCore::QNode *SceneEntity::transformForEntity(const QString &name)
     return componentFromEntity<Qt3DCore::QTransform>(e);
 }
 
+/*!
+ * Returns the name of the nearest entity of the EntityCollection hit by the
+ * ray going from \a origin in \a direction, in world space, or an empty
+ * string if none is hit.
+ *
+ * Ray casts are done on the CPU against the triangles of the meshes of the
+ * entities, which are expected not to change once loaded. Meshes are indexed
+ * on worker threads the first time the scene is queried. Entities whose
+ * meshes were merged or instanced with others at import are only tested
+ * against their bounds, and skinned meshes are ignored.
+ *
+ * \sa castRay
+ */
+QString SceneEntity::pick(const QVector3D &origin, const QVector3D &direction)
+{
+    return pick(origin, direction, nullptr);
+}
+
+/*!
+ * \overload
+ *
+ * Also sets \a distance, if not null, to the distance along the ray from
+ * \a origin to the hit point.
+ */
+QString SceneEntity::pick(const QVector3D &origin, const QVector3D &direction, float *distance)
+{
+    const QVector<SceneQuery::RayHit> hits = m_sceneQuery->castRay(origin, direction, true);
+    if (hits.isEmpty())
+        return QString();
+    if (distance != nullptr)
+        *distance = hits.first().distance;
+    return hits.first().entityName;
+}
+
+/*!
+ * Returns the names of all the entities of the EntityCollection hit by the
+ * ray going from \a origin in \a direction, in world space, nearest first.
+ *
+ * \sa pick
+ */
+QStringList SceneEntity::castRay(const QVector3D &origin, const QVector3D &direction)
+{
+    QStringList names;
+    const QVector<SceneQuery::RayHit> hits = m_sceneQuery->castRay(origin, direction, false);
+    names.reserve(hits.size());
+    for (const SceneQuery::RayHit &hit : hits)
+        names.push_back(hit.entityName);
+    return names;
+}
+
+/*!
+ * Returns the names of the entities of the EntityCollection whose bounds
+ * intersect the world space box going from \a boxMin to \a boxMax.
+ */
+QStringList SceneEntity::entitiesInBox(const QVector3D &boxMin, const QVector3D &boxMax)
+{
+    BoundingBox box;
+    box.min = boxMin;
+    box.max = boxMax;
+    return m_sceneQuery->entitiesInBox(box);
+}
+
+/*!
+ * Returns the names of the entities of the EntityCollection whose bounds
+ * intersect the view frustum of the camera with the \a viewProjection
+ * matrix, usually projectionMatrix * viewMatrix.
+ *
+ * The test is conservative: bounds lying near the corners of the frustum
+ * may be reported even though they are outside of it.
+ */
+QStringList SceneEntity::entitiesInFrustum(const QMatrix4x4 &viewProjection)
+{
+    return m_sceneQuery->entitiesInFrustum(viewProjection);
+}
+
+/*!
+ * \property SceneEntity::levelOfDetailCamera
+ *
+ * Holds the camera used to switch between the levels of detail of the
+ * entities loaded from glTF files using the MSFT_lod extension.
+ *
+ * The level used for an entity is the last one whose screen coverage is
+ * reached by the bounding sphere of the entity, as seen from the camera. The
+ * entity isn't drawn at all below the screen coverage of its last level. Only
+ * the first level is drawn as long as no camera is set.
+ *
+ * \sa screenCoverages
+ */
+Qt3DRender::QCamera *SceneEntity::levelOfDetailCamera() const
+{
+    return m_levelOfDetailCamera;
+}
+
+void SceneEntity::setLevelOfDetailCamera(Qt3DRender::QCamera *levelOfDetailCamera)
+{
+    if (m_levelOfDetailCamera == levelOfDetailCamera)
+        return;
+
+    if (m_levelOfDetailCamera) {
+        QObject::disconnect(m_levelOfDetailCameraDestroyedConnection);
+        QObject::disconnect(m_levelOfDetailCameraFieldOfViewConnection);
+    }
+
+    m_levelOfDetailCamera = levelOfDetailCamera;
+    if (m_levelOfDetailCamera) {
+        auto f = [this]() { setLevelOfDetailCamera(nullptr); };
+        m_levelOfDetailCameraDestroyedConnection = QObject::connect(m_levelOfDetailCamera, &Qt3DCore::QNode::nodeDestroyed, this, f);
+        m_levelOfDetailCameraFieldOfViewConnection = QObject::connect(m_levelOfDetailCamera, &Qt3DRender::QCamera::fieldOfViewChanged,
+                                                                      this, &SceneEntity::updateLevelsOfDetail);
+    }
+
+    updateLevelsOfDetail();
+    emit levelOfDetailCameraChanged(m_levelOfDetailCamera);
+}
+
+/*!
+ * Returns the minimum screen coverages of the levels of detail of the entity
+ * called \a entityName, as read from the MSFT_screencoverage extra of its
+ * glTF node.
+ *
+ * A screen coverage is the ratio between the area of the square bounding the
+ * projected bounding sphere of the entity and the one of a square filling the
+ * viewport vertically.
+ *
+ * \sa levelOfDetailCamera
+ */
+QVector<qreal> SceneEntity::screenCoverages(const QString &entityName) const
+{
+    Qt3DRender::QLevelOfDetailSwitch *lodSwitch = levelOfDetailSwitch(entity(entityName));
+    if (lodSwitch == nullptr)
+        return {};
+    return lodSwitch->property("screenCoverages").value<QVector<qreal>>();
+}
+
+/*!
+ * Overrides the minimum screen coverages of the levels of detail of the
+ * entity called \a entityName with \a screenCoverages, one per level.
+ *
+ * \sa screenCoverages
+ */
+void SceneEntity::setScreenCoverages(const QString &entityName, const QVector<qreal> &screenCoverages)
+{
+    Qt3DRender::QLevelOfDetailSwitch *lodSwitch = levelOfDetailSwitch(entity(entityName));
+    if (lodSwitch == nullptr)
+        return;
+    lodSwitch->setProperty("screenCoverages", QVariant::fromValue(screenCoverages));
+    updateLevelsOfDetail();
+}
+
+/*!
+ * \internal
+ *
+ * Converts the screen coverages of the levels of detail to distances to the
+ * camera, given its field of view, as Qt3D only handles distances and pixel
+ * sizes.
+ */
+void SceneEntity::updateLevelsOfDetail()
+{
+    const float tanHalfFieldOfView = m_levelOfDetailCamera ? std::tan(qDegreesToRadians(m_levelOfDetailCamera->fieldOfView()) * 0.5f) : 0.0f;
+    const QStringList names = m_entities->names();
+    for (const QString &name : names) {
+        Qt3DRender::QLevelOfDetailSwitch *lodSwitch = levelOfDetailSwitch(entity(name));
+        if (lodSwitch == nullptr)
+            continue;
+
+        lodSwitch->setCamera(m_levelOfDetailCamera);
+        const QVector<qreal> screenCoverages = lodSwitch->property("screenCoverages").value<QVector<qreal>>();
+        if (m_levelOfDetailCamera == nullptr || screenCoverages.isEmpty() || qFuzzyIsNull(tanHalfFieldOfView)) {
+            lodSwitch->setThresholds({});
+            lodSwitch->setCurrentIndex(0);
+            continue;
+        }
+
+        // The last level is the culled one
+        Qt3DCore::QEntity *lodEntity = lodSwitch->entities().isEmpty() ? nullptr : lodSwitch->entities().first();
+        int levelCount = 0;
+        if (lodEntity != nullptr) {
+            const auto childNodes = lodEntity->childNodes();
+            levelCount = int(std::count_if(childNodes.begin(), childNodes.end(),
+                                           [](Qt3DCore::QNode *node) { return qobject_cast<Qt3DCore::QEntity *>(node) != nullptr; })) - 1;
+        }
+        if (levelCount <= 0)
+            continue;
+
+        // Projected radius over half the viewport height, squared
+        const float radius = lodSwitch->volumeOverride().radius() * maximumScale(lodEntity);
+        QVector<qreal> thresholds;
+        thresholds.reserve(levelCount + 1);
+        for (int level = 0; level < levelCount; ++level) {
+            const qreal screenCoverage = screenCoverages.at(std::min(level, screenCoverages.size() - 1));
+            thresholds.push_back(screenCoverage > 0.0 ? radius / (tanHalfFieldOfView * std::sqrt(screenCoverage))
+                                                      : std::numeric_limits<qreal>::max());
+        }
+        thresholds.push_back(std::numeric_limits<qreal>::max());
+        lodSwitch->setThresholds(thresholds);
+    }
+}
+
 QT_END_NAMESPACE
@@ -30,6 +30,8 @@
 #define KUESA_SCENEENTITY_H
 
 #include <Qt3DCore/qentity.h>
+#include <QtGui/qmatrix4x4.h>
+#include <QtGui/qvector3d.h>
 #include <Kuesa/animationclipcollection.h>
 #include <Kuesa/armaturecollection.h>
 #include <Kuesa/effectcollection.h>
@@ -52,6 +54,8 @@ class QTransform;
 
 namespace Kuesa {
 
+class SceneQuery;
+
 class KUESASHARED_EXPORT SceneEntity : public Qt3DCore::QEntity
 {
     Q_OBJECT
@@ -66,6 +70,7 @@ class KUESASHARED_EXPORT SceneEntity : public Qt3DCore::QEntity
     Q_PROPERTY(Kuesa::EntityCollection *entities READ entities NOTIFY loadingDone)
     Q_PROPERTY(Kuesa::TextureImageCollection *textureImages READ textureImages NOTIFY loadingDone)
     Q_PROPERTY(Kuesa::AnimationMappingCollection *animationMappings READ animationMappings NOTIFY loadingDone)
+    Q_PROPERTY(Qt3DRender::QCamera *levelOfDetailCamera READ levelOfDetailCamera WRITE setLevelOfDetailCamera NOTIFY levelOfDetailCameraChanged)
 
 public:
     SceneEntity(Qt3DCore::QNode *parent = nullptr);
@@ -110,8 +115,22 @@ public:
 
     Q_INVOKABLE Qt3DCore::QNode *transformForEntity(const QString &name);
 
+    Q_INVOKABLE QString pick(const QVector3D &origin, const QVector3D &direction);
+    QString pick(const QVector3D &origin, const QVector3D &direction, float *distance);
+    Q_INVOKABLE QStringList castRay(const QVector3D &origin, const QVector3D &direction);
+    Q_INVOKABLE QStringList entitiesInBox(const QVector3D &boxMin, const QVector3D &boxMax);
+    Q_INVOKABLE QStringList entitiesInFrustum(const QMatrix4x4 &viewProjection);
+
+    Qt3DRender::QCamera *levelOfDetailCamera() const;
+    Q_INVOKABLE QVector<qreal> screenCoverages(const QString &entityName) const;
+    Q_INVOKABLE void setScreenCoverages(const QString &entityName, const QVector<qreal> &screenCoverages);
+
+public Q_SLOTS:
+    void setLevelOfDetailCamera(Qt3DRender::QCamera *levelOfDetailCamera);
+
 Q_SIGNALS:
     void loadingDone();
+    void levelOfDetailCameraChanged(Qt3DRender::QCamera *levelOfDetailCamera);
 
 private:
     AnimationClipCollection *m_clips;
@@ -126,6 +145,12 @@ private:
     EntityCollection *m_entities;
     TextureImageCollection *m_textureImages;
     AnimationMappingCollection *m_animationMappings;
+    SceneQuery *m_sceneQuery;
+    Qt3DRender::QCamera *m_levelOfDetailCamera;
+    QMetaObject::Connection m_levelOfDetailCameraDestroyedConnection;
+    QMetaObject::Connection m_levelOfDetailCameraFieldOfViewConnection;
+
+    void updateLevelsOfDetail();
 };
 
 } // namespace Kuesa
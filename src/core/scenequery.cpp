@@ -0,0 +1,412 @@
+/*
+    scenequery.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "scenequery_p.h"
+#include "sceneentity.h"
+#include "kuesa_utils_p.h"
+#include "geometryutils_p.h"
+
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtGui/QVector4D>
+#include <Qt3DCore/QTransform>
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+#include <Qt3DRender/QGeometryRenderer>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Kuesa;
+
+namespace {
+
+Qt3DRender::QAttribute *findAttribute(Qt3DRender::QGeometry *geometry, const QString &name)
+{
+    const auto attributes = geometry->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->name() == name)
+            return attribute;
+    }
+    return nullptr;
+}
+
+// Copies what the worker thread needs to build the BVH of the mesh
+MeshBvh::MeshData meshData(Qt3DRender::QGeometryRenderer *renderer)
+{
+    MeshBvh::MeshData data;
+    Qt3DRender::QGeometry *geometry = renderer->geometry();
+    Qt3DRender::QAttribute *positionAttribute = findAttribute(geometry, Qt3DRender::QAttribute::defaultPositionAttributeName());
+    if (positionAttribute == nullptr || positionAttribute->buffer() == nullptr || positionAttribute->vertexSize() < 3)
+        return data;
+
+    data.positionData = positionAttribute->buffer()->data();
+    data.positionType = positionAttribute->vertexBaseType();
+    data.positionOffset = positionAttribute->byteOffset();
+    data.positionStride = GLTF2Import::attributeElementStride(positionAttribute);
+    data.vertexCount = positionAttribute->count();
+
+    Qt3DRender::QAttribute *indexAttribute = nullptr;
+    const auto attributes = geometry->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->attributeType() == Qt3DRender::QAttribute::IndexAttribute && attribute->buffer() != nullptr) {
+            indexAttribute = attribute;
+            break;
+        }
+    }
+
+    if (indexAttribute != nullptr) {
+        data.indexData = indexAttribute->buffer()->data();
+        data.indexType = indexAttribute->vertexBaseType();
+        data.indexOffset = indexAttribute->byteOffset();
+        data.indexStride = GLTF2Import::attributeElementStride(indexAttribute);
+        data.first = uint(renderer->indexOffset());
+        data.count = renderer->vertexCount() > 0 ? uint(renderer->vertexCount()) : indexAttribute->count();
+    } else {
+        data.first = uint(renderer->firstVertex());
+        data.count = renderer->vertexCount() > 0 ? uint(renderer->vertexCount()) : data.vertexCount;
+    }
+    return data;
+}
+
+// Per instance matrices of the instanced geometries created by the importer
+QVector<QMatrix4x4> instanceMatrices(Qt3DRender::QGeometry *geometry)
+{
+    QVector<QMatrix4x4> matrices;
+    Qt3DRender::QAttribute *attribute = findAttribute(geometry, QStringLiteral("instanceModelMatrix"));
+    if (attribute == nullptr || attribute->divisor() == 0 ||
+        attribute->vertexBaseType() != Qt3DRender::QAttribute::Float || attribute->vertexSize() != 16 ||
+        !GLTF2Import::isAttributeReadable(attribute))
+        return matrices;
+
+    const QByteArray data = attribute->buffer()->data();
+    const char *rawData = data.constData() + attribute->byteOffset();
+    const uint stride = GLTF2Import::attributeElementStride(attribute);
+    matrices.reserve(int(attribute->count()));
+    for (uint i = 0; i < attribute->count(); ++i) {
+        float values[16];
+        memcpy(values, rawData + i * stride, sizeof(values));
+        // Stored column major
+        matrices.push_back(QMatrix4x4(values).transposed());
+    }
+    return matrices;
+}
+
+BoundingBox transformedBounds(const QMatrix4x4 &matrix, const BoundingBox &bounds)
+{
+    BoundingBox transformed = bounds;
+    GLTF2Import::transformBounds(matrix, transformed.min, transformed.max);
+    return transformed;
+}
+
+} // namespace
+
+/*!
+ * \class Kuesa::SceneQuery
+ * \internal
+ *
+ * Answers the ray casts and volume queries of a SceneEntity, for the
+ * entities of its EntityCollection.
+ *
+ * A top level BVH bounds the entities in world space, from the bounds the
+ * glTF importer stores on them. It is rebuilt when the transform of an entity
+ * or of one of its ancestors changes.
+ *
+ * Ray casts then go through the triangles of the primitives of the entities,
+ * its child entities which aren't in the collection, using a BVH per mesh in
+ * the space of its positions. Mesh BVHs are built on worker threads, the
+ * first time the scene is queried. Meshes are expected to be static, the BVH
+ * of a mesh is only built again when its geometry is replaced, as when the
+ * glTF importer updates a reloaded file in place.
+ * Entities whose primitives were merged or instanced with others by the
+ * importer are only tested against their bounds.
+ */
+
+SceneQuery::SceneQuery(SceneEntity *sceneEntity)
+    : QObject(sceneEntity)
+    , m_sceneEntity(sceneEntity)
+    , m_targetsDirty(true)
+    , m_worldDirty(true)
+{
+    QObject::connect(sceneEntity, &SceneEntity::loadingDone, this, [this] { invalidateTargets(); });
+    QObject::connect(sceneEntity->entities(), &AbstractAssetCollection::namesChanged, this, [this] { invalidateTargets(); });
+}
+
+SceneQuery::~SceneQuery()
+{
+    for (QFuture<QSharedPointer<MeshBvh>> &future : m_meshBvhs)
+        future.waitForFinished();
+}
+
+/*!
+ * Returns the entities hit by the ray going from \a origin in \a direction,
+ * nearest first, or only the nearest one if \a nearestOnly is true.
+ */
+QVector<SceneQuery::RayHit> SceneQuery::castRay(const QVector3D &origin, const QVector3D &direction, bool nearestOnly)
+{
+    QVector<RayHit> hits;
+    const float length = direction.length();
+    if (qFuzzyIsNull(length))
+        return hits;
+
+    update();
+
+    // Distances are along the normalized direction
+    const QVector3D unitDirection = direction / length;
+    const QVector<int> &items = m_topLevelBvh.items();
+    m_topLevelBvh.castRay(origin, unitDirection, std::numeric_limits<float>::max(), [&](int slot, float maxDistance) {
+        const Target &target = m_targets.at(items.at(slot));
+        float distance = 0.0f;
+        if (!castRay(target, origin, unitDirection, maxDistance, &distance))
+            return maxDistance;
+        hits.push_back({ target.name, distance });
+        return nearestOnly ? distance : maxDistance;
+    });
+
+    std::sort(hits.begin(), hits.end(), [](const RayHit &a, const RayHit &b) { return a.distance < b.distance; });
+    if (nearestOnly && hits.size() > 1)
+        hits.resize(1);
+    return hits;
+}
+
+/*!
+ * Returns the names of the entities whose world space bounds intersect \a box.
+ */
+QStringList SceneQuery::entitiesInBox(const BoundingBox &box)
+{
+    update();
+
+    QStringList names;
+    m_topLevelBvh.query([&box](const BoundingBox &bounds) { return bounds.intersects(box); },
+                        [&](int item) { names.push_back(m_targets.at(item).name); });
+    return names;
+}
+
+/*!
+ * Returns the names of the entities whose world space bounds aren't
+ * entirely outside of one of the planes of the frustum of \a viewProjection.
+ */
+QStringList SceneQuery::entitiesInFrustum(const QMatrix4x4 &viewProjection)
+{
+    update();
+
+    // Planes facing the inside of the frustum, from the rows of the matrix
+    QVector4D planes[6];
+    for (int axis = 0; axis < 3; ++axis) {
+        planes[2 * axis] = viewProjection.row(3) + viewProjection.row(axis);
+        planes[2 * axis + 1] = viewProjection.row(3) - viewProjection.row(axis);
+    }
+
+    const auto isInFrustum = [&planes](const BoundingBox &bounds) {
+        for (const QVector4D &plane : planes) {
+            // Corner of the box the farthest along the plane normal
+            const QVector3D corner(plane.x() >= 0.0f ? bounds.max.x() : bounds.min.x(),
+                                   plane.y() >= 0.0f ? bounds.max.y() : bounds.min.y(),
+                                   plane.z() >= 0.0f ? bounds.max.z() : bounds.min.z());
+            if (QVector3D::dotProduct(plane.toVector3D(), corner) + plane.w() < 0.0f)
+                return false;
+        }
+        return true;
+    };
+
+    QStringList names;
+    m_topLevelBvh.query(isInFrustum, [&](int item) { names.push_back(m_targets.at(item).name); });
+    return names;
+}
+
+void SceneQuery::invalidateTargets()
+{
+    m_targetsDirty = true;
+    m_worldDirty = true;
+}
+
+void SceneQuery::update()
+{
+    if (m_targetsDirty) {
+        gatherTargets();
+        m_targetsDirty = false;
+        m_worldDirty = true;
+    }
+
+    if (!m_worldDirty)
+        return;
+
+    QVector<BoundingBox> worldBounds;
+    worldBounds.reserve(m_targets.size());
+    for (Target &target : m_targets) {
+        target.worldMatrix = worldMatrix(target.entity);
+        target.inverseWorldMatrix = target.worldMatrix.inverted();
+        target.worldBounds = transformedBounds(target.worldMatrix, target.localBounds);
+        worldBounds.push_back(target.worldBounds);
+    }
+
+    // One entity per leaf, leaves are then exact
+    m_topLevelBvh.build(worldBounds, 1);
+    m_worldDirty = false;
+}
+
+void SceneQuery::gatherTargets()
+{
+    m_targets.clear();
+
+    EntityCollection *entities = m_sceneEntity->entities();
+    const QStringList names = entities->names();
+    QSet<Qt3DCore::QEntity *> namedEntities;
+    for (const QString &name : names)
+        namedEntities.insert(entities->find(name));
+
+    for (const QString &name : names) {
+        Target target;
+        target.name = name;
+        target.entity = entities->find(name);
+        if (target.entity == nullptr)
+            continue;
+
+        // The primitives of a node are child entities without a name
+        addPrimitives(target, target.entity, QMatrix4x4());
+        const auto childNodes = target.entity->childNodes();
+        for (Qt3DCore::QNode *childNode : childNodes) {
+            auto child = qobject_cast<Qt3DCore::QEntity *>(childNode);
+            if (child == nullptr || namedEntities.contains(child))
+                continue;
+            auto transform = componentFromEntity<Qt3DCore::QTransform>(child);
+            addPrimitives(target, child, transform ? transform->matrix() : QMatrix4x4());
+        }
+
+        // Entities not imported have to wait for the BVHs of their meshes
+        if (!GLTF2Import::bounds(target.entity, target.localBounds.min, target.localBounds.max)) {
+            for (const Primitive &primitive : qAsConst(target.primitives))
+                target.localBounds.unite(transformedBounds(primitive.matrix, meshBvh(primitive.renderer)->bounds()));
+        }
+
+        if (!target.localBounds.isEmpty())
+            m_targets.push_back(target);
+    }
+
+    // Drop the BVHs of the meshes which aren't used anymore
+    QSet<Qt3DRender::QGeometryRenderer *> usedRenderers;
+    for (const Target &target : qAsConst(m_targets)) {
+        for (const Primitive &primitive : target.primitives)
+            usedRenderers.insert(primitive.renderer);
+    }
+    for (auto it = m_meshBvhs.begin(); it != m_meshBvhs.end();) {
+        if (!usedRenderers.contains(it.key())) {
+            QObject::disconnect(it.key(), nullptr, this, nullptr);
+            it = m_meshBvhs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SceneQuery::addPrimitives(Target &target, Qt3DCore::QEntity *entity, const QMatrix4x4 &matrix)
+{
+    auto renderer = componentFromEntity<Qt3DRender::QGeometryRenderer>(entity);
+    if (renderer == nullptr || renderer->geometry() == nullptr ||
+        renderer->primitiveType() != Qt3DRender::QGeometryRenderer::Triangles)
+        return;
+
+    const QVector<QMatrix4x4> instances = instanceMatrices(renderer->geometry());
+    if (instances.isEmpty()) {
+        target.primitives.push_back({ renderer, matrix, matrix.inverted() });
+    } else {
+        for (const QMatrix4x4 &instance : instances) {
+            const QMatrix4x4 instanceMatrix = matrix * instance;
+            target.primitives.push_back({ renderer, instanceMatrix, instanceMatrix.inverted() });
+        }
+    }
+
+    // Start building the BVH of the mesh
+    if (!m_meshBvhs.contains(renderer)) {
+        m_meshBvhs.insert(renderer, QtConcurrent::run(&MeshBvh::build, meshData(renderer)));
+        QObject::connect(renderer, &QObject::destroyed, this, [this, renderer] {
+            m_meshBvhs.remove(renderer);
+            invalidateTargets();
+        });
+        // Meshes updated in place when reloading get a new geometry
+        QObject::connect(renderer, &Qt3DRender::QGeometryRenderer::geometryChanged, this, [this, renderer] {
+            QObject::disconnect(renderer, nullptr, this, nullptr);
+            m_meshBvhs.remove(renderer);
+            invalidateTargets();
+        });
+    }
+}
+
+QMatrix4x4 SceneQuery::worldMatrix(Qt3DCore::QEntity *entity)
+{
+    QMatrix4x4 matrix;
+    for (Qt3DCore::QEntity *e = entity; e != nullptr; e = e->parentEntity()) {
+        auto transform = componentFromEntity<Qt3DCore::QTransform>(e);
+        if (transform == nullptr)
+            continue;
+        matrix = transform->matrix() * matrix;
+
+        if (!m_observedTransforms.contains(transform)) {
+            m_observedTransforms.insert(transform);
+            QObject::connect(transform, &Qt3DCore::QTransform::matrixChanged, this, [this] { m_worldDirty = true; });
+            QObject::connect(transform, &QObject::destroyed, this, [this, transform] {
+                m_observedTransforms.remove(transform);
+                invalidateTargets();
+            });
+        }
+    }
+    return matrix;
+}
+
+QSharedPointer<MeshBvh> SceneQuery::meshBvh(Qt3DRender::QGeometryRenderer *renderer)
+{
+    // Blocks until the worker thread is done with it
+    return m_meshBvhs.value(renderer).result();
+}
+
+bool SceneQuery::castRay(const Target &target, const QVector3D &origin, const QVector3D &direction, float maxDistance, float *distance)
+{
+    // Entities without primitives only have their bounds, which the ray hits
+    // as target was found by the top level BVH
+    if (target.primitives.isEmpty()) {
+        const QVector3D inverseDirection(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+        return target.worldBounds.intersectsRay(origin, inverseDirection, maxDistance, distance);
+    }
+
+    // Affine transforms preserve the distances along the ray direction
+    const QVector3D localOrigin = target.inverseWorldMatrix * origin;
+    const QVector3D localDirection = target.inverseWorldMatrix.mapVector(direction);
+    bool hit = false;
+    for (const Primitive &primitive : target.primitives) {
+        const QVector3D primitiveOrigin = primitive.inverseMatrix * localOrigin;
+        const QVector3D primitiveDirection = primitive.inverseMatrix.mapVector(localDirection);
+        float primitiveDistance = 0.0f;
+        if (meshBvh(primitive.renderer)->castRay(primitiveOrigin, primitiveDirection, maxDistance, &primitiveDistance)) {
+            maxDistance = primitiveDistance;
+            *distance = primitiveDistance;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,124 @@
+/*
+    scenequery_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_SCENEQUERY_P_H
+#define KUESA_SCENEQUERY_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Kuesa API.  It exists for the convenience
+// of other Kuesa classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QObject>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QVector>
+#include <QtGui/QMatrix4x4>
+
+#include "bvh_p.h"
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DCore {
+class QEntity;
+class QTransform;
+} // namespace Qt3DCore
+
+namespace Qt3DRender {
+class QGeometryRenderer;
+} // namespace Qt3DRender
+
+namespace Kuesa {
+
+class SceneEntity;
+
+class Q_AUTOTEST_EXPORT SceneQuery : public QObject
+{
+public:
+    struct RayHit {
+        QString entityName;
+        float distance = 0.0f;
+    };
+
+    explicit SceneQuery(SceneEntity *sceneEntity);
+    ~SceneQuery();
+
+    QVector<RayHit> castRay(const QVector3D &origin, const QVector3D &direction, bool nearestOnly);
+    QStringList entitiesInBox(const BoundingBox &box);
+    QStringList entitiesInFrustum(const QMatrix4x4 &viewProjection);
+
+    int meshBvhCount() const { return m_meshBvhs.size(); }
+
+private:
+    struct Primitive {
+        Qt3DRender::QGeometryRenderer *renderer = nullptr;
+        // Relative to the entity
+        QMatrix4x4 matrix;
+        // From the space of the entity to the one of the primitive
+        QMatrix4x4 inverseMatrix;
+    };
+
+    struct Target {
+        QString name;
+        Qt3DCore::QEntity *entity = nullptr;
+        BoundingBox localBounds;
+        QVector<Primitive> primitives;
+        QMatrix4x4 worldMatrix;
+        QMatrix4x4 inverseWorldMatrix;
+        BoundingBox worldBounds;
+    };
+
+    void invalidateTargets();
+    void update();
+    void gatherTargets();
+    void addPrimitives(Target &target, Qt3DCore::QEntity *entity, const QMatrix4x4 &matrix);
+    QMatrix4x4 worldMatrix(Qt3DCore::QEntity *entity);
+    QSharedPointer<MeshBvh> meshBvh(Qt3DRender::QGeometryRenderer *renderer);
+    bool castRay(const Target &target, const QVector3D &origin, const QVector3D &direction, float maxDistance, float *distance);
+
+    SceneEntity *m_sceneEntity;
+    QVector<Target> m_targets;
+    Bvh m_topLevelBvh;
+    bool m_targetsDirty;
+    bool m_worldDirty;
+    QHash<Qt3DRender::QGeometryRenderer *, QFuture<QSharedPointer<MeshBvh>>> m_meshBvhs;
+    QSet<Qt3DCore::QTransform *> m_observedTransforms;
+};
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_SCENEQUERY_P_H
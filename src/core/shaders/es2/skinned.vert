@@ -75,7 +75,8 @@ void main()
     worldPosition = vec3(modelMatrix * skinnedPosition);
     worldNormal = normalize(modelNormalMatrix * skinnedNormal);
     worldTangent.xyz = normalize(vec3(modelMatrix * vec4(skinnedTangent, 0.0)));
-    worldTangent.w = vertexTangent.w;
+    // Quantized tangents may not store an exact handedness
+    worldTangent.w = vertexTangent.w < 0.0 ? -1.0 : 1.0;
 
     gl_Position = mvp * skinnedPosition;
 }
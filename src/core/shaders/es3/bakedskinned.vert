@@ -0,0 +1,112 @@
+/*
+    bakedskinned.vert
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#version 300 es
+
+precision highp float;
+precision highp int;
+precision highp sampler2D;
+
+in vec3 vertexPosition;
+in vec3 vertexNormal;
+in vec4 vertexTangent;
+in vec4 vertexColor;
+in vec2 vertexTexCoord;
+
+in uvec4 vertexJointIndices;
+in vec4 vertexJointWeights;
+
+out vec3 worldPosition;
+out vec3 worldNormal;
+out vec4 worldTangent;
+out vec4 color;
+out vec2 texCoord;
+
+uniform mat4 modelMatrix;
+uniform mat3 modelNormalMatrix;
+uniform mat4 mvp;
+
+// Each row holds one frame, each joint uses 3 texels holding
+// the first 3 rows of its skinning matrix
+uniform sampler2D bakedSkinningTexture;
+uniform float bakedSkinningTime;
+// x: first frame, y: frame count, z: duration, w: time offset
+uniform vec4 bakedSkinningClip;
+
+uniform mat3 texCoordTransform;
+
+mat4 bakedSkinningMatrix(uint joint, int frame)
+{
+    int x = 3 * int(joint);
+    vec4 row0 = texelFetch(bakedSkinningTexture, ivec2(x, frame), 0);
+    vec4 row1 = texelFetch(bakedSkinningTexture, ivec2(x + 1, frame), 0);
+    vec4 row2 = texelFetch(bakedSkinningTexture, ivec2(x + 2, frame), 0);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+void main()
+{
+    // Pass through scaled texture coordinates
+    vec3 transformedTexCoord = texCoordTransform * vec3(vertexTexCoord, 1.0);
+    texCoord = transformedTexCoord.xy / transformedTexCoord.z;
+
+    // Pass through vertex colors
+    color = vertexColor;
+
+    // Find the two baked frames surrounding the current time
+    int firstFrame = int(bakedSkinningClip.x);
+    int lastFrameIndex = max(int(bakedSkinningClip.y) - 1, 0);
+    float duration = bakedSkinningClip.z;
+    float localTime = duration > 0.0 ? mod(bakedSkinningTime + bakedSkinningClip.w, duration) : 0.0;
+    float framePosition = duration > 0.0 ? localTime / duration * float(lastFrameIndex) : 0.0;
+    int frame0 = min(int(floor(framePosition)), lastFrameIndex);
+    int frame1 = min(frame0 + 1, lastFrameIndex);
+    float frameFactor = framePosition - float(frame0);
+
+    // Perform the skinning
+    mat4 skinningMatrix = mat4(0.0);
+    for (int i = 0; i < 4; ++i) {
+        mat4 jointMatrix0 = bakedSkinningMatrix(vertexJointIndices[i], firstFrame + frame0);
+        mat4 jointMatrix1 = bakedSkinningMatrix(vertexJointIndices[i], firstFrame + frame1);
+        mat4 jointMatrix = jointMatrix0 + (jointMatrix1 - jointMatrix0) * frameFactor;
+        skinningMatrix += jointMatrix * vertexJointWeights[i];
+    }
+
+    vec4 skinnedPosition = skinningMatrix * vec4(vertexPosition, 1.0);
+    vec3 skinnedNormal = vec3(skinningMatrix * vec4(vertexNormal, 0.0));
+    vec3 skinnedTangent = vec3(skinningMatrix * vec4(vertexTangent.xyz, 0.0));
+
+    // Transform position, normal, and tangent to world space
+    worldPosition = vec3(modelMatrix * skinnedPosition);
+    worldNormal = normalize(modelNormalMatrix * skinnedNormal);
+    worldTangent.xyz = normalize(vec3(modelMatrix * vec4(skinnedTangent, 0.0)));
+    // Quantized tangents may not store an exact handedness
+    worldTangent.w = vertexTangent.w < 0.0 ? -1.0 : 1.0;
+
+    gl_Position = mvp * skinnedPosition;
+}
@@ -0,0 +1,14 @@
+// Weighted blended order independent transparency
+// McGuire and Bavoil, Weighted Blended Order-Independent Transparency, JCGT 2013
+layout(location = 0) out highp vec4 kuesa_oitAccumulation;
+layout(location = 1) out highp vec4 kuesa_oitWeight;
+
+void kuesa_weightedBlendedOIT(const in highp vec4 color)
+{
+    // Favor close and opaque surfaces, clamped to stay within half float range
+    highp float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1.0e8 *
+                               pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1.0e-2, 3.0e3);
+    // Color is summed, alpha multiplies the revealage by (1 - alpha)
+    kuesa_oitAccumulation = vec4(color.rgb * color.a * weight, color.a);
+    kuesa_oitWeight = vec4(color.a * weight);
+}
@@ -0,0 +1,51 @@
+/*
+    dualfilterupsample.frag
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Jim Albamont <jim.albamont@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#version 150
+
+in vec2 texCoord;
+out vec4 fragColor;
+
+uniform sampler2D dualFilterSampler;
+// Half a texel of dualFilterSampler
+uniform vec2 halfPixel;
+
+// Renders into a target twice the size of the source using a tent filter
+// made of eight bilinear samples
+void main()
+{
+    vec4 sum = texture(dualFilterSampler, texCoord + vec2(-halfPixel.x * 2.0, 0.0));
+    sum += texture(dualFilterSampler, texCoord + vec2(-halfPixel.x, halfPixel.y)) * 2.0;
+    sum += texture(dualFilterSampler, texCoord + vec2(0.0, halfPixel.y * 2.0));
+    sum += texture(dualFilterSampler, texCoord + vec2(halfPixel.x, halfPixel.y)) * 2.0;
+    sum += texture(dualFilterSampler, texCoord + vec2(halfPixel.x * 2.0, 0.0));
+    sum += texture(dualFilterSampler, texCoord + vec2(halfPixel.x, -halfPixel.y)) * 2.0;
+    sum += texture(dualFilterSampler, texCoord + vec2(0.0, -halfPixel.y * 2.0));
+    sum += texture(dualFilterSampler, texCoord + vec2(-halfPixel.x, -halfPixel.y)) * 2.0;
+    fragColor = sum / 12.0;
+}
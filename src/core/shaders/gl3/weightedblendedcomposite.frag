@@ -0,0 +1,58 @@
+/*
+    weightedblendedcomposite.frag
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Jim Albamont <jim.albamont@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#version 150
+
+in vec2 texCoord;
+out vec4 fragColor;
+
+// Opaque objects
+uniform sampler2D inputTexture;
+// Sum of the weighted premultiplied colors, revealage in alpha
+uniform sampler2D accumulationTexture;
+// Sum of the weighted alphas
+uniform sampler2D weightTexture;
+
+// Blends the weighted average of the transparent surfaces over the opaque
+// ones, by how much they hide them
+void main()
+{
+    vec4 color = texture(inputTexture, texCoord);
+    vec4 accumulation = texture(accumulationTexture, texCoord);
+    float revealage = accumulation.a;
+
+    // No transparent surface covers this pixel
+    if (revealage >= 1.0) {
+        fragColor = color;
+        return;
+    }
+
+    float weight = max(texture(weightTexture, texCoord).r, 1.0e-5);
+    vec3 averageColor = accumulation.rgb / weight;
+    fragColor = vec4(mix(averageColor, color.rgb, revealage), color.a);
+}
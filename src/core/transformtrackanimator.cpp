@@ -0,0 +1,254 @@
+/*
+    transformtrackanimator.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "transformtrackanimator_p.h"
+
+#include <Qt3DCore/QTransform>
+#include <Qt3DCore/QJoint>
+#include <Qt3DAnimation/QAnimationClip>
+#include <Qt3DAnimation/QChannelMapping>
+#include <Qt3DAnimation/QClock>
+#include <QtGui/QMatrix4x4>
+
+#include <cmath>
+
+QT_BEGIN_NAMESPACE
+
+namespace Kuesa {
+
+TransformTrackMapper::TransformTrackMapper(Qt3DCore::QNode *parent)
+    : Qt3DAnimation::QChannelMapper(parent)
+{
+}
+
+TransformTrackAnimator::TransformTrackAnimator(QObject *parent)
+    : QAbstractAnimation(parent)
+    , m_trackCount(0)
+    , m_normalizedTime(0.0f)
+{
+}
+
+TransformTrackAnimator::~TransformTrackAnimator()
+{
+}
+
+// Returns false if the mapper contains mappings which can't be turned into tracks
+bool TransformTrackAnimator::setClip(Qt3DAnimation::QAnimationClip *clip, Qt3DAnimation::QChannelMapper *mapper)
+{
+    m_transformTracks.clear();
+    m_jointTracks.clear();
+    m_trackCount = 0;
+    m_values.clear();
+    m_sampler = AnimationSampler();
+
+    if (!clip || !mapper)
+        return false;
+
+    AnimationSampler sampler(clip->clipData());
+
+    QHash<QString, int> channelOffsets;
+    channelOffsets.reserve(sampler.channelCount());
+    for (int i = 0, m = sampler.channelCount(); i < m; ++i)
+        channelOffsets.insert(sampler.channelName(i), sampler.channelOffset(i));
+
+    QVector<TransformTrack> transformTracks;
+    QVector<JointTrack> jointTracks;
+    QHash<Qt3DCore::QTransform *, int> transformTrackIndices;
+    int trackCount = 0;
+    const QVector<Qt3DAnimation::QAbstractChannelMapping *> mappings = mapper->mappings();
+    for (Qt3DAnimation::QAbstractChannelMapping *abstractMapping : mappings) {
+        // Skeleton mappings are redundant with the joint channel mappings
+        auto mapping = qobject_cast<Qt3DAnimation::QChannelMapping *>(abstractMapping);
+        if (!mapping)
+            continue;
+
+        const auto offsetIt = channelOffsets.constFind(mapping->channelName());
+        if (offsetIt == channelOffsets.cend())
+            continue;
+
+        const QString property = mapping->property();
+        Qt3DCore::QNode *target = mapping->target();
+        if (auto transform = qobject_cast<Qt3DCore::QTransform *>(target)) {
+            auto indexIt = transformTrackIndices.find(transform);
+            if (indexIt == transformTrackIndices.end()) {
+                indexIt = transformTrackIndices.insert(transform, transformTracks.size());
+                transformTracks.push_back({ transform, -1, -1, -1 });
+            }
+            TransformTrack &track = transformTracks[indexIt.value()];
+            if (property == QLatin1String("translation"))
+                track.translationOffset = offsetIt.value();
+            else if (property == QLatin1String("rotation"))
+                track.rotationOffset = offsetIt.value();
+            else if (property == QLatin1String("scale3D"))
+                track.scaleOffset = offsetIt.value();
+            else
+                return false;
+        } else if (auto joint = qobject_cast<Qt3DCore::QJoint *>(target)) {
+            JointTrack track { joint, JointTranslation, offsetIt.value() };
+            if (property == QLatin1String("translation"))
+                track.type = JointTranslation;
+            else if (property == QLatin1String("rotation"))
+                track.type = JointRotation;
+            else if (property == QLatin1String("scale"))
+                track.type = JointScale;
+            else
+                return false;
+            jointTracks.push_back(track);
+        } else {
+            return false;
+        }
+        ++trackCount;
+    }
+
+    m_sampler = sampler;
+    m_transformTracks = transformTracks;
+    m_jointTracks = jointTracks;
+    m_trackCount = trackCount;
+    m_values.resize(m_sampler.componentCount());
+    return true;
+}
+
+int TransformTrackAnimator::trackCount() const
+{
+    return m_trackCount;
+}
+
+void TransformTrackAnimator::setClock(Qt3DAnimation::QClock *clock)
+{
+    if (m_clock == clock)
+        return;
+    if (m_clock)
+        disconnect(m_clock, nullptr, this, nullptr);
+    m_clock = clock;
+    const auto updateDirection = [this] {
+        setDirection(playbackRate() < 0.0f ? Backward : Forward);
+    };
+    if (m_clock)
+        connect(m_clock, &Qt3DAnimation::QClock::playbackRateChanged, this, updateDirection);
+    updateDirection();
+}
+
+Qt3DAnimation::QClock *TransformTrackAnimator::clock() const
+{
+    return m_clock;
+}
+
+float TransformTrackAnimator::playbackRate() const
+{
+    return m_clock ? float(m_clock->playbackRate()) : 1.0f;
+}
+
+float TransformTrackAnimator::normalizedTime() const
+{
+    return m_normalizedTime;
+}
+
+void TransformTrackAnimator::setNormalizedTime(float timeFraction)
+{
+    const int d = duration();
+    if (d > 0)
+        setCurrentTime(int(qBound(0.0f, timeFraction, 1.0f) * float(d)));
+}
+
+int TransformTrackAnimator::duration() const
+{
+    const float rate = std::abs(playbackRate());
+    if (qFuzzyIsNull(rate))
+        return -1;
+    return int(std::ceil(m_sampler.duration() * 1000.0f / rate));
+}
+
+void TransformTrackAnimator::updateCurrentTime(int currentTime)
+{
+    const float clipDuration = m_sampler.duration();
+    const float time = std::min(float(currentTime) * 0.001f * std::abs(playbackRate()), clipDuration);
+    m_normalizedTime = clipDuration > 0.0f ? time / clipDuration : 0.0f;
+    evaluate(time);
+}
+
+// Samples all channels at time (in seconds) and applies them to the targets
+void TransformTrackAnimator::evaluate(float time)
+{
+    if (m_trackCount == 0)
+        return;
+
+    m_sampler.sample(time, m_values.data());
+
+    // Rotation components are stored with the scalar part first
+    const float *values = m_values.constData();
+    for (const TransformTrack &track : qAsConst(m_transformTracks)) {
+        Qt3DCore::QTransform *transform = track.target.data();
+        if (!transform)
+            continue;
+
+        // Components without a channel keep their current value
+        QVector3D translation = transform->translation();
+        if (track.translationOffset >= 0) {
+            const float *v = values + track.translationOffset;
+            translation = QVector3D(v[0], v[1], v[2]);
+        }
+        QQuaternion rotation = transform->rotation();
+        if (track.rotationOffset >= 0) {
+            const float *v = values + track.rotationOffset;
+            rotation = QQuaternion(v[0], v[1], v[2], v[3]).normalized();
+        }
+        QVector3D scale = transform->scale3D();
+        if (track.scaleOffset >= 0) {
+            const float *v = values + track.scaleOffset;
+            scale = QVector3D(v[0], v[1], v[2]);
+        }
+
+        QMatrix4x4 matrix;
+        matrix.translate(translation);
+        matrix.rotate(rotation);
+        matrix.scale(scale);
+        transform->setMatrix(matrix);
+    }
+
+    for (const JointTrack &track : qAsConst(m_jointTracks)) {
+        Qt3DCore::QJoint *joint = track.target.data();
+        if (!joint)
+            continue;
+        const float *v = values + track.offset;
+        switch (track.type) {
+        case JointTranslation:
+            joint->setTranslation(QVector3D(v[0], v[1], v[2]));
+            break;
+        case JointRotation:
+            joint->setRotation(QQuaternion(v[0], v[1], v[2], v[3]).normalized());
+            break;
+        case JointScale:
+            joint->setScale(QVector3D(v[0], v[1], v[2]));
+            break;
+        }
+    }
+}
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
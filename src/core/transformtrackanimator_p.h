@@ -0,0 +1,140 @@
+/*
+    transformtrackanimator_p.h
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef KUESA_TRANSFORMTRACKANIMATOR_P_H
+#define KUESA_TRANSFORMTRACKANIMATOR_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Kuesa API.  It exists for the convenience
+// of other Kuesa classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QAbstractAnimation>
+#include <QtCore/QPointer>
+#include <QtCore/QVector>
+#include <Qt3DAnimation/QChannelMapper>
+#include "animationsampler_p.h"
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DCore {
+class QNode;
+class QTransform;
+class QJoint;
+}
+
+namespace Qt3DAnimation {
+class QAnimationClip;
+class QClock;
+} // namespace Qt3DAnimation
+
+namespace Kuesa {
+
+// Mappers created by the glTF importer when transform tracks were requested.
+// They hold the same mappings, AnimationPlayer uses them to decide how clips
+// get applied.
+class Q_AUTOTEST_EXPORT TransformTrackMapper : public Qt3DAnimation::QChannelMapper
+{
+    Q_OBJECT
+public:
+    explicit TransformTrackMapper(Qt3DCore::QNode *parent = nullptr);
+};
+
+// Plays a clip on the frontend, without going through the animation aspect.
+// Mappings targeting Qt3DCore::QTransform or Qt3DCore::QJoint are resolved
+// once into typed tracks. Every frame, all channels are sampled in one pass
+// and written with the typed setters of the targets, which avoids the
+// QVariant and property name lookups of the generic property updates.
+// The tracks of a QTransform are grouped so that its translation, rotation
+// and scale are composed and applied with a single setMatrix call.
+class Q_AUTOTEST_EXPORT TransformTrackAnimator : public QAbstractAnimation
+{
+    Q_OBJECT
+public:
+    explicit TransformTrackAnimator(QObject *parent = nullptr);
+    ~TransformTrackAnimator();
+
+    bool setClip(Qt3DAnimation::QAnimationClip *clip, Qt3DAnimation::QChannelMapper *mapper);
+    int trackCount() const;
+
+    void setClock(Qt3DAnimation::QClock *clock);
+    Qt3DAnimation::QClock *clock() const;
+
+    float normalizedTime() const;
+    void setNormalizedTime(float timeFraction);
+
+    void evaluate(float time);
+
+    int duration() const override;
+
+protected:
+    void updateCurrentTime(int currentTime) override;
+
+private:
+    enum JointTrackType {
+        JointTranslation,
+        JointRotation,
+        JointScale
+    };
+
+    struct JointTrack {
+        QPointer<Qt3DCore::QJoint> target;
+        JointTrackType type;
+        int offset;
+    };
+
+    // Offsets of the animated components, -1 when a component isn't animated
+    struct TransformTrack {
+        QPointer<Qt3DCore::QTransform> target;
+        int translationOffset;
+        int rotationOffset;
+        int scaleOffset;
+    };
+
+    float playbackRate() const;
+
+    AnimationSampler m_sampler;
+    QVector<TransformTrack> m_transformTracks;
+    QVector<JointTrack> m_jointTracks;
+    int m_trackCount;
+    QVector<float> m_values;
+    QPointer<Qt3DAnimation::QClock> m_clock;
+    float m_normalizedTime;
+};
+
+} // namespace Kuesa
+
+QT_END_NAMESPACE
+
+#endif // KUESA_TRANSFORMTRACKANIMATOR_P_H
@@ -38,6 +38,8 @@
 #include <Kuesa/ThresholdEffect>
 #include <Kuesa/OpacityMask>
 #include <Kuesa/Skybox>
+#include <Kuesa/BlendedAnimationPlayer>
+#include <Kuesa/BakedSkinningAnimation>
 #include "postfxlistextension.h"
 
 #include <QtQml/qqml.h>
@@ -78,6 +80,8 @@ void KuesaPlugin::registerTypes(const char *uri)
     qmlRegisterType<Kuesa::Skybox>(uri, 1, 0, "Skybox");
     qmlRegisterType<Kuesa::Asset>(uri, 1, 0, "Asset");
     qmlRegisterExtendedType<Kuesa::AnimationPlayer, Kuesa::AnimationPlayerItem>(uri, 1, 0, "AnimationPlayer");
+    qmlRegisterType<Kuesa::BlendedAnimationPlayer>(uri, 1, 0, "BlendedAnimationPlayer");
+    qmlRegisterType<Kuesa::BakedSkinningAnimation>(uri, 1, 0, "BakedSkinningAnimation");
 
     // Post FX
     qmlRegisterUncreatableType<Kuesa::AbstractPostProcessingEffect>("Kuesa.Effects", 1, 0, "AbstractPostProcessingEffect", QStringLiteral("AbstractPostProcessingEffect is abstract"));
@@ -0,0 +1,326 @@
+/*
+    tst_animationplayer.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/sceneentity.h>
+#include <Kuesa/animationplayer.h>
+#include <Kuesa/private/retargetedmappercache_p.h>
+#include <Kuesa/private/transformtrackanimator_p.h>
+#include <Qt3DCore/QTransform>
+#include <Qt3DAnimation/QAnimationClip>
+#include <Qt3DAnimation/QChannelMapper>
+#include <Qt3DAnimation/QChannelMapping>
+#include <Qt3DAnimation/QClipAnimator>
+
+namespace {
+
+Qt3DAnimation::QChannelMapper *animatorMapper(Kuesa::AnimationPlayer *player)
+{
+    auto animator = player->findChild<Qt3DAnimation::QClipAnimator *>();
+    return animator ? animator->channelMapper() : nullptr;
+}
+
+// Translation channel going from (0, 0, 0) to end over one second
+Qt3DAnimation::QChannel translationChannel(const QString &name, const QVector3D &end)
+{
+    Qt3DAnimation::QChannel channel(name);
+    const QStringList componentNames = { QStringLiteral("X"), QStringLiteral("Y"), QStringLiteral("Z") };
+    for (int i = 0; i < 3; ++i) {
+        Qt3DAnimation::QChannelComponent component(componentNames.at(i));
+        component.appendKeyFrame(Qt3DAnimation::QKeyFrame(QVector2D(0.0f, 0.0f)));
+        component.appendKeyFrame(Qt3DAnimation::QKeyFrame(QVector2D(1.0f, end[i])));
+        channel.appendChannelComponent(component);
+    }
+    return channel;
+}
+
+} // namespace
+
+class tst_AnimationPlayer : public QObject
+{
+    Q_OBJECT
+
+private:
+    void populateScene(Kuesa::SceneEntity *scene)
+    {
+        auto clip = new Qt3DAnimation::QAnimationClip;
+        Qt3DAnimation::QAnimationClipData clipData;
+        clipData.appendChannel(Qt3DAnimation::QChannel(QStringLiteral("Location_0")));
+        clip->setClipData(clipData);
+        scene->animationClips()->add(QStringLiteral("DoorOpen"), clip);
+
+        auto mapping = new Qt3DAnimation::QChannelMapping;
+        mapping->setChannelName(QStringLiteral("Location_0"));
+        mapping->setProperty(QStringLiteral("translation"));
+        mapping->setTarget(new Qt3DCore::QTransform(scene));
+
+        auto mapper = new Qt3DAnimation::QChannelMapper;
+        mapper->addMapping(mapping);
+        scene->animationMappings()->add(QStringLiteral("DoorOpen"), mapper);
+    }
+
+    // Same as the importer creates in TransformTrackAnimations mode
+    Qt3DCore::QTransform *populateTrackScene(Kuesa::SceneEntity *scene)
+    {
+        auto clip = new Qt3DAnimation::QAnimationClip;
+        Qt3DAnimation::QAnimationClipData clipData;
+        clipData.appendChannel(translationChannel(QStringLiteral("Location_0"), QVector3D(2.0f, 4.0f, 6.0f)));
+        clip->setClipData(clipData);
+        scene->animationClips()->add(QStringLiteral("Slide"), clip);
+
+        auto target = new Qt3DCore::QTransform(scene);
+        auto mapping = new Qt3DAnimation::QChannelMapping;
+        mapping->setChannelName(QStringLiteral("Location_0"));
+        mapping->setProperty(QStringLiteral("translation"));
+        mapping->setTarget(target);
+
+        auto mapper = new Kuesa::TransformTrackMapper;
+        mapper->addMapping(mapping);
+        scene->animationMappings()->add(QStringLiteral("Slide"), mapper);
+        return target;
+    }
+
+private Q_SLOTS:
+    void checkUsesMapperWithoutTargets()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        populateScene(&scene);
+        Kuesa::AnimationPlayer *player = new Kuesa::AnimationPlayer(&scene);
+
+        // WHEN
+        player->setClip(QStringLiteral("DoorOpen"));
+
+        // THEN
+        QCOMPARE(player->status(), Kuesa::AnimationPlayer::Ready);
+        QCOMPARE(animatorMapper(player), scene.animationMapping(QStringLiteral("DoorOpen")));
+    }
+
+    void checkRetargetedMappersAreShared()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        populateScene(&scene);
+        Kuesa::RetargetedMapperCache *cache = Kuesa::RetargetedMapperCache::instance();
+        const int initialCount = cache->mapperCount();
+
+        auto target1 = new Qt3DCore::QTransform(&scene);
+        auto target2 = new Qt3DCore::QTransform(&scene);
+
+        auto player1 = new Kuesa::AnimationPlayer(&scene);
+        auto player2 = new Kuesa::AnimationPlayer(&scene);
+        auto player3 = new Kuesa::AnimationPlayer(&scene);
+        player1->setClip(QStringLiteral("DoorOpen"));
+        player2->setClip(QStringLiteral("DoorOpen"));
+        player3->setClip(QStringLiteral("DoorOpen"));
+
+        // WHEN
+        player1->addTarget(target1);
+        player2->addTarget(target1);
+
+        // THEN
+        QCOMPARE(player1->status(), Kuesa::AnimationPlayer::Ready);
+        QCOMPARE(player2->status(), Kuesa::AnimationPlayer::Ready);
+        QCOMPARE(cache->mapperCount(), initialCount + 1);
+        Qt3DAnimation::QChannelMapper *sharedMapper = animatorMapper(player1);
+        QVERIFY(sharedMapper != nullptr);
+        QVERIFY(sharedMapper != scene.animationMapping(QStringLiteral("DoorOpen")));
+        QCOMPARE(animatorMapper(player2), sharedMapper);
+        QCOMPARE(cache->referenceCount(sharedMapper), 2);
+        QCOMPARE(sharedMapper->mappings().size(), 1);
+        auto mapping = qobject_cast<Qt3DAnimation::QChannelMapping *>(sharedMapper->mappings().first());
+        QVERIFY(mapping);
+        QCOMPARE(mapping->target(), target1);
+
+        // WHEN
+        player3->addTarget(target2);
+
+        // THEN
+        QCOMPARE(cache->mapperCount(), initialCount + 2);
+        QVERIFY(animatorMapper(player3) != sharedMapper);
+
+        // WHEN
+        delete player3;
+
+        // THEN
+        QCOMPARE(cache->mapperCount(), initialCount + 1);
+
+        // WHEN
+        player2->removeTarget(target1);
+
+        // THEN
+        QCOMPARE(animatorMapper(player2), scene.animationMapping(QStringLiteral("DoorOpen")));
+        QCOMPARE(cache->mapperCount(), initialCount + 1);
+        QCOMPARE(cache->referenceCount(sharedMapper), 1);
+
+        // WHEN
+        player2->addTarget(target1);
+
+        // THEN
+        QCOMPARE(animatorMapper(player2), sharedMapper);
+        QCOMPARE(cache->referenceCount(sharedMapper), 2);
+
+        // WHEN
+        delete target1;
+
+        // THEN
+        QCOMPARE(cache->mapperCount(), initialCount);
+    }
+
+    void checkReevaluatingDoesNotLeak()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        populateScene(&scene);
+        Kuesa::RetargetedMapperCache *cache = Kuesa::RetargetedMapperCache::instance();
+        const int initialCount = cache->mapperCount();
+
+        auto target = new Qt3DCore::QTransform(&scene);
+        auto player = new Kuesa::AnimationPlayer(&scene);
+        player->setClip(QStringLiteral("DoorOpen"));
+        player->addTarget(target);
+        Qt3DAnimation::QChannelMapper *mapper = animatorMapper(player);
+
+        // WHEN
+        for (int i = 0; i < 10; ++i)
+            emit scene.loadingDone();
+
+        // THEN
+        QCOMPARE(cache->mapperCount(), initialCount + 1);
+        QCOMPARE(animatorMapper(player), mapper);
+        QCOMPARE(cache->referenceCount(mapper), 1);
+
+        // WHEN
+        delete player;
+
+        // THEN
+        QCOMPARE(cache->mapperCount(), initialCount);
+    }
+
+    void checkErrorReleasesRetargetedMapper()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        populateScene(&scene);
+        Kuesa::RetargetedMapperCache *cache = Kuesa::RetargetedMapperCache::instance();
+        const int initialCount = cache->mapperCount();
+
+        auto target1 = new Qt3DCore::QTransform(&scene);
+        auto target2 = new Qt3DCore::QTransform(&scene);
+        auto player = new Kuesa::AnimationPlayer(&scene);
+        player->setClip(QStringLiteral("DoorOpen"));
+        player->addTarget(target1);
+
+        // THEN
+        QCOMPARE(player->status(), Kuesa::AnimationPlayer::Ready);
+        QCOMPARE(cache->mapperCount(), initialCount + 1);
+
+        // WHEN -> more targets than mappings
+        player->addTarget(target2);
+
+        // THEN -> the stale retargeted mapper no longer drives target1
+        QCOMPARE(player->status(), Kuesa::AnimationPlayer::Error);
+        QVERIFY(animatorMapper(player) == nullptr);
+        QCOMPARE(cache->mapperCount(), initialCount);
+
+        // WHEN
+        player->removeTarget(target2);
+
+        // THEN
+        QCOMPARE(player->status(), Kuesa::AnimationPlayer::Ready);
+        QVERIFY(animatorMapper(player) != nullptr);
+        QCOMPARE(cache->mapperCount(), initialCount + 1);
+    }
+
+    void checkPlaysTransformTracks()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        Qt3DCore::QTransform *target = populateTrackScene(&scene);
+        auto player = new Kuesa::AnimationPlayer(&scene);
+        auto clipAnimator = player->findChild<Qt3DAnimation::QClipAnimator *>();
+        QVERIFY(clipAnimator != nullptr);
+
+        // WHEN
+        player->setClip(QStringLiteral("Slide"));
+
+        // THEN
+        QCOMPARE(player->status(), Kuesa::AnimationPlayer::Ready);
+        auto trackAnimator = player->findChild<Kuesa::TransformTrackAnimator *>();
+        QVERIFY(trackAnimator != nullptr);
+        QCOMPARE(trackAnimator->trackCount(), 1);
+
+        // WHEN
+        player->setNormalizedTime(0.5f);
+
+        // THEN -> the target is updated on the frontend
+        QCOMPARE(player->normalizedTime(), 0.5f);
+        QCOMPARE(target->translation(), QVector3D(1.0f, 2.0f, 3.0f));
+
+        // WHEN
+        QSignalSpy runningSpy(player, SIGNAL(runningChanged(bool)));
+        player->start();
+
+        // THEN -> only the track animator drives the target
+        QVERIFY(player->isRunning());
+        QCOMPARE(trackAnimator->state(), QAbstractAnimation::Running);
+        QVERIFY(!clipAnimator->isRunning());
+        QCOMPARE(runningSpy.count(), 1);
+
+        // WHEN
+        player->stop();
+
+        // THEN
+        QVERIFY(!player->isRunning());
+        QCOMPARE(runningSpy.count(), 2);
+    }
+
+    void checkPlaysRetargetedTransformTracks()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        Qt3DCore::QTransform *source = populateTrackScene(&scene);
+        auto target = new Qt3DCore::QTransform(&scene);
+        auto player = new Kuesa::AnimationPlayer(&scene);
+        player->setClip(QStringLiteral("Slide"));
+
+        // WHEN
+        player->addTarget(target);
+        player->setNormalizedTime(1.0f);
+
+        // THEN -> the tracks follow the retargeted mapper
+        QCOMPARE(player->status(), Kuesa::AnimationPlayer::Ready);
+        QVERIFY(player->findChild<Kuesa::TransformTrackAnimator *>() != nullptr);
+        QCOMPARE(target->translation(), QVector3D(2.0f, 4.0f, 6.0f));
+        QCOMPARE(source->translation(), QVector3D());
+    }
+};
+
+QTEST_GUILESS_MAIN(tst_AnimationPlayer)
+#include "tst_animationplayer.moc"
@@ -0,0 +1,289 @@
+/*
+    tst_animationsampler.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <Kuesa/private/animationsampler_p.h>
+#include <Kuesa/private/animationparser_p.h>
+#include <Kuesa/private/bufferviewsparser_p.h>
+#include <Kuesa/private/bufferaccessorparser_p.h>
+#include <Kuesa/private/nodeparser_p.h>
+#include <Kuesa/private/gltf2context_p.h>
+
+using namespace Kuesa;
+using namespace GLTF2Import;
+
+namespace {
+
+QByteArray toByteArray(const QVector<float> &values)
+{
+    return QByteArray(reinterpret_cast<const char *>(values.constData()), values.size() * int(sizeof(float)));
+}
+
+// Runs the AnimationParser on an animation with channelCount translation
+// channels sharing the same sampler and returns the resulting clip data
+Qt3DAnimation::QAnimationClipData parseAnimation(const QVector<float> &times,
+                                                 const QVector<float> &values,
+                                                 int componentCount,
+                                                 const QString &interpolation,
+                                                 const QString &path = QStringLiteral("translation"),
+                                                 int channelCount = 1)
+{
+    GLTF2ContextPrivate context;
+
+    BufferView inputView;
+    inputView.bufferData = toByteArray(times);
+    inputView.byteLength = inputView.bufferData.size();
+    context.addBufferView(inputView);
+
+    BufferView outputView;
+    outputView.bufferData = toByteArray(values);
+    outputView.byteLength = outputView.bufferData.size();
+    context.addBufferView(outputView);
+
+    Accessor inputAccessor;
+    inputAccessor.bufferViewIndex = 0;
+    inputAccessor.dataSize = 1;
+    inputAccessor.count = times.size();
+    context.addAccessor(inputAccessor);
+
+    Accessor outputAccessor;
+    outputAccessor.bufferViewIndex = 1;
+    outputAccessor.dataSize = componentCount;
+    outputAccessor.count = values.size() / componentCount;
+    context.addAccessor(outputAccessor);
+
+    QJsonArray channels;
+    for (int i = 0; i < channelCount; ++i) {
+        context.addTreeNode(TreeNode());
+        channels.push_back(QJsonObject {
+                { QStringLiteral("sampler"), 0 },
+                { QStringLiteral("target"), QJsonObject { { QStringLiteral("node"), i }, { QStringLiteral("path"), path } } } });
+    }
+
+    const QJsonObject animation {
+        { QStringLiteral("samplers"), QJsonArray { QJsonObject { { QStringLiteral("input"), 0 }, { QStringLiteral("output"), 1 }, { QStringLiteral("interpolation"), interpolation } } } },
+        { QStringLiteral("channels"), channels }
+    };
+
+    AnimationParser parser;
+    if (!parser.parse(QJsonArray { animation }, &context) || context.animationsCount() != 1)
+        return {};
+    return context.animation(0).clipData;
+}
+
+// glTF 2.0 cubic spline evaluation, see Appendix C of the specification
+float hermite(float t0, float p0, float b0, float t1, float p1, float a1, float t)
+{
+    const float td = t1 - t0;
+    const float s = (t - t0) / td;
+    const float s2 = s * s;
+    const float s3 = s2 * s;
+    return (2.0f * s3 - 3.0f * s2 + 1.0f) * p0 + (s3 - 2.0f * s2 + s) * td * b0 + (-2.0f * s3 + 3.0f * s2) * p1 + (s3 - s2) * td * a1;
+}
+
+} // namespace
+
+class tst_AnimationSampler : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void checkEmpty()
+    {
+        // GIVEN
+        AnimationSampler sampler;
+
+        // THEN
+        QCOMPARE(sampler.duration(), 0.0f);
+        QCOMPARE(sampler.channelCount(), 0);
+        QCOMPARE(sampler.componentCount(), 0);
+        QVERIFY(sampler.sample(1.0f).isEmpty());
+    }
+
+    void checkLayout()
+    {
+        // GIVEN
+        const auto clipData = parseAnimation({ 0.0f, 2.0f },
+                                             { 0.0f, 0.0f, 0.0f, 1.0f, 2.0f, 3.0f },
+                                             3, QStringLiteral("LINEAR"), QStringLiteral("translation"), 3);
+
+        // WHEN
+        AnimationSampler sampler(clipData);
+
+        // THEN
+        QCOMPARE(sampler.duration(), 2.0f);
+        QCOMPARE(sampler.channelCount(), 3);
+        QCOMPARE(sampler.componentCount(), 9);
+        QCOMPARE(sampler.channelIndex(QStringLiteral("Location_1")), 1);
+        QCOMPARE(sampler.channelIndex(QStringLiteral("Location_3")), -1);
+        QCOMPARE(sampler.channelName(2), QStringLiteral("Location_2"));
+        QCOMPARE(sampler.channelOffset(2), 6);
+        QCOMPARE(sampler.channelComponentCount(2), 3);
+        QCOMPARE(sampler.sample(1.0f), QVector<float>({ 0.5f, 1.0f, 1.5f, 0.5f, 1.0f, 1.5f, 0.5f, 1.0f, 1.5f }));
+    }
+
+    void checkLinear()
+    {
+        // GIVEN
+        AnimationSampler sampler(parseAnimation({ 0.0f, 1.0f, 2.0f },
+                                                { 0.0f, 0.0f, 0.0f, 10.0f, 0.0f, 0.0f, 30.0f, 0.0f, 0.0f },
+                                                3, QStringLiteral("LINEAR")));
+
+        // THEN
+        QCOMPARE(sampler.sample(-1.0f).first(), 0.0f);
+        QCOMPARE(sampler.sample(0.5f).first(), 5.0f);
+        QCOMPARE(sampler.sample(1.0f).first(), 10.0f);
+        QCOMPARE(sampler.sample(1.5f).first(), 20.0f);
+        QCOMPARE(sampler.sample(3.0f).first(), 30.0f);
+    }
+
+    void checkStep()
+    {
+        // GIVEN
+        AnimationSampler sampler(parseAnimation({ 0.0f, 1.0f, 2.0f },
+                                                { 0.0f, 0.0f, 0.0f, 10.0f, 0.0f, 0.0f, 30.0f, 0.0f, 0.0f },
+                                                3, QStringLiteral("STEP")));
+
+        // THEN
+        QCOMPARE(sampler.sample(0.5f).first(), 0.0f);
+        QCOMPARE(sampler.sample(1.0f).first(), 10.0f);
+        QCOMPARE(sampler.sample(1.99f).first(), 10.0f);
+        QCOMPARE(sampler.sample(2.0f).first(), 30.0f);
+    }
+
+    void checkCubicSpline()
+    {
+        // GIVEN -> in-tangent, value, out-tangent for each key frame
+        const QVector<float> times = { 0.0f, 1.0f, 3.0f };
+        const QVector<float> a = { 0.0f, 4.0f, -1.0f };
+        const QVector<float> p = { 1.0f, 3.0f, 2.0f };
+        const QVector<float> b = { 2.0f, -3.0f, 0.0f };
+        QVector<float> values;
+        for (int i = 0; i < times.size(); ++i)
+            values << a[i] << 0.0f << 0.0f << p[i] << 0.0f << 0.0f << b[i] << 0.0f << 0.0f;
+        AnimationSampler sampler(parseAnimation(times, values, 3, QStringLiteral("CUBICSPLINE")));
+
+        // THEN -> the bezier handles generated by the parser match the spline
+        QCOMPARE(sampler.duration(), 3.0f);
+        for (int i = 0; i <= 30; ++i) {
+            const float t = 0.1f * float(i);
+            const int k = t < 1.0f ? 0 : 1;
+            const float expected = t >= 3.0f ? p[2] : hermite(times[k], p[k], b[k], times[k + 1], p[k + 1], a[k + 1], t);
+            const float actual = sampler.sample(t).first();
+            QVERIFY2(std::abs(actual - expected) < 1.0e-4f, qPrintable(QStringLiteral("t=%1 expected=%2 actual=%3").arg(t).arg(expected).arg(actual)));
+        }
+    }
+
+    void checkRotationComponentOrder()
+    {
+        // GIVEN -> glTF stores x, y, z, w
+        AnimationSampler sampler(parseAnimation({ 0.0f, 1.0f },
+                                                { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f },
+                                                4, QStringLiteral("LINEAR"), QStringLiteral("rotation")));
+
+        // THEN -> sampled with the scalar part first
+        QCOMPARE(sampler.channelComponentCount(0), 4);
+        QCOMPARE(sampler.sample(0.0f), QVector<float>({ 1.0f, 0.0f, 0.0f, 0.0f }));
+        QCOMPARE(sampler.sample(1.0f), QVector<float>({ 0.0f, 0.0f, 1.0f, 0.0f }));
+    }
+
+    void checkDeterministic()
+    {
+        // GIVEN
+        const int keyFrameCount = 32;
+        QVector<float> times;
+        QVector<float> values;
+        for (int i = 0; i < keyFrameCount; ++i) {
+            times << 0.1f * float(i);
+            for (int j = 0; j < 9; ++j)
+                values << std::sin(float(i * 9 + j));
+        }
+        AnimationSampler sampler(parseAnimation(times, values, 3, QStringLiteral("CUBICSPLINE"), QStringLiteral("translation"), 4));
+        const int sampleCount = 100;
+        const float timeStep = sampler.duration() / float(sampleCount - 1);
+
+        // WHEN
+        QVector<float> range(sampleCount * sampler.componentCount());
+        sampler.sampleRange(0.0f, timeStep, sampleCount, range.data());
+
+        // THEN
+        for (int i = 0; i < sampleCount; ++i) {
+            const QVector<float> single = sampler.sample(float(i) * timeStep);
+            QVERIFY(std::equal(single.begin(), single.end(), range.begin() + i * sampler.componentCount()));
+        }
+
+        // WHEN
+        QVector<float> otherRange(range.size());
+        sampler.sampleRange(0.0f, timeStep, sampleCount, otherRange.data());
+
+        // THEN
+        QCOMPARE(otherRange, range);
+    }
+
+    void benchmarkSampling_data()
+    {
+        QTest::addColumn<QString>("interpolation");
+
+        QTest::newRow("LINEAR") << QStringLiteral("LINEAR");
+        QTest::newRow("STEP") << QStringLiteral("STEP");
+        QTest::newRow("CUBICSPLINE") << QStringLiteral("CUBICSPLINE");
+    }
+
+    void benchmarkSampling()
+    {
+        QFETCH(QString, interpolation);
+
+        // GIVEN -> 200 channels of 100 key frames
+        const int keyFrameCount = 100;
+        const int valuesPerKeyFrame = interpolation == QLatin1String("CUBICSPLINE") ? 9 : 3;
+        QVector<float> times;
+        QVector<float> values;
+        for (int i = 0; i < keyFrameCount; ++i) {
+            times << 0.04f * float(i);
+            for (int j = 0; j < valuesPerKeyFrame; ++j)
+                values << std::cos(float(i * valuesPerKeyFrame + j));
+        }
+        AnimationSampler sampler(parseAnimation(times, values, 3, interpolation, QStringLiteral("translation"), 200));
+        QCOMPARE(sampler.componentCount(), 600);
+
+        const int sampleCount = 250;
+        const float timeStep = sampler.duration() / float(sampleCount - 1);
+        QVector<float> output(sampleCount * sampler.componentCount());
+
+        // WHEN
+        QBENCHMARK {
+            sampler.sampleRange(0.0f, timeStep, sampleCount, output.data());
+        }
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_AnimationSampler)
+
+#include "tst_animationsampler.moc"
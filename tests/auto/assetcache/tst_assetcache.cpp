@@ -0,0 +1,268 @@
+/*
+    tst_assetcache.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+#include <Kuesa/private/assetcache_p.h>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+#include <memory>
+#include <vector>
+
+using namespace Kuesa;
+using namespace GLTF2Import;
+
+namespace {
+
+bool writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write(data) == data.size();
+}
+
+class ReaderThread : public QThread
+{
+public:
+    ReaderThread(AssetCache *cache, const QString &path)
+        : m_cache(cache)
+        , m_path(path)
+        , m_success(false)
+    {
+    }
+
+    QByteArray data() const { return m_data; }
+    bool success() const { return m_success; }
+
+protected:
+    void run() override
+    {
+        m_data = m_cache->fileData(m_path, m_success);
+    }
+
+private:
+    AssetCache *m_cache;
+    QString m_path;
+    QByteArray m_data;
+    bool m_success;
+};
+
+} // namespace
+
+class tst_AssetCache : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void checkHit()
+    {
+        // GIVEN
+        QTemporaryDir dir;
+        const QString path = dir.filePath(QStringLiteral("buffer.bin"));
+        QVERIFY(writeFile(path, QByteArray(64, 'a')));
+        AssetCache cache;
+
+        // WHEN
+        bool success = false;
+        const QByteArray first = cache.fileData(path, success);
+
+        // THEN
+        QVERIFY(success);
+        QCOMPARE(first, QByteArray(64, 'a'));
+        QCOMPARE(cache.statistics().hits, 0);
+        QCOMPARE(cache.statistics().misses, 1);
+        QCOMPARE(cache.statistics().size, qint64(64));
+
+        // WHEN
+        const QByteArray second = cache.fileData(path, success);
+
+        // THEN
+        QVERIFY(success);
+        QCOMPARE(second.constData(), first.constData());
+        QCOMPARE(cache.statistics().hits, 1);
+        QCOMPARE(cache.statistics().misses, 1);
+    }
+
+    void checkModifiedFileIsReadAgain()
+    {
+        // GIVEN
+        QTemporaryDir dir;
+        const QString path = dir.filePath(QStringLiteral("buffer.bin"));
+        QVERIFY(writeFile(path, QByteArray(64, 'a')));
+        AssetCache cache;
+        bool success = false;
+        cache.fileData(path, success);
+
+        // WHEN
+        QVERIFY(writeFile(path, QByteArray(32, 'b')));
+        const QByteArray data = cache.fileData(path, success);
+
+        // THEN
+        QVERIFY(success);
+        QCOMPARE(data, QByteArray(32, 'b'));
+        QCOMPARE(cache.statistics().hits, 0);
+        QCOMPARE(cache.statistics().misses, 2);
+    }
+
+    void checkIdenticalContentsAreShared()
+    {
+        // GIVEN
+        QTemporaryDir dir;
+        const QString path1 = dir.filePath(QStringLiteral("buffer1.bin"));
+        const QString path2 = dir.filePath(QStringLiteral("buffer2.bin"));
+        QVERIFY(writeFile(path1, QByteArray(64, 'a')));
+        QVERIFY(writeFile(path2, QByteArray(64, 'a')));
+        AssetCache cache;
+
+        // WHEN
+        bool success1 = false;
+        bool success2 = false;
+        const QByteArray data1 = cache.fileData(path1, success1);
+        const QByteArray data2 = cache.fileData(path2, success2);
+
+        // THEN
+        QVERIFY(success1);
+        QVERIFY(success2);
+        QCOMPARE(data1.constData(), data2.constData());
+        QCOMPARE(cache.statistics().misses, 2);
+        QCOMPARE(cache.statistics().size, qint64(64));
+    }
+
+    void checkMissingFile()
+    {
+        // GIVEN
+        QTemporaryDir dir;
+        AssetCache cache;
+
+        // WHEN
+        bool success = true;
+        const QByteArray data = cache.fileData(dir.filePath(QStringLiteral("missing.bin")), success);
+
+        // THEN
+        QVERIFY(!success);
+        QVERIFY(data.isEmpty());
+    }
+
+    void checkEviction()
+    {
+        // GIVEN
+        QTemporaryDir dir;
+        const QString path1 = dir.filePath(QStringLiteral("buffer1.bin"));
+        const QString path2 = dir.filePath(QStringLiteral("buffer2.bin"));
+        QVERIFY(writeFile(path1, QByteArray(64, 'a')));
+        QVERIFY(writeFile(path2, QByteArray(64, 'b')));
+        AssetCache cache;
+        cache.setMaximumSize(100);
+        bool success = false;
+
+        // WHEN
+        QByteArray data1 = cache.fileData(path1, success);
+        const QByteArray data2 = cache.fileData(path2, success);
+
+        // THEN -> data in use isn't evicted
+        QCOMPARE(cache.statistics().evictions, 0);
+        QCOMPARE(cache.statistics().size, qint64(128));
+
+        // WHEN
+        data1.clear();
+        cache.setMaximumSize(100);
+
+        // THEN
+        QCOMPARE(cache.statistics().evictions, 1);
+        QCOMPARE(cache.statistics().size, qint64(64));
+
+        // WHEN
+        cache.fileData(path1, success);
+        cache.fileData(path2, success);
+
+        // THEN
+        QCOMPARE(cache.statistics().misses, 3);
+        QCOMPARE(cache.statistics().hits, 1);
+    }
+
+    void checkClear()
+    {
+        // GIVEN
+        QTemporaryDir dir;
+        const QString path = dir.filePath(QStringLiteral("buffer.bin"));
+        QVERIFY(writeFile(path, QByteArray(64, 'a')));
+        AssetCache cache;
+        bool success = false;
+        cache.fileData(path, success);
+
+        // WHEN
+        cache.clear();
+
+        // THEN
+        QCOMPARE(cache.statistics().misses, 0);
+        QCOMPARE(cache.statistics().size, qint64(0));
+
+        // WHEN
+        cache.fileData(path, success);
+
+        // THEN
+        QCOMPARE(cache.statistics().hits, 0);
+        QCOMPARE(cache.statistics().misses, 1);
+    }
+
+    void checkConcurrentReads()
+    {
+        // GIVEN
+        QTemporaryDir dir;
+        const QString pathA = dir.filePath(QStringLiteral("a.bin"));
+        const QString pathB = dir.filePath(QStringLiteral("b.bin"));
+        QVERIFY(writeFile(pathA, QByteArray(1024 * 1024, 'a')));
+        QVERIFY(writeFile(pathB, QByteArray(1024 * 1024, 'b')));
+        AssetCache cache;
+        std::vector<std::unique_ptr<ReaderThread>> readers;
+        for (int i = 0; i < 8; ++i)
+            readers.emplace_back(new ReaderThread(&cache, (i % 2) ? pathB : pathA));
+
+        // WHEN
+        for (const auto &reader : readers)
+            reader->start();
+        for (const auto &reader : readers)
+            QVERIFY(reader->wait());
+
+        // THEN -> each file is read once and its data is shared
+        QCOMPARE(cache.statistics().misses, 2);
+        QCOMPARE(cache.statistics().hits, 6);
+        QCOMPARE(cache.statistics().size, qint64(2 * 1024 * 1024));
+        for (int i = 0; i < 8; ++i) {
+            QVERIFY(readers[i]->success());
+            QCOMPARE(readers[i]->data().constData(), readers[i % 2]->data().constData());
+        }
+        QCOMPARE(readers[0]->data(), QByteArray(1024 * 1024, 'a'));
+        QCOMPARE(readers[1]->data(), QByteArray(1024 * 1024, 'b'));
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_AssetCache)
+
+#include "tst_assetcache.moc"
@@ -229,6 +229,72 @@ private Q_SLOTS:
                   << QStringLiteral("asset2")
                   << QStringLiteral("asset4")));
     }
+
+    void shouldCreateAssetsOnFirstLookup()
+    {
+        // GIVEN
+        DummyAssetCollection collection;
+        Qt3DCore::QEntity owner;
+        int factoryCalls = 0;
+        QSignalSpy nameChangeSpy(&collection, SIGNAL(namesChanged()));
+
+        // WHEN
+        collection.addAssetFactory(QStringLiteral("lazy"), &owner, [&factoryCalls]() -> Qt3DCore::QNode * {
+            ++factoryCalls;
+            return new Qt3DRender::QMaterial;
+        });
+
+        // THEN
+        QCOMPARE(collection.names(), QStringList() << QStringLiteral("lazy"));
+        QCOMPARE(collection.size(), 1);
+        QVERIFY(collection.contains(QStringLiteral("lazy")));
+        QVERIFY(collection.hasAssetFactory(QStringLiteral("lazy")));
+        QCOMPARE(factoryCalls, 0);
+        QCOMPARE(nameChangeSpy.count(), 1);
+
+        // WHEN
+        Qt3DRender::QMaterial *asset = collection.find(QStringLiteral("lazy"));
+
+        // THEN
+        QVERIFY(asset != nullptr);
+        QCOMPARE(asset->parent(), &collection);
+        QCOMPARE(factoryCalls, 1);
+        QVERIFY(!collection.hasAssetFactory(QStringLiteral("lazy")));
+        QCOMPARE(collection.find(QStringLiteral("lazy")), asset);
+        QCOMPARE(factoryCalls, 1);
+        QCOMPARE(collection.size(), 1);
+        QCOMPARE(nameChangeSpy.count(), 1);
+    }
+
+    void shouldRemoveFactoriesOfDestroyedOwner()
+    {
+        // GIVEN
+        DummyAssetCollection collection;
+        auto owner = new Qt3DCore::QEntity;
+        collection.addAssetFactory(QStringLiteral("lazy"), owner, []() -> Qt3DCore::QNode * {
+            return new Qt3DRender::QMaterial;
+        });
+        collection.addAssetFactory(QStringLiteral("empty"), owner, []() -> Qt3DCore::QNode * {
+            return nullptr;
+        });
+        QSignalSpy nameChangeSpy(&collection, SIGNAL(namesChanged()));
+
+        // WHEN
+        Qt3DRender::QMaterial *asset = collection.find(QStringLiteral("empty"));
+
+        // THEN
+        QVERIFY(asset == nullptr);
+        QCOMPARE(collection.names(), QStringList() << QStringLiteral("lazy"));
+        QCOMPARE(nameChangeSpy.count(), 1);
+
+        // WHEN
+        delete owner;
+
+        // THEN
+        QVERIFY(collection.names().empty());
+        QCOMPARE(collection.find(QStringLiteral("lazy")), nullptr);
+        QCOMPARE(nameChangeSpy.count(), 2);
+    }
 };
 
 QTEST_GUILESS_MAIN(tst_AssetCollection)
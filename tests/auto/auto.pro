@@ -36,6 +36,10 @@ SUBDIRS = \
     effectcollection \
     sceneentity \
     textureimagecollection \
+    blendedanimationplayer \
+    bakedskinninganimation \
+    gaussianblureffect \
+    metallicroughnesseffect \
     assetpipelineeditor
 
 #installed_cmake.depends = cmake
@@ -59,5 +63,15 @@ qtConfig(private_tests) {
         skinparser \
         postfxlistextension \
         assetitem \
-        forwardrenderer
+        forwardrenderer \
+        animationplayer \
+        animationsampler \
+        transformtrackanimator \
+        rendertargetpool \
+        renderscalecontroller \
+        renderstageprofiler \
+        meshoptimizer \
+        scenequery \
+        assetcache \
+        sceneupdater
 }
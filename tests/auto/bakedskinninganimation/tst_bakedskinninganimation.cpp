@@ -0,0 +1,234 @@
+/*
+    tst_bakedskinninganimation.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/bakedskinninganimation.h>
+#include <Kuesa/private/bakedskinninganimation_p.h>
+#include <Kuesa/metallicroughnessmaterial.h>
+#include <Qt3DCore/QJoint>
+#include <Qt3DCore/QSkeleton>
+#include <Qt3DRender/QParameter>
+#include <Qt3DAnimation/QAnimationClip>
+#include <Qt3DAnimation/QChannelMapper>
+#include <Qt3DAnimation/QChannelMapping>
+
+namespace {
+
+Qt3DAnimation::QChannelComponent linearComponent(float v0, float v1)
+{
+    Qt3DAnimation::QChannelComponent component;
+    Qt3DAnimation::QKeyFrame k0(QVector2D(0.0f, v0));
+    Qt3DAnimation::QKeyFrame k1(QVector2D(1.0f, v1));
+    k0.setInterpolationType(Qt3DAnimation::QKeyFrame::LinearInterpolation);
+    k1.setInterpolationType(Qt3DAnimation::QKeyFrame::LinearInterpolation);
+    component.appendKeyFrame(k0);
+    component.appendKeyFrame(k1);
+    return component;
+}
+
+Qt3DRender::QParameter *findParameter(Qt3DRender::QMaterial *material, const QString &name)
+{
+    const auto parameters = material->parameters();
+    for (Qt3DRender::QParameter *parameter : parameters) {
+        if (parameter->name() == name)
+            return parameter;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+class tst_BakedSkinningAnimation : public QObject
+{
+    Q_OBJECT
+
+private:
+    Qt3DCore::QNode m_root;
+    Qt3DCore::QSkeleton *m_skeleton = nullptr;
+    Qt3DCore::QJoint *m_rootJoint = nullptr;
+    Qt3DCore::QJoint *m_childJoint = nullptr;
+    Qt3DAnimation::QAnimationClip *m_clip = nullptr;
+    Qt3DAnimation::QChannelMapper *m_mapper = nullptr;
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        // Root joint offset by 1 on Y, child joint moving from 0 to 2 on X over 1 second
+        m_rootJoint = new Qt3DCore::QJoint;
+        m_rootJoint->setTranslation(QVector3D(0.0f, 1.0f, 0.0f));
+        m_childJoint = new Qt3DCore::QJoint;
+        m_childJoint->setInverseBindMatrix([] {
+            QMatrix4x4 m;
+            m.translate(0.0f, -1.0f, 0.0f);
+            return m;
+        }());
+        m_rootJoint->addChildJoint(m_childJoint);
+
+        m_skeleton = new Qt3DCore::QSkeleton(&m_root);
+        m_skeleton->setRootJoint(m_rootJoint);
+
+        Qt3DAnimation::QChannel channel(QStringLiteral("Location_1"));
+        channel.appendChannelComponent(linearComponent(0.0f, 2.0f));
+        channel.appendChannelComponent(linearComponent(0.0f, 0.0f));
+        channel.appendChannelComponent(linearComponent(0.0f, 0.0f));
+        Qt3DAnimation::QAnimationClipData clipData;
+        clipData.appendChannel(channel);
+        m_clip = new Qt3DAnimation::QAnimationClip(&m_root);
+        m_clip->setClipData(clipData);
+
+        auto mapping = new Qt3DAnimation::QChannelMapping;
+        mapping->setChannelName(QStringLiteral("Location_1"));
+        mapping->setTarget(m_childJoint);
+        mapping->setProperty(QStringLiteral("translation"));
+        m_mapper = new Qt3DAnimation::QChannelMapper(&m_root);
+        m_mapper->addMapping(mapping);
+    }
+
+    void checkDefaults()
+    {
+        // GIVEN
+        Kuesa::BakedSkinningAnimation baked;
+
+        // THEN
+        QCOMPARE(baked.framesPerSecond(), 30.0f);
+        QCOMPARE(baked.time(), 0.0f);
+        QCOMPARE(baked.jointCount(), 0);
+        QCOMPARE(baked.clipCount(), 0);
+        QVERIFY(baked.texture() != nullptr);
+    }
+
+    void checkInvalidInput()
+    {
+        // GIVEN
+        Kuesa::BakedSkinningAnimation baked;
+
+        // WHEN
+        const int idx = baked.addClip(m_clip, m_mapper, nullptr);
+
+        // THEN
+        QCOMPARE(idx, -1);
+        QCOMPARE(baked.clipCount(), 0);
+    }
+
+    void checkBaking()
+    {
+        // GIVEN
+        Kuesa::BakedSkinningAnimation baked;
+        baked.setFramesPerSecond(4.0f);
+        QSignalSpy bakedSpy(&baked, &Kuesa::BakedSkinningAnimation::bakedDataChanged);
+
+        // WHEN
+        const int first = baked.addClip(m_clip, m_mapper, m_skeleton);
+        const int second = baked.addClip(m_clip, m_mapper, m_skeleton);
+
+        // THEN
+        QCOMPARE(first, 0);
+        QCOMPARE(second, 1);
+        QCOMPARE(bakedSpy.count(), 2);
+        QCOMPARE(baked.jointCount(), 2);
+        QCOMPARE(baked.clipDuration(0), 1.0f);
+        QCOMPARE(baked.clipFrameCount(0), 5);
+        QCOMPARE(baked.clipFirstFrame(0), 0);
+        QCOMPARE(baked.clipFirstFrame(1), 5);
+
+        // THEN -> Root joint isn't animated, its skinning matrix is its transform
+        QCOMPARE(baked.skinningMatrix(0, 0, 0).column(3), QVector4D(0.0f, 1.0f, 0.0f, 1.0f));
+
+        // THEN -> Child joint follows the clip, the bind pose offset cancels the root's
+        QCOMPARE(baked.skinningMatrix(0, 0, 1).column(3), QVector4D(0.0f, 0.0f, 0.0f, 1.0f));
+        QCOMPARE(baked.skinningMatrix(0, 2, 1).column(3), QVector4D(1.0f, 0.0f, 0.0f, 1.0f));
+        QCOMPARE(baked.skinningMatrix(1, 4, 1).column(3), QVector4D(2.0f, 0.0f, 0.0f, 1.0f));
+
+        // WHEN
+        baked.clear();
+
+        // THEN
+        QCOMPARE(baked.clipCount(), 0);
+        QCOMPARE(baked.jointCount(), 0);
+    }
+
+    void checkAttachSharesParameters()
+    {
+        // GIVEN
+        Kuesa::BakedSkinningAnimation baked;
+        baked.addClip(m_clip, m_mapper, m_skeleton);
+        Kuesa::MetallicRoughnessMaterial material1;
+        Kuesa::MetallicRoughnessMaterial material2;
+
+        // WHEN
+        baked.attach(&material1, 0);
+        baked.attach(&material2, 0, 0.5f);
+
+        // THEN
+        QVERIFY(material1.useBakedSkinning());
+        QVERIFY(material2.useBakedSkinning());
+        Qt3DRender::QParameter *time1 = findParameter(&material1, QStringLiteral("bakedSkinningTime"));
+        Qt3DRender::QParameter *time2 = findParameter(&material2, QStringLiteral("bakedSkinningTime"));
+        QVERIFY(time1 != nullptr);
+        QCOMPARE(time1, time2);
+        QCOMPARE(findParameter(&material1, QStringLiteral("bakedSkinningTexture")),
+                 findParameter(&material2, QStringLiteral("bakedSkinningTexture")));
+        QCOMPARE(findParameter(&material2, QStringLiteral("bakedSkinningClip"))->value().value<QVector4D>(),
+                 QVector4D(0.0f, 31.0f, 1.0f, 0.5f));
+
+        // WHEN
+        baked.setTime(0.25f);
+
+        // THEN
+        QCOMPARE(time1->value().toFloat(), 0.25f);
+
+        // WHEN
+        baked.detach(&material1);
+
+        // THEN
+        QVERIFY(!material1.useBakedSkinning());
+        QVERIFY(findParameter(&material1, QStringLiteral("bakedSkinningTime")) == nullptr);
+        QVERIFY(findParameter(&material1, QStringLiteral("bakedSkinningClip")) == nullptr);
+    }
+
+    void checkTextureDataGeneratorComparison()
+    {
+        // GIVEN -> the textures of two animations baked once each
+        const QVector<float> data1(4 * 4, 1.0f);
+        const QVector<float> data2(4 * 4, 2.0f);
+        const Kuesa::BakedSkinningTextureDataGenerator generator1(data1, 2, 2);
+        const Kuesa::BakedSkinningTextureDataGenerator generator2(data2, 2, 2);
+
+        // THEN -> Qt3D mustn't share their textures
+        QVERIFY(!(generator1 == generator2));
+        QVERIFY(!(generator1 == Kuesa::BakedSkinningTextureDataGenerator(data1, 4, 1)));
+
+        // THEN -> unless they hold the same data
+        QVERIFY(generator1 == Kuesa::BakedSkinningTextureDataGenerator(data1, 2, 2));
+        QVERIFY(generator1 == Kuesa::BakedSkinningTextureDataGenerator(QVector<float>(4 * 4, 1.0f), 2, 2));
+    }
+};
+
+QTEST_GUILESS_MAIN(tst_BakedSkinningAnimation)
+#include "tst_bakedskinninganimation.moc"
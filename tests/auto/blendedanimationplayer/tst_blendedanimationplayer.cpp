@@ -0,0 +1,196 @@
+/*
+    tst_blendedanimationplayer.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/sceneentity.h>
+#include <Kuesa/blendedanimationplayer.h>
+#include <Qt3DCore/QTransform>
+#include <Qt3DAnimation/QAnimationClip>
+#include <Qt3DAnimation/QChannelMapper>
+#include <Qt3DAnimation/QChannelMapping>
+#include <Qt3DAnimation/QClipBlendValue>
+#include <Qt3DAnimation/QLerpClipBlend>
+#include <Qt3DAnimation/QAdditiveClipBlend>
+
+class tst_BlendedAnimationPlayer : public QObject
+{
+    Q_OBJECT
+
+private:
+    Qt3DCore::QTransform *m_transform = nullptr;
+
+    void addClip(Kuesa::SceneEntity *scene, const QString &name)
+    {
+        // All clips animate the same node, hence use the same channel names
+        auto clip = new Qt3DAnimation::QAnimationClip;
+        Qt3DAnimation::QAnimationClipData clipData;
+        clipData.appendChannel(Qt3DAnimation::QChannel(QStringLiteral("Location_0")));
+        clip->setClipData(clipData);
+        scene->animationClips()->add(name, clip);
+
+        auto mapping = new Qt3DAnimation::QChannelMapping;
+        mapping->setChannelName(QStringLiteral("Location_0"));
+        mapping->setProperty(QStringLiteral("translation"));
+        mapping->setTarget(m_transform);
+
+        auto mapper = new Qt3DAnimation::QChannelMapper;
+        mapper->addMapping(mapping);
+        scene->animationMappings()->add(name, mapper);
+    }
+
+    void populateScene(Kuesa::SceneEntity *scene)
+    {
+        m_transform = new Qt3DCore::QTransform(scene);
+        addClip(scene, QStringLiteral("Walk"));
+        addClip(scene, QStringLiteral("Run"));
+        addClip(scene, QStringLiteral("Wave"));
+    }
+
+private Q_SLOTS:
+    void checkDefaults()
+    {
+        // GIVEN
+        Kuesa::BlendedAnimationPlayer player;
+
+        // THEN
+        QCOMPARE(player.status(), Kuesa::BlendedAnimationPlayer::None);
+        QVERIFY(player.clips().isEmpty());
+        QVERIFY(player.blendTree() == nullptr);
+        QVERIFY(player.channelMapper() == nullptr);
+    }
+
+    void checkInvalidClip()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        populateScene(&scene);
+        auto player = new Kuesa::BlendedAnimationPlayer(&scene);
+
+        // WHEN
+        player->addClip(QStringLiteral("Walk"));
+        player->addClip(QStringLiteral("Jump"));
+
+        // THEN
+        QCOMPARE(player->status(), Kuesa::BlendedAnimationPlayer::Error);
+        QVERIFY(player->blendTree() == nullptr);
+
+        // WHEN
+        player->removeClip(QStringLiteral("Jump"));
+
+        // THEN
+        QCOMPARE(player->status(), Kuesa::BlendedAnimationPlayer::Ready);
+    }
+
+    void checkWeightedBlendTree()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        populateScene(&scene);
+        auto player = new Kuesa::BlendedAnimationPlayer(&scene);
+
+        // WHEN
+        player->addClip(QStringLiteral("Walk"), 1.0f);
+        player->addClip(QStringLiteral("Run"), 3.0f);
+
+        // THEN
+        QCOMPARE(player->status(), Kuesa::BlendedAnimationPlayer::Ready);
+        QCOMPARE(player->clips(), QStringList({ QStringLiteral("Walk"), QStringLiteral("Run") }));
+        auto lerp = qobject_cast<Qt3DAnimation::QLerpClipBlend *>(player->blendTree());
+        QVERIFY(lerp);
+        QCOMPARE(lerp->blendFactor(), 0.75f);
+        auto start = qobject_cast<Qt3DAnimation::QClipBlendValue *>(lerp->startClip());
+        auto end = qobject_cast<Qt3DAnimation::QClipBlendValue *>(lerp->endClip());
+        QVERIFY(start && end);
+        QCOMPARE(start->clip(), scene.animationClip(QStringLiteral("Walk")));
+        QCOMPARE(end->clip(), scene.animationClip(QStringLiteral("Run")));
+
+        // WHEN
+        player->setClipWeight(QStringLiteral("Run"), 1.0f);
+
+        // THEN -> only the factor is updated
+        QCOMPARE(player->blendTree(), lerp);
+        QCOMPARE(lerp->blendFactor(), 0.5f);
+
+        // WHEN
+        player->crossFade(QStringLiteral("Walk"), QStringLiteral("Run"), 0.2f);
+
+        // THEN
+        QCOMPARE(player->blendTree(), lerp);
+        QVERIFY(qFuzzyCompare(lerp->blendFactor(), 0.2f));
+    }
+
+    void checkAdditiveLayer()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        populateScene(&scene);
+        auto player = new Kuesa::BlendedAnimationPlayer(&scene);
+
+        // WHEN
+        player->addClip(QStringLiteral("Wave"), 0.5f, Kuesa::BlendedAnimationPlayer::Additive);
+
+        // THEN -> an additive layer needs a base
+        QCOMPARE(player->status(), Kuesa::BlendedAnimationPlayer::Error);
+
+        // WHEN
+        player->addClip(QStringLiteral("Walk"));
+
+        // THEN
+        QCOMPARE(player->status(), Kuesa::BlendedAnimationPlayer::Ready);
+        auto additive = qobject_cast<Qt3DAnimation::QAdditiveClipBlend *>(player->blendTree());
+        QVERIFY(additive);
+        QCOMPARE(additive->additiveFactor(), 0.5f);
+        auto base = qobject_cast<Qt3DAnimation::QClipBlendValue *>(additive->baseClip());
+        QVERIFY(base);
+        QCOMPARE(base->clip(), scene.animationClip(QStringLiteral("Walk")));
+    }
+
+    void checkChannelsAreResolvedOnce()
+    {
+        // GIVEN
+        Kuesa::SceneEntity scene;
+        populateScene(&scene);
+        auto player = new Kuesa::BlendedAnimationPlayer(&scene);
+
+        // WHEN
+        player->addClip(QStringLiteral("Walk"));
+        player->addClip(QStringLiteral("Run"));
+        player->addClip(QStringLiteral("Wave"), 1.0f, Kuesa::BlendedAnimationPlayer::Additive);
+
+        // THEN
+        Qt3DAnimation::QChannelMapper *mapper = player->channelMapper();
+        QVERIFY(mapper);
+        QCOMPARE(mapper->mappings().size(), 1);
+        // Mapping node is shared, not copied
+        QCOMPARE(mapper->mappings().first(), scene.animationMapping(QStringLiteral("Walk"))->mappings().first());
+    }
+};
+
+QTEST_GUILESS_MAIN(tst_BlendedAnimationPlayer)
+#include "tst_blendedanimationplayer.moc"
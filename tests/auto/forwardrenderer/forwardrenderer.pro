@@ -28,7 +28,7 @@ TEMPLATE = app
 
 TARGET = tst_forwardrenderer
 
-QT += testlib kuesa kuesa-private 3dcore 3drender
+QT += testlib kuesa kuesa-private 3dcore 3drender 3dlogic
 
 CONFIG += testcase
 
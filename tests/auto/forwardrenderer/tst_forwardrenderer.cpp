@@ -30,9 +30,16 @@
 
 #include <Kuesa/forwardrenderer.h>
 #include <Kuesa/abstractpostprocessingeffect.h>
+#include <Kuesa/thresholdeffect.h>
+#include <Kuesa/opacitymask.h>
 #include <Kuesa/private/opaquerenderstage_p.h>
 #include <Kuesa/private/zfillrenderstage_p.h>
 #include <Kuesa/private/transparentrenderstage_p.h>
+#include <Kuesa/private/rendertargetpool_p.h>
+#include <Kuesa/private/fusedpostprocessingeffect_p.h>
+#include <Kuesa/private/weightedblendedrenderstage_p.h>
+#include <Kuesa/private/weightedblendedcompositeeffect_p.h>
+#include <Kuesa/private/renderstageprofiler_p.h>
 #include <Qt3DRender/QViewport>
 #include <Qt3DRender/QCameraSelector>
 #include <Qt3DRender/QCamera>
@@ -44,6 +51,9 @@
 #include <Qt3DRender/QRenderTargetSelector>
 #include <Qt3DRender/QRenderTargetOutput>
 #include <Qt3DRender/QFrustumCulling>
+#include <Qt3DRender/QParameter>
+#include <Qt3DRender/QSortPolicy>
+#include <Qt3DLogic/QFrameAction>
 #include <QWindow>
 #include <QOffscreenSurface>
 
@@ -95,6 +105,82 @@ private:
     Qt3DRender::QAbstractTexture *m_inputTexture;
 };
 
+struct DrawCommand
+{
+    int id;
+    int shader;
+    int changeCost;
+    float depth;
+};
+
+// Orders commands the way Qt3D's render views apply a QSortPolicy: a stable
+// sort on the first criterion, then each run of equal keys is sorted by the
+// next criterion
+void sortDrawCommands(QVector<DrawCommand>::iterator begin, QVector<DrawCommand>::iterator end,
+                      const QVector<Qt3DRender::QSortPolicy::SortType> &sortTypes, int level = 0)
+{
+    if (level >= sortTypes.size() || end - begin < 2)
+        return;
+
+    const Qt3DRender::QSortPolicy::SortType sortType = sortTypes.at(level);
+    const auto key = [sortType](const DrawCommand &command) -> float {
+        switch (sortType) {
+        case Qt3DRender::QSortPolicy::Material:
+            return command.shader;
+        case Qt3DRender::QSortPolicy::StateChangeCost:
+            return -command.changeCost;
+        case Qt3DRender::QSortPolicy::FrontToBack:
+            return command.depth;
+        case Qt3DRender::QSortPolicy::BackToFront:
+            return -command.depth;
+        default:
+            return 0.0f;
+        }
+    };
+    std::stable_sort(begin, end, [&key](const DrawCommand &a, const DrawCommand &b) {
+        return key(a) < key(b);
+    });
+
+    for (auto rangeBegin = begin; rangeBegin != end;) {
+        const float rangeKey = key(*rangeBegin);
+        const auto rangeEnd = std::find_if(rangeBegin, end, [&key, rangeKey](const DrawCommand &command) {
+            return key(command) != rangeKey;
+        });
+        sortDrawCommands(rangeBegin, rangeEnd, sortTypes, level + 1);
+        rangeBegin = rangeEnd;
+    }
+}
+
+QVector<int> drawOrder(const Qt3DRender::QSortPolicy *sortPolicy)
+{
+    // Two shaders with interleaved depths, one of them with extra render states
+    QVector<DrawCommand> commands = {
+        { 0, 1, 0, 4.0f },
+        { 1, 2, 1, 1.0f },
+        { 2, 1, 0, 2.0f },
+        { 3, 2, 1, 3.0f },
+        { 4, 1, 2, 5.0f },
+    };
+    if (sortPolicy->isEnabled())
+        sortDrawCommands(commands.begin(), commands.end(), sortPolicy->sortTypes());
+
+    QVector<int> ids;
+    for (const DrawCommand &command : qAsConst(commands))
+        ids.push_back(command.id);
+    return ids;
+}
+
+QVector<Qt3DRender::QFrameGraphNode *> frameGraphLeaves(Qt3DRender::QFrameGraphNode *node)
+{
+    QVector<Qt3DRender::QFrameGraphNode *> leaves;
+    const auto children = node->findChildren<Qt3DRender::QFrameGraphNode *>(QString(), Qt::FindDirectChildrenOnly);
+    if (children.empty())
+        leaves.push_back(node);
+    for (Qt3DRender::QFrameGraphNode *child : children)
+        leaves += frameGraphLeaves(child);
+    return leaves;
+}
+
 } // namespace
 
 class tst_ForwardRenderer : public QObject
@@ -347,14 +433,23 @@ private Q_SLOTS:
             // WHEN
             renderer.addPostProcessingEffect(&fx);
 
-            // THEN
+            // THEN - reconfiguration is deferred
             QCOMPARE(renderer.postProcessingEffects().size(), 1);
             QCOMPARE(renderer.postProcessingEffects().first(), &fx);
+            QCOMPARE(spy.size(), 0);
+
+            // WHEN
+            QCoreApplication::processEvents();
+
+            // THEN
             // QVERIFY(renderer.frameGraphSubtreeForPostProcessingEffect(&fx) != nullptr);
             QCOMPARE(spy.size(), 1);
             spy.clear();
         }
 
+        // WHEN
+        QCoreApplication::processEvents();
+
         // THEN
         QCOMPARE(renderer.postProcessingEffects().size(), 0);
         QCOMPARE(spy.size(), 1);
@@ -367,6 +462,7 @@ private Q_SLOTS:
         tst_FX fx;
         QSignalSpy spy(&renderer, SIGNAL(frameGraphTreeReconfigured()));
         renderer.addPostProcessingEffect(&fx);
+        QCoreApplication::processEvents();
 
         // THEN
         // QVERIFY(renderer.frameGraphSubtreeForPostProcessingEffect(&fx) != nullptr);
@@ -401,6 +497,7 @@ private Q_SLOTS:
         // WHEN - removing and re-adding fx3
         renderer.removePostProcessingEffect(&fx3);
         renderer.addPostProcessingEffect(&fx3);
+        QCoreApplication::processEvents();
 
         // THEN - fx3 should go at end and order should now be 1, 2, 3
         QCOMPARE(renderer.postProcessingEffects().size(), 3);
@@ -439,6 +536,7 @@ private Q_SLOTS:
         tst_FX fx1, fx2;
         renderer.addPostProcessingEffect(&fx1);
         renderer.addPostProcessingEffect(&fx2);
+        QCoreApplication::processEvents();
 
         auto renderTargetSelector = findParentSGNode<Qt3DRender::QRenderTargetSelector>(fx1.frameGraphSubTree().data());
         auto fx1Texture = renderTargetSelector->target()->outputs().first()->texture();
@@ -459,8 +557,9 @@ private Q_SLOTS:
         // WHEN
         spy.clear();
         window->resize(128, 128);
+        QCoreApplication::processEvents();
 
-        // THEN
+        // THEN - updated once control returns to the event loop
         QVERIFY(spy.size() >= 1);
         QCOMPARE(fx1Texture->width(), window->width());
         QCOMPARE(fx1Texture->height(), window->height());
@@ -479,6 +578,7 @@ private Q_SLOTS:
         // WHEN
         spy.clear();
         renderer.setExternalRenderTargetSize(QSize(64, 64));
+        QCoreApplication::processEvents();
 
         // THEN
         QVERIFY(spy.size() >= 1);
@@ -535,6 +635,7 @@ private Q_SLOTS:
         // WHEN
         tst_FX fx;
         renderer.addPostProcessingEffect(&fx);
+        QCoreApplication::processEvents();
 
         // THEN
         QVERIFY(opaqueStage->parent() != noFXStageParent);
@@ -542,12 +643,522 @@ private Q_SLOTS:
 
         // WHEN
         renderer.removePostProcessingEffect(&fx);
+        QCoreApplication::processEvents();
 
         // THEN
         QVERIFY(opaqueStage->parent() == noFXStageParent);
     }
 
+    void testOpaqueSortPolicy()
+    {
+        // GIVEN
+        Kuesa::ForwardRenderer renderer;
+        QSignalSpy spy(&renderer, SIGNAL(opaqueSortPolicyChanged(Kuesa::ForwardRenderer::OpaqueSortPolicy)));
+        QVERIFY(spy.isValid());
+        Kuesa::OpaqueRenderStage *opaqueStage = static_cast<Kuesa::OpaqueRenderStage *>(renderer.renderStages().first());
+        Qt3DRender::QSortPolicy *sortPolicy = opaqueStage->findChild<Qt3DRender::QSortPolicy *>();
+
+        // THEN - opaque objects aren't sorted by default
+        QCOMPARE(renderer.opaqueSortPolicy(), Kuesa::ForwardRenderer::NoOpaqueSorting);
+        QVERIFY(sortPolicy != nullptr);
+        QVERIFY(!sortPolicy->isEnabled());
+        QVERIFY(opaqueStage->sortTypes().empty());
+        QCOMPARE(drawOrder(sortPolicy), (QVector<int>{ 0, 1, 2, 3, 4 }));
+
+        // THEN - the policy is the only leaf, so every opaque draw goes through it
+        QCOMPARE(frameGraphLeaves(opaqueStage), (QVector<Qt3DRender::QFrameGraphNode *>{ sortPolicy }));
+
+        // WHEN
+        renderer.setOpaqueSortPolicy(Kuesa::ForwardRenderer::StateChangeOpaqueSorting);
+
+        // THEN - shader program first, then render states, then front to back
+        QCOMPARE(spy.size(), 1);
+        QVERIFY(sortPolicy->isEnabled());
+        QCOMPARE(opaqueStage->sortTypes(), (QVector<Qt3DRender::QSortPolicy::SortType>{
+                                                   Qt3DRender::QSortPolicy::Material,
+                                                   Qt3DRender::QSortPolicy::StateChangeCost,
+                                                   Qt3DRender::QSortPolicy::FrontToBack }));
+        QCOMPARE(sortPolicy->sortTypes(), opaqueStage->sortTypes());
+
+        // THEN - shader 1 before shader 2, cheapest state changes last, front to back within
+        QCOMPARE(drawOrder(sortPolicy), (QVector<int>{ 4, 2, 0, 1, 3 }));
+
+        // WHEN - adding a zfill stage
+        renderer.setZFilling(true);
+
+        // THEN - opaque stage keeps its policy
+        QCOMPARE(renderer.renderStages().at(1), opaqueStage);
+        QCOMPARE(opaqueStage->sortTypes().size(), 3);
+        QCOMPARE(frameGraphLeaves(opaqueStage), (QVector<Qt3DRender::QFrameGraphNode *>{ sortPolicy }));
+
+        // WHEN
+        renderer.setOpaqueSortPolicy(Kuesa::ForwardRenderer::FrontToBackOpaqueSorting);
+
+        // THEN
+        QCOMPARE(spy.size(), 2);
+        QCOMPARE(opaqueStage->sortTypes(), (QVector<Qt3DRender::QSortPolicy::SortType>{ Qt3DRender::QSortPolicy::FrontToBack }));
+        QCOMPARE(drawOrder(sortPolicy), (QVector<int>{ 1, 2, 3, 0, 4 }));
+
+        // WHEN
+        renderer.setOpaqueSortPolicy(Kuesa::ForwardRenderer::NoOpaqueSorting);
+
+        // THEN
+        QCOMPARE(spy.size(), 3);
+        QVERIFY(!sortPolicy->isEnabled());
+        QVERIFY(opaqueStage->sortTypes().empty());
+        QCOMPARE(drawOrder(sortPolicy), (QVector<int>{ 0, 1, 2, 3, 4 }));
+
+        // THEN - transparent objects still sorted separately
+        Kuesa::TransparentRenderStage *transparentStage = static_cast<Kuesa::TransparentRenderStage *>(renderer.renderStages().last());
+        QVERIFY(transparentStage->findChild<Qt3DRender::QSortPolicy *>() != sortPolicy);
+    }
+
+    void testOrderIndependentTransparency()
+    {
+        // GIVEN
+        Kuesa::ForwardRenderer renderer;
+        QSignalSpy spy(&renderer, SIGNAL(orderIndependentTransparencyChanged(bool)));
+        QVERIFY(spy.isValid());
+        renderer.setBackToFrontSorting(true);
+
+        // THEN
+        QVERIFY(!renderer.orderIndependentTransparency());
+        QVERIFY(qobject_cast<Kuesa::TransparentRenderStage *>(renderer.renderStages().last()) != nullptr);
+        QVERIFY(renderer.findChild<Kuesa::WeightedBlendedCompositeEffect *>() == nullptr);
+
+        // WHEN
+        renderer.setOrderIndependentTransparency(true);
+        QCoreApplication::processEvents();
+
+        // THEN -> weighted blended stage replaces the transparent one
+        QVERIFY(renderer.orderIndependentTransparency());
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(renderer.renderStages().size(), 2);
+        auto weightedBlendedStage = qobject_cast<Kuesa::WeightedBlendedRenderStage *>(renderer.renderStages().last());
+        QVERIFY(weightedBlendedStage != nullptr);
+        QCOMPARE(weightedBlendedStage->parent(), renderer.renderStages().first()->parent());
+
+        // THEN -> scene is rendered offscreen and shares its depth with the transparency targets
+        auto sceneTargetSelector = qobject_cast<Qt3DRender::QRenderTargetSelector *>(weightedBlendedStage->parent());
+        QVERIFY(sceneTargetSelector != nullptr);
+        Qt3DRender::QRenderTarget *transparencyTarget = weightedBlendedStage->renderTarget();
+        QVERIFY(transparencyTarget != nullptr);
+        QCOMPARE(transparencyTarget->outputs().size(), 3);
+        Qt3DRender::QAbstractTexture *accumulation = Kuesa::ForwardRenderer::findRenderTargetTexture(transparencyTarget, Qt3DRender::QRenderTargetOutput::Color0);
+        Qt3DRender::QAbstractTexture *weight = Kuesa::ForwardRenderer::findRenderTargetTexture(transparencyTarget, Qt3DRender::QRenderTargetOutput::Color1);
+        QVERIFY(accumulation != nullptr);
+        QVERIFY(weight != nullptr);
+        QCOMPARE(accumulation->format(), Qt3DRender::QAbstractTexture::RGBA16F);
+        QCOMPARE(weight->format(), Qt3DRender::QAbstractTexture::R16F);
+        QCOMPARE(Kuesa::ForwardRenderer::findRenderTargetTexture(transparencyTarget, Qt3DRender::QRenderTargetOutput::Depth),
+                 Kuesa::ForwardRenderer::findRenderTargetTexture(sceneTargetSelector->target(), Qt3DRender::QRenderTargetOutput::Depth));
+        QCOMPARE(transparencyTarget->outputs().first()->objectName(), Kuesa::WeightedBlendedRenderStage::accumulationOutputName());
+
+        // THEN -> composite pass reads the targets and renders on the surface
+        auto compositeEffect = renderer.findChild<Kuesa::WeightedBlendedCompositeEffect *>();
+        QVERIFY(compositeEffect != nullptr);
+        QCOMPARE(compositeEffect->accumulationTexture(), accumulation);
+        QCOMPARE(compositeEffect->weightTexture(), weight);
+        QVERIFY(compositeEffect->frameGraphSubTree()->parent() != nullptr);
+        QVERIFY(qobject_cast<Qt3DRender::QRenderTargetSelector *>(compositeEffect->frameGraphSubTree()->parent()) == nullptr);
+
+        // WHEN
+        tst_FX fx;
+        renderer.addPostProcessingEffect(&fx);
+        QCoreApplication::processEvents();
+
+        // THEN -> effects process the composited scene
+        auto compositeTargetSelector = qobject_cast<Qt3DRender::QRenderTargetSelector *>(compositeEffect->frameGraphSubTree()->parent());
+        QVERIFY(compositeTargetSelector != nullptr);
+        QVERIFY(fx.inputTexture() != nullptr);
+        QCOMPARE(Kuesa::ForwardRenderer::findRenderTargetTexture(compositeTargetSelector->target(), Qt3DRender::QRenderTargetOutput::Color0),
+                 fx.inputTexture());
+        QVERIFY(fx.inputTexture() != Kuesa::ForwardRenderer::findRenderTargetTexture(sceneTargetSelector->target(), Qt3DRender::QRenderTargetOutput::Color0));
+
+        // WHEN
+        renderer.removePostProcessingEffect(&fx);
+        renderer.setOrderIndependentTransparency(false);
+        QCoreApplication::processEvents();
+
+        // THEN -> back to blending in draw order, on the surface
+        QCOMPARE(spy.count(), 2);
+        auto transparentStage = qobject_cast<Kuesa::TransparentRenderStage *>(renderer.renderStages().last());
+        QVERIFY(transparentStage != nullptr);
+        QVERIFY(transparentStage->backToFrontSorting());
+        QVERIFY(qobject_cast<Qt3DRender::QFrustumCulling *>(transparentStage->parent()) != nullptr);
+        QVERIFY(compositeEffect->frameGraphSubTree()->parent() == nullptr);
+    }
+
+    void testBatchedEffectChanges()
+    {
+        // GIVEN
+        Kuesa::ForwardRenderer renderer;
+        QSignalSpy spy(&renderer, SIGNAL(frameGraphTreeReconfigured()));
+        QVERIFY(spy.isValid());
+        tst_FX fx[5];
+        Kuesa::RenderTargetPool *pool = renderer.findChild<Kuesa::RenderTargetPool *>();
+        QVERIFY(pool != nullptr);
+
+        // THEN
+        QCOMPARE(pool->textureCount(), 0);
+        QCOMPARE(pool->renderTargetCount(), 0);
+
+        // WHEN - appending effects the way PostFXListExtension does
+        for (tst_FX &effect : fx)
+            renderer.addPostProcessingEffect(&effect);
+        QCoreApplication::processEvents();
+
+        // THEN - single rebuild, scene color and depth plus one ping-pong texture
+        QCOMPARE(spy.size(), 1);
+        QCOMPARE(pool->textureCount(), 3);
+        QCOMPARE(pool->renderTargetCount(), 3);
+        const QVector<Qt3DRender::QRenderTarget *> targets = renderTargets(renderer);
+        QVERIFY(fx[0].inputTexture() != nullptr);
+        QVERIFY(fx[1].inputTexture() != fx[0].inputTexture());
+        QCOMPARE(fx[2].inputTexture(), fx[0].inputTexture());
+
+        // WHEN - changing the effect chain
+        spy.clear();
+        renderer.removePostProcessingEffect(&fx[4]);
+        renderer.removePostProcessingEffect(&fx[3]);
+        renderer.addPostProcessingEffect(&fx[4]);
+        QCoreApplication::processEvents();
+
+        // THEN - render targets are reused
+        QCOMPARE(spy.size(), 1);
+        QCOMPARE(pool->textureCount(), 3);
+        QCOMPARE(renderTargets(renderer), targets);
+
+        // WHEN - removing all effects
+        spy.clear();
+        for (tst_FX &effect : fx)
+            renderer.removePostProcessingEffect(&effect);
+        QCoreApplication::processEvents();
+
+        // THEN - the pooled render targets and textures are released
+        QCOMPARE(spy.size(), 1);
+        QCOMPARE(renderer.postProcessingEffects().size(), 0);
+        QCOMPARE(pool->textureCount(), 0);
+        QCOMPARE(pool->renderTargetCount(), 0);
+        QVERIFY(renderTargets(renderer).isEmpty());
+    }
+
+    void testCoalescedResizes()
+    {
+        // GIVEN
+        Kuesa::ForwardRenderer renderer;
+        QOffscreenSurface surface;
+        renderer.setExternalRenderTargetSize(QSize(100, 100));
+        renderer.setRenderSurface(&surface);
+        tst_FX fx1, fx2;
+        renderer.addPostProcessingEffect(&fx1);
+        renderer.addPostProcessingEffect(&fx2);
+        QCoreApplication::processEvents();
+
+        const auto textures = renderer.findChildren<Qt3DRender::QAbstractTexture *>();
+        QCOMPARE(textures.size(), 3);
+        QVector<QSharedPointer<QSignalSpy>> sizeSpies;
+        for (Qt3DRender::QAbstractTexture *texture : textures) {
+            sizeSpies.push_back(QSharedPointer<QSignalSpy>::create(texture, SIGNAL(widthChanged(int))));
+            sizeSpies.push_back(QSharedPointer<QSignalSpy>::create(texture, SIGNAL(heightChanged(int))));
+        }
+        const auto setSizeCount = [&sizeSpies] {
+            int count = 0;
+            for (const auto &spy : qAsConst(sizeSpies)) {
+                count += spy->size();
+                spy->clear();
+            }
+            return count;
+        };
+        QSignalSpy sceneSizeSpy(&fx1, SIGNAL(sceneSizeChanged(const QSize &)));
+
+        // WHEN - simulating an interactive resize within a single frame
+        for (int i = 1; i <= 10; ++i)
+            renderer.setExternalRenderTargetSize(QSize(100 + i * 10, 100 + i * 5));
+
+        // THEN - nothing resized yet
+        QCOMPARE(setSizeCount(), 0);
+        QCOMPARE(sceneSizeSpy.size(), 0);
+
+        // WHEN
+        QCoreApplication::processEvents();
+
+        // THEN - each texture is resized once in both dimensions
+        QCOMPARE(setSizeCount(), 2 * textures.size());
+        QCOMPARE(sceneSizeSpy.size(), 1);
+        QCOMPARE(textures.first()->width(), 200);
+        QCOMPARE(textures.first()->height(), 150);
+
+        // WHEN - rounding sizes up to buckets
+        sceneSizeSpy.clear();
+        renderer.setRenderTargetSizeGranularity(64);
+        QCoreApplication::processEvents();
+
+        // THEN
+        QCOMPARE(setSizeCount(), 2 * textures.size());
+        QCOMPARE(sceneSizeSpy.size(), 1);
+        QCOMPARE(textures.first()->width(), 256);
+        QCOMPARE(textures.first()->height(), 192);
+
+        // WHEN - resizing within the bucket
+        sceneSizeSpy.clear();
+        for (int i = 1; i <= 10; ++i) {
+            renderer.setExternalRenderTargetSize(QSize(200 + i * 5, 150 + i * 4));
+            QCoreApplication::processEvents();
+        }
+
+        // THEN - no reallocation at all
+        QCOMPARE(setSizeCount(), 0);
+        QCOMPARE(sceneSizeSpy.size(), 0);
+
+        // WHEN - leaving the bucket
+        renderer.setExternalRenderTargetSize(QSize(260, 190));
+        QCoreApplication::processEvents();
+
+        // THEN - only width changed
+        QCOMPARE(setSizeCount(), textures.size());
+        QCOMPARE(sceneSizeSpy.size(), 1);
+        QCOMPARE(textures.first()->width(), 320);
+        QCOMPARE(textures.first()->height(), 192);
+
+        // Cleanup, effects outlive the renderer
+        renderer.removePostProcessingEffect(&fx1);
+        renderer.removePostProcessingEffect(&fx2);
+    }
+
+    void testRenderScale()
+    {
+        // GIVEN
+        Kuesa::ForwardRenderer renderer;
+        QOffscreenSurface surface;
+        renderer.setExternalRenderTargetSize(QSize(200, 100));
+        renderer.setRenderSurface(&surface);
+        tst_FX fx;
+        renderer.addPostProcessingEffect(&fx);
+        QCoreApplication::processEvents();
+        QSignalSpy sceneSizeSpy(&fx, SIGNAL(sceneSizeChanged(const QSize &)));
+        QSignalSpy scaleSpy(&renderer, SIGNAL(renderScaleChanged(float)));
+        const auto textures = renderer.findChildren<Qt3DRender::QAbstractTexture *>();
+
+        // THEN
+        QCOMPARE(renderer.renderScale(), 1.0f);
+        QCOMPARE(renderer.automaticRenderScale(), false);
+        QCOMPARE(textures.first()->width(), 200);
+
+        // WHEN
+        renderer.setRenderScale(0.5f);
+        QCoreApplication::processEvents();
+
+        // THEN - scene and effects rendered at half the surface size
+        QCOMPARE(scaleSpy.size(), 1);
+        QCOMPARE(sceneSizeSpy.size(), 1);
+        QCOMPARE(sceneSizeSpy.first().first().toSize(), QSize(100, 50));
+        for (Qt3DRender::QAbstractTexture *texture : textures) {
+            QCOMPARE(texture->width(), 100);
+            QCOMPARE(texture->height(), 50);
+        }
+
+        // WHEN - out of range
+        renderer.setRenderScale(0.0f);
+
+        // THEN
+        QCOMPARE(renderer.renderScale(), 0.1f);
+
+        // WHEN
+        renderer.setAutomaticRenderScale(true);
+
+        // THEN - frame times measured through a frame action
+        QCOMPARE(renderer.automaticRenderScale(), true);
+        QVERIFY(renderer.findChild<Qt3DCore::QEntity *>(QStringLiteral("KuesaFrameTime")) != nullptr);
+
+        // WHEN
+        renderer.setAutomaticRenderScale(false);
+
+        // THEN
+        QCOMPARE(renderer.automaticRenderScale(), false);
+        QVERIFY(renderer.findChild<Qt3DCore::QEntity *>(QStringLiteral("KuesaFrameTime")) == nullptr);
+
+        // Cleanup, effects outlive the renderer
+        renderer.removePostProcessingEffect(&fx);
+    }
+
+    void testFusingEffects()
+    {
+        // GIVEN
+        Kuesa::ForwardRenderer renderer;
+        Kuesa::ThresholdEffect threshold;
+        Kuesa::OpacityMask mask;
+        tst_FX fx;
+        mask.setPremultipliedAlpha(true);
+        Kuesa::RenderTargetPool *pool = renderer.findChild<Kuesa::RenderTargetPool *>();
+
+        // WHEN
+        renderer.addPostProcessingEffect(&threshold);
+        renderer.addPostProcessingEffect(&mask);
+        renderer.addPostProcessingEffect(&fx);
+        QCoreApplication::processEvents();
+
+        // THEN -> threshold and mask rendered in a single pass
+        auto fusedEffects = renderer.findChildren<Kuesa::FusedPostProcessingEffect *>();
+        QCOMPARE(fusedEffects.size(), 1);
+        Kuesa::FusedPostProcessingEffect *fused = fusedEffects.first();
+        QCOMPARE(fused->effects(), (QVector<Kuesa::AbstractPostProcessingEffect *>{ &threshold, &mask }));
+        QVERIFY(fused->frameGraphSubTree()->parent() != nullptr);
+        QVERIFY(threshold.frameGraphSubTree()->parent() == nullptr);
+        QVERIFY(mask.frameGraphSubTree()->parent() == nullptr);
+        QVERIFY(fx.frameGraphSubTree()->parent() != nullptr);
+        // scene color and depth plus the fused pass output
+        QCOMPARE(pool->textureCount(), 3);
+
+        // WHEN -> mask no longer fusable
+        mask.setPremultipliedAlpha(false);
+        QCoreApplication::processEvents();
+
+        // THEN
+        QCOMPARE(renderer.findChildren<Kuesa::FusedPostProcessingEffect *>().size(), 0);
+        QVERIFY(threshold.frameGraphSubTree()->parent() != nullptr);
+        QVERIFY(mask.frameGraphSubTree()->parent() != nullptr);
+
+        // WHEN -> a single fusable effect isn't fused
+        renderer.removePostProcessingEffect(&mask);
+        QCoreApplication::processEvents();
+
+        // THEN
+        QCOMPARE(renderer.findChildren<Kuesa::FusedPostProcessingEffect *>().size(), 0);
+        QVERIFY(threshold.frameGraphSubTree()->parent() != nullptr);
+
+        // Cleanup, effects outlive the renderer
+        renderer.removePostProcessingEffect(&threshold);
+        renderer.removePostProcessingEffect(&fx);
+    }
+
+    void testFusedShaderCode()
+    {
+        // GIVEN
+        Kuesa::ThresholdEffect threshold;
+        Kuesa::OpacityMask mask;
+        mask.setPremultipliedAlpha(true);
+        Kuesa::FusedPostProcessingEffect fused({ &threshold, &mask });
+
+        // WHEN
+        const QString code = Kuesa::FusedPostProcessingEffect::fragmentShaderCode(fused.effects(), QByteArrayLiteral("#version 150 core\n"));
+
+        // THEN -> effects are applied in order, with their own globals
+        QVERIFY(code.startsWith(QStringLiteral("#version 150 core\n")));
+        QVERIFY(code.contains(QStringLiteral("uniform float kuesa_fx0_threshold;")));
+        QVERIFY(code.contains(QStringLiteral("uniform sampler2D kuesa_fx1_maskTexture;")));
+        const int first = code.indexOf(QStringLiteral("color = kuesa_fx0_apply(color, texCoord);"));
+        const int second = code.indexOf(QStringLiteral("color = kuesa_fx1_apply(color, texCoord);"));
+        QVERIFY(first > 0);
+        QVERIFY(second > first);
+
+        // WHEN
+        threshold.setThreshold(0.5f);
+
+        // THEN -> mirrored parameter follows
+        bool found = false;
+        const auto parameters = fused.frameGraphSubTree()->findChildren<Qt3DRender::QParameter *>();
+        for (const Qt3DRender::QParameter *parameter : parameters) {
+            if (parameter->name() == QStringLiteral("kuesa_fx0_threshold")) {
+                QCOMPARE(parameter->value().toFloat(), 0.5f);
+                found = true;
+            }
+        }
+        QVERIFY(found);
+    }
+
+    void testApproximateProfiling()
+    {
+        // GIVEN
+        Kuesa::ForwardRenderer renderer;
+        tst_FX fx;
+        fx.setObjectName(QStringLiteral("FX"));
+        renderer.addPostProcessingEffect(&fx);
+        QCoreApplication::processEvents();
+        QSignalSpy profilingSpy(&renderer, SIGNAL(approximateProfilingChanged(bool)));
+        QSignalSpy resultsSpy(&renderer, SIGNAL(profilingResultsChanged()));
+
+        // THEN
+        QCOMPARE(renderer.approximateProfiling(), false);
+        QVERIFY(renderer.renderStageTimings().isEmpty());
+        QVERIFY(renderer.renderStageCpuTimings().isEmpty());
+        QCOMPARE(renderer.profiledFrameTime(), 0.0f);
+        QCOMPARE(renderer.profiledCpuFrameTime(), 0.0f);
+        QVERIFY(renderer.findChild<Qt3DCore::QEntity *>(QStringLiteral("KuesaFrameTime")) == nullptr);
+
+        // WHEN
+        renderer.setApproximateProfiling(true);
+
+        // THEN -> frame times measured through a frame action
+        QCOMPARE(renderer.approximateProfiling(), true);
+        QCOMPARE(profilingSpy.size(), 1);
+        QCOMPARE(resultsSpy.size(), 1);
+        auto frameAction = renderer.findChild<Qt3DLogic::QFrameAction *>();
+        QVERIFY(frameAction != nullptr);
+
+        // WHEN -> measure frames with everything enabled
+        const int windowFrameCount = Kuesa::RenderStageProfiler::settleFrameCount + Kuesa::RenderStageProfiler::sampleFrameCount;
+        for (int frame = 0; frame < windowFrameCount; ++frame)
+            emit frameAction->triggered(0.01f);
+
+        // THEN -> first stage knocked out
+        QCOMPARE(resultsSpy.size(), 2);
+        QCOMPARE(renderer.profiledFrameTime(), 10.0f);
+        // CPU time actually used by the test, measured separately
+        QVERIFY(renderer.profiledCpuFrameTime() >= 0.0f);
+        auto opaqueStage = renderer.findChild<Kuesa::OpaqueRenderStage *>();
+        QVERIFY(opaqueStage != nullptr);
+        QVERIFY(!opaqueStage->isEnabled());
+
+        // WHEN
+        for (int frame = 0; frame < windowFrameCount; ++frame)
+            emit frameAction->triggered(0.006f);
+
+        // THEN -> stage enabled back and timed
+        QCOMPARE(resultsSpy.size(), 3);
+        QVERIFY(opaqueStage->isEnabled());
+        const QVariantMap timings = renderer.renderStageTimings();
+        QCOMPARE(timings.size(), 1);
+        QVERIFY(qAbs(timings.value(opaqueStage->objectName()).toFloat() - 4.0f) < 0.01f);
+        // CPU side of the stage measured separately
+        const QVariantMap cpuTimings = renderer.renderStageCpuTimings();
+        QCOMPARE(cpuTimings.size(), 1);
+        QVERIFY(cpuTimings.value(opaqueStage->objectName()).toFloat() >= 0.0f);
+
+        // WHEN -> measure all stages and the effect
+        for (int frame = 0; frame < 4 * windowFrameCount; ++frame)
+            emit frameAction->triggered(0.01f);
+
+        // THEN
+        QVERIFY(renderer.renderStageTimings().contains(QStringLiteral("KuesaTransparentRenderStage")));
+        QVERIFY(renderer.renderStageTimings().contains(QStringLiteral("FX")));
+
+        // WHEN -> disabled while a section is knocked out
+        for (int frame = 0; frame < windowFrameCount; ++frame)
+            emit frameAction->triggered(0.01f);
+        renderer.setApproximateProfiling(false);
+
+        // THEN -> everything enabled back and results forgotten
+        QCOMPARE(renderer.approximateProfiling(), false);
+        QCOMPARE(profilingSpy.size(), 2);
+        QVERIFY(renderer.renderStageTimings().isEmpty());
+        QVERIFY(renderer.renderStageCpuTimings().isEmpty());
+        QCOMPARE(renderer.profiledCpuFrameTime(), 0.0f);
+        QVERIFY(renderer.findChild<Qt3DCore::QEntity *>(QStringLiteral("KuesaFrameTime")) == nullptr);
+        for (Kuesa::AbstractRenderStage *stage : renderer.findChildren<Kuesa::AbstractRenderStage *>())
+            QVERIFY(stage->isEnabled());
+        QVERIFY(fx.frameGraphSubTree()->isEnabled());
+
+        // Cleanup, effects outlive the renderer
+        renderer.removePostProcessingEffect(&fx);
+    }
+
 private:
+    QVector<Qt3DRender::QRenderTarget *> renderTargets(const Kuesa::ForwardRenderer &renderer)
+    {
+        return renderer.findChildren<Qt3DRender::QRenderTarget *>().toVector();
+    }
+
     template<class T>
     T *findParentSGNode(Qt3DCore::QNode *node)
     {
@@ -0,0 +1,244 @@
+/*
+    tst_gaussianblureffect.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Jim Albamont <jim.albamont@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/gaussianblureffect.h>
+#include <Kuesa/bloomeffect.h>
+#include <Qt3DRender/QTexture>
+#include <Qt3DRender/QRenderPassFilter>
+#include <Qt3DRender/QFilterKey>
+#include <Qt3DRender/QRenderTargetSelector>
+#include <Qt3DRender/QRenderTarget>
+#include <Qt3DRender/QRenderTargetOutput>
+
+using namespace Kuesa;
+
+namespace {
+
+const QSize sceneSize(1920, 1080);
+
+// Texture fetches per pixel of each pass, as found in the shaders
+int tapsPerPixel(const Qt3DRender::QRenderPassFilter *filter)
+{
+    switch (filter->matchAny().first()->value().toInt()) {
+    case 1: // vertical and horizontal gaussian blur
+    case 2:
+        return 9;
+    case 3: // dual filter downsampling
+        return 5;
+    case 4: // dual filter upsampling
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+struct Cost {
+    qint64 pixels = 0;
+    qint64 taps = 0;
+};
+
+// Returns the number of pixels shaded by the effect per frame, that is
+// the size of the target each of its passes renders into, and the number
+// of texture fetches these pixels make
+Cost cost(const GaussianBlurEffect &effect)
+{
+    Cost cost;
+    const auto filters = effect.frameGraphSubTree()->findChildren<Qt3DRender::QRenderPassFilter *>();
+    for (const Qt3DRender::QRenderPassFilter *filter : filters) {
+        QSize targetSize = sceneSize;
+        for (QObject *node = filter->parent(); node != nullptr; node = node->parent()) {
+            auto selector = qobject_cast<Qt3DRender::QRenderTargetSelector *>(node);
+            if (selector == nullptr)
+                continue;
+            for (const Qt3DRender::QRenderTargetOutput *output : selector->target()->outputs()) {
+                if (output->attachmentPoint() == Qt3DRender::QRenderTargetOutput::Color0)
+                    targetSize = QSize(output->texture()->width(), output->texture()->height());
+            }
+            break;
+        }
+        const qint64 pixels = qint64(targetSize.width()) * targetSize.height();
+        cost.pixels += pixels;
+        cost.taps += pixels * tapsPerPixel(filter);
+    }
+    return cost;
+}
+
+Cost cost(GaussianBlurEffect::Quality quality)
+{
+    Qt3DRender::QTexture2D input;
+    input.setSize(sceneSize.width(), sceneSize.height());
+
+    GaussianBlurEffect effect;
+    effect.setSceneSize(sceneSize);
+    effect.setInputTexture(&input);
+    effect.setQuality(quality);
+
+    return cost(effect);
+}
+
+} // namespace
+
+class tst_GaussianBlurEffect : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void checkDefaults()
+    {
+        // GIVEN
+        GaussianBlurEffect effect;
+
+        // THEN
+        QCOMPARE(effect.quality(), GaussianBlurEffect::HighQuality);
+        QCOMPARE(effect.blurPassCount(), 8);
+        QCOMPARE(GaussianBlurEffect::downsampleLevelCount(GaussianBlurEffect::HighQuality), 0);
+        QCOMPARE(GaussianBlurEffect::downsampleLevelCount(GaussianBlurEffect::MediumQuality), 4);
+        QCOMPARE(GaussianBlurEffect::downsampleLevelCount(GaussianBlurEffect::LowQuality), 2);
+    }
+
+    void checkQualityRebuildsPasses()
+    {
+        // GIVEN
+        GaussianBlurEffect effect;
+        effect.setSceneSize(sceneSize);
+        QSignalSpy spy(&effect, &GaussianBlurEffect::qualityChanged);
+
+        // THEN
+        QCOMPARE(effect.frameGraphSubTree()->findChildren<Qt3DRender::QRenderPassFilter *>().size(), 2 * 8);
+
+        // WHEN
+        effect.setQuality(GaussianBlurEffect::MediumQuality);
+
+        // THEN
+        QCOMPARE(spy.count(), 1);
+        // 4 downsampling and 4 upsampling passes
+        QCOMPARE(effect.frameGraphSubTree()->findChildren<Qt3DRender::QRenderPassFilter *>().size(), 2 * 4);
+
+        // WHEN
+        effect.setBlurPassCount(2);
+
+        // THEN -> doesn't affect reduced resolution blurs
+        QCOMPARE(effect.frameGraphSubTree()->findChildren<Qt3DRender::QRenderPassFilter *>().size(), 2 * 4);
+
+        // WHEN
+        effect.setQuality(GaussianBlurEffect::LowQuality);
+
+        // THEN
+        QCOMPARE(spy.count(), 2);
+        QCOMPARE(effect.frameGraphSubTree()->findChildren<Qt3DRender::QRenderPassFilter *>().size(), 2 * 2);
+
+        // WHEN
+        effect.setQuality(GaussianBlurEffect::HighQuality);
+
+        // THEN
+        QCOMPARE(spy.count(), 3);
+        QCOMPARE(effect.frameGraphSubTree()->findChildren<Qt3DRender::QRenderPassFilter *>().size(), 2 * 2);
+    }
+
+    void checkDownsampleChainSizes()
+    {
+        // GIVEN
+        GaussianBlurEffect effect;
+        effect.setSceneSize(QSize(256, 128));
+
+        // WHEN
+        effect.setQuality(GaussianBlurEffect::LowQuality);
+
+        // THEN -> levels are half the size of the previous one
+        QSet<QPair<int, int>> sizes;
+        const auto selectors = effect.frameGraphSubTree()->findChildren<Qt3DRender::QRenderTargetSelector *>();
+        for (const Qt3DRender::QRenderTargetSelector *selector : selectors) {
+            const Qt3DRender::QAbstractTexture *texture = selector->target()->outputs().first()->texture();
+            sizes.insert({ texture->width(), texture->height() });
+        }
+        QCOMPARE(sizes, (QSet<QPair<int, int>>{ { 128, 64 }, { 64, 32 } }));
+
+        // WHEN
+        effect.setSceneSize(QSize(512, 256));
+
+        // THEN
+        sizes.clear();
+        for (const Qt3DRender::QRenderTargetSelector *selector : selectors) {
+            const Qt3DRender::QAbstractTexture *texture = selector->target()->outputs().first()->texture();
+            sizes.insert({ texture->width(), texture->height() });
+        }
+        QCOMPARE(sizes, (QSet<QPair<int, int>>{ { 256, 128 }, { 128, 64 } }));
+    }
+
+    void checkPixelCost()
+    {
+        // WHEN
+        const Cost high = cost(GaussianBlurEffect::HighQuality);
+        const Cost medium = cost(GaussianBlurEffect::MediumQuality);
+        const Cost low = cost(GaussianBlurEffect::LowQuality);
+
+        // THEN -> 8 horizontal and vertical passes at full resolution
+        const qint64 scenePixels = qint64(sceneSize.width()) * sceneSize.height();
+        QCOMPARE(high.pixels, 16 * scenePixels);
+        QCOMPARE(high.taps, 9 * 16 * scenePixels);
+
+        // Downsampling into 960x540, 480x270, 240x135 and 120x67, then
+        // upsampling back into 240x135, 480x270, 960x540 and 1920x1080
+        QCOMPARE(medium.pixels, qint64(688440 + 2754000));
+        QCOMPARE(medium.taps, qint64(5 * 688440 + 8 * 2754000));
+
+        // Downsampling into 960x540 and 480x270, then upsampling back
+        // into 960x540 and 1920x1080
+        QCOMPARE(low.pixels, qint64(648000 + 2592000));
+        QCOMPARE(low.taps, qint64(5 * 648000 + 8 * 2592000));
+
+        // Reduced resolution blurs cost less than 2 full resolution passes
+        QVERIFY(medium.taps < high.taps / 8);
+        QVERIFY(medium.pixels < 2 * scenePixels);
+        QVERIFY(low.taps < medium.taps);
+    }
+
+    void checkBloomForwardsQuality()
+    {
+        // GIVEN
+        BloomEffect bloom;
+        QSignalSpy spy(&bloom, &BloomEffect::blurQualityChanged);
+
+        // THEN
+        QCOMPARE(bloom.blurQuality(), GaussianBlurEffect::HighQuality);
+
+        // WHEN
+        bloom.setBlurQuality(GaussianBlurEffect::LowQuality);
+
+        // THEN
+        QCOMPARE(bloom.blurQuality(), GaussianBlurEffect::LowQuality);
+        QCOMPARE(spy.count(), 1);
+    }
+};
+
+QTEST_MAIN(tst_GaussianBlurEffect)
+#include "tst_gaussianblureffect.moc"
@@ -28,24 +28,86 @@
 
 #include <QtTest/QtTest>
 #include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
 #include <QFile>
 #include <QLatin1String>
 #include <QString>
 #include <Kuesa/SceneEntity>
 #include <Kuesa/private/gltf2parser_p.h>
+#include <Kuesa/private/gltf2context_p.h>
 #include <Qt3DCore/QEntity>
 #include <Qt3DCore/QComponent>
+#include <Qt3DCore/QTransform>
 #include <Kuesa/MetallicRoughnessMaterial>
 #include <Qt3DCore/QSkeleton>
 #include <Qt3DCore/QJoint>
 #include <Qt3DRender/QCameraLens>
 #include <Qt3DRender/QCamera>
+#include <Qt3DRender/QGeometryRenderer>
+#include <Qt3DRender/QGeometry>
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QLevelOfDetailSwitch>
 #include <Kuesa/LayerCollection>
 #include <Kuesa/private/kuesa_utils_p.h>
 
 using namespace Kuesa;
 using namespace GLTF2Import;
 
+namespace {
+
+QVector<Qt3DRender::QGeometryRenderer *> instancedRenderers(Qt3DCore::QEntity *root)
+{
+    QVector<Qt3DRender::QGeometryRenderer *> renderers;
+    const auto allRenderers = root->findChildren<Qt3DRender::QGeometryRenderer *>();
+    for (Qt3DRender::QGeometryRenderer *renderer : allRenderers) {
+        if (renderer->instanceCount() > 1)
+            renderers.push_back(renderer);
+    }
+    return renderers;
+}
+
+QVector<QMatrix4x4> instanceMatrices(Qt3DRender::QGeometryRenderer *renderer)
+{
+    QVector<QMatrix4x4> matrices;
+    const auto attributes = renderer->geometry()->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->name() != QStringLiteral("instanceModelMatrix"))
+            continue;
+        const QByteArray data = attribute->buffer()->data();
+        const float *rawData = reinterpret_cast<const float *>(data.constData());
+        for (uint i = 0; i < attribute->count(); ++i)
+            matrices.push_back(QMatrix4x4(rawData + 16 * i).transposed());
+    }
+    return matrices;
+}
+
+Qt3DRender::QAttribute *findAttribute(Qt3DRender::QGeometryRenderer *renderer, const QString &name)
+{
+    const auto attributes = renderer->geometry()->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->name() == name)
+            return attribute;
+    }
+    return nullptr;
+}
+
+QVector3D vertexPosition(Qt3DRender::QGeometryRenderer *renderer, int vertex)
+{
+    const auto attributes = renderer->geometry()->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->name() != Qt3DRender::QAttribute::defaultPositionAttributeName())
+            continue;
+        const QByteArray data = attribute->buffer()->data();
+        const float *rawData = reinterpret_cast<const float *>(data.constData() + attribute->byteOffset()) + 3 * vertex;
+        return QVector3D(rawData[0], rawData[1], rawData[2]);
+    }
+    return QVector3D();
+}
+
+} // namespace
+
 class GLTF2ParserNoTextures : public GLTF2Parser
 {
 public:
@@ -682,6 +744,494 @@ private Q_SLOTS:
         }
     }
 
+    void checkAutomaticInstancing()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        parser.setAutomaticInstancing(true);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+
+        // THEN -> static boxes drawn in one call
+        QVERIFY(res != nullptr);
+        const auto renderers = instancedRenderers(res);
+        QCOMPARE(renderers.size(), 1);
+        Qt3DRender::QGeometryRenderer *renderer = renderers.first();
+        QCOMPARE(renderer->instanceCount(), 3);
+
+        const QVector<QMatrix4x4> matrices = instanceMatrices(renderer);
+        QCOMPARE(matrices.size(), 3);
+        QCOMPARE(matrices.at(0).column(3), QVector4D(-2.0f, 0.0f, 0.0f, 1.0f));
+        QCOMPARE(matrices.at(1).column(3), QVector4D(0.0f, 0.0f, 0.0f, 1.0f));
+        QCOMPARE(matrices.at(2).column(3), QVector4D(2.0f, 3.0f, 0.0f, 1.0f));
+
+        Qt3DRender::QAttribute *boundsAttribute = renderer->geometry()->boundingVolumePositionAttribute();
+        QVERIFY(boundsAttribute != nullptr);
+        QCOMPARE(boundsAttribute->count(), 24U);
+
+        auto instancesEntity = qobject_cast<Qt3DCore::QEntity *>(renderer->parent());
+        QVERIFY(instancesEntity != nullptr);
+        auto material = componentFromEntity<MetallicRoughnessMaterial>(instancesEntity);
+        QVERIFY(material != nullptr);
+        QVERIFY(material->useInstancing());
+        QVERIFY(scene.material(QStringLiteral("Red_instanced")) != nullptr);
+
+        // THEN -> nodes are kept, without primitives
+        Qt3DCore::QEntity *box0 = scene.entity(QStringLiteral("box0"));
+        QVERIFY(box0 != nullptr);
+        QVERIFY(box0->findChildren<Qt3DCore::QEntity *>().isEmpty());
+
+        // THEN -> animated box drawn on its own
+        Qt3DCore::QEntity *animatedBox = scene.entity(QStringLiteral("animatedBox"));
+        QVERIFY(animatedBox != nullptr);
+        const auto animatedBoxRenderer = animatedBox->findChild<Qt3DRender::QGeometryRenderer *>();
+        QVERIFY(animatedBoxRenderer != nullptr);
+        QCOMPARE(animatedBoxRenderer->instanceCount(), 1);
+    }
+
+    void checkAutomaticInstancingIsOptIn()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+
+        // THEN
+        QVERIFY(res != nullptr);
+        QVERIFY(instancedRenderers(res).isEmpty());
+        QCOMPARE(scene.entity(QStringLiteral("box0"))->findChildren<Qt3DCore::QEntity *>().size(), 1);
+    }
+
+    void checkMeshGpuInstancingExtension()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_ext_mesh_gpu_instancing.gltf"));
+
+        // THEN -> instances drawn relative to their node
+        QVERIFY(res != nullptr);
+        Qt3DCore::QEntity *instances = scene.entity(QStringLiteral("instances"));
+        QVERIFY(instances != nullptr);
+        const auto renderer = instances->findChild<Qt3DRender::QGeometryRenderer *>();
+        QVERIFY(renderer != nullptr);
+        QCOMPARE(renderer->instanceCount(), 3);
+
+        const QVector<QMatrix4x4> matrices = instanceMatrices(renderer);
+        QCOMPARE(matrices.size(), 3);
+        QCOMPARE(matrices.at(0).column(3), QVector4D(-3.0f, 0.0f, 0.0f, 1.0f));
+        QCOMPARE(matrices.at(1)(0, 0), 2.0f);
+        QCOMPARE(matrices.at(2).column(3), QVector4D(3.0f, 0.0f, 0.0f, 1.0f));
+    }
+
+    void checkStaticGeometryMerging()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        parser.setMergeStaticGeometry(true);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+
+        // THEN -> static boxes drawn in one call
+        QVERIFY(res != nullptr);
+        QCOMPARE(parser.drawCountBeforeMerging(), 4);
+        QCOMPARE(parser.drawCount(), 2);
+
+        const auto mergedRanges = parser.mergedRanges();
+        QCOMPARE(mergedRanges.size(), 3);
+        Qt3DCore::QEntity *box0 = scene.entity(QStringLiteral("box0"));
+        Qt3DCore::QEntity *box2 = scene.entity(QStringLiteral("box2"));
+        QVERIFY(box0 != nullptr);
+        QVERIFY(box2 != nullptr);
+        QVERIFY(box0->findChildren<Qt3DCore::QEntity *>().isEmpty());
+        QCOMPARE(mergedRanges.value(box0).size(), 1);
+        QCOMPARE(mergedRanges.value(box2).size(), 1);
+
+        const MergedRange box0Range = mergedRanges.value(box0).first();
+        const MergedRange box2Range = mergedRanges.value(box2).first();
+        QVERIFY(box0Range.renderer != nullptr);
+        QCOMPARE(box2Range.renderer, box0Range.renderer);
+        QCOMPARE(box0Range.firstIndex, 0);
+        QCOMPARE(box0Range.indexCount, 36);
+        QCOMPARE(box2Range.firstIndex, 72);
+        QCOMPARE(box2Range.indexCount, 36);
+
+        // THEN -> vertices are in world space
+        Qt3DRender::QGeometryRenderer *renderer = box0Range.renderer;
+        QCOMPARE(vertexPosition(renderer, 0), vertexPosition(renderer, 24) + QVector3D(-2.0f, 0.0f, 0.0f));
+        QCOMPARE(vertexPosition(renderer, 48), vertexPosition(renderer, 24) + QVector3D(2.0f, 3.0f, 0.0f));
+
+        auto mergedEntity = qobject_cast<Qt3DCore::QEntity *>(renderer->parent());
+        QVERIFY(mergedEntity != nullptr);
+        QCOMPARE(mergedEntity->parentEntity(), res);
+        auto material = componentFromEntity<MetallicRoughnessMaterial>(mergedEntity);
+        QVERIFY(material != nullptr);
+        QCOMPARE(static_cast<Qt3DRender::QMaterial *>(material), scene.material(QStringLiteral("Red")));
+
+        // THEN -> animated box drawn on its own
+        Qt3DCore::QEntity *animatedBox = scene.entity(QStringLiteral("animatedBox"));
+        QVERIFY(animatedBox != nullptr);
+        QCOMPARE(animatedBox->findChildren<Qt3DCore::QEntity *>().size(), 1);
+    }
+
+    void checkStaticGeometryMergingIsOptIn()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+
+        // THEN
+        QVERIFY(res != nullptr);
+        QVERIFY(parser.mergedRanges().isEmpty());
+        QCOMPARE(parser.drawCountBeforeMerging(), 4);
+        QCOMPARE(parser.drawCount(), 4);
+    }
+
+    void checkMeshQuantization()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "quantized.gltf"));
+
+        // THEN
+        QVERIFY(res != nullptr);
+        Qt3DCore::QEntity *quad = scene.entity(QStringLiteral("quad"));
+        QVERIFY(quad != nullptr);
+        const auto primitiveEntities = quad->findChildren<Qt3DCore::QEntity *>();
+        QCOMPARE(primitiveEntities.size(), 1);
+        Qt3DCore::QEntity *primitiveEntity = primitiveEntities.first();
+        auto renderer = componentFromEntity<Qt3DRender::QGeometryRenderer>(primitiveEntity);
+        QVERIFY(renderer != nullptr);
+
+        // THEN -> signed positions are read as normalized unsigned values
+        Qt3DRender::QAttribute *position = findAttribute(renderer, Qt3DRender::QAttribute::defaultPositionAttributeName());
+        QVERIFY(position != nullptr);
+        QCOMPARE(position->vertexBaseType(), Qt3DRender::QAttribute::UnsignedShort);
+        QCOMPARE(position->property("normalized").toBool(), false);
+        const QByteArray positionData = position->buffer()->data();
+        const quint16 *rawPositions = reinterpret_cast<const quint16 *>(positionData.constData() + position->byteOffset());
+        QCOMPARE(rawPositions[0], quint16(32668));
+
+        // THEN -> which the primitive transform dequantizes
+        auto dequantization = componentFromEntity<Qt3DCore::QTransform>(primitiveEntity);
+        QVERIFY(dequantization != nullptr);
+        const QVector3D normalizedPosition(rawPositions[0] / 65535.0f, rawPositions[1] / 65535.0f, rawPositions[2] / 65535.0f);
+        const QVector3D dequantizedPosition = dequantization->matrix() * normalizedPosition;
+        QVERIFY((dequantizedPosition - QVector3D(-100.0f, -100.0f, 0.0f)).length() < 0.01f);
+
+        // THEN -> normalized normals are used as stored
+        Qt3DRender::QAttribute *normal = findAttribute(renderer, Qt3DRender::QAttribute::defaultNormalAttributeName());
+        QVERIFY(normal != nullptr);
+        QCOMPARE(normal->vertexBaseType(), Qt3DRender::QAttribute::Byte);
+        QCOMPARE(normal->property("normalized").toBool(), true);
+
+        // THEN -> texture coordinates are converted to floats
+        Qt3DRender::QAttribute *texCoord = findAttribute(renderer, Qt3DRender::QAttribute::defaultTextureCoordinateAttributeName());
+        QVERIFY(texCoord != nullptr);
+        QCOMPARE(texCoord->vertexBaseType(), Qt3DRender::QAttribute::Float);
+        const QByteArray texCoordData = texCoord->buffer()->data();
+        const float *rawTexCoords = reinterpret_cast<const float *>(texCoordData.constData() + texCoord->byteOffset());
+        QCOMPARE(rawTexCoords[4], 1.0f);
+        QCOMPARE(rawTexCoords[5], 1.0f);
+    }
+
+    void checkPrecomputedBounds()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "Box.gltf"));
+
+        // THEN -> bounds come from the POSITION accessor
+        QVERIFY(res != nullptr);
+        const auto renderers = res->findChildren<Qt3DRender::QGeometryRenderer *>();
+        QCOMPARE(renderers.size(), 1);
+        Qt3DRender::QGeometry *geometry = renderers.first()->geometry();
+        QCOMPARE(geometry->property("boundsMin").value<QVector3D>(), QVector3D(-0.5f, -0.5f, -0.5f));
+        QCOMPARE(geometry->property("boundsMax").value<QVector3D>(), QVector3D(0.5f, 0.5f, 0.5f));
+        QVERIFY(geometry->boundingVolumePositionAttribute() == nullptr);
+
+        // THEN -> and are aggregated on the entity of the node
+        auto primitiveEntity = qobject_cast<Qt3DCore::QEntity *>(renderers.first()->parent());
+        QVERIFY(primitiveEntity != nullptr);
+        Qt3DCore::QEntity *nodeEntity = primitiveEntity->parentEntity();
+        QVERIFY(nodeEntity != nullptr);
+        QCOMPARE(nodeEntity->property("boundsMin").value<QVector3D>(), QVector3D(-0.5f, -0.5f, -0.5f));
+        QCOMPARE(nodeEntity->property("boundsMax").value<QVector3D>(), QVector3D(0.5f, 0.5f, 0.5f));
+        QVERIFY(!nodeEntity->parentEntity()->property("boundsMin").isValid());
+    }
+
+    void checkPrecomputedBoundsOfQuantizedMesh()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "quantized.gltf"));
+
+        // THEN -> entity bounds are dequantized
+        QVERIFY(res != nullptr);
+        Qt3DCore::QEntity *quad = scene.entity(QStringLiteral("quad"));
+        QVERIFY(quad != nullptr);
+        const QVector3D boundsMin = quad->property("boundsMin").value<QVector3D>();
+        const QVector3D boundsMax = quad->property("boundsMax").value<QVector3D>();
+        QVERIFY((boundsMin - QVector3D(-100.0f, -100.0f, 0.0f)).length() < 0.01f);
+        QVERIFY((boundsMax - QVector3D(100.0f, 100.0f, 0.0f)).length() < 0.01f);
+
+        // THEN -> Qt3D gets float bounds for the normalized positions
+        const auto renderer = quad->findChild<Qt3DRender::QGeometryRenderer *>();
+        QVERIFY(renderer != nullptr);
+        Qt3DRender::QAttribute *boundsAttribute = renderer->geometry()->boundingVolumePositionAttribute();
+        QVERIFY(boundsAttribute != nullptr);
+        QCOMPARE(boundsAttribute->vertexBaseType(), Qt3DRender::QAttribute::Float);
+        QCOMPARE(boundsAttribute->count(), 4U);
+    }
+
+    void checkPrecomputedBoundsOfNormalizedPositions()
+    {
+        // GIVEN -> quantized.gltf with its signed short positions normalized
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        QFile file(QStringLiteral(ASSETS "quantized.gltf"));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QJsonObject document = QJsonDocument::fromJson(file.readAll()).object();
+        QJsonArray accessors = document.value(QStringLiteral("accessors")).toArray();
+        QJsonObject positionAccessor = accessors.at(1).toObject();
+        positionAccessor.insert(QStringLiteral("normalized"), true);
+        accessors[1] = positionAccessor;
+        document.insert(QStringLiteral("accessors"), accessors);
+
+        // WHEN
+        QScopedPointer<Qt3DCore::QEntity> res(parser.parse(QJsonDocument(document).toJson(), QStringLiteral(ASSETS)));
+
+        // THEN -> bounds hold the values the shaders read
+        QVERIFY(!res.isNull());
+        Qt3DCore::QEntity *quad = scene.entity(QStringLiteral("quad"));
+        QVERIFY(quad != nullptr);
+        const float extent = 100.0f / 32767.0f;
+        const QVector3D boundsMin = quad->property("boundsMin").value<QVector3D>();
+        const QVector3D boundsMax = quad->property("boundsMax").value<QVector3D>();
+        QVERIFY((boundsMin - QVector3D(-extent, -extent, 0.0f)).length() < 1e-6f);
+        QVERIFY((boundsMax - QVector3D(extent, extent, 0.0f)).length() < 1e-6f);
+
+        // THEN -> Qt3D gets float bounds for the normalized positions
+        const auto renderer = quad->findChild<Qt3DRender::QGeometryRenderer *>();
+        QVERIFY(renderer != nullptr);
+        QCOMPARE(renderer->geometry()->property("boundsMin").value<QVector3D>(), boundsMin);
+        Qt3DRender::QAttribute *boundsAttribute = renderer->geometry()->boundingVolumePositionAttribute();
+        QVERIFY(boundsAttribute != nullptr);
+        QCOMPARE(boundsAttribute->vertexBaseType(), Qt3DRender::QAttribute::Float);
+    }
+
+    void checkLevelsOfDetail()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "lod.gltf"));
+
+        // THEN
+        QVERIFY(res != nullptr);
+        Qt3DCore::QEntity *lodBox = scene.entity(QStringLiteral("lodBox"));
+        QVERIFY(lodBox != nullptr);
+        const auto lodSwitches = lodBox->findChildren<Qt3DRender::QLevelOfDetailSwitch *>();
+        QCOMPARE(lodSwitches.size(), 1);
+        Qt3DRender::QLevelOfDetailSwitch *lodSwitch = lodSwitches.first();
+        QCOMPARE(lodSwitch->volumeOverride().radius(), 0.5f * std::sqrt(3.0f));
+        QCOMPARE(scene.screenCoverages(QStringLiteral("lodBox")), (QVector<qreal>{ 0.5, 0.1, 0.01 }));
+
+        // THEN -> 3 levels and the culled one, only the first is enabled
+        QCOMPARE(lodSwitch->entities().size(), 1);
+        QVector<Qt3DCore::QEntity *> levels;
+        const auto childNodes = lodSwitch->entities().first()->childNodes();
+        for (Qt3DCore::QNode *childNode : childNodes) {
+            if (auto level = qobject_cast<Qt3DCore::QEntity *>(childNode))
+                levels.push_back(level);
+        }
+        QCOMPARE(levels.size(), 4);
+        QVERIFY(levels.at(0)->isEnabled());
+        for (int i = 1; i < 4; ++i) {
+            QVERIFY(!levels.at(i)->isEnabled());
+            QCOMPARE(levels.at(i)->findChildren<Qt3DCore::QEntity *>().size(), i < 3 ? 1 : 0);
+        }
+        QCOMPARE(parser.drawCount(), 1);
+
+        // THEN -> meshes of the levels are named after the node unless they have a name
+        QVERIFY(scene.mesh(QStringLiteral("Mesh_0")) != nullptr);
+        QVERIFY(scene.mesh(QStringLiteral("lodBox_lod1_0")) != nullptr);
+        QVERIFY(scene.mesh(QStringLiteral("LowMesh_0")) != nullptr);
+    }
+
+    void checkLevelOfDetailThresholds()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "lod.gltf"));
+        QVERIFY(res != nullptr);
+        res->setParent(&scene);
+        auto lodSwitch = scene.entity(QStringLiteral("lodBox"))->findChild<Qt3DRender::QLevelOfDetailSwitch *>();
+        QVERIFY(lodSwitch != nullptr);
+        QVERIFY(lodSwitch->thresholds().isEmpty());
+
+        // WHEN
+        Qt3DRender::QCamera camera;
+        camera.setFieldOfView(90.0f);
+        scene.setLevelOfDetailCamera(&camera);
+
+        // THEN -> distances at which the sphere reaches the coverages
+        const float radius = 0.5f * std::sqrt(3.0f);
+        QCOMPARE(lodSwitch->camera(), &camera);
+        QVector<qreal> thresholds = lodSwitch->thresholds();
+        QCOMPARE(thresholds.size(), 4);
+        QVERIFY(qAbs(thresholds.at(0) - radius / std::sqrt(0.5)) < 0.001);
+        QVERIFY(qAbs(thresholds.at(1) - radius / std::sqrt(0.1)) < 0.001);
+        QVERIFY(qAbs(thresholds.at(2) - radius / std::sqrt(0.01)) < 0.001);
+
+        // WHEN
+        scene.setScreenCoverages(QStringLiteral("lodBox"), { 0.25, 0.04, 0.01 });
+
+        // THEN
+        thresholds = lodSwitch->thresholds();
+        QVERIFY(qAbs(thresholds.at(0) - 2.0 * radius) < 0.001);
+        QVERIFY(qAbs(thresholds.at(1) - 5.0 * radius) < 0.001);
+
+        // WHEN
+        scene.setLevelOfDetailCamera(nullptr);
+
+        // THEN
+        QVERIFY(lodSwitch->thresholds().isEmpty());
+    }
+
+    void checkSceneIndex()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setContext(&context);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "scenes.gltf"));
+
+        // THEN -> only the nodes of the default scene are instantiated
+        QVERIFY(res != nullptr);
+        QCOMPARE(context.defaultScene(), 1);
+        QVERIFY(scene.entity(QStringLiteral("boxA")) == nullptr);
+        QVERIFY(scene.entity(QStringLiteral("boxB")) != nullptr);
+        QVERIFY(scene.entity(QStringLiteral("boxC")) != nullptr);
+        QCOMPARE(parser.drawCount(), 2);
+        Qt3DRender::QGeometryRenderer *mesh = scene.mesh(QStringLiteral("Box_0"));
+        QVERIFY(mesh != nullptr);
+        QCOMPARE(mesh->parent(), res);
+
+        // WHEN -> instantiating another scene without parsing again
+        context.setAssetsParent(&scene);
+        delete res;
+        res = parser.instantiateScene(0);
+
+        // THEN
+        QVERIFY(res != nullptr);
+        QVERIFY(scene.entity(QStringLiteral("boxA")) != nullptr);
+        QVERIFY(scene.entity(QStringLiteral("boxB")) == nullptr);
+        QVERIFY(scene.entity(QStringLiteral("boxC")) == nullptr);
+        QCOMPARE(parser.drawCount(), 1);
+        QCOMPARE(scene.meshes()->names().size(), 1);
+        QCOMPARE(scene.mesh(QStringLiteral("Box_0")), mesh);
+        QCOMPARE(mesh->parent(), res);
+
+        // WHEN
+        QTest::ignoreMessage(QtWarningMsg, "Invalid scene reference");
+        Qt3DCore::QEntity *invalidRes = parser.instantiateScene(2);
+
+        // THEN
+        QVERIFY(invalidRes == nullptr);
+        delete res;
+    }
+
+    void checkParseSceneIndex()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setContext(&context);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "scenes.gltf"), 0);
+
+        // THEN
+        QVERIFY(res != nullptr);
+        QVERIFY(scene.entity(QStringLiteral("boxA")) != nullptr);
+        QVERIFY(scene.entity(QStringLiteral("boxB")) == nullptr);
+        QCOMPARE(parser.drawCount(), 1);
+    }
+
+    void checkLazyMeshes()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setLazyMeshes(true);
+        parser.setContext(&context);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "lazymeshes.gltf"));
+
+        // THEN -> the mesh of the scene is created, the unused one deferred
+        QVERIFY(res != nullptr);
+        QCOMPARE(scene.meshes()->names(), QStringList({ QStringLiteral("Box_0"), QStringLiteral("SmallBox_0") }));
+        QVERIFY(!scene.meshes()->hasAssetFactory(QStringLiteral("Box_0")));
+        QVERIFY(scene.meshes()->hasAssetFactory(QStringLiteral("SmallBox_0")));
+        QVERIFY(context.mesh(1).meshPrimitives.first().primitiveRenderer == nullptr);
+
+        // WHEN
+        Qt3DRender::QGeometryRenderer *mesh = scene.mesh(QStringLiteral("SmallBox_0"));
+
+        // THEN -> created on first lookup and destroyed with the scene
+        QVERIFY(mesh != nullptr);
+        QCOMPARE(mesh->objectName(), QStringLiteral("SmallBox_0"));
+        QVERIFY(!scene.meshes()->hasAssetFactory(QStringLiteral("SmallBox_0")));
+        QCOMPARE(scene.mesh(QStringLiteral("SmallBox_0")), mesh);
+        QCOMPARE(context.mesh(1).meshPrimitives.first().primitiveRenderer, mesh);
+        QCOMPARE(mesh->parent(), res);
+
+        // THEN -> the buffer views are shared with the mesh created before
+        Qt3DRender::QGeometryRenderer *box = scene.mesh(QStringLiteral("Box_0"));
+        QVERIFY(box != nullptr);
+        const auto attributes = mesh->geometry()->attributes();
+        const auto boxAttributes = box->geometry()->attributes();
+        QCOMPARE(attributes.size(), boxAttributes.size());
+        for (int i = 0, m = attributes.size(); i < m; ++i)
+            QCOMPARE(attributes.at(i)->buffer(), boxAttributes.at(i)->buffer());
+
+        // WHEN
+        delete res;
+
+        // THEN
+        QVERIFY(scene.meshes()->names().isEmpty());
+    }
+
 #if defined(KUESA_DRACO_COMPRESSION)
     void checkDracoCompression()
     {
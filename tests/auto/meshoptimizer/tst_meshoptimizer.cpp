@@ -0,0 +1,360 @@
+/*
+    tst_meshoptimizer.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+#include <Kuesa/private/meshoptimizer_p.h>
+#include <Qt3DCore/QNode>
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+#include <algorithm>
+
+using namespace Kuesa;
+using namespace GLTF2Import;
+
+namespace {
+
+const int gridSize = 64;
+const int gridVertexCount = (gridSize + 1) * (gridSize + 1);
+
+// Triangles of a regular grid of quads, in random order
+QVector<quint32> shuffledGridIndices()
+{
+    QVector<QVector<quint32>> triangles;
+    for (int y = 0; y < gridSize; ++y) {
+        for (int x = 0; x < gridSize; ++x) {
+            const quint32 topLeft = quint32(y * (gridSize + 1) + x);
+            const quint32 bottomLeft = topLeft + gridSize + 1;
+            triangles.push_back({ topLeft, topLeft + 1, bottomLeft });
+            triangles.push_back({ topLeft + 1, bottomLeft + 1, bottomLeft });
+        }
+    }
+
+    // Deterministic shuffle
+    quint32 seed = 1;
+    for (int i = triangles.size() - 1; i > 0; --i) {
+        seed = seed * 1664525U + 1013904223U;
+        std::swap(triangles[i], triangles[int(seed % quint32(i + 1))]);
+    }
+
+    QVector<quint32> indices;
+    for (const QVector<quint32> &triangle : qAsConst(triangles))
+        indices += triangle;
+    return indices;
+}
+
+// Sorted triangles, each starting with its smallest index
+QVector<QVector<quint32>> canonicalTriangles(const QVector<quint32> &indices)
+{
+    QVector<QVector<quint32>> triangles;
+    for (int i = 0; i + 2 < indices.size(); i += 3) {
+        QVector<quint32> triangle = { indices.at(i), indices.at(i + 1), indices.at(i + 2) };
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+template<typename T>
+QByteArray toByteArray(const QVector<T> &values)
+{
+    return QByteArray(reinterpret_cast<const char *>(values.constData()), values.size() * int(sizeof(T)));
+}
+
+QVector<float> readFloats(const Qt3DRender::QAttribute *attribute)
+{
+    const QByteArray data = attribute->buffer()->data();
+    const float *rawData = reinterpret_cast<const float *>(data.constData() + attribute->byteOffset());
+    return QVector<float>(rawData, rawData + attribute->count() * attribute->vertexSize());
+}
+
+QVector<quint32> readIndices(const Qt3DRender::QAttribute *attribute)
+{
+    const QByteArray data = attribute->buffer()->data();
+    QVector<quint32> indices;
+    for (uint i = 0; i < attribute->count(); ++i) {
+        if (attribute->vertexBaseType() == Qt3DRender::QAttribute::UnsignedShort)
+            indices.push_back(reinterpret_cast<const quint16 *>(data.constData() + attribute->byteOffset())[i]);
+        else
+            indices.push_back(reinterpret_cast<const quint32 *>(data.constData() + attribute->byteOffset())[i]);
+    }
+    return indices;
+}
+
+// Positions of the vertices of each triangle
+QVector<QVector<float>> trianglePositions(const QVector<float> &positions, const QVector<quint32> &indices)
+{
+    QVector<QVector<float>> triangles;
+    for (int i = 0; i < indices.size(); i += 3) {
+        QVector<QVector<float>> corners;
+        for (int corner = 0; corner < 3; ++corner) {
+            const int vertex = int(indices.at(i + corner));
+            corners.push_back({ positions.at(vertex * 3), positions.at(vertex * 3 + 1), positions.at(vertex * 3 + 2) });
+        }
+        std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+        triangles.push_back(corners.at(0) + corners.at(1) + corners.at(2));
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// A 4x4 grid with 32-bit indices, in random triangle order
+Qt3DRender::QGeometry *createGridGeometry(Qt3DRender::QBuffer *positionBuffer = nullptr, Qt3DRender::QBuffer *indexBuffer = nullptr)
+{
+    QVector<float> positions;
+    for (int y = 0; y <= 4; ++y) {
+        for (int x = 0; x <= 4; ++x)
+            positions += { float(x), float(y), 0.0f };
+    }
+
+    QVector<quint32> indices;
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            const quint32 topLeft = quint32(y * 5 + x);
+            indices += { topLeft, topLeft + 1, topLeft + 5, topLeft + 1, topLeft + 6, topLeft + 5 };
+        }
+    }
+    std::reverse(indices.begin(), indices.end());
+
+    auto geometry = new Qt3DRender::QGeometry();
+    if (positionBuffer == nullptr)
+        positionBuffer = new Qt3DRender::QBuffer(geometry);
+    positionBuffer->setData(toByteArray(positions));
+    geometry->addAttribute(new Qt3DRender::QAttribute(positionBuffer,
+                                                      Qt3DRender::QAttribute::defaultPositionAttributeName(),
+                                                      Qt3DRender::QAttribute::Float,
+                                                      3,
+                                                      uint(positions.size() / 3)));
+
+    if (indexBuffer == nullptr)
+        indexBuffer = new Qt3DRender::QBuffer(geometry);
+    indexBuffer->setData(toByteArray(indices));
+    auto indexAttribute = new Qt3DRender::QAttribute(indexBuffer,
+                                                     Qt3DRender::QAttribute::UnsignedInt,
+                                                     1,
+                                                     uint(indices.size()));
+    indexAttribute->setAttributeType(Qt3DRender::QAttribute::IndexAttribute);
+    geometry->addAttribute(indexAttribute);
+    return geometry;
+}
+
+// Separate triangles using each of vertexCount vertices, with 32-bit indices
+Qt3DRender::QGeometry *createTrianglesGeometry(int vertexCount)
+{
+    QVector<float> positions;
+    for (int vertex = 0; vertex < vertexCount; ++vertex)
+        positions += { float(vertex), float(vertex % 3), 0.0f };
+
+    QVector<quint32> indices;
+    for (int vertex = 0; vertex + 2 < vertexCount; vertex += 3)
+        indices += { quint32(vertex), quint32(vertex + 1), quint32(vertex + 2) };
+    if (vertexCount % 3 != 0)
+        indices += { quint32(vertexCount - 3), quint32(vertexCount - 2), quint32(vertexCount - 1) };
+
+    auto geometry = new Qt3DRender::QGeometry();
+    auto positionBuffer = new Qt3DRender::QBuffer(geometry);
+    positionBuffer->setData(toByteArray(positions));
+    geometry->addAttribute(new Qt3DRender::QAttribute(positionBuffer,
+                                                      Qt3DRender::QAttribute::defaultPositionAttributeName(),
+                                                      Qt3DRender::QAttribute::Float,
+                                                      3,
+                                                      uint(vertexCount)));
+
+    auto indexBuffer = new Qt3DRender::QBuffer(geometry);
+    indexBuffer->setData(toByteArray(indices));
+    auto indexAttribute = new Qt3DRender::QAttribute(indexBuffer,
+                                                     Qt3DRender::QAttribute::UnsignedInt,
+                                                     1,
+                                                     uint(indices.size()));
+    indexAttribute->setAttributeType(Qt3DRender::QAttribute::IndexAttribute);
+    geometry->addAttribute(indexAttribute);
+    return geometry;
+}
+
+QHash<Qt3DRender::QBuffer *, int> bufferUseCounts(const QVector<Qt3DRender::QGeometry *> &geometries)
+{
+    QHash<Qt3DRender::QBuffer *, int> useCounts;
+    for (const Qt3DRender::QGeometry *geometry : geometries) {
+        const auto attributes = geometry->attributes();
+        for (const Qt3DRender::QAttribute *attribute : attributes)
+            ++useCounts[attribute->buffer()];
+    }
+    return useCounts;
+}
+
+Qt3DRender::QAttribute *attribute(const Qt3DRender::QGeometry *geometry, Qt3DRender::QAttribute::AttributeType type)
+{
+    const auto attributes = geometry->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->attributeType() == type)
+            return attribute;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+class tst_MeshOptimizer : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void checkVertexCacheOptimization()
+    {
+        // GIVEN
+        const QVector<quint32> indices = shuffledGridIndices();
+        const float acmrBefore = MeshOptimizer::averageCacheMissRatio(indices, gridVertexCount);
+
+        // WHEN
+        const QVector<quint32> optimizedIndices = MeshOptimizer::optimizeVertexCache(indices, gridVertexCount);
+        const float acmrAfter = MeshOptimizer::averageCacheMissRatio(optimizedIndices, gridVertexCount);
+
+        // THEN -> random order misses almost all vertices, a regular grid
+        // drawn in a good order transforms less than a vertex per triangle
+        QVERIFY2(acmrBefore > 2.5f, qPrintable(QStringLiteral("ACMR before: %1").arg(acmrBefore)));
+        QVERIFY2(acmrAfter < 0.8f, qPrintable(QStringLiteral("ACMR after: %1").arg(acmrAfter)));
+        // at least three times fewer vertices transformed
+        QVERIFY2(acmrAfter < acmrBefore / 3.0f,
+                 qPrintable(QStringLiteral("ACMR before: %1, after: %2").arg(acmrBefore).arg(acmrAfter)));
+        QCOMPARE(canonicalTriangles(optimizedIndices), canonicalTriangles(indices));
+    }
+
+    void checkAverageCacheMissRatio()
+    {
+        // GIVEN
+        const QVector<quint32> separateTriangles = { 0, 1, 2, 3, 4, 5 };
+        const QVector<quint32> sharedEdge = { 0, 1, 2, 2, 1, 3 };
+
+        // THEN
+        QCOMPARE(MeshOptimizer::averageCacheMissRatio(separateTriangles, 6), 3.0f);
+        QCOMPARE(MeshOptimizer::averageCacheMissRatio(sharedEdge, 4), 2.0f);
+        QCOMPARE(MeshOptimizer::averageCacheMissRatio({}, 0), 0.0f);
+    }
+
+    void checkVertexFetchOptimization()
+    {
+        // GIVEN
+        const QVector<quint32> indices = { 4, 2, 0, 0, 2, 5 };
+        QVector<quint32> optimizedIndices = indices;
+
+        // WHEN
+        const QVector<quint32> previousIndices = MeshOptimizer::optimizeVertexFetch(optimizedIndices, 6);
+
+        // THEN -> vertices numbered by first use, unused ones last
+        QCOMPARE(optimizedIndices, QVector<quint32>({ 0, 1, 2, 2, 1, 3 }));
+        QCOMPARE(previousIndices, QVector<quint32>({ 4, 2, 0, 5, 1, 3 }));
+        for (int i = 0; i < indices.size(); ++i)
+            QCOMPARE(previousIndices.at(int(optimizedIndices.at(i))), indices.at(i));
+    }
+
+    void checkOptimizeGeometry()
+    {
+        // GIVEN
+        QScopedPointer<Qt3DRender::QGeometry> geometry(createGridGeometry());
+        Qt3DRender::QAttribute *positionAttribute = attribute(geometry.data(), Qt3DRender::QAttribute::VertexAttribute);
+        Qt3DRender::QAttribute *indexAttribute = attribute(geometry.data(), Qt3DRender::QAttribute::IndexAttribute);
+        Qt3DRender::QBuffer *indexBuffer = indexAttribute->buffer();
+        const auto trianglesBefore = trianglePositions(readFloats(positionAttribute), readIndices(indexAttribute));
+
+        // WHEN
+        const bool optimized = MeshOptimizer::optimizeGeometry(geometry.data(), bufferUseCounts({ geometry.data() }));
+
+        // THEN -> same triangles, 16-bit indices, vertices in drawing order
+        QVERIFY(optimized);
+        QCOMPARE(indexAttribute->vertexBaseType(), Qt3DRender::QAttribute::UnsignedShort);
+        QCOMPARE(indexAttribute->count(), 96U);
+        QCOMPARE(indexAttribute->buffer(), indexBuffer);
+        QCOMPARE(indexBuffer->data().size(), 96 * int(sizeof(quint16)));
+
+        const QVector<quint32> indices = readIndices(indexAttribute);
+        QCOMPARE(indices.mid(0, 3), QVector<quint32>({ 0, 1, 2 }));
+        QCOMPARE(trianglePositions(readFloats(positionAttribute), indices), trianglesBefore);
+    }
+
+    void checkOptimizeGeometryIndexType_data()
+    {
+        QTest::addColumn<int>("vertexCount");
+        QTest::addColumn<Qt3DRender::QAttribute::VertexBaseType>("indexType");
+
+        QTest::newRow("65535 vertices") << 65535 << Qt3DRender::QAttribute::UnsignedShort;
+        // Index 65535 is the primitive restart index, forbidden by glTF
+        QTest::newRow("65536 vertices") << 65536 << Qt3DRender::QAttribute::UnsignedInt;
+    }
+
+    void checkOptimizeGeometryIndexType()
+    {
+        // GIVEN
+        QFETCH(int, vertexCount);
+        QFETCH(Qt3DRender::QAttribute::VertexBaseType, indexType);
+        QScopedPointer<Qt3DRender::QGeometry> geometry(createTrianglesGeometry(vertexCount));
+        Qt3DRender::QAttribute *indexAttribute = attribute(geometry.data(), Qt3DRender::QAttribute::IndexAttribute);
+
+        // WHEN
+        const bool optimized = MeshOptimizer::optimizeGeometry(geometry.data(), bufferUseCounts({ geometry.data() }));
+
+        // THEN
+        QVERIFY(optimized);
+        QCOMPARE(indexAttribute->vertexBaseType(), indexType);
+        const QVector<quint32> indices = readIndices(indexAttribute);
+        QCOMPARE(*std::max_element(indices.cbegin(), indices.cend()), quint32(vertexCount - 1));
+    }
+
+    void checkOptimizeGeometryKeepsSharedBuffers()
+    {
+        // GIVEN
+        Qt3DCore::QNode root;
+        auto positionBuffer = new Qt3DRender::QBuffer(&root);
+        auto indexBuffer = new Qt3DRender::QBuffer(&root);
+        auto geometry = createGridGeometry(positionBuffer, indexBuffer);
+        auto otherGeometry = createGridGeometry(positionBuffer, indexBuffer);
+        geometry->setParent(&root);
+        otherGeometry->setParent(&root);
+        const QByteArray positionData = positionBuffer->data();
+        const QByteArray indexData = indexBuffer->data();
+        Qt3DRender::QAttribute *positionAttribute = attribute(geometry, Qt3DRender::QAttribute::VertexAttribute);
+        Qt3DRender::QAttribute *indexAttribute = attribute(geometry, Qt3DRender::QAttribute::IndexAttribute);
+        const auto trianglesBefore = trianglePositions(readFloats(positionAttribute), readIndices(indexAttribute));
+
+        // WHEN
+        const bool optimized = MeshOptimizer::optimizeGeometry(geometry, bufferUseCounts({ geometry, otherGeometry }));
+
+        // THEN -> the other geometry is left untouched
+        QVERIFY(optimized);
+        QCOMPARE(positionBuffer->data(), positionData);
+        QCOMPARE(indexBuffer->data(), indexData);
+        QVERIFY(indexAttribute->buffer() != indexBuffer);
+        QCOMPARE(indexAttribute->vertexBaseType(), Qt3DRender::QAttribute::UnsignedShort);
+        QCOMPARE(trianglePositions(readFloats(positionAttribute), readIndices(indexAttribute)), trianglesBefore);
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_MeshOptimizer)
+
+#include "tst_meshoptimizer.moc"
@@ -0,0 +1,127 @@
+/*
+    tst_metallicroughnesseffect.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/metallicroughnesseffect.h>
+#include <Qt3DRender/QTechnique>
+#include <Qt3DRender/QRenderPass>
+#include <Qt3DRender/QFilterKey>
+#include <Qt3DRender/QShaderProgram>
+#include <Qt3DRender/QGraphicsApiFilter>
+
+using namespace Kuesa;
+
+namespace {
+
+Qt3DRender::QRenderPass *drawStagePass(Qt3DRender::QTechnique *technique, const QString &drawStage)
+{
+    const auto renderPasses = technique->renderPasses();
+    for (Qt3DRender::QRenderPass *pass : renderPasses) {
+        const auto filterKeys = pass->filterKeys();
+        for (const Qt3DRender::QFilterKey *filterKey : filterKeys) {
+            if (filterKey->name() == QLatin1String("KuesaDrawStage") && filterKey->value() == drawStage)
+                return pass;
+        }
+    }
+    return nullptr;
+}
+
+QByteArray vertexShaderCode(Qt3DRender::QTechnique *technique, const QString &drawStage)
+{
+    Qt3DRender::QRenderPass *pass = drawStagePass(technique, drawStage);
+    return pass ? pass->shaderProgram()->vertexShaderCode() : QByteArray();
+}
+
+bool isES2(const Qt3DRender::QTechnique *technique)
+{
+    return technique->graphicsApiFilter()->api() == Qt3DRender::QGraphicsApiFilter::OpenGLES &&
+            technique->graphicsApiFilter()->majorVersion() == 2;
+}
+
+} // namespace
+
+class tst_MetallicRoughnessEffect : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void checkZFillFollowsVertexShader_data()
+    {
+        QTest::addColumn<QByteArray>("property");
+        QTest::addColumn<QByteArray>("vertexAttribute");
+
+        QTest::newRow("instancing") << QByteArray("useInstancing") << QByteArray("instanceModelMatrix");
+        QTest::newRow("skinning") << QByteArray("useSkinning") << QByteArray("vertexJointIndices");
+    }
+
+    void checkZFillFollowsVertexShader()
+    {
+        // GIVEN
+        QFETCH(QByteArray, property);
+        QFETCH(QByteArray, vertexAttribute);
+        MetallicRoughnessEffect effect;
+        QCoreApplication::processEvents();
+        const auto techniques = effect.techniques();
+        QCOMPARE(techniques.size(), 3);
+
+        QHash<Qt3DRender::QTechnique *, QByteArray> defaultShaders;
+        for (Qt3DRender::QTechnique *technique : techniques) {
+            const QByteArray zfillShader = vertexShaderCode(technique, QStringLiteral("ZFill"));
+            QVERIFY(!zfillShader.isEmpty());
+            QCOMPARE(zfillShader, vertexShaderCode(technique, QStringLiteral("Opaque")));
+            QVERIFY(!zfillShader.contains(vertexAttribute));
+            defaultShaders.insert(technique, zfillShader);
+        }
+
+        // WHEN
+        QVERIFY(effect.setProperty(property.constData(), true));
+
+        // THEN -> the depth prepass transforms vertices like the opaque pass
+        for (Qt3DRender::QTechnique *technique : techniques) {
+            const QByteArray zfillShader = vertexShaderCode(technique, QStringLiteral("ZFill"));
+            QCOMPARE(zfillShader, vertexShaderCode(technique, QStringLiteral("Opaque")));
+            // ES2 has no instanced draw calls
+            if (property == "useInstancing" && isES2(technique))
+                continue;
+            QVERIFY(zfillShader != defaultShaders.value(technique));
+            QVERIFY(zfillShader.contains(vertexAttribute));
+        }
+
+        // WHEN
+        QVERIFY(effect.setProperty(property.constData(), false));
+
+        // THEN
+        for (Qt3DRender::QTechnique *technique : techniques)
+            QCOMPARE(vertexShaderCode(technique, QStringLiteral("ZFill")), defaultShaders.value(technique));
+    }
+};
+
+QTEST_MAIN(tst_MetallicRoughnessEffect)
+#include "tst_metallicroughnesseffect.moc"
@@ -0,0 +1,157 @@
+/*
+    tst_renderscalecontroller.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/private/renderscalecontroller_p.h>
+
+using namespace Kuesa;
+
+namespace {
+
+const float targetFrameTime = 1.0f / 60.0f;
+
+// Feeds frames of frameTime until the scale changes or frameCount frames went by,
+// returning the number of frames it took
+int runFrames(RenderScaleController &controller, float frameTime, int frameCount)
+{
+    for (int frame = 1; frame <= frameCount; ++frame) {
+        if (controller.update(frameTime))
+            return frame;
+    }
+    return -1;
+}
+
+} // namespace
+
+class tst_RenderScaleController : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void checkDefaults()
+    {
+        // GIVEN
+        RenderScaleController controller;
+
+        // THEN
+        QCOMPARE(controller.scale(), 1.0f);
+        QCOMPARE(controller.minimumScale(), 0.5f);
+        QCOMPARE(controller.targetFrameTime(), targetFrameTime);
+        QVERIFY(controller.averageFrameTime() < 0.0f);
+    }
+
+    void checkScaleIsKeptWhenInTime()
+    {
+        // GIVEN
+        RenderScaleController controller;
+
+        // WHEN
+        const int frames = runFrames(controller, targetFrameTime, 1000);
+
+        // THEN
+        QCOMPARE(frames, -1);
+        QCOMPARE(controller.scale(), 1.0f);
+    }
+
+    void checkDownscalesOnSlowFrames()
+    {
+        // GIVEN
+        RenderScaleController controller;
+
+        // WHEN - frames take twice as long
+        const int frames = runFrames(controller, 2.0f * targetFrameTime, 1000);
+
+        // THEN - reacts once settled, halving the pixel count
+        QCOMPARE(frames, RenderScaleController::settleFrameCount);
+        QVERIFY(controller.scale() < 1.0f);
+        QVERIFY(qAbs(controller.scale() - 0.7f) < 0.01f);
+
+        // WHEN - still too slow
+        QVERIFY(runFrames(controller, 2.0f * targetFrameTime, 1000) > 0);
+
+        // THEN - down to the minimum
+        QCOMPARE(controller.scale(), 0.5f);
+
+        // WHEN
+        const int moreFrames = runFrames(controller, 2.0f * targetFrameTime, 1000);
+
+        // THEN - can't go any lower
+        QCOMPARE(moreFrames, -1);
+        QCOMPARE(controller.scale(), 0.5f);
+    }
+
+    void checkUpscalesWhenInTime()
+    {
+        // GIVEN
+        RenderScaleController controller;
+        controller.setScale(0.5f);
+
+        // WHEN
+        const int frames = runFrames(controller, targetFrameTime, 1000);
+
+        // THEN - raised by a single step
+        QVERIFY(frames >= RenderScaleController::settleFrameCount);
+        QVERIFY(qFuzzyCompare(controller.scale(), 0.5f + RenderScaleController::scaleStep));
+    }
+
+    void checkFailedProbesDelayUpscaling()
+    {
+        // GIVEN - fast enough at 0.8, too slow at 0.85
+        RenderScaleController controller;
+        controller.setScale(0.8f);
+
+        // WHEN
+        const int firstProbe = runFrames(controller, targetFrameTime, 10000);
+        QVERIFY(qFuzzyCompare(controller.scale(), 0.85f));
+        QVERIFY(runFrames(controller, 1.2f * targetFrameTime, 10000) > 0);
+        QVERIFY(controller.scale() < 0.85f);
+        controller.setScale(0.8f);
+        const int secondProbe = runFrames(controller, targetFrameTime, 10000);
+
+        // THEN - waits longer before probing again
+        QVERIFY(secondProbe > firstProbe);
+    }
+
+    void checkIgnoresInvalidFrameTimes()
+    {
+        // GIVEN
+        RenderScaleController controller;
+
+        // WHEN
+        const int frames = runFrames(controller, 0.0f, 1000);
+
+        // THEN
+        QCOMPARE(frames, -1);
+        QVERIFY(controller.averageFrameTime() < 0.0f);
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_RenderScaleController)
+#include "tst_renderscalecontroller.moc"
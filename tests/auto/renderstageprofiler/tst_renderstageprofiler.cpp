@@ -0,0 +1,253 @@
+/*
+    tst_renderstageprofiler.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/private/renderstageprofiler_p.h>
+#include <cmath>
+
+using namespace Kuesa;
+
+namespace {
+
+const int windowFrameCount = RenderStageProfiler::settleFrameCount + RenderStageProfiler::sampleFrameCount;
+
+// Feeds frames until a measurement window completes, taking baseFrameTime
+// plus sectionTimes[section] for each enabled section. Returns the number of
+// frames it took or -1 if no window completed after 1000 frames
+int runWindow(RenderStageProfiler &profiler, float baseFrameTime, const QVector<float> &sectionTimes)
+{
+    for (int frame = 1; frame <= 1000; ++frame) {
+        float frameTime = baseFrameTime;
+        for (int section = 0; section < sectionTimes.size(); ++section) {
+            if (section != profiler.disabledSection())
+                frameTime += sectionTimes.at(section);
+        }
+        if (profiler.update(frameTime))
+            return frame;
+    }
+    return -1;
+}
+
+} // namespace
+
+class tst_RenderStageProfiler : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void checkDefaults()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+
+        // THEN
+        QCOMPARE(profiler.sectionCount(), 0);
+        QCOMPARE(profiler.disabledSection(), -1);
+        QVERIFY(profiler.frameTime() < 0.0f);
+        QVERIFY(profiler.cpuFrameTime() < 0.0f);
+        QVERIFY(profiler.sectionTime(0) < 0.0f);
+        QVERIFY(profiler.sectionCpuTime(0) < 0.0f);
+    }
+
+    void checkCpuFrameTime()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+        profiler.setSectionCount(1);
+
+        // WHEN -> all sections enabled
+        for (int frame = 0; frame < windowFrameCount; ++frame)
+            profiler.update(0.01f, 0.004f);
+
+        // THEN
+        QCOMPARE(profiler.disabledSection(), 0);
+        QVERIFY(qAbs(profiler.frameTime() - 0.01f) < 1e-5f);
+        QVERIFY(qAbs(profiler.cpuFrameTime() - 0.004f) < 1e-5f);
+
+        // WHEN -> section knocked out
+        for (int frame = 0; frame < windowFrameCount; ++frame)
+            profiler.update(0.008f, 0.001f);
+
+        // THEN -> only frames with all sections enabled count
+        QCOMPARE(profiler.disabledSection(), -1);
+        QVERIFY(qAbs(profiler.cpuFrameTime() - 0.004f) < 1e-5f);
+
+        // THEN -> CPU and frame time differences kept apart
+        QVERIFY(qAbs(profiler.sectionTime(0) - 0.002f) < 1e-5f);
+        QVERIFY(qAbs(profiler.sectionCpuTime(0) - 0.003f) < 1e-5f);
+
+        // WHEN
+        profiler.reset();
+
+        // THEN
+        QVERIFY(profiler.cpuFrameTime() < 0.0f);
+        QVERIFY(profiler.sectionCpuTime(0) < 0.0f);
+    }
+
+    void checkSectionCpuTimesWithCappedFrameTimes()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+        profiler.setSectionCount(1);
+        const float vsyncFrameTime = 1.0f / 60.0f;
+
+        // WHEN -> v-sync hides the section in the frame times
+        for (int frame = 0; frame < windowFrameCount; ++frame)
+            profiler.update(vsyncFrameTime, 0.006f);
+        for (int frame = 0; frame < windowFrameCount; ++frame)
+            profiler.update(vsyncFrameTime, 0.002f);
+
+        // THEN -> but not in the CPU time
+        QCOMPARE(profiler.sectionTime(0), 0.0f);
+        QVERIFY(qAbs(profiler.sectionCpuTime(0) - 0.004f) < 1e-5f);
+    }
+
+    void checkProcessCpuTime()
+    {
+        // WHEN
+        const double before = RenderStageProfiler::processCpuTime();
+        volatile double sum = 0.0;
+        for (int i = 0; i < 1000000; ++i)
+            sum = sum + std::sqrt(double(i));
+        const double after = RenderStageProfiler::processCpuTime();
+
+        // THEN
+        QVERIFY(before >= 0.0);
+        QVERIFY(after >= before);
+    }
+
+    void checkFrameTimeWithoutSections()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+
+        // WHEN
+        const int frames = runWindow(profiler, 0.01f, {});
+
+        // THEN
+        QCOMPARE(frames, windowFrameCount);
+        QCOMPARE(profiler.disabledSection(), -1);
+        QVERIFY(qAbs(profiler.frameTime() - 0.01f) < 1e-5f);
+    }
+
+    void checkSectionsAreKnockedOutInTurn()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+        const QVector<float> sectionTimes = { 0.004f, 0.001f, 0.002f };
+        profiler.setSectionCount(sectionTimes.size());
+
+        // THEN
+        QCOMPARE(profiler.sectionCount(), 3);
+
+        for (int section = 0; section < sectionTimes.size(); ++section) {
+            // WHEN
+            QCOMPARE(runWindow(profiler, 0.005f, sectionTimes), windowFrameCount);
+
+            // THEN
+            QCOMPARE(profiler.disabledSection(), section);
+            QVERIFY(qAbs(profiler.frameTime() - 0.012f) < 1e-5f);
+
+            // WHEN
+            QCOMPARE(runWindow(profiler, 0.005f, sectionTimes), windowFrameCount);
+
+            // THEN
+            QCOMPARE(profiler.disabledSection(), -1);
+            QVERIFY(qAbs(profiler.sectionTime(section) - sectionTimes.at(section)) < 1e-5f);
+        }
+
+        // WHEN
+        runWindow(profiler, 0.005f, sectionTimes);
+
+        // THEN
+        QCOMPARE(profiler.disabledSection(), 0);
+    }
+
+    void checkSettlingFramesAreIgnored()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+        profiler.setSectionCount(1);
+
+        // WHEN
+        for (int frame = 0; frame < RenderStageProfiler::settleFrameCount; ++frame)
+            profiler.update(1.0f);
+        runWindow(profiler, 0.01f, {});
+
+        // THEN
+        QVERIFY(qAbs(profiler.frameTime() - 0.01f) < 1e-5f);
+    }
+
+    void checkSectionTimeIsNeverNegative()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+        profiler.setSectionCount(1);
+        runWindow(profiler, 0.01f, {});
+
+        // WHEN
+        runWindow(profiler, 0.02f, {});
+
+        // THEN
+        QCOMPARE(profiler.sectionTime(0), 0.0f);
+    }
+
+    void checkInvalidFrameTimesAreIgnored()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+
+        // WHEN
+        for (int frame = 0; frame < 2 * windowFrameCount; ++frame)
+            QVERIFY(!profiler.update(0.0f));
+
+        // THEN
+        QVERIFY(profiler.frameTime() < 0.0f);
+    }
+
+    void checkResultsAreResetWithSectionCount()
+    {
+        // GIVEN
+        RenderStageProfiler profiler;
+        profiler.setSectionCount(2);
+        runWindow(profiler, 0.01f, { 0.001f, 0.002f });
+        runWindow(profiler, 0.01f, { 0.001f, 0.002f });
+        QVERIFY(profiler.sectionTime(0) >= 0.0f);
+
+        // WHEN
+        profiler.setSectionCount(3);
+
+        // THEN
+        QCOMPARE(profiler.disabledSection(), -1);
+        QVERIFY(profiler.frameTime() < 0.0f);
+        QVERIFY(profiler.sectionTime(0) < 0.0f);
+        QVERIFY(profiler.sectionTime(2) < 0.0f);
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_RenderStageProfiler)
+#include "tst_renderstageprofiler.moc"
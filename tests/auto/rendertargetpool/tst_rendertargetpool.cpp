@@ -0,0 +1,237 @@
+/*
+    tst_rendertargetpool.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/forwardrenderer.h>
+#include <Kuesa/bloomeffect.h>
+#include <Kuesa/thresholdeffect.h>
+#include <Kuesa/gaussianblureffect.h>
+#include <Kuesa/private/rendertargetpool_p.h>
+#include <Qt3DRender/QAbstractTexture>
+#include <Qt3DRender/QRenderTarget>
+#include <Qt3DRender/QRenderTargetOutput>
+#include <QOffscreenSurface>
+
+using namespace Kuesa;
+
+class tst_RenderTargetPool : public QObject
+{
+    Q_OBJECT
+
+private:
+    qint64 chainMemoryUsage(const QVector<AbstractPostProcessingEffect *> &effects, const QSize &size)
+    {
+        ForwardRenderer renderer;
+        QOffscreenSurface surface;
+        renderer.setExternalRenderTargetSize(size);
+        renderer.setRenderSurface(&surface);
+        for (AbstractPostProcessingEffect *effect : effects)
+            renderer.addPostProcessingEffect(effect);
+        QCoreApplication::processEvents();
+
+        RenderTargetPool *pool = renderer.findChild<RenderTargetPool *>();
+        const qint64 memory = pool->memoryUsage();
+
+        // effects outlive the renderer
+        for (AbstractPostProcessingEffect *effect : effects)
+            renderer.removePostProcessingEffect(effect);
+        return memory;
+    }
+
+private Q_SLOTS:
+
+    void checkTexturesAreSharedWhenPassesDontOverlap()
+    {
+        // GIVEN
+        RenderTargetPool pool;
+        pool.setSceneSize(QSize(64, 32));
+
+        // WHEN
+        Qt3DRender::QAbstractTexture *a = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 1);
+        Qt3DRender::QAbstractTexture *b = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 1, 2);
+        Qt3DRender::QAbstractTexture *c = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 2, 3);
+        Qt3DRender::QAbstractTexture *d = pool.acquireTexture(Qt3DRender::QAbstractTexture::DepthFormat, 2, 3);
+
+        // THEN
+        QVERIFY(a != b);
+        QCOMPARE(c, a);
+        QVERIFY(d != a && d != b);
+        QCOMPARE(d->format(), Qt3DRender::QAbstractTexture::DepthFormat);
+        QCOMPARE(pool.textureCount(), 3);
+        QCOMPARE(a->width(), 64);
+        QCOMPARE(a->height(), 32);
+        QCOMPARE(pool.memoryUsage(), qint64(3 * 64 * 32 * 4));
+    }
+
+    void checkResetKeepsTextures()
+    {
+        // GIVEN
+        RenderTargetPool pool;
+        Qt3DRender::QAbstractTexture *a = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 1);
+        Qt3DRender::QAbstractTexture *b = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 1);
+
+        // WHEN
+        pool.reset();
+
+        // THEN
+        QCOMPARE(pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 1), a);
+        QCOMPARE(pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 1), b);
+        QCOMPARE(pool.textureCount(), 2);
+    }
+
+    void checkResize()
+    {
+        // GIVEN
+        RenderTargetPool pool;
+        Qt3DRender::QAbstractTexture *a = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA16F, 0, 0);
+
+        // WHEN
+        pool.setSceneSize(QSize(128, 128));
+
+        // THEN
+        QCOMPARE(a->width(), 128);
+        QCOMPARE(a->height(), 128);
+        QCOMPARE(pool.memoryUsage(), qint64(128 * 128 * 8));
+    }
+
+    void checkReleaseUnused()
+    {
+        // GIVEN
+        RenderTargetPool pool;
+        pool.setSceneSize(QSize(64, 64));
+        Qt3DRender::QAbstractTexture *a = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 0);
+        Qt3DRender::QAbstractTexture *b = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 0, 2);
+        Qt3DRender::QAbstractTexture *depth = pool.acquireTexture(Qt3DRender::QAbstractTexture::DepthFormat, 0, 0);
+        Qt3DRender::QRenderTarget *aTarget = pool.renderTarget(a, depth);
+        pool.renderTarget(b);
+        QSignalSpy bDestroyedSpy(b, SIGNAL(destroyed(QObject *)));
+
+        // WHEN -> the chain is rebuilt without b
+        pool.reset();
+        QCOMPARE(pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 0), a);
+        QCOMPARE(pool.acquireTexture(Qt3DRender::QAbstractTexture::DepthFormat, 0, 0), depth);
+        QCOMPARE(pool.renderTarget(a, depth), aTarget);
+        pool.releaseUnused();
+
+        // THEN
+        QCOMPARE(bDestroyedSpy.count(), 1);
+        QCOMPARE(pool.textureCount(), 2);
+        QCOMPARE(pool.renderTargetCount(), 1);
+        QCOMPARE(pool.memoryUsage(), qint64(2 * 64 * 64 * 4));
+
+        // WHEN -> nothing gets acquired
+        pool.reset();
+        pool.releaseUnused();
+
+        // THEN
+        QCOMPARE(pool.textureCount(), 0);
+        QCOMPARE(pool.renderTargetCount(), 0);
+        QCOMPARE(pool.memoryUsage(), qint64(0));
+    }
+
+    void checkRenderTargetsAreCached()
+    {
+        // GIVEN
+        RenderTargetPool pool;
+        Qt3DRender::QAbstractTexture *color = pool.acquireTexture(Qt3DRender::QAbstractTexture::RGBA8_UNorm, 0, 0);
+        Qt3DRender::QAbstractTexture *depth = pool.acquireTexture(Qt3DRender::QAbstractTexture::DepthFormat, 0, 0);
+
+        // WHEN
+        Qt3DRender::QRenderTarget *colorTarget = pool.renderTarget(color);
+        Qt3DRender::QRenderTarget *colorDepthTarget = pool.renderTarget(color, depth);
+
+        // THEN
+        QVERIFY(colorTarget != colorDepthTarget);
+        QCOMPARE(colorTarget->outputs().size(), 1);
+        QCOMPARE(colorDepthTarget->outputs().size(), 2);
+        QCOMPARE(ForwardRenderer::findRenderTargetTexture(colorDepthTarget, Qt3DRender::QRenderTargetOutput::Depth), depth);
+        QCOMPARE(pool.renderTarget(color), colorTarget);
+        QCOMPARE(pool.renderTarget(color, depth), colorDepthTarget);
+        QCOMPARE(pool.renderTargetCount(), 2);
+    }
+
+    void checkChainMemoryUsage()
+    {
+        // GIVEN
+        const QSize size(256, 256);
+        const qint64 texture = 256 * 256 * 4;
+        ThresholdEffect threshold;
+        BloomEffect bloom;
+        GaussianBlurEffect blur;
+
+        // THEN - scene color and depth, blur intermediate texture
+        QCOMPARE(chainMemoryUsage({ &blur }, size), 3 * texture);
+
+        // THEN - scene color and depth, bright parts, blur intermediate texture
+        QCOMPARE(chainMemoryUsage({ &bloom }, size), 4 * texture);
+
+        // THEN - bloom reuses the scene texture once the threshold has read it,
+        // 6 textures would be needed without pooling
+        QCOMPARE(chainMemoryUsage({ &threshold, &bloom }, size), 4 * texture);
+    }
+
+    void checkShrinkingChainReleasesTextures()
+    {
+        // GIVEN
+        const QSize size(256, 256);
+        const qint64 texture = 256 * 256 * 4;
+        ThresholdEffect threshold;
+        BloomEffect bloom;
+        ForwardRenderer renderer;
+        QOffscreenSurface surface;
+        renderer.setExternalRenderTargetSize(size);
+        renderer.setRenderSurface(&surface);
+        renderer.addPostProcessingEffect(&threshold);
+        renderer.addPostProcessingEffect(&bloom);
+        QCoreApplication::processEvents();
+        RenderTargetPool *pool = renderer.findChild<RenderTargetPool *>();
+        QCOMPARE(pool->memoryUsage(), 4 * texture);
+
+        // WHEN
+        renderer.removePostProcessingEffect(&bloom);
+        QCoreApplication::processEvents();
+
+        // THEN - only the scene color and depth are left
+        QCOMPARE(pool->textureCount(), 2);
+        QCOMPARE(pool->memoryUsage(), 2 * texture);
+
+        // WHEN
+        renderer.removePostProcessingEffect(&threshold);
+        QCoreApplication::processEvents();
+
+        // THEN
+        QCOMPARE(pool->textureCount(), 0);
+        QCOMPARE(pool->renderTargetCount(), 0);
+        QCOMPARE(pool->memoryUsage(), qint64(0));
+    }
+};
+
+QTEST_MAIN(tst_RenderTargetPool)
+
+#include "tst_rendertargetpool.moc"
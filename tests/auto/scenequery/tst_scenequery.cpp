@@ -0,0 +1,237 @@
+/*
+    tst_scenequery.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Paul Lemire <paul.lemire@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+#include <Kuesa/SceneEntity>
+#include <Kuesa/private/gltf2parser_p.h>
+#include <Qt3DCore/QEntity>
+#include <Qt3DCore/QTransform>
+#include <Qt3DRender/QGeometry>
+#include <Qt3DRender/QGeometryRenderer>
+#include <random>
+
+using namespace Kuesa;
+
+class tst_SceneQuery : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void checkCastRay()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+        QVERIFY(res != nullptr);
+        res->setParent(&scene);
+
+        // WHEN
+        const QStringList hits = scene.castRay(QVector3D(-10.0f, 0.0f, 0.0f), QVector3D(1.0f, 0.0f, 0.0f));
+
+        // THEN
+        QCOMPARE(hits, QStringList() << QStringLiteral("box0") << QStringLiteral("box1"));
+
+        // WHEN
+        float distance = 0.0f;
+        const QString nearest = scene.pick(QVector3D(-10.0f, 0.0f, 0.0f), QVector3D(2.0f, 0.0f, 0.0f), &distance);
+
+        // THEN
+        QCOMPARE(nearest, QStringLiteral("box0"));
+        QVERIFY(qFuzzyCompare(distance, 7.5f));
+
+        // WHEN -> box2 is a child of group
+        const QString child = scene.pick(QVector3D(2.0f, 10.0f, 0.0f), QVector3D(0.0f, -1.0f, 0.0f), &distance);
+
+        // THEN
+        QCOMPARE(child, QStringLiteral("box2"));
+        QVERIFY(qFuzzyCompare(distance, 6.5f));
+
+        // WHEN
+        const QString miss = scene.pick(QVector3D(0.0f, 10.0f, 10.0f), QVector3D(0.0f, 1.0f, 0.0f));
+
+        // THEN
+        QVERIFY(miss.isEmpty());
+    }
+
+    void checkCastRayFollowsTransforms()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+        QVERIFY(res != nullptr);
+        res->setParent(&scene);
+        QCOMPARE(scene.pick(QVector3D(2.0f, 10.0f, 0.0f), QVector3D(0.0f, -1.0f, 0.0f)), QStringLiteral("box2"));
+
+        // WHEN
+        auto groupTransform = qobject_cast<Qt3DCore::QTransform *>(scene.transformForEntity(QStringLiteral("group")));
+        QVERIFY(groupTransform != nullptr);
+        groupTransform->setTranslation(QVector3D(0.0f, 0.0f, 0.0f));
+        float distance = 0.0f;
+        const QString hit = scene.pick(QVector3D(2.0f, 10.0f, 0.0f), QVector3D(0.0f, -1.0f, 0.0f), &distance);
+
+        // THEN
+        QCOMPARE(hit, QStringLiteral("box2"));
+        QVERIFY(qFuzzyCompare(distance, 9.5f));
+    }
+
+    void checkCastRayFollowsGeometryChanges()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+        QVERIFY(res != nullptr);
+        res->setParent(&scene);
+        QCOMPARE(scene.castRay(QVector3D(-10.0f, 0.0f, 0.0f), QVector3D(1.0f, 0.0f, 0.0f)),
+                 QStringList() << QStringLiteral("box0") << QStringLiteral("box1"));
+
+        // WHEN -> the mesh gets a geometry without triangles, as when reloaded
+        Qt3DRender::QGeometryRenderer *mesh = scene.mesh(QStringLiteral("Mesh_0"));
+        QVERIFY(mesh != nullptr);
+        mesh->setGeometry(new Qt3DRender::QGeometry(mesh));
+        const QStringList hits = scene.castRay(QVector3D(-10.0f, 0.0f, 0.0f), QVector3D(1.0f, 0.0f, 0.0f));
+
+        // THEN -> the BVH of the previous geometry isn't used anymore
+        QVERIFY(hits.isEmpty());
+    }
+
+    void checkCastRayOnMergedPrimitives()
+    {
+        // GIVEN -> static boxes merged into a single mesh
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        parser.setMergeStaticGeometry(true);
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+        QVERIFY(res != nullptr);
+        res->setParent(&scene);
+
+        // WHEN
+        const QStringList hits = scene.castRay(QVector3D(-10.0f, 0.0f, 0.0f), QVector3D(1.0f, 0.0f, 0.0f));
+
+        // THEN -> their bounds are still told apart
+        QCOMPARE(hits, QStringList() << QStringLiteral("box0") << QStringLiteral("box1"));
+    }
+
+    void checkEntitiesInBox()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+        QVERIFY(res != nullptr);
+        res->setParent(&scene);
+
+        // WHEN
+        QStringList names = scene.entitiesInBox(QVector3D(-3.0f, -1.0f, -1.0f), QVector3D(0.6f, 1.0f, 1.0f));
+        names.sort();
+
+        // THEN
+        QCOMPARE(names, QStringList() << QStringLiteral("box0") << QStringLiteral("box1"));
+        QVERIFY(scene.entitiesInBox(QVector3D(10.0f, 10.0f, 10.0f), QVector3D(11.0f, 11.0f, 11.0f)).isEmpty());
+    }
+
+    void checkEntitiesInFrustum()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "instancing_automatic.gltf"));
+        QVERIFY(res != nullptr);
+        res->setParent(&scene);
+
+        QMatrix4x4 projection;
+        projection.ortho(-1.0f, 1.0f, -1.0f, 1.0f, 0.1f, 100.0f);
+        QMatrix4x4 view;
+        view.lookAt(QVector3D(0.0f, 0.0f, 10.0f), QVector3D(), QVector3D(0.0f, 1.0f, 0.0f));
+
+        // WHEN
+        QStringList names = scene.entitiesInFrustum(projection * view);
+        names.sort();
+
+        // THEN
+        QCOMPARE(names, QStringList() << QStringLiteral("animatedBox") << QStringLiteral("box1"));
+
+        // WHEN -> looking away
+        view.setToIdentity();
+        view.lookAt(QVector3D(0.0f, 0.0f, 10.0f), QVector3D(0.0f, 0.0f, 20.0f), QVector3D(0.0f, 1.0f, 0.0f));
+
+        // THEN
+        QVERIFY(scene.entitiesInFrustum(projection * view).isEmpty());
+    }
+
+    void benchmarkCarScenePicking()
+    {
+        if (!QFile::exists(QStringLiteral(CAR_ASSET)))
+            QSKIP("Car scene not available");
+
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Parser parser(&scene);
+        Qt3DCore::QEntity *res = parser.parse(QStringLiteral(CAR_ASSET));
+        QVERIFY(res != nullptr);
+        res->setParent(&scene);
+
+        // Rays from a sphere around the car, aimed near its center
+        const float radius = 10.0f;
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        QVector<QPair<QVector3D, QVector3D>> rays;
+        rays.reserve(10000);
+        while (rays.size() < 10000) {
+            const QVector3D direction(distribution(generator), distribution(generator), distribution(generator));
+            if (direction.lengthSquared() > 1.0f || qFuzzyIsNull(direction.lengthSquared()))
+                continue;
+            const QVector3D target = 0.5f * QVector3D(distribution(generator), distribution(generator), distribution(generator));
+            const QVector3D origin = target - radius * direction.normalized();
+            rays.push_back({ origin, target - origin });
+        }
+
+        // Waits for the BVHs of the meshes to be built
+        scene.pick(rays.first().first, rays.first().second);
+
+        // WHEN
+        int hitCount = 0;
+        QBENCHMARK {
+            hitCount = 0;
+            for (const auto &ray : qAsConst(rays)) {
+                if (!scene.pick(ray.first, ray.second).isEmpty())
+                    ++hitCount;
+            }
+        }
+
+        // THEN
+        QVERIFY(hitCount > 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(tst_SceneQuery)
+
+#include "tst_scenequery.moc"
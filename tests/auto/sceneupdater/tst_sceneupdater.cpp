@@ -0,0 +1,331 @@
+/*
+    tst_sceneupdater.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <Kuesa/SceneEntity>
+#include <Kuesa/MetallicRoughnessMaterial>
+#include <Kuesa/private/gltf2context_p.h>
+#include <Kuesa/private/gltf2parser_p.h>
+#include <Kuesa/private/sceneupdater_p.h>
+#include <Qt3DCore/QEntity>
+#include <Qt3DCore/QTransform>
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+#include <Qt3DRender/QGeometryRenderer>
+
+using namespace Kuesa;
+using namespace GLTF2Import;
+
+namespace {
+
+QJsonObject readDocument(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+// Sets key to value in the object at index of the array arrayKey of document
+void setArrayItemValue(QJsonObject &document, const QString &arrayKey, int index, const QString &key, const QJsonValue &value)
+{
+    QJsonArray array = document.value(arrayKey).toArray();
+    QJsonObject item = array.at(index).toObject();
+    item.insert(key, value);
+    array[index] = item;
+    document.insert(arrayKey, array);
+}
+
+// Sets the attributes of the first primitive of the mesh at meshIdx
+void setPrimitiveAttributes(QJsonObject &document, int meshIdx, const QJsonObject &attributes)
+{
+    QJsonArray meshes = document.value(QStringLiteral("meshes")).toArray();
+    QJsonObject mesh = meshes.at(meshIdx).toObject();
+    QJsonArray primitives = mesh.value(QStringLiteral("primitives")).toArray();
+    QJsonObject primitive = primitives.at(0).toObject();
+    primitive.insert(QStringLiteral("attributes"), attributes);
+    primitives[0] = primitive;
+    mesh.insert(QStringLiteral("primitives"), primitives);
+    meshes[meshIdx] = mesh;
+    document.insert(QStringLiteral("meshes"), meshes);
+}
+
+Qt3DRender::QAttribute *attribute(Qt3DRender::QGeometryRenderer *mesh, const QString &name)
+{
+    const auto attributes = mesh->geometry()->attributes();
+    for (Qt3DRender::QAttribute *attribute : attributes) {
+        if (attribute->name() == name)
+            return attribute;
+    }
+    return nullptr;
+}
+
+Qt3DCore::QTransform *transform(Qt3DCore::QEntity *entity)
+{
+    const auto transforms = entity->componentsOfType<Qt3DCore::QTransform>();
+    return transforms.isEmpty() ? nullptr : transforms.first();
+}
+
+} // namespace
+
+class tst_SceneUpdater : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Parses document as the new version of the file and applies it
+    bool update(GLTF2ContextPrivate *context, const QVector<Qt3DCore::QEntity *> &nodeEntities,
+                const QJsonObject &document, SceneUpdater::Statistics &statistics)
+    {
+        GLTF2ContextPrivate updatedContext;
+        GLTF2Parser parser;
+        parser.setLazyMeshes(true);
+        parser.setContext(&updatedContext);
+        if (!parser.parseDocument(QJsonDocument(document).toJson(), QStringLiteral(ASSETS)))
+            return false;
+
+        SceneUpdater updater(context, nodeEntities);
+        const bool updated = updater.update(&updatedContext);
+        statistics = updater.statistics();
+
+        Qt3DCore::QNode discardedAssets;
+        updatedContext.setAssetsParent(&discardedAssets);
+        return updated;
+    }
+
+private Q_SLOTS:
+    void checkUnchangedDocument()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setContext(&context);
+        const QJsonObject document = readDocument(QStringLiteral(ASSETS "scenes.gltf"));
+        QScopedPointer<Qt3DCore::QEntity> root(parser.parse(QJsonDocument(document).toJson(), QStringLiteral(ASSETS)));
+        QVERIFY(!root.isNull());
+
+        // WHEN
+        SceneUpdater::Statistics statistics;
+        const bool updated = update(&context, parser.nodeEntities(), document, statistics);
+
+        // THEN
+        QVERIFY(updated);
+        QCOMPARE(statistics.materials, 0);
+        QCOMPARE(statistics.meshes, 0);
+        QCOMPARE(statistics.nodes, 0);
+    }
+
+    void checkMaterialUpdate()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setContext(&context);
+        QJsonObject document = readDocument(QStringLiteral(ASSETS "scenes.gltf"));
+        QScopedPointer<Qt3DCore::QEntity> root(parser.parse(QJsonDocument(document).toJson(), QStringLiteral(ASSETS)));
+        QVERIFY(!root.isNull());
+        auto material = qobject_cast<MetallicRoughnessMaterial *>(scene.material(QStringLiteral("Red")));
+        QVERIFY(material != nullptr);
+
+        // WHEN
+        const QJsonObject pbr{ { QStringLiteral("baseColorFactor"), QJsonArray{ 0.0, 1.0, 0.0, 1.0 } },
+                               { QStringLiteral("metallicFactor"), 0.0 } };
+        setArrayItemValue(document, QStringLiteral("materials"), 0, QStringLiteral("pbrMetallicRoughness"), pbr);
+        SceneUpdater::Statistics statistics;
+        const bool updated = update(&context, parser.nodeEntities(), document, statistics);
+
+        // THEN -> the material is updated in place
+        QVERIFY(updated);
+        QCOMPARE(statistics.materials, 1);
+        QCOMPARE(statistics.meshes, 0);
+        QCOMPARE(statistics.nodes, 0);
+        QCOMPARE(scene.material(QStringLiteral("Red")), material);
+        QCOMPARE(material->baseColorFactor(), QColor::fromRgbF(0.0, 1.0, 0.0, 1.0));
+    }
+
+    void checkNodeUpdate()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setContext(&context);
+        QJsonObject document = readDocument(QStringLiteral(ASSETS "scenes.gltf"));
+        QScopedPointer<Qt3DCore::QEntity> root(parser.parse(QJsonDocument(document).toJson(), QStringLiteral(ASSETS)));
+        QVERIFY(!root.isNull());
+        Qt3DCore::QEntity *boxB = scene.entity(QStringLiteral("boxB"));
+        QVERIFY(boxB != nullptr);
+        QVERIFY(transform(boxB) != nullptr);
+
+        // WHEN
+        setArrayItemValue(document, QStringLiteral("nodes"), 1, QStringLiteral("translation"), QJsonArray{ 0.0, 0.0, 3.0 });
+        SceneUpdater::Statistics statistics;
+        const bool updated = update(&context, parser.nodeEntities(), document, statistics);
+
+        // THEN -> the entity moves
+        QVERIFY(updated);
+        QCOMPARE(statistics.materials, 0);
+        QCOMPARE(statistics.meshes, 0);
+        QCOMPARE(statistics.nodes, 1);
+        QCOMPARE(scene.entity(QStringLiteral("boxB")), boxB);
+        QCOMPARE(transform(boxB)->translation(), QVector3D(0.0f, 0.0f, 3.0f));
+    }
+
+    void checkMeshUpdate()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setContext(&context);
+        QJsonObject document = readDocument(QStringLiteral(ASSETS "scenes.gltf"));
+        QScopedPointer<Qt3DCore::QEntity> root(parser.parse(QJsonDocument(document).toJson(), QStringLiteral(ASSETS)));
+        QVERIFY(!root.isNull());
+        Qt3DRender::QGeometryRenderer *mesh = scene.mesh(QStringLiteral("Box_0"));
+        QVERIFY(mesh != nullptr);
+        Qt3DRender::QGeometry *geometry = mesh->geometry();
+        QVERIFY(geometry != nullptr);
+
+        // WHEN -> the positions are read from another accessor
+        setPrimitiveAttributes(document, 0, { { QStringLiteral("NORMAL"), 2 }, { QStringLiteral("POSITION"), 1 } });
+        SceneUpdater::Statistics statistics;
+        const bool updated = update(&context, parser.nodeEntities(), document, statistics);
+
+        // THEN -> the renderer keeps its name and gets a new geometry
+        QVERIFY(updated);
+        QCOMPARE(statistics.materials, 0);
+        QCOMPARE(statistics.meshes, 1);
+        QCOMPARE(statistics.nodes, 0);
+        QCOMPARE(scene.mesh(QStringLiteral("Box_0")), mesh);
+        QVERIFY(mesh->geometry() != nullptr);
+        QVERIFY(mesh->geometry() != geometry);
+        QCOMPARE(mesh->geometry()->parent(), mesh);
+        QCOMPARE(context.mesh(0).meshPrimitives.first().primitiveRenderer, mesh);
+    }
+
+    void checkMeshUpdateWithSharedBufferView()
+    {
+        // GIVEN -> boxB and boxC draw two meshes reading the same buffer views
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setContext(&context);
+        QJsonObject document = readDocument(QStringLiteral(ASSETS "scenes.gltf"));
+        QJsonArray meshes = document.value(QStringLiteral("meshes")).toArray();
+        QJsonObject smallBox = meshes.at(0).toObject();
+        smallBox.insert(QStringLiteral("name"), QStringLiteral("SmallBox"));
+        meshes.append(smallBox);
+        document.insert(QStringLiteral("meshes"), meshes);
+        setArrayItemValue(document, QStringLiteral("nodes"), 2, QStringLiteral("mesh"), 1);
+        QScopedPointer<Qt3DCore::QEntity> root(parser.parse(QJsonDocument(document).toJson(), QStringLiteral(ASSETS), 1));
+        QVERIFY(!root.isNull());
+        Qt3DRender::QGeometryRenderer *box = scene.mesh(QStringLiteral("Box_0"));
+        Qt3DRender::QGeometryRenderer *smallBoxMesh = scene.mesh(QStringLiteral("SmallBox_0"));
+        QVERIFY(box != nullptr);
+        QVERIFY(smallBoxMesh != nullptr);
+        const QString positionName = Qt3DRender::QAttribute::defaultPositionAttributeName();
+        const QString normalName = Qt3DRender::QAttribute::defaultNormalAttributeName();
+        QPointer<Qt3DRender::QBuffer> vertexBuffer = attribute(smallBoxMesh, positionName)->buffer();
+        QCOMPARE(attribute(box, positionName)->buffer(), vertexBuffer.data());
+        Qt3DCore::QEntity *boxB = scene.entity(QStringLiteral("boxB"));
+        Qt3DCore::QEntity *boxC = scene.entity(QStringLiteral("boxC"));
+        QVERIFY(boxB != nullptr);
+        QVERIFY(boxC != nullptr);
+        QCOMPARE(boxB->property("boundsMax").value<QVector3D>(), QVector3D(0.5f, 0.5f, 0.5f));
+
+        // WHEN -> the positions of Box are read from another accessor, twice
+        // so that the geometry replaced the second time was created by an update
+        for (const int positionAccessor : { 1, 2 }) {
+            setPrimitiveAttributes(document, 0, { { QStringLiteral("NORMAL"), 3 - positionAccessor }, { QStringLiteral("POSITION"), positionAccessor } });
+            SceneUpdater::Statistics statistics;
+            const bool updated = update(&context, parser.nodeEntities(), document, statistics);
+
+            // THEN -> the buffer view is still shared and SmallBox is unchanged
+            QVERIFY(updated);
+            QCOMPARE(statistics.meshes, 1);
+            QVERIFY(!vertexBuffer.isNull());
+            QCOMPARE(vertexBuffer->data().size(), 576);
+            QCOMPARE(attribute(smallBoxMesh, positionName)->buffer(), vertexBuffer.data());
+            QCOMPARE(attribute(smallBoxMesh, normalName)->buffer(), vertexBuffer.data());
+            QCOMPARE(attribute(box, positionName)->buffer(), vertexBuffer.data());
+            QCOMPARE(attribute(box, positionName)->byteOffset(), positionAccessor == 1 ? 0u : 288u);
+
+            // THEN -> the bounds follow the new positions
+            const float extent = positionAccessor == 1 ? 1.0f : 0.5f;
+            QCOMPARE(box->geometry()->property("boundsMax").value<QVector3D>(), QVector3D(extent, extent, extent));
+            QCOMPARE(boxB->property("boundsMin").value<QVector3D>(), -QVector3D(extent, extent, extent));
+            QCOMPARE(boxB->property("boundsMax").value<QVector3D>(), QVector3D(extent, extent, extent));
+            QCOMPARE(boxC->property("boundsMax").value<QVector3D>(), QVector3D(0.5f, 0.5f, 0.5f));
+        }
+    }
+
+    void checkIncompatibleDocument()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2ContextPrivate context;
+        GLTF2Parser parser(&scene);
+        parser.setContext(&context);
+        QJsonObject document = readDocument(QStringLiteral(ASSETS "scenes.gltf"));
+        QScopedPointer<Qt3DCore::QEntity> root(parser.parse(QJsonDocument(document).toJson(), QStringLiteral(ASSETS)));
+        QVERIFY(!root.isNull());
+        auto material = qobject_cast<MetallicRoughnessMaterial *>(scene.material(QStringLiteral("Red")));
+        QVERIFY(material != nullptr);
+        const QColor baseColorFactor = material->baseColorFactor();
+
+        // WHEN -> the material is renamed and changed
+        const QJsonObject pbr{ { QStringLiteral("baseColorFactor"), QJsonArray{ 0.0, 1.0, 0.0, 1.0 } } };
+        setArrayItemValue(document, QStringLiteral("materials"), 0, QStringLiteral("pbrMetallicRoughness"), pbr);
+        setArrayItemValue(document, QStringLiteral("materials"), 0, QStringLiteral("name"), QStringLiteral("Green"));
+        SceneUpdater::Statistics statistics;
+        bool updated = update(&context, parser.nodeEntities(), document, statistics);
+
+        // THEN -> nothing changes, the file has to be loaded again
+        QVERIFY(!updated);
+        QCOMPARE(material->baseColorFactor(), baseColorFactor);
+
+        // WHEN -> a node is added to a scene
+        document = readDocument(QStringLiteral(ASSETS "scenes.gltf"));
+        setArrayItemValue(document, QStringLiteral("scenes"), 1, QStringLiteral("nodes"), QJsonArray{ 0, 1 });
+        updated = update(&context, parser.nodeEntities(), document, statistics);
+
+        // THEN
+        QVERIFY(!updated);
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_SceneUpdater)
+
+#include "tst_sceneupdater.moc"
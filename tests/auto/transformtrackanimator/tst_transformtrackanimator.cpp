@@ -0,0 +1,294 @@
+/*
+    tst_transformtrackanimator.cpp
+
+    This file is part of Kuesa.
+
+    Copyright (C) 2018 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+    Author: Mike Krus <mike.krus@kdab.com>
+
+    Licensees holding valid proprietary KDAB Kuesa licenses may use this file in
+    accordance with the Kuesa Enterprise License Agreement provided with the Software in the
+    LICENSE.KUESA.ENTERPRISE file.
+
+    Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest/QtTest>
+
+#include <Kuesa/sceneentity.h>
+#include <Kuesa/private/transformtrackanimator_p.h>
+#include <Kuesa/private/gltf2parser_p.h>
+#include <Qt3DCore/QEntity>
+#include <Qt3DCore/QTransform>
+#include <Qt3DCore/QJoint>
+#include <Qt3DAnimation/QAnimationClip>
+#include <Qt3DAnimation/QChannelMapping>
+
+using namespace Kuesa;
+
+namespace {
+
+Qt3DAnimation::QChannel linearChannel(const QString &name, const QStringList &componentNames,
+                                      const QVector<float> &startValues, const QVector<float> &endValues)
+{
+    Qt3DAnimation::QChannel channel(name);
+    for (int i = 0, m = componentNames.size(); i < m; ++i) {
+        Qt3DAnimation::QChannelComponent component(componentNames.at(i));
+        component.appendKeyFrame(Qt3DAnimation::QKeyFrame(QVector2D(0.0f, startValues.at(i))));
+        component.appendKeyFrame(Qt3DAnimation::QKeyFrame(QVector2D(1.0f, endValues.at(i))));
+        channel.appendChannelComponent(component);
+    }
+    return channel;
+}
+
+Qt3DAnimation::QChannel translationChannel(const QString &name, const QVector3D &end)
+{
+    return linearChannel(name,
+                         { QStringLiteral("X"), QStringLiteral("Y"), QStringLiteral("Z") },
+                         { 0.0f, 0.0f, 0.0f },
+                         { end.x(), end.y(), end.z() });
+}
+
+// Rotation components are stored with the scalar part first, like the glTF importer does
+Qt3DAnimation::QChannel rotationChannel(const QString &name, const QQuaternion &end)
+{
+    return linearChannel(name,
+                         { QStringLiteral("W"), QStringLiteral("X"), QStringLiteral("Y"), QStringLiteral("Z") },
+                         { 1.0f, 0.0f, 0.0f, 0.0f },
+                         { end.scalar(), end.x(), end.y(), end.z() });
+}
+
+Qt3DAnimation::QChannelMapping *mapping(const QString &channelName, Qt3DCore::QNode *target, const QString &property)
+{
+    auto channelMapping = new Qt3DAnimation::QChannelMapping();
+    channelMapping->setChannelName(channelName);
+    channelMapping->setTarget(target);
+    channelMapping->setProperty(property);
+    return channelMapping;
+}
+
+bool fuzzyCompare(const QQuaternion &a, const QQuaternion &b)
+{
+    return qAbs(QQuaternion::dotProduct(a, b)) > 0.9999f;
+}
+
+// Scene with transformCount animated transforms, each one with its own
+// translation and rotation channel
+struct AnimatedScene {
+    explicit AnimatedScene(int transformCount)
+    {
+        Qt3DAnimation::QAnimationClipData clipData;
+        for (int i = 0; i < transformCount; ++i) {
+            auto entity = new Qt3DCore::QEntity(&root);
+            auto transform = new Qt3DCore::QTransform();
+            entity->addComponent(transform);
+            transforms.push_back(transform);
+
+            const QString location = QStringLiteral("Location_%1").arg(i);
+            const QString rotation = QStringLiteral("Rotation_%1").arg(i);
+            clipData.appendChannel(translationChannel(location, QVector3D(float(i), 1.0f, 2.0f)));
+            clipData.appendChannel(rotationChannel(rotation, QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, float(i % 180))));
+            mapper.addMapping(mapping(location, transform, QStringLiteral("translation")));
+            mapper.addMapping(mapping(rotation, transform, QStringLiteral("rotation")));
+        }
+        clip.setClipData(clipData);
+    }
+
+    Qt3DCore::QEntity root;
+    Qt3DAnimation::QAnimationClip clip;
+    TransformTrackMapper mapper;
+    QVector<Qt3DCore::QTransform *> transforms;
+};
+
+} // namespace
+
+class tst_TransformTrackAnimator : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void checkTransformTracks()
+    {
+        // GIVEN
+        AnimatedScene scene(1);
+        TransformTrackAnimator animator;
+
+        // WHEN
+        const bool success = animator.setClip(&scene.clip, &scene.mapper);
+
+        // THEN
+        QVERIFY(success);
+        QCOMPARE(animator.trackCount(), 2);
+        QCOMPARE(animator.duration(), 1000);
+
+        // WHEN
+        animator.evaluate(0.5f);
+
+        // THEN
+        Qt3DCore::QTransform *transform = scene.transforms.first();
+        QCOMPARE(transform->translation(), QVector3D(0.0f, 0.5f, 1.0f));
+        QVERIFY(fuzzyCompare(transform->rotation(), QQuaternion()));
+    }
+
+    void checkSingleUpdatePerTransform()
+    {
+        // GIVEN
+        AnimatedScene scene(1);
+        Qt3DCore::QTransform *transform = scene.transforms.first();
+        transform->setScale3D(QVector3D(2.0f, 2.0f, 2.0f));
+        TransformTrackAnimator animator;
+        QVERIFY(animator.setClip(&scene.clip, &scene.mapper));
+        QSignalSpy matrixSpy(transform, SIGNAL(matrixChanged()));
+
+        // WHEN
+        animator.evaluate(0.5f);
+
+        // THEN -> translation and rotation are applied as one matrix
+        // and the scale, which has no channel, is kept
+        QCOMPARE(matrixSpy.count(), 1);
+        QCOMPARE(transform->translation(), QVector3D(0.0f, 0.5f, 1.0f));
+        QCOMPARE(transform->scale3D(), QVector3D(2.0f, 2.0f, 2.0f));
+    }
+
+    void checkRotationIsNormalized()
+    {
+        // GIVEN
+        Qt3DCore::QEntity root;
+        auto transform = new Qt3DCore::QTransform(&root);
+        Qt3DAnimation::QAnimationClip clip;
+        Qt3DAnimation::QAnimationClipData clipData;
+        clipData.appendChannel(rotationChannel(QStringLiteral("Rotation"), QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, 90.0f)));
+        clip.setClipData(clipData);
+        TransformTrackMapper mapper;
+        mapper.addMapping(mapping(QStringLiteral("Rotation"), transform, QStringLiteral("rotation")));
+        TransformTrackAnimator animator;
+
+        // WHEN
+        QVERIFY(animator.setClip(&clip, &mapper));
+        animator.evaluate(0.5f);
+
+        // THEN
+        QVERIFY(qFuzzyCompare(transform->rotation().length(), 1.0f));
+        QVERIFY(fuzzyCompare(transform->rotation(), QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, 45.0f)));
+    }
+
+    void checkJointTracks()
+    {
+        // GIVEN
+        Qt3DCore::QJoint joint;
+        Qt3DAnimation::QAnimationClip clip;
+        Qt3DAnimation::QAnimationClipData clipData;
+        clipData.appendChannel(translationChannel(QStringLiteral("Scale"), QVector3D(2.0f, 4.0f, 6.0f)));
+        clip.setClipData(clipData);
+        TransformTrackMapper mapper;
+        mapper.addMapping(mapping(QStringLiteral("Scale"), &joint, QStringLiteral("scale")));
+        TransformTrackAnimator animator;
+
+        // WHEN
+        QVERIFY(animator.setClip(&clip, &mapper));
+        animator.evaluate(1.0f);
+
+        // THEN
+        QCOMPARE(animator.trackCount(), 1);
+        QCOMPARE(joint.scale(), QVector3D(2.0f, 4.0f, 6.0f));
+    }
+
+    void checkUnsupportedMapping()
+    {
+        // GIVEN
+        Qt3DCore::QEntity entity;
+        Qt3DAnimation::QAnimationClip clip;
+        Qt3DAnimation::QAnimationClipData clipData;
+        clipData.appendChannel(translationChannel(QStringLiteral("Location"), QVector3D(1.0f, 1.0f, 1.0f)));
+        clip.setClipData(clipData);
+        TransformTrackMapper mapper;
+        mapper.addMapping(mapping(QStringLiteral("Location"), &entity, QStringLiteral("objectName")));
+        TransformTrackAnimator animator;
+
+        // WHEN
+        const bool success = animator.setClip(&clip, &mapper);
+
+        // THEN
+        QVERIFY(!success);
+        QCOMPARE(animator.trackCount(), 0);
+    }
+
+    void checkNormalizedTime()
+    {
+        // GIVEN
+        AnimatedScene scene(1);
+        TransformTrackAnimator animator;
+        QVERIFY(animator.setClip(&scene.clip, &scene.mapper));
+
+        // WHEN
+        animator.setNormalizedTime(0.25f);
+
+        // THEN
+        QCOMPARE(animator.normalizedTime(), 0.25f);
+        QCOMPARE(scene.transforms.first()->translation(), QVector3D(0.0f, 0.25f, 0.5f));
+    }
+
+    void checkImporterCreatesTransformTrackMappers()
+    {
+        // GIVEN
+        SceneEntity scene;
+        GLTF2Import::GLTF2Parser parser(&scene, true);
+        parser.setTransformTrackAnimations(true);
+
+        // WHEN
+        Qt3DCore::QEntity *res = parser.parse(QString(ASSETS "animated_cube_lot_rot_scale.gltf"));
+
+        // THEN
+        QVERIFY(res != nullptr);
+        const QStringList names = scene.animationMappings()->names();
+        QVERIFY(!names.isEmpty());
+        for (const QString &name : names)
+            QVERIFY(qobject_cast<TransformTrackMapper *>(scene.animationMapping(name)) != nullptr);
+        delete res;
+    }
+
+    void benchmarkEvaluation_data()
+    {
+        QTest::addColumn<int>("transformCount");
+
+        QTest::newRow("100 transforms") << 100;
+        QTest::newRow("5000 transforms") << 5000;
+    }
+
+    void benchmarkEvaluation()
+    {
+        // GIVEN
+        QFETCH(int, transformCount);
+        AnimatedScene scene(transformCount);
+        TransformTrackAnimator animator;
+        QVERIFY(animator.setClip(&scene.clip, &scene.mapper));
+        QCOMPARE(animator.trackCount(), 2 * transformCount);
+        QCOMPARE(animator.duration(), 1000);
+
+        // THEN -> per frame path of a playing clip, from the current
+        // time to the updated transforms
+        int currentTime = 0;
+        QBENCHMARK {
+            animator.setCurrentTime(currentTime);
+            currentTime = (currentTime + 16) % 1000;
+        }
+    }
+};
+
+QTEST_MAIN(tst_TransformTrackAnimator)
+
+#include "tst_transformtrackanimator.moc"
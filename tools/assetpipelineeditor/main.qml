@@ -176,4 +176,9 @@ Kuesa.SceneEntity {
 
         onStatusChanged: _mainWindow.updateScene(scene)
     }
+
+    Connections {
+        target: _mainWindow
+        onReloadRequested: gltf2importer.reload()
+    }
 }
@@ -339,11 +339,13 @@ void MainWindow::openFile()
 
 void MainWindow::reloadFile()
 {
-    // clear filepath, emit, then set the old filepath which will force a reload
-    QString c = QUrl(m_filePathURL).toLocalFile();
-    m_filePathURL.clear();
-    emit filePathChanged(m_filePathURL);
-    setFilePath(c);
+    // the importer only updates what changed when it can, otherwise it
+    // destroys the previous assets, which must not be inspected anymore
+    if (m_filePathURL.isEmpty())
+        return;
+    m_assetInspector->clear();
+    m_ui->actionReload->setEnabled(false);
+    emit reloadRequested();
 }
 
 void MainWindow::about()
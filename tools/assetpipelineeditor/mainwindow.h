@@ -79,6 +79,7 @@ signals:
     void activeCameraChanged(int activeCamera);
     void clearColorChanged(QColor clearColor);
     void renderAreaSizeChanged(QSize renderAreaSize);
+    void reloadRequested();
 
 protected:
     void closeEvent(QCloseEvent *event) override;